@@ -57,6 +57,7 @@ namespace fizzy
       case ValType::i64: return "64-bit integer";
       case ValType::f32: return "32-bit floating point";
       case ValType::f64: return "64-bit floating point";
+      case ValType::v128: return "128-bit vector";
       }
     }
 
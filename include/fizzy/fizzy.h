@@ -60,6 +60,9 @@ typedef struct FizzyModule FizzyModule;
 /// The opaque data type representing an instance (instantiated module).
 typedef struct FizzyInstance FizzyInstance;
 
+/// The opaque data type representing a cache of parsed modules.
+typedef struct FizzyModuleCache FizzyModuleCache;
+
 /// The data type representing numeric values.
 typedef union FizzyValue
 {
@@ -84,6 +87,11 @@ typedef struct FizzyExecutionResult
     /// Value returned from a function.
     /// Valid only if #has_value equals true.
     FizzyValue value;
+    /// Whether execution has been stopped by the interrupt request,
+    /// see fizzy_set_execution_context_interrupt_requested().
+    /// The interrupted execution is also trapped.
+    /// Ignored in results of host functions if #trapped equals false.
+    bool interrupted;
 } FizzyExecutionResult;
 
 /// The opaque data type representing an execution context.
@@ -111,6 +119,9 @@ static const FizzyValueType FizzyValueTypeI32 = 0x7f;
 static const FizzyValueType FizzyValueTypeI64 = 0x7e;
 static const FizzyValueType FizzyValueTypeF32 = 0x7d;
 static const FizzyValueType FizzyValueTypeF64 = 0x7c;
+/// 128-bit vector value. It occupies 2 consecutive ::FizzyValue items, the low half first,
+/// in the arguments, the results and the globals.
+static const FizzyValueType FizzyValueTypeV128 = 0x7b;
 /// Special value, can be used only as function output type.
 static const FizzyValueType FizzyValueTypeVoid = 0;
 
@@ -118,6 +129,8 @@ static const FizzyValueType FizzyValueTypeVoid = 0;
 typedef struct FizzyFunctionType
 {
     /// Output type, equals to ::FizzyValueTypeVoid iff function has no output.
+    /// The first output type for functions with multiple outputs,
+    /// see fizzy_get_function_outputs().
     FizzyValueType output;
     /// Pointer to input types array.
     const FizzyValueType* inputs;
@@ -299,9 +312,49 @@ void fizzy_free_module(const FizzyModule* module) FIZZY_NOEXCEPT;
 ///
 /// @note  Creating a copy is needed if more than single instance of a module is required, because
 /// instantiation takes ownership of a module, and the same module cannot be instantiated twice.
+/// @note  Modules are immutable, so the copy shares the parsed module data with @p module and
+/// the cost of copying does not depend on the module size. The shared data is released when
+/// the last copy and the last instance using it are freed.
 /// @note  Input module is not modified neither in success nor in failure case.
 const FizzyModule* fizzy_clone_module(const FizzyModule* module) FIZZY_NOEXCEPT;
 
+/// Create a cache of parsed modules.
+///
+/// The cache keys modules by the content of their binaries and evicts the least recently used
+/// ones when the total cost of the cached modules exceeds @p capacity. The cost of a module is
+/// the size of its binary plus the size of its translated code and its initial memory image.
+/// The cache can be used from multiple threads concurrently.
+///
+/// @param  capacity    The budget of the cache in bytes.
+/// @return             Pointer to the cache, or NULL in case memory could not be allocated.
+FizzyModuleCache* fizzy_create_module_cache(size_t capacity) FIZZY_NOEXCEPT;
+
+/// Free the module cache.
+///
+/// @param  cache    Pointer to the cache. If NULL is passed, function has no effect.
+///
+/// @note  The modules obtained from the cache are not affected.
+void fizzy_free_module_cache(FizzyModuleCache* cache) FIZZY_NOEXCEPT;
+
+/// Parse binary module using the module cache.
+///
+/// If the cache contains a module parsed from the same binary, the returned module shares it,
+/// otherwise the binary is parsed and the module is added to the cache.
+///
+/// @param  cache               Pointer to the cache. Cannot be NULL.
+/// @param  wasm_binary         Pointer to module binary data.
+/// @param  wasm_binary_size    Size of the module binary data.
+/// @param  error               Pointer to store detailed error information at. Can be NULL if error
+///                             information is not required.
+/// @return                     non-NULL pointer to module in case of success, NULL otherwise.
+///
+/// @note  The returned module is owned by the caller in the same way as the result of
+///        fizzy_parse(), i.e. it must be passed to fizzy_free_module() or fizzy_instantiate().
+/// @note  FizzyError::code will be ::FizzySuccess if function returns non-NULL
+///        will and will not be ::FizzySuccess otherwise.
+const FizzyModule* fizzy_parse_cached(FizzyModuleCache* cache, const uint8_t* wasm_binary,
+    size_t wasm_binary_size, FizzyError* error) FIZZY_NOEXCEPT;
+
 /// Get number of types defined in the module.
 ///
 /// @param  module    Pointer to module. Cannot be NULL.
@@ -346,6 +399,16 @@ FizzyImportDescription fizzy_get_import_description(
 FizzyFunctionType fizzy_get_function_type(
     const FizzyModule* module, uint32_t func_idx) FIZZY_NOEXCEPT;
 
+/// Get all output types of the function defined in the module.
+///
+/// @param  module         Pointer to module. Cannot be NULL.
+/// @param  func_idx       Function index, as in fizzy_get_function_type().
+/// @param  out_outputs    Pointer to store the pointer to the output types array, valid as long as
+///                        the module. Cannot be NULL.
+/// @return                Number of the output types.
+size_t fizzy_get_function_outputs(const FizzyModule* module, uint32_t func_idx,
+    const FizzyValueType** out_outputs) FIZZY_NOEXCEPT;
+
 /// Check whether module has a table.
 ///
 /// @param  module          Pointer to module. Cannot be NULL.
@@ -607,6 +670,27 @@ int* fizzy_get_execution_context_depth(FizzyExecutionContext* ctx) FIZZY_NOEXCEP
 
 int64_t* fizzy_get_execution_context_ticks(FizzyExecutionContext* ctx) FIZZY_NOEXCEPT;
 
+/// Requests the executions running in the context to stop, or clears the request.
+///
+/// @param  ctx         Pointer to execution context. Cannot be NULL.
+/// @param  requested   Whether to stop the executions.
+///
+/// @note
+/// It can be called from another thread, e.g. a timer, while the execution runs. The execution
+/// then ends with the trap and the FizzyExecutionResult::interrupted flag set. The request is not
+/// cleared by the execution, so all following executions in the context are stopped until it is
+/// cleared.
+void fizzy_set_execution_context_interrupt_requested(
+    FizzyExecutionContext* ctx, bool requested) FIZZY_NOEXCEPT;
+
+/// Returns whether the stop of the executions running in the context has been requested,
+/// see fizzy_set_execution_context_interrupt_requested().
+///
+/// @param  ctx         Pointer to execution context. Cannot be NULL.
+/// @return             true if the interrupt has been requested, false otherwise.
+bool fizzy_get_execution_context_interrupt_requested(
+    const FizzyExecutionContext* ctx) FIZZY_NOEXCEPT;
+
 /// Execute module function.
 ///
 /// @param  instance    Pointer to module instance. Cannot be NULL.
@@ -619,9 +703,37 @@ int64_t* fizzy_get_execution_context_ticks(FizzyExecutionContext* ctx) FIZZY_NOE
 /// No validation is done on the number of arguments passed in @p args, nor on their types.
 /// When number of passed arguments or their types are different from the ones defined by the
 /// function type, behaviour is undefined.
+///
+/// @note
+/// The function must have at most one output, which is not v128. A function with more outputs
+/// is not executed and the trap is reported, use fizzy_execute_multi() for such functions.
 FizzyExecutionResult fizzy_execute(FizzyInstance* instance, uint32_t func_idx,
     const FizzyValue* args, FizzyExecutionContext* ctx) FIZZY_NOEXCEPT;
 
+/// Execute module function with any number of results.
+///
+/// @param  instance    Pointer to module instance. Cannot be NULL.
+/// @param  args        Pointer to the argument array. Can be NULL if function has 0 inputs.
+/// @param  results     Pointer to the array for the results, of the size equal to the number of
+///                     the function outputs, see fizzy_get_function_outputs(). Each v128 output
+///                     occupies 2 items, see ::FizzyValueTypeV128.
+///                     Can be NULL if function has 0 outputs.
+///                     The results are not written if execution ends with a trap.
+/// @param  ctx         Opaque pointer to execution context. If NULL new execution context
+///                     will be allocated.
+/// @return             false if execution ended with a trap, true otherwise.
+///
+/// @note
+/// No validation is done on the number of arguments passed in @p args, nor on their types,
+/// see fizzy_execute().
+///
+/// @note
+/// The execution stopped by the interrupt request also returns false. It can be told apart from
+/// other traps with fizzy_get_execution_context_interrupt_requested(), as the request is not
+/// cleared by the execution.
+bool fizzy_execute_multi(FizzyInstance* instance, uint32_t func_idx, const FizzyValue* args,
+    FizzyValue* results, FizzyExecutionContext* ctx) FIZZY_NOEXCEPT;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,100 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "suspend.hpp"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <optional>
+#include <utility>
+
+namespace fizzy
+{
+/// The execution context of an execution awaited in a C++20 coroutine, see execute_async().
+class AsyncExecutionContext : public ExecutionContext
+{
+    friend class ExecutionAwaiter;
+    friend void resume_async(AsyncExecutionContext& ctx, const Value* results) noexcept;
+
+    std::coroutine_handle<> m_awaiting;
+    std::optional<ExecutionResult> m_result;
+};
+
+/// The awaitable suspendable execution, see execute_async().
+class ExecutionAwaiter
+{
+    Instance& m_instance;
+    FuncIdx m_func_idx;
+    const Value* m_args;
+    Value* m_results;
+    AsyncExecutionContext& m_ctx;
+
+public:
+    ExecutionAwaiter(Instance& instance, FuncIdx func_idx, const Value* args, Value* results,
+        AsyncExecutionContext& ctx) noexcept
+      : m_instance{instance}, m_func_idx{func_idx}, m_args{args}, m_results{results}, m_ctx{ctx}
+    {}
+
+    bool await_ready() const noexcept { return false; }
+
+    /// Starts the execution, and keeps the coroutine suspended if the execution is suspended.
+    /// The awaiting coroutine is set before, as the execution may be resumed right away.
+    bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        m_ctx.m_awaiting = awaiting;
+        const auto result = execute_suspendable(m_instance, m_func_idx, m_args, m_results, m_ctx);
+        if (result.suspended)
+            return true;
+
+        m_ctx.m_awaiting = {};
+        m_ctx.m_result.emplace(result);
+        return false;
+    }
+
+    ExecutionResult await_resume() noexcept
+    {
+        const auto result = *m_ctx.m_result;
+        m_ctx.m_result.reset();
+        return result;
+    }
+};
+
+/// Executes a function like execute_suspendable() in a C++20 coroutine:
+///
+///     const auto result = co_await execute_async(instance, func_idx, args, results, ctx);
+///
+/// The coroutine stays suspended while a host function has suspended the execution. The host
+/// resumes the execution with resume_async() when its operation completes, e.g. from a callback
+/// of the event loop, and the coroutine is resumed in that call once the execution finishes.
+/// This way many executions are multiplexed over the threads running the event loop.
+///
+/// @param  instance    The instance, as in execute_suspendable().
+/// @param  func_idx    The function index, as in execute_suspendable().
+/// @param  args        The pointer to the arguments, as in execute_suspendable().
+/// @param  results     The pointer to the array for the results, as in execute_suspendable().
+/// @param  ctx         The execution context, also passed to the host functions.
+/// @return             The awaitable of the result of the execution: Void, Trap or Interrupted.
+inline ExecutionAwaiter execute_async(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, AsyncExecutionContext& ctx) noexcept
+{
+    return {instance, func_idx, args, results, ctx};
+}
+
+/// Resumes the execution awaited with execute_async(), see resume().
+/// If the execution finishes, the awaiting coroutine is resumed before this returns.
+inline void resume_async(AsyncExecutionContext& ctx, const Value* results) noexcept
+{
+    const auto result = resume(ctx, results);
+    if (result.suspended)
+        return;
+
+    ctx.m_result.emplace(result);
+    std::exchange(ctx.m_awaiting, {}).resume();
+}
+}  // namespace fizzy
+
+#endif /* __cpp_impl_coroutine */
@@ -0,0 +1,121 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "atomic_wait.hpp"
+#include "cxx20/atomic_ref.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+
+namespace fizzy
+{
+namespace
+{
+struct Waiter
+{
+    const void* address = nullptr;
+    std::condition_variable cv;
+    bool notified = false;
+};
+
+/// The queue of the threads waiting at the addresses hashed to it, in the order of their waits.
+struct WaitQueue
+{
+    std::mutex mutex;
+    std::list<Waiter*> waiters;
+};
+
+constexpr size_t NumWaitQueues = 64;
+
+WaitQueue& get_wait_queue(const void* address) noexcept
+{
+    static WaitQueue queues[NumWaitQueues];
+    // The waits are at least 4-byte aligned, so the lowest bits are not hashed.
+    return queues[(reinterpret_cast<uintptr_t>(address) >> 2) % NumWaitQueues];
+}
+
+template <typename T>
+WaitResult wait(T* address, T expected, int64_t timeout_ns,
+    const std::atomic<bool>& interrupt_requested) noexcept
+{
+    auto& queue = get_wait_queue(address);
+    std::unique_lock lock{queue.mutex};
+
+    // The value is loaded under the lock, so the notify following the store of a new value
+    // in another thread cannot be missed.
+    if (atomic_ref<T>{*address}.load() != expected)
+        return WaitResult::not_equal;
+
+    Waiter waiter;
+    waiter.address = address;
+    const auto it = queue.waiters.insert(queue.waiters.end(), &waiter);
+
+    using clock = std::chrono::steady_clock;
+    const auto now = clock::now();
+    const auto timeout = std::chrono::nanoseconds{timeout_ns};
+    // The timeouts not representable as the deadline are treated as infinite.
+    const auto deadline = (timeout_ns < 0 || timeout >= clock::time_point::max() - now) ?
+                              clock::time_point::max() :
+                              now + timeout;
+    constexpr auto poll_interval = std::chrono::milliseconds{WaitInterruptPollIntervalMs};
+
+    // The interrupt request does not notify the waiters, so the wait is sliced to poll it.
+    // The notified waiter is removed from the queue by atomic_notify().
+    while (!waiter.notified)
+    {
+        if (interrupt_requested.load(std::memory_order_relaxed))
+        {
+            queue.waiters.erase(it);
+            return WaitResult::interrupted;
+        }
+
+        const auto slice_start = clock::now();
+        if (slice_start >= deadline)
+        {
+            queue.waiters.erase(it);
+            return WaitResult::timed_out;
+        }
+        const auto slice_end =
+            deadline - slice_start > poll_interval ? slice_start + poll_interval : deadline;
+        waiter.cv.wait_until(lock, slice_end);
+    }
+    return WaitResult::ok;
+}
+}  // namespace
+
+WaitResult atomic_wait(uint32_t* address, uint32_t expected, int64_t timeout_ns,
+    const std::atomic<bool>& interrupt_requested) noexcept
+{
+    return wait(address, expected, timeout_ns, interrupt_requested);
+}
+
+WaitResult atomic_wait(uint64_t* address, uint64_t expected, int64_t timeout_ns,
+    const std::atomic<bool>& interrupt_requested) noexcept
+{
+    return wait(address, expected, timeout_ns, interrupt_requested);
+}
+
+uint32_t atomic_notify(const uint8_t* address, uint32_t count) noexcept
+{
+    auto& queue = get_wait_queue(address);
+    const std::lock_guard lock{queue.mutex};
+
+    uint32_t num_woken = 0;
+    for (auto it = queue.waiters.begin(); it != queue.waiters.end() && num_woken < count;)
+    {
+        auto& waiter = **it;
+        if (waiter.address != address)
+        {
+            ++it;
+            continue;
+        }
+        waiter.notified = true;
+        waiter.cv.notify_one();
+        it = queue.waiters.erase(it);
+        ++num_woken;
+    }
+    return num_woken;
+}
+}  // namespace fizzy
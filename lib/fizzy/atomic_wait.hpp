@@ -0,0 +1,54 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace fizzy
+{
+/// The longest time the wait blocks without checking the interrupt request, in milliseconds.
+constexpr int64_t WaitInterruptPollIntervalMs = 10;
+
+/// The result of memory.atomic.wait32 and memory.atomic.wait64, as returned to the WebAssembly
+/// code.
+enum class WaitResult : uint32_t
+{
+    ok = 0,         ///< Woken by memory.atomic.notify.
+    not_equal = 1,  ///< The loaded value did not match the expected one.
+    timed_out = 2,  ///< Not woken before the timeout.
+    /// The wait has been stopped by the interrupt request. Not returned to the WebAssembly code,
+    /// the execution is interrupted instead.
+    interrupted = 3,
+};
+
+/// Implements memory.atomic.wait32: if the value at the address equals @a expected, suspends
+/// the thread until it is woken by atomic_notify() for the same address or the timeout passes.
+///
+/// The waiting threads are kept in the process-wide queues keyed by the address, like futexes,
+/// so the instances sharing the memory wake each other. The address must be 4-byte aligned.
+///
+/// The wait is split into slices of at most WaitInterruptPollIntervalMs, which poll
+/// @a interrupt_requested, so also the wait without a timeout can be interrupted.
+///
+/// @param  address             The address in the shared memory.
+/// @param  expected            The expected value.
+/// @param  timeout_ns          The timeout in nanoseconds, or a negative value to wait without
+///                             a timeout.
+/// @param  interrupt_requested The flag stopping the wait, see
+///                             ExecutionContext::interrupt_requested.
+WaitResult atomic_wait(uint32_t* address, uint32_t expected, int64_t timeout_ns,
+    const std::atomic<bool>& interrupt_requested) noexcept;
+
+/// Implements memory.atomic.wait64, see the 32-bit variant. The address must be 8-byte aligned.
+WaitResult atomic_wait(uint64_t* address, uint64_t expected, int64_t timeout_ns,
+    const std::atomic<bool>& interrupt_requested) noexcept;
+
+/// Implements memory.atomic.notify: wakes up to @a count threads waiting at the address,
+/// in the order of their waits.
+///
+/// @return  The number of the woken threads.
+uint32_t atomic_notify(const uint8_t* address, uint32_t count) noexcept;
+}  // namespace fizzy
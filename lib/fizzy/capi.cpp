@@ -6,11 +6,20 @@
 #include "cxx23/utility.hpp"
 #include "execute.hpp"
 #include "instantiate.hpp"
+#include "module_cache.hpp"
 #include "parser.hpp"
 #include <fizzy/fizzy.h>
+#include <cassert>
 #include <cstring>
 #include <memory>
 
+/// The module handle of the C API.
+/// Each handle holds a reference to the shared immutable module, so cloning a handle is cheap.
+struct FizzyModule
+{
+    std::shared_ptr<const fizzy::Module> module;
+};
+
 namespace
 {
 inline void set_success(FizzyError* error) noexcept
@@ -85,14 +94,33 @@ inline void set_error_from_current_exception(FizzyError* error) noexcept
     }
 }
 
-inline const FizzyModule* wrap(const fizzy::Module* module) noexcept
+inline const fizzy::Module* unwrap(const FizzyModule* module) noexcept
 {
-    return reinterpret_cast<const FizzyModule*>(module);
+    return module->module.get();
 }
 
-inline const fizzy::Module* unwrap(const FizzyModule* module) noexcept
+/// The deleter of the module reference held by an instance created with the C API.
+/// The instance owns the module handle it was created from, so that the handle stays valid
+/// and can be returned by fizzy_get_instance_module().
+struct ModuleHandleDeleter
 {
-    return reinterpret_cast<const fizzy::Module*>(module);
+    const FizzyModule* handle = nullptr;
+
+    void operator()(const fizzy::Module* /*module*/) const noexcept { delete handle; }
+};
+
+/// Returns the module reference taking ownership of the module handle.
+inline std::shared_ptr<const fizzy::Module> take_module_handle(const FizzyModule* module)
+{
+    // In case of allocation failure the deleter is called, i.e. the ownership is always taken.
+    return {unwrap(module), ModuleHandleDeleter{module}};
+}
+
+inline const FizzyModule* get_module_handle(const fizzy::Instance& instance) noexcept
+{
+    const auto* deleter = std::get_deleter<ModuleHandleDeleter>(instance.module);
+    assert(deleter != nullptr);  // The instance must be created with the C API.
+    return deleter->handle;
 }
 
 static_assert(sizeof(FizzyValueType) == sizeof(fizzy::ValType));
@@ -100,6 +128,7 @@ static_assert(FizzyValueTypeI32 == fizzy::to_underlying(fizzy::ValType::i32));
 static_assert(FizzyValueTypeI64 == fizzy::to_underlying(fizzy::ValType::i64));
 static_assert(FizzyValueTypeF32 == fizzy::to_underlying(fizzy::ValType::f32));
 static_assert(FizzyValueTypeF64 == fizzy::to_underlying(fizzy::ValType::f64));
+static_assert(FizzyValueTypeV128 == fizzy::to_underlying(fizzy::ValType::v128));
 static_assert(FizzyValueTypeVoid == 0);
 static_assert(std::is_same_v<decltype(fizzy::to_underlying(fizzy::ValType::i32)),
     std::remove_const<decltype(FizzyValueTypeI32)>::type>);
@@ -176,6 +205,21 @@ inline fizzy::ExecutionContext* unwrap(FizzyExecutionContext* ctx) noexcept
     return reinterpret_cast<fizzy::ExecutionContext*>(ctx);
 }
 
+inline const fizzy::ExecutionContext* unwrap(const FizzyExecutionContext* ctx) noexcept
+{
+    return reinterpret_cast<const fizzy::ExecutionContext*>(ctx);
+}
+
+inline FizzyModuleCache* wrap(fizzy::ModuleCache* cache) noexcept
+{
+    return reinterpret_cast<FizzyModuleCache*>(cache);
+}
+
+inline fizzy::ModuleCache* unwrap(FizzyModuleCache* cache) noexcept
+{
+    return reinterpret_cast<fizzy::ModuleCache*>(cache);
+}
+
 inline FizzyInstance* wrap(fizzy::Instance* instance) noexcept
 {
     return reinterpret_cast<FizzyInstance*>(instance);
@@ -188,13 +232,13 @@ inline fizzy::Instance* unwrap(FizzyInstance* instance) noexcept
 
 inline FizzyExecutionResult wrap(const fizzy::ExecutionResult& result) noexcept
 {
-    return {result.trapped, result.has_value, wrap(result.value)};
+    return {result.trapped, result.has_value, wrap(result.value), result.interrupted};
 }
 
 inline fizzy::ExecutionResult unwrap(const FizzyExecutionResult& result) noexcept
 {
     if (result.trapped)
-        return fizzy::Trap;
+        return result.interrupted ? fizzy::Interrupted : fizzy::Trap;
     else if (!result.has_value)
         return fizzy::Void;
     else
@@ -446,7 +490,7 @@ bool fizzy_validate(const uint8_t* wasm_binary, size_t wasm_binary_size, FizzyEr
 {
     try
     {
-        fizzy::parse({wasm_binary, wasm_binary_size});
+        fizzy::validate({wasm_binary, wasm_binary_size});
         set_success(error);
         return true;
     }
@@ -463,8 +507,9 @@ const FizzyModule* fizzy_parse(
     try
     {
         auto module = fizzy::parse({wasm_binary, wasm_binary_size});
+        auto* c_module = new FizzyModule{std::move(module)};
         set_success(error);
-        return wrap(module.release());
+        return c_module;
     }
     catch (...)
     {
@@ -475,15 +520,15 @@ const FizzyModule* fizzy_parse(
 
 void fizzy_free_module(const FizzyModule* module) noexcept
 {
-    delete unwrap(module);
+    delete module;
 }
 
 const FizzyModule* fizzy_clone_module(const FizzyModule* module) noexcept
 {
     try
     {
-        auto clone = std::make_unique<fizzy::Module>(*unwrap(module));
-        return wrap(clone.release());
+        // The module is immutable, the clone is a new handle sharing it.
+        return new FizzyModule{*module};
     }
     catch (...)
     {
@@ -491,6 +536,40 @@ const FizzyModule* fizzy_clone_module(const FizzyModule* module) noexcept
     }
 }
 
+FizzyModuleCache* fizzy_create_module_cache(size_t capacity) noexcept
+{
+    try
+    {
+        return wrap(new fizzy::ModuleCache{capacity});
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void fizzy_free_module_cache(FizzyModuleCache* cache) noexcept
+{
+    delete unwrap(cache);
+}
+
+const FizzyModule* fizzy_parse_cached(FizzyModuleCache* cache, const uint8_t* wasm_binary,
+    size_t wasm_binary_size, FizzyError* error) noexcept
+{
+    try
+    {
+        auto module = unwrap(cache)->get_or_parse({wasm_binary, wasm_binary_size});
+        auto* c_module = new FizzyModule{std::move(module)};
+        set_success(error);
+        return c_module;
+    }
+    catch (...)
+    {
+        set_error_from_current_exception(error);
+        return nullptr;
+    }
+}
+
 uint32_t fizzy_get_type_count(const FizzyModule* module) noexcept
 {
     return static_cast<uint32_t>(unwrap(module)->typesec.size());
@@ -518,6 +597,14 @@ FizzyFunctionType fizzy_get_function_type(const FizzyModule* module, uint32_t fu
     return wrap(unwrap(module)->get_function_type(func_idx));
 }
 
+size_t fizzy_get_function_outputs(
+    const FizzyModule* module, uint32_t func_idx, const FizzyValueType** out_outputs) noexcept
+{
+    const auto& outputs = unwrap(module)->get_function_type(func_idx).outputs;
+    *out_outputs = wrap(outputs.data());
+    return outputs.size();
+}
+
 bool fizzy_module_has_table(const FizzyModule* module) noexcept
 {
     return unwrap(module)->has_table();
@@ -634,9 +721,8 @@ FizzyInstance* fizzy_instantiate(const FizzyModule* module,
         auto memory = unwrap(imported_memory);
         auto globals = unwrap(imported_globals, imported_globals_size);
 
-        auto instance = fizzy::instantiate(std::unique_ptr<const fizzy::Module>(unwrap(module)),
-            std::move(functions), std::move(table), std::move(memory), std::move(globals),
-            memory_pages_limit);
+        auto instance = fizzy::instantiate(take_module_handle(module), std::move(functions),
+            std::move(table), std::move(memory), std::move(globals), memory_pages_limit);
 
         set_success(error);
         return wrap(instance.release());
@@ -661,12 +747,12 @@ FizzyInstance* fizzy_resolve_instantiate(const FizzyModule* c_module,
         auto memory = unwrap(imported_memory);
         auto imported_globals = unwrap(c_imported_globals, imported_globals_size);
 
-        std::unique_ptr<const fizzy::Module> module{unwrap(c_module)};
+        const auto module = take_module_handle(c_module);
         auto resolved_imports = fizzy::resolve_imported_functions(*module, imported_functions);
         auto resolved_globals = fizzy::resolve_imported_globals(*module, imported_globals);
 
-        auto instance = fizzy::instantiate(std::move(module), std::move(resolved_imports),
-            std::move(table), std::move(memory), std::move(resolved_globals), memory_pages_limit);
+        auto instance = fizzy::instantiate(module, std::move(resolved_imports), std::move(table),
+            std::move(memory), std::move(resolved_globals), memory_pages_limit);
 
         set_success(error);
         return wrap(instance.release());
@@ -685,7 +771,7 @@ void fizzy_free_instance(FizzyInstance* instance) noexcept
 
 const FizzyModule* fizzy_get_instance_module(FizzyInstance* instance) noexcept
 {
-    return wrap(unwrap(instance)->module.get());
+    return get_module_handle(*unwrap(instance));
 }
 
 uint8_t* fizzy_get_instance_memory_data(FizzyInstance* instance) noexcept
@@ -737,6 +823,17 @@ int64_t* fizzy_get_execution_context_ticks(FizzyExecutionContext* c_ctx) noexcep
     return &unwrap(c_ctx)->ticks;
 }
 
+void fizzy_set_execution_context_interrupt_requested(
+    FizzyExecutionContext* c_ctx, bool requested) noexcept
+{
+    unwrap(c_ctx)->interrupt_requested = requested;
+}
+
+bool fizzy_get_execution_context_interrupt_requested(const FizzyExecutionContext* c_ctx) noexcept
+{
+    return unwrap(c_ctx)->interrupt_requested;
+}
+
 FizzyExecutionResult fizzy_execute(FizzyInstance* c_instance, uint32_t func_idx,
     const FizzyValue* c_args, FizzyExecutionContext* c_ctx) noexcept
 {
@@ -748,4 +845,16 @@ FizzyExecutionResult fizzy_execute(FizzyInstance* c_instance, uint32_t func_idx,
     return wrap(result);
 }
 
+bool fizzy_execute_multi(FizzyInstance* c_instance, uint32_t func_idx, const FizzyValue* c_args,
+    FizzyValue* c_results, FizzyExecutionContext* c_ctx) noexcept
+{
+    auto* instance = unwrap(c_instance);
+    const auto* args = unwrap(c_args);
+    auto* results = unwrap(c_results);
+    const auto result =
+        (c_ctx == nullptr ? fizzy::execute(*instance, func_idx, args, results) :
+                            fizzy::execute(*instance, func_idx, args, results, *unwrap(c_ctx)));
+    return !result.trapped;
+}
+
 }  // extern "C"
@@ -0,0 +1,311 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "checkpoint.hpp"
+#include "instructions.hpp"
+#include "parser.hpp"
+#include <cstring>
+#include <tuple>
+
+namespace fizzy
+{
+namespace
+{
+/// The magic bytes and the version of the serialized checkpoint.
+constexpr uint8_t CheckpointMagic[]{0x00, 'f', 'z', 'c'};
+constexpr uint32_t CheckpointVersion = 2;
+
+/// Identifies the module of the checkpoint, whose functions the frames refer to. The code offsets
+/// of the frames are relative to the functions' code, so the module parsed with another code
+/// layout matches too.
+uint64_t get_module_fingerprint(const Module& module) noexcept
+{
+    return module.binary_hash;
+}
+
+class Writer
+{
+    bytes m_output;
+
+public:
+    template <typename T>
+    void write(T value)
+    {
+        const auto* const data = reinterpret_cast<const uint8_t*>(&value);
+        m_output.append(data, sizeof(value));
+    }
+
+    void write_values(const std::vector<Value>& values)
+    {
+        write(static_cast<uint32_t>(values.size()));
+        for (const auto& value : values)
+            write(value.i64);
+    }
+
+    void write_bytes(bytes_view data)
+    {
+        write(static_cast<uint64_t>(data.size()));
+        m_output.append(data);
+    }
+
+    bytes output() noexcept { return std::move(m_output); }
+};
+
+class Reader
+{
+    const uint8_t* m_pos;
+    const uint8_t* const m_end;
+
+    void require(uint64_t size) const
+    {
+        if (size > static_cast<uint64_t>(m_end - m_pos))
+            throw parser_error{"unexpected end of checkpoint"};
+    }
+
+public:
+    explicit Reader(bytes_view input) noexcept : m_pos{input.data()}, m_end{m_pos + input.size()} {}
+
+    template <typename T>
+    T read()
+    {
+        require(sizeof(T));
+        T value;
+        std::memcpy(&value, m_pos, sizeof(value));
+        m_pos += sizeof(value);
+        return value;
+    }
+
+    /// Reads the number of the following items, checking the input has enough bytes for them,
+    /// so a malformed count does not cause a huge allocation.
+    uint32_t read_count(size_t item_size)
+    {
+        const auto count = read<uint32_t>();
+        require(uint64_t{count} * item_size);
+        return count;
+    }
+
+    std::vector<Value> read_values()
+    {
+        std::vector<Value> values(read_count(sizeof(uint64_t)));
+        for (auto& value : values)
+            value = read<uint64_t>();
+        return values;
+    }
+
+    bytes read_bytes()
+    {
+        const auto size = read<uint64_t>();
+        require(size);
+        bytes data{m_pos, static_cast<size_t>(size)};
+        m_pos += size;
+        return data;
+    }
+
+    bool at_end() const noexcept { return m_pos == m_end; }
+};
+
+/// Checks that the frame can be re-entered in the function of the module.
+void validate_frame(const Module& module, const CheckpointFrame& frame)
+{
+    if (frame.func_idx < module.imported_function_types.size() ||
+        frame.func_idx >= module.get_function_count())
+        throw instantiate_error{"checkpoint frame of invalid function"};
+
+    const auto& code = module.get_code(frame.func_idx);
+    if (frame.code_offset >= code.instructions_size)
+        throw instantiate_error{"checkpoint frame with invalid code offset"};
+
+    const auto num_locals =
+        get_num_slots(module.get_function_type(frame.func_idx).inputs) + code.local_count;
+    if (frame.locals.size() != num_locals)
+        throw instantiate_error{"checkpoint frame with invalid number of locals"};
+    if (frame.stack.size() > static_cast<size_t>(code.max_stack_height))
+        throw instantiate_error{"checkpoint frame with invalid stack height"};
+
+    // The frame can only continue at the start of a reachable instruction, with the stack height
+    // the instruction expects. Find the instruction walking the code along its stack heights.
+    const auto instructions = module.get_instructions(code);
+    const auto stack_heights = module.get_stack_heights(code);
+    const auto* const target = instructions.data() + frame.code_offset;
+    const auto* pos = instructions.data();
+    const auto* heights_pos = stack_heights.data();
+    const auto* const heights_end = heights_pos + stack_heights.size();
+    uint32_t stack_height_plus_1 = 0;
+    while (true)
+    {
+        if (pos > target || heights_pos == heights_end)
+            throw instantiate_error{"checkpoint frame with invalid code offset"};
+        std::tie(stack_height_plus_1, heights_pos) =
+            leb128u_decode<uint32_t>(heights_pos, heights_end);
+        if (pos == target)
+            break;
+        const auto [count, value_size] = get_immediates_layout(pos, code.immediate_size);
+        pos += 1 + count * code.immediate_size + value_size;
+    }
+    if (stack_height_plus_1 == 0)  // Unreachable instruction.
+        throw instantiate_error{"checkpoint frame with invalid code offset"};
+    if (frame.stack.size() != stack_height_plus_1 - 1)
+        throw instantiate_error{"checkpoint frame with invalid stack height"};
+}
+
+/// Checks that the frame continues with the call re-entering the next frame. The next frame may be
+/// of a tail callee of the called function, so only the results of the functions must match.
+void validate_call(const Module& module, const CheckpointFrame& frame,
+    const CheckpointFrame& next_frame)
+{
+    const auto& code = module.get_code(frame.func_idx);
+    const auto* const instr = module.get_instructions(code).data() + frame.code_offset;
+    const auto opcode = static_cast<Instr>(*instr);
+    if (opcode != Instr::call && opcode != Instr::call_indirect)
+        throw instantiate_error{"checkpoint frame is not at a call"};
+
+    // The callee's function index or type index, stored in Code::immediate_size bytes.
+    uint32_t callee_idx = instr[1];
+    if (code.immediate_size == sizeof(uint16_t))
+    {
+        uint16_t value;
+        std::memcpy(&value, instr + 1, sizeof(value));
+        callee_idx = value;
+    }
+    else if (code.immediate_size == sizeof(uint32_t))
+        std::memcpy(&callee_idx, instr + 1, sizeof(callee_idx));
+    const auto& callee_type = opcode == Instr::call ? module.get_function_type(callee_idx) :
+                                                      module.typesec[callee_idx];
+    if (callee_type.outputs != module.get_function_type(next_frame.func_idx).outputs)
+        throw instantiate_error{"checkpoint frame is not at a call of the next frame"};
+}
+}  // namespace
+
+bytes serialize_checkpoint(const Checkpoint& checkpoint)
+{
+    const auto& state = checkpoint.state;
+    const auto& module = *state.module;
+
+    Writer writer;
+    for (const auto byte : CheckpointMagic)
+        writer.write(byte);
+    writer.write(CheckpointVersion);
+    writer.write(CodeFormatVersion);
+    writer.write(get_module_fingerprint(module));
+    writer.write(checkpoint.ticks);
+
+    writer.write(uint8_t{state.memory.has_value()});
+    if (state.memory.has_value())
+        writer.write_bytes(*state.memory);
+
+    writer.write_values(state.globals);
+
+    writer.write(uint8_t{state.table.has_value()});
+    if (state.table.has_value())
+    {
+        writer.write(static_cast<uint32_t>(state.table->size()));
+        // The elements are stored as the function indices increased by 1, or 0 if not initialized.
+        for (const auto& element : *state.table)
+        {
+            if (element.instance == nullptr)
+                writer.write(uint32_t{0});
+            else if (element.instance == state.source)
+                writer.write(element.func_idx + 1);
+            else
+                throw instantiate_error{"checkpoint table refers to another instance"};
+        }
+    }
+
+    writer.write(static_cast<uint32_t>(state.dropped_data_segments.size()));
+    for (const auto dropped : state.dropped_data_segments)
+        writer.write(uint8_t{dropped});
+
+    writer.write(static_cast<uint32_t>(checkpoint.frames.size()));
+    for (const auto& frame : checkpoint.frames)
+    {
+        writer.write(frame.func_idx);
+        writer.write(frame.code_offset);
+        writer.write_values(frame.locals);
+        writer.write_values(frame.stack);
+    }
+
+    return writer.output();
+}
+
+Checkpoint deserialize_checkpoint(bytes_view input, Instance& instance)
+{
+    const auto& module = *instance.module;
+    Reader reader{input};
+
+    for (const auto byte : CheckpointMagic)
+    {
+        if (reader.read<uint8_t>() != byte)
+            throw parser_error{"invalid checkpoint magic"};
+    }
+    if (reader.read<uint32_t>() != CheckpointVersion)
+        throw parser_error{"unsupported checkpoint version"};
+    if (reader.read<uint32_t>() != CodeFormatVersion)
+        throw parser_error{"unsupported checkpoint code format"};
+    if (reader.read<uint64_t>() != get_module_fingerprint(module))
+        throw instantiate_error{"checkpoint of another module"};
+
+    Checkpoint checkpoint;
+    checkpoint.ticks = reader.read<int64_t>();
+
+    auto& state = checkpoint.state;
+    state.module = instance.module;
+    state.source = &instance;
+
+    if (reader.read<uint8_t>() != 0)
+    {
+        state.memory = reader.read_bytes();
+        if (instance.memory == nullptr || state.memory->size() % PageSize != 0 ||
+            state.memory->size() > memory_pages_to_bytes(instance.memory_pages_limit))
+            throw instantiate_error{"checkpoint memory does not fit the instance"};
+    }
+    else if (instance.memory != nullptr)
+        throw instantiate_error{"checkpoint memory does not fit the instance"};
+
+    state.globals = reader.read_values();
+    if (state.globals.size() != instance.globals.size())
+        throw instantiate_error{"checkpoint globals do not fit the instance"};
+
+    if (reader.read<uint8_t>() != 0)
+    {
+        if (instance.table == nullptr)
+            throw instantiate_error{"checkpoint table does not fit the instance"};
+        state.table.emplace(reader.read_count(sizeof(uint32_t)));
+        for (auto& element : *state.table)
+        {
+            const auto func_idx_plus_1 = reader.read<uint32_t>();
+            if (func_idx_plus_1 > module.get_function_count())
+                throw instantiate_error{"checkpoint table refers to invalid function"};
+            if (func_idx_plus_1 != 0)
+                element = {&instance, func_idx_plus_1 - 1, {}};
+        }
+    }
+    else if (instance.table != nullptr)
+        throw instantiate_error{"checkpoint table does not fit the instance"};
+
+    if (reader.read<uint32_t>() != module.datasec.size())
+        throw instantiate_error{"checkpoint data segments do not fit the instance"};
+    state.dropped_data_segments.resize(module.datasec.size());
+    for (size_t i = 0; i < state.dropped_data_segments.size(); ++i)
+        state.dropped_data_segments[i] = reader.read<uint8_t>() != 0;
+
+    // A frame takes at least its indices and the counts of its values.
+    checkpoint.frames.resize(reader.read_count(4 * sizeof(uint32_t)));
+    if (checkpoint.frames.empty())
+        throw parser_error{"checkpoint without frames"};
+    for (auto& frame : checkpoint.frames)
+    {
+        frame.func_idx = reader.read<uint32_t>();
+        frame.code_offset = reader.read<uint32_t>();
+        frame.locals = reader.read_values();
+        frame.stack = reader.read_values();
+        validate_frame(module, frame);
+    }
+    for (size_t i = 1; i < checkpoint.frames.size(); ++i)
+        validate_call(module, checkpoint.frames[i - 1], checkpoint.frames[i]);
+
+    if (!reader.at_end())
+        throw parser_error{"unexpected data at the end of checkpoint"};
+    return checkpoint;
+}
+}  // namespace fizzy
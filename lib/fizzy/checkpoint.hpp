@@ -0,0 +1,105 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include "execute.hpp"
+#include "snapshot.hpp"
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace fizzy
+{
+/// The frame of a WebAssembly function captured in a checkpoint.
+struct CheckpointFrame
+{
+    /// The index of the function.
+    FuncIdx func_idx = 0;
+
+    /// The offset of the instruction the frame continues with, in the function's instructions.
+    /// The instruction is executed again when resumed: it is either the instruction which has run
+    /// out of ticks, or the call of the next frame.
+    uint32_t code_offset = 0;
+
+    /// The values of the arguments and the local variables.
+    std::vector<Value> locals;
+
+    /// The operand stack, from the bottom.
+    std::vector<Value> stack;
+};
+
+/// The state of an execution captured by execute_checkpointable().
+struct Checkpoint
+{
+    /// The state of the instance: its memory, globals and table.
+    Snapshot state;
+
+    /// The frames of the execution, the outermost first.
+    std::vector<CheckpointFrame> frames;
+
+    /// The ticks left when the checkpoint has been taken. They are negative if the last
+    /// instruction has overdrawn them, see execute_checkpointable().
+    int64_t ticks = 0;
+};
+
+/// Executes a function like execute() with results, with metering enabled. The execution running
+/// out of ticks is stopped and its state is captured in a checkpoint instead of trapping, so it
+/// can be resumed later with resume_checkpoint(), possibly in another process with
+/// serialize_checkpoint() and deserialize_checkpoint().
+///
+/// The frames are captured at the start of the instruction which has run out of ticks, which is
+/// refunded and executed again when resumed. The bulk memory instructions charge their ticks
+/// after taking their operands, so they overdraw the ticks instead, and the checkpoint is taken
+/// at the next instruction. The calls of the resumed frames are not counted again in
+/// ExecutionContext::call_counts.
+///
+/// All the frames must be of functions of the instance. The execution running out of ticks in
+/// another instance called via the table, or in an execution nested in a host function, traps.
+///
+/// @param  instance    The instance.
+/// @param  func_idx    The function index, as in execute().
+/// @param  args        The pointer to the arguments, as in execute().
+/// @param  results     The pointer to the array for the results, as in execute() with results.
+/// @param  ctx         Execution context. ExecutionContext::metering_enabled must be set.
+/// @param  checkpoint  Set to the state of the execution if it has run out of ticks.
+/// @return             Void, Trap, Interrupted, or Suspended if the execution has run out of
+///                     ticks and @a checkpoint is set.
+ExecutionResult execute_checkpointable(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx, std::optional<Checkpoint>& checkpoint) noexcept;
+
+/// Resumes the execution from the checkpoint taken by execute_checkpointable() or this function.
+///
+/// The state of the instance is restored from the checkpoint, and the frames are re-entered
+/// on the native stack. The execution continues with the ticks of the context, so these are
+/// usually set to Checkpoint::ticks plus the ticks granted for the continuation.
+///
+/// @param  instance    The instance of the module of the checkpoint, instantiated with the same
+///                     imports.
+/// @param  results     The pointer to the array for the results of the function of the first
+///                     frame.
+/// @param  ctx         Execution context, as in execute_checkpointable().
+/// @param  checkpoint  The checkpoint to resume from. It is reset, and set again to the new state
+///                     if the execution runs out of ticks again.
+/// @return             The result as in execute_checkpointable().
+ExecutionResult resume_checkpoint(Instance& instance, Value* results, ExecutionContext& ctx,
+    std::optional<Checkpoint>& checkpoint) noexcept;
+
+/// Serializes the checkpoint to bytes, e.g. to store it in a file.
+///
+/// The table elements must refer to the functions of the checkpointed instance, otherwise
+/// instantiate_error is thrown. The values are stored in the native byte order.
+bytes serialize_checkpoint(const Checkpoint& checkpoint);
+
+/// Deserializes the checkpoint serialized with serialize_checkpoint() for resuming it in
+/// the instance.
+///
+/// Throws parser_error if the input is malformed or has been serialized by a version of Fizzy
+/// translating the code differently, and instantiate_error if it has been taken with another module
+/// or does not fit the instance. Each frame is checked to continue at the start of a reachable
+/// instruction with the stack height the code expects there, and each frame but the last one
+/// at the call re-entering the next frame.
+Checkpoint deserialize_checkpoint(bytes_view input, Instance& instance);
+}  // namespace fizzy
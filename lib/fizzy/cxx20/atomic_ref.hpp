@@ -0,0 +1,68 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+#ifdef __cpp_lib_atomic_ref
+
+namespace fizzy
+{
+using std::atomic_ref;
+}  // namespace fizzy
+
+#else
+
+namespace fizzy
+{
+/// The subset of C++20's std::atomic_ref for integral types, implemented with the GCC/Clang
+/// __atomic builtins. All operations are sequentially consistent.
+/// See https://en.cppreference.com/w/cpp/atomic/atomic_ref.
+template <typename T>
+class atomic_ref
+{
+    static_assert(std::is_integral_v<T>);
+
+    T* m_ptr;
+
+public:
+    static constexpr size_t required_alignment = sizeof(T);
+
+    explicit atomic_ref(T& obj) noexcept : m_ptr{&obj} {}
+
+    T load() const noexcept { return __atomic_load_n(m_ptr, __ATOMIC_SEQ_CST); }
+
+    void store(T desired) const noexcept { __atomic_store_n(m_ptr, desired, __ATOMIC_SEQ_CST); }
+
+    T exchange(T desired) const noexcept
+    {
+        return __atomic_exchange_n(m_ptr, desired, __ATOMIC_SEQ_CST);
+    }
+
+    bool compare_exchange_strong(T& expected, T desired) const noexcept
+    {
+        return __atomic_compare_exchange_n(
+            m_ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+
+    T fetch_add(T arg) const noexcept { return __atomic_fetch_add(m_ptr, arg, __ATOMIC_SEQ_CST); }
+
+    T fetch_sub(T arg) const noexcept { return __atomic_fetch_sub(m_ptr, arg, __ATOMIC_SEQ_CST); }
+
+    T fetch_and(T arg) const noexcept { return __atomic_fetch_and(m_ptr, arg, __ATOMIC_SEQ_CST); }
+
+    T fetch_or(T arg) const noexcept { return __atomic_fetch_or(m_ptr, arg, __ATOMIC_SEQ_CST); }
+
+    T fetch_xor(T arg) const noexcept { return __atomic_fetch_xor(m_ptr, arg, __ATOMIC_SEQ_CST); }
+};
+}  // namespace fizzy
+
+#endif /* __cpp_lib_atomic_ref */
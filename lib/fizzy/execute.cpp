@@ -4,24 +4,65 @@
 
 #include "execute.hpp"
 #include "asserts.hpp"
+#include "atomic_wait.hpp"
+#include "checkpoint.hpp"
+#include "cxx20/atomic_ref.hpp"
 #include "cxx20/bit.hpp"
 #include "instructions.hpp"
+#include "simd.hpp"
 #include "stack.hpp"
+#include "suspend.hpp"
+#include "tiering.hpp"
 #include "trunc_boundaries.hpp"
 #include "types.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <iterator>
 #include <stack>
+#include <utility>
 
 namespace fizzy
 {
-namespace
+/// The state of the execution started with execute_checkpointable(), see
+/// ExecutionContext::checkpoint_execution.
+class CheckpointExecution
 {
-// code_offset + stack_drop
-constexpr auto BranchImmediateSize = 2 * sizeof(uint32_t);
+    /// The frames of the resumed checkpoint still to be re-entered, in the order of entering them.
+    const CheckpointFrame* m_resumed_frames = nullptr;
+    const CheckpointFrame* m_resumed_frames_end = nullptr;
+
+public:
+    /// The checkpointed instance. Only its frames are captured.
+    const Instance& instance;
+
+    /// The frames captured while unwinding the execution, the innermost first.
+    std::vector<CheckpointFrame> captured_frames;
+
+    CheckpointExecution(
+        const Instance& _instance, const std::vector<CheckpointFrame>& resumed_frames) noexcept
+      : m_resumed_frames{resumed_frames.data()},
+        m_resumed_frames_end{resumed_frames.data() + resumed_frames.size()},
+        instance{_instance}
+    {}
+
+    /// Returns the frame re-entered by the next call, or nullptr if all have been re-entered.
+    const CheckpointFrame* next_resumed_frame() const noexcept
+    {
+        return m_resumed_frames != m_resumed_frames_end ? m_resumed_frames : nullptr;
+    }
+
+    /// Takes the frame re-entered by the function being entered, see next_resumed_frame().
+    const CheckpointFrame* take_resumed_frame() noexcept
+    {
+        return m_resumed_frames != m_resumed_frames_end ? m_resumed_frames++ : nullptr;
+    }
+};
 
+namespace
+{
 constexpr uint32_t F32AbsMask = 0x7fffffff;
 constexpr uint32_t F32SignMask = ~F32AbsMask;
 constexpr uint64_t F64AbsMask = 0x7fffffffffffffff;
@@ -36,6 +77,13 @@ inline T read(const uint8_t*& input) noexcept
     return ret;
 }
 
+/// Reads the index, offset or branch immediate stored in the code as ImmT.
+template <typename ImmT>
+inline uint32_t read_immediate(const uint8_t*& input) noexcept
+{
+    return read<ImmT>(input);
+}
+
 template <typename T>
 inline void store(bytes& input, size_t offset, T value) noexcept
 {
@@ -65,12 +113,10 @@ inline constexpr DstT extend(SrcT in) noexcept
 }
 
 template <typename DstT, typename SrcT = DstT>
-inline bool load_from_memory(
-    bytes_view memory, OperandStack& stack, const uint8_t*& immediates) noexcept
+inline bool load_from_memory(bytes_view memory, OperandStack& stack, uint32_t offset) noexcept
 {
+    // NOTE: alignment is dropped by the parser, the offset is the only immediate
     const auto address = stack.top().as<uint32_t>();
-    // NOTE: alignment is dropped by the parser
-    const auto offset = read<uint32_t>(immediates);
     // Addressing is 32-bit, but we keep the value as 64-bit to detect overflows.
     if ((uint64_t{address} + offset + sizeof(SrcT)) > memory.size())
         return false;
@@ -95,18 +141,71 @@ inline constexpr DstT shrink(Value value) noexcept
 }
 
 template <typename DstT>
-inline bool store_into_memory(
-    bytes& memory, OperandStack& stack, const uint8_t*& immediates) noexcept
+inline bool store_into_memory(bytes& memory, std::vector<uint64_t>& dirty_memory_blocks,
+    OperandStack& stack, uint32_t offset) noexcept
 {
+    // NOTE: alignment is dropped by the parser, the offset is the only immediate
     const auto value = shrink<DstT>(stack.pop());
     const auto address = stack.pop().as<uint32_t>();
-    // NOTE: alignment is dropped by the parser
-    const auto offset = read<uint32_t>(immediates);
     // Addressing is 32-bit, but we keep the value as 64-bit to detect overflows.
     if ((uint64_t{address} + offset + sizeof(DstT)) > memory.size())
         return false;
 
     store<DstT>(memory, address + offset, value);
+    if (!dirty_memory_blocks.empty())
+        mark_memory_dirty(dirty_memory_blocks, uint64_t{address} + offset, sizeof(DstT));
+    return true;
+}
+
+/// Implements memory.copy: copies @a size bytes between possibly overlapping memory ranges.
+/// Returns false if any of the ranges is out of bounds.
+inline bool copy_memory(bytes& memory, std::vector<uint64_t>& dirty_memory_blocks, uint32_t dst,
+    uint32_t src, uint32_t size) noexcept
+{
+    // Addressing is 32-bit, but we keep the value as 64-bit to detect overflows.
+    if (uint64_t{src} + size > memory.size() || uint64_t{dst} + size > memory.size())
+        return false;
+
+    if (size != 0)
+    {
+        std::memmove(&memory[dst], &memory[src], size);
+        if (!dirty_memory_blocks.empty())
+            mark_memory_dirty(dirty_memory_blocks, dst, size);
+    }
+    return true;
+}
+
+/// Implements memory.fill: sets @a size bytes of memory to @a value.
+/// Returns false if the range is out of bounds.
+inline bool fill_memory(bytes& memory, std::vector<uint64_t>& dirty_memory_blocks, uint32_t dst,
+    uint8_t value, uint32_t size) noexcept
+{
+    if (uint64_t{dst} + size > memory.size())
+        return false;
+
+    if (size != 0)
+    {
+        std::memset(&memory[dst], value, size);
+        if (!dirty_memory_blocks.empty())
+            mark_memory_dirty(dirty_memory_blocks, dst, size);
+    }
+    return true;
+}
+
+/// Implements memory.init: copies @a size bytes of the data segment to memory.
+/// Returns false if any of the ranges is out of bounds.
+inline bool init_memory(bytes& memory, std::vector<uint64_t>& dirty_memory_blocks, uint32_t dst,
+    bytes_view data, uint32_t src, uint32_t size) noexcept
+{
+    if (uint64_t{src} + size > data.size() || uint64_t{dst} + size > memory.size())
+        return false;
+
+    if (size != 0)
+    {
+        std::memcpy(&memory[dst], &data[src], size);
+        if (!dirty_memory_blocks.empty())
+            mark_memory_dirty(dirty_memory_blocks, dst, size);
+    }
     return true;
 }
 
@@ -504,80 +603,1450 @@ __attribute__((no_sanitize("float-cast-overflow"))) inline constexpr float demot
     return static_cast<float>(value);
 }
 
-void branch(const Code& code, OperandStack& stack, const uint8_t*& pc, uint32_t arity) noexcept
+template <typename ImmT>
+void branch(
+    const uint8_t* instructions, OperandStack& stack, const uint8_t*& pc, uint32_t arity) noexcept
 {
-    const auto code_offset = read<uint32_t>(pc);
-    const auto stack_drop = read<uint32_t>(pc);
+    const auto code_offset = read_immediate<ImmT>(pc);
+    const auto stack_drop = read_immediate<ImmT>(pc);
 
-    pc = code.instructions.data() + code_offset;
+    pc = instructions + code_offset;
 
     // When branch is taken, additional stack items must be dropped.
     assert(static_cast<int>(stack_drop) >= 0);
     assert(stack.size() >= stack_drop + arity);
-    if (arity != 0)
+    if (arity == 1)
     {
-        assert(arity == 1);
         const auto result = stack.top();
         stack.drop(stack_drop);
         stack.top() = result;
     }
     else
+    {
+        // Multiple values, including the v128 value occupying 2 stack items. They are moved
+        // starting from the bottom one, so the destinations don't overlap the values not moved yet.
+        for (auto i = arity; i-- > 0;)
+            stack[i + stack_drop] = stack[i];
         stack.drop(stack_drop);
+    }
+}
+
+/// Truncates the float value to an integer value, saturating the values out of the range of
+/// the integer type. NaN is converted to 0.
+template <typename DstT, typename SrcT>
+inline DstT trunc_sat(SrcT value) noexcept
+{
+    static_assert(std::is_floating_point_v<SrcT>);
+    static_assert(std::is_integral_v<DstT>);
+    using boundaries = trunc_boundaries<SrcT, DstT>;
+
+    if (std::isnan(value))
+        return 0;
+    if (value <= boundaries::lower)
+        return std::numeric_limits<DstT>::min();
+    if (value >= boundaries::upper)
+        return std::numeric_limits<DstT>::max();
+    return static_cast<DstT>(value);
+}
+
+/// Loads the v128 value from the 2 stack items starting at the given one, the low half first.
+template <typename V>
+inline V load_v128(const Value* items) noexcept
+{
+    V ret;
+    __builtin_memcpy(&ret, items, sizeof(ret));
+    return ret;
+}
+
+/// Stores the v128 value into the 2 stack items starting at the given one, the low half first.
+template <typename V>
+inline void store_v128(Value* items, V value) noexcept
+{
+    static_assert(sizeof(value) == 2 * sizeof(Value));
+    __builtin_memcpy(items, &value, sizeof(value));
+}
+
+template <typename V>
+inline V pop_v128(OperandStack& stack) noexcept
+{
+    const auto ret = load_v128<V>(&stack[1]);
+    stack.drop(2);
+    return ret;
+}
+
+template <typename V>
+inline void push_v128(OperandStack& stack, V value) noexcept
+{
+    stack.push(Value{});
+    stack.push(Value{});
+    store_v128(&stack[1], value);
+}
+
+/// Applies the operation to the v128 value on the stack top, interpreted as the vector type V.
+template <typename V, typename Op>
+inline void v128_unary_op(OperandStack& stack, Op op) noexcept
+{
+    auto* const items = &stack[1];
+    store_v128(items, op(load_v128<V>(items)));
+}
+
+/// Applies the operation to the 2 v128 values on the stack top, interpreted as the vector type V.
+template <typename V, typename Op>
+inline void v128_binary_op(OperandStack& stack, Op op) noexcept
+{
+    const auto b = pop_v128<V>(stack);
+    auto* const items = &stack[1];
+    store_v128(items, op(load_v128<V>(items), b));
+}
+
+/// Executes the SIMD instruction following the simd_prefix opcode, starting with its sub-opcode
+/// immediate. Not inlined, so the SIMD instructions do not affect the code of the main
+/// interpreter loop. Returns false on trap.
+template <typename ImmT>
+__attribute__((noinline)) bool execute_simd(OperandStack& stack, const uint8_t*& pc,
+    bytes* memory, std::vector<uint64_t>& dirty_memory_blocks) noexcept
+{
+    using namespace simd;
+
+    // Reads the offset immediate and returns the pointer to the memory accessed at the address,
+    // or nullptr if the access is out of bounds.
+    const auto access_memory = [&pc, memory](uint32_t address, size_t size) noexcept {
+        const auto offset = read_immediate<ImmT>(pc);
+        // Addressing is 32-bit, but we keep the value as 64-bit to detect overflows.
+        const auto effective_address = uint64_t{address} + offset;
+        return effective_address + size <= memory->size() ? memory->data() + effective_address :
+                                                            nullptr;
+    };
+    const auto mark_dirty = [memory, &dirty_memory_blocks](const uint8_t* ptr, size_t size) {
+        if (!dirty_memory_blocks.empty())
+            mark_memory_dirty(
+                dirty_memory_blocks, static_cast<uint64_t>(ptr - memory->data()), size);
+    };
+
+    static constexpr auto eq = [](auto a, auto b) noexcept { return a == b; };
+    static constexpr auto ne = [](auto a, auto b) noexcept { return a != b; };
+    static constexpr auto lt = [](auto a, auto b) noexcept { return a < b; };
+    static constexpr auto gt = [](auto a, auto b) noexcept { return a > b; };
+    static constexpr auto le = [](auto a, auto b) noexcept { return a <= b; };
+    static constexpr auto ge = [](auto a, auto b) noexcept { return a >= b; };
+    static constexpr auto min = [](auto a, auto b) noexcept { return b < a ? b : a; };
+    static constexpr auto max = [](auto a, auto b) noexcept { return a < b ? b : a; };
+    static constexpr auto neg = [](auto a) noexcept { return -a; };
+
+    const auto instr = static_cast<SimdInstr>(read_immediate<ImmT>(pc));
+    switch (instr)
+    {
+    case SimdInstr::v128_load:
+    case SimdInstr::v128_load8x8_s:
+    case SimdInstr::v128_load8x8_u:
+    case SimdInstr::v128_load16x4_s:
+    case SimdInstr::v128_load16x4_u:
+    case SimdInstr::v128_load32x2_s:
+    case SimdInstr::v128_load32x2_u:
+    {
+        const auto size = instr == SimdInstr::v128_load ? size_t{16} : size_t{8};
+        const auto* const ptr = access_memory(stack.pop().as<uint32_t>(), size);
+        if (ptr == nullptr)
+            return false;
+
+        u8x16 value{};
+        __builtin_memcpy(&value, ptr, size);
+        switch (instr)
+        {
+        case SimdInstr::v128_load8x8_s:
+            push_v128(stack, extend_low<i16x8>(as<i8x16>(value)));
+            break;
+        case SimdInstr::v128_load8x8_u:
+            push_v128(stack, extend_low<u16x8>(value));
+            break;
+        case SimdInstr::v128_load16x4_s:
+            push_v128(stack, extend_low<i32x4>(as<i16x8>(value)));
+            break;
+        case SimdInstr::v128_load16x4_u:
+            push_v128(stack, extend_low<u32x4>(as<u16x8>(value)));
+            break;
+        case SimdInstr::v128_load32x2_s:
+            push_v128(stack, extend_low<i64x2>(as<i32x4>(value)));
+            break;
+        case SimdInstr::v128_load32x2_u:
+            push_v128(stack, extend_low<u64x2>(as<u32x4>(value)));
+            break;
+        default:
+            push_v128(stack, value);
+            break;
+        }
+        break;
+    }
+    case SimdInstr::v128_load8_splat:
+    case SimdInstr::v128_load16_splat:
+    case SimdInstr::v128_load32_splat:
+    case SimdInstr::v128_load64_splat:
+    {
+        const auto size = size_t{1} << (static_cast<uint8_t>(instr) -
+                                        static_cast<uint8_t>(SimdInstr::v128_load8_splat));
+        const auto* const ptr = access_memory(stack.pop().as<uint32_t>(), size);
+        if (ptr == nullptr)
+            return false;
+
+        u8x16 value;
+        for (size_t i = 0; i < sizeof(value); i += size)
+            __builtin_memcpy(reinterpret_cast<uint8_t*>(&value) + i, ptr, size);
+        push_v128(stack, value);
+        break;
+    }
+    case SimdInstr::v128_load32_zero:
+    case SimdInstr::v128_load64_zero:
+    {
+        const auto size = instr == SimdInstr::v128_load32_zero ? size_t{4} : size_t{8};
+        const auto* const ptr = access_memory(stack.pop().as<uint32_t>(), size);
+        if (ptr == nullptr)
+            return false;
+
+        u8x16 value{};
+        __builtin_memcpy(&value, ptr, size);
+        push_v128(stack, value);
+        break;
+    }
+    case SimdInstr::v128_store:
+    {
+        const auto value = pop_v128<u8x16>(stack);
+        auto* const ptr = access_memory(stack.pop().as<uint32_t>(), sizeof(value));
+        if (ptr == nullptr)
+            return false;
+
+        __builtin_memcpy(ptr, &value, sizeof(value));
+        mark_dirty(ptr, sizeof(value));
+        break;
+    }
+    case SimdInstr::v128_load8_lane:
+    case SimdInstr::v128_load16_lane:
+    case SimdInstr::v128_load32_lane:
+    case SimdInstr::v128_load64_lane:
+    {
+        const auto size = size_t{1} << (static_cast<uint8_t>(instr) -
+                                        static_cast<uint8_t>(SimdInstr::v128_load8_lane));
+        auto value = pop_v128<u8x16>(stack);
+        const auto* const ptr = access_memory(stack.pop().as<uint32_t>(), size);
+        const auto lane = *pc++;
+        if (ptr == nullptr)
+            return false;
+
+        __builtin_memcpy(reinterpret_cast<uint8_t*>(&value) + lane * size, ptr, size);
+        push_v128(stack, value);
+        break;
+    }
+    case SimdInstr::v128_store8_lane:
+    case SimdInstr::v128_store16_lane:
+    case SimdInstr::v128_store32_lane:
+    case SimdInstr::v128_store64_lane:
+    {
+        const auto size = size_t{1} << (static_cast<uint8_t>(instr) -
+                                        static_cast<uint8_t>(SimdInstr::v128_store8_lane));
+        const auto value = pop_v128<u8x16>(stack);
+        auto* const ptr = access_memory(stack.pop().as<uint32_t>(), size);
+        const auto lane = *pc++;
+        if (ptr == nullptr)
+            return false;
+
+        __builtin_memcpy(ptr, reinterpret_cast<const uint8_t*>(&value) + lane * size, size);
+        mark_dirty(ptr, size);
+        break;
+    }
+
+    case SimdInstr::v128_const:
+    {
+        u8x16 value;
+        __builtin_memcpy(&value, pc, sizeof(value));
+        pc += sizeof(value);
+        push_v128(stack, value);
+        break;
+    }
+    case SimdInstr::i8x16_shuffle:
+    {
+        const auto* const lanes = pc;
+        pc += 16;
+        v128_binary_op<u8x16>(stack, [lanes](u8x16 a, u8x16 b) { return shuffle(a, b, lanes); });
+        break;
+    }
+    case SimdInstr::i8x16_swizzle:
+        v128_binary_op<u8x16>(stack, swizzle);
+        break;
+
+    case SimdInstr::i8x16_splat:
+        push_v128(stack, splat<u8x16>(static_cast<uint8_t>(stack.pop().as<uint32_t>())));
+        break;
+    case SimdInstr::i16x8_splat:
+        push_v128(stack, splat<u16x8>(static_cast<uint16_t>(stack.pop().as<uint32_t>())));
+        break;
+    case SimdInstr::i32x4_splat:
+        push_v128(stack, splat<u32x4>(stack.pop().as<uint32_t>()));
+        break;
+    case SimdInstr::i64x2_splat:
+        push_v128(stack, splat<u64x2>(stack.pop().as<uint64_t>()));
+        break;
+    case SimdInstr::f32x4_splat:
+        push_v128(stack, splat<f32x4>(stack.pop().as<float>()));
+        break;
+    case SimdInstr::f64x2_splat:
+        push_v128(stack, splat<f64x2>(stack.pop().as<double>()));
+        break;
+
+    case SimdInstr::i8x16_extract_lane_s:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{int32_t{pop_v128<i8x16>(stack)[lane]}});
+        break;
+    }
+    case SimdInstr::i8x16_extract_lane_u:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{uint32_t{pop_v128<u8x16>(stack)[lane]}});
+        break;
+    }
+    case SimdInstr::i16x8_extract_lane_s:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{int32_t{pop_v128<i16x8>(stack)[lane]}});
+        break;
+    }
+    case SimdInstr::i16x8_extract_lane_u:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{uint32_t{pop_v128<u16x8>(stack)[lane]}});
+        break;
+    }
+    case SimdInstr::i32x4_extract_lane:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{pop_v128<u32x4>(stack)[lane]});
+        break;
+    }
+    case SimdInstr::i64x2_extract_lane:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{pop_v128<u64x2>(stack)[lane]});
+        break;
+    }
+    case SimdInstr::f32x4_extract_lane:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{pop_v128<f32x4>(stack)[lane]});
+        break;
+    }
+    case SimdInstr::f64x2_extract_lane:
+    {
+        const auto lane = *pc++;
+        stack.push(Value{pop_v128<f64x2>(stack)[lane]});
+        break;
+    }
+    case SimdInstr::i8x16_replace_lane:
+    {
+        const auto lane = *pc++;
+        const auto x = static_cast<uint8_t>(stack.pop().as<uint32_t>());
+        v128_unary_op<u8x16>(stack, [lane, x](u8x16 a) {
+            a[lane] = x;
+            return a;
+        });
+        break;
+    }
+    case SimdInstr::i16x8_replace_lane:
+    {
+        const auto lane = *pc++;
+        const auto x = static_cast<uint16_t>(stack.pop().as<uint32_t>());
+        v128_unary_op<u16x8>(stack, [lane, x](u16x8 a) {
+            a[lane] = x;
+            return a;
+        });
+        break;
+    }
+    case SimdInstr::i32x4_replace_lane:
+    {
+        const auto lane = *pc++;
+        const auto x = stack.pop().as<uint32_t>();
+        v128_unary_op<u32x4>(stack, [lane, x](u32x4 a) {
+            a[lane] = x;
+            return a;
+        });
+        break;
+    }
+    case SimdInstr::i64x2_replace_lane:
+    {
+        const auto lane = *pc++;
+        const auto x = stack.pop().as<uint64_t>();
+        v128_unary_op<u64x2>(stack, [lane, x](u64x2 a) {
+            a[lane] = x;
+            return a;
+        });
+        break;
+    }
+    case SimdInstr::f32x4_replace_lane:
+    {
+        const auto lane = *pc++;
+        const auto x = stack.pop().as<float>();
+        v128_unary_op<f32x4>(stack, [lane, x](f32x4 a) {
+            a[lane] = x;
+            return a;
+        });
+        break;
+    }
+    case SimdInstr::f64x2_replace_lane:
+    {
+        const auto lane = *pc++;
+        const auto x = stack.pop().as<double>();
+        v128_unary_op<f64x2>(stack, [lane, x](f64x2 a) {
+            a[lane] = x;
+            return a;
+        });
+        break;
+    }
+
+    case SimdInstr::i8x16_eq:
+        v128_binary_op<i8x16>(stack, eq);
+        break;
+    case SimdInstr::i8x16_ne:
+        v128_binary_op<i8x16>(stack, ne);
+        break;
+    case SimdInstr::i8x16_lt_s:
+        v128_binary_op<i8x16>(stack, lt);
+        break;
+    case SimdInstr::i8x16_lt_u:
+        v128_binary_op<u8x16>(stack, lt);
+        break;
+    case SimdInstr::i8x16_gt_s:
+        v128_binary_op<i8x16>(stack, gt);
+        break;
+    case SimdInstr::i8x16_gt_u:
+        v128_binary_op<u8x16>(stack, gt);
+        break;
+    case SimdInstr::i8x16_le_s:
+        v128_binary_op<i8x16>(stack, le);
+        break;
+    case SimdInstr::i8x16_le_u:
+        v128_binary_op<u8x16>(stack, le);
+        break;
+    case SimdInstr::i8x16_ge_s:
+        v128_binary_op<i8x16>(stack, ge);
+        break;
+    case SimdInstr::i8x16_ge_u:
+        v128_binary_op<u8x16>(stack, ge);
+        break;
+    case SimdInstr::i16x8_eq:
+        v128_binary_op<i16x8>(stack, eq);
+        break;
+    case SimdInstr::i16x8_ne:
+        v128_binary_op<i16x8>(stack, ne);
+        break;
+    case SimdInstr::i16x8_lt_s:
+        v128_binary_op<i16x8>(stack, lt);
+        break;
+    case SimdInstr::i16x8_lt_u:
+        v128_binary_op<u16x8>(stack, lt);
+        break;
+    case SimdInstr::i16x8_gt_s:
+        v128_binary_op<i16x8>(stack, gt);
+        break;
+    case SimdInstr::i16x8_gt_u:
+        v128_binary_op<u16x8>(stack, gt);
+        break;
+    case SimdInstr::i16x8_le_s:
+        v128_binary_op<i16x8>(stack, le);
+        break;
+    case SimdInstr::i16x8_le_u:
+        v128_binary_op<u16x8>(stack, le);
+        break;
+    case SimdInstr::i16x8_ge_s:
+        v128_binary_op<i16x8>(stack, ge);
+        break;
+    case SimdInstr::i16x8_ge_u:
+        v128_binary_op<u16x8>(stack, ge);
+        break;
+    case SimdInstr::i32x4_eq:
+        v128_binary_op<i32x4>(stack, eq);
+        break;
+    case SimdInstr::i32x4_ne:
+        v128_binary_op<i32x4>(stack, ne);
+        break;
+    case SimdInstr::i32x4_lt_s:
+        v128_binary_op<i32x4>(stack, lt);
+        break;
+    case SimdInstr::i32x4_lt_u:
+        v128_binary_op<u32x4>(stack, lt);
+        break;
+    case SimdInstr::i32x4_gt_s:
+        v128_binary_op<i32x4>(stack, gt);
+        break;
+    case SimdInstr::i32x4_gt_u:
+        v128_binary_op<u32x4>(stack, gt);
+        break;
+    case SimdInstr::i32x4_le_s:
+        v128_binary_op<i32x4>(stack, le);
+        break;
+    case SimdInstr::i32x4_le_u:
+        v128_binary_op<u32x4>(stack, le);
+        break;
+    case SimdInstr::i32x4_ge_s:
+        v128_binary_op<i32x4>(stack, ge);
+        break;
+    case SimdInstr::i32x4_ge_u:
+        v128_binary_op<u32x4>(stack, ge);
+        break;
+    case SimdInstr::i64x2_eq:
+        v128_binary_op<i64x2>(stack, eq);
+        break;
+    case SimdInstr::i64x2_ne:
+        v128_binary_op<i64x2>(stack, ne);
+        break;
+    case SimdInstr::i64x2_lt_s:
+        v128_binary_op<i64x2>(stack, lt);
+        break;
+    case SimdInstr::i64x2_gt_s:
+        v128_binary_op<i64x2>(stack, gt);
+        break;
+    case SimdInstr::i64x2_le_s:
+        v128_binary_op<i64x2>(stack, le);
+        break;
+    case SimdInstr::i64x2_ge_s:
+        v128_binary_op<i64x2>(stack, ge);
+        break;
+    case SimdInstr::f32x4_eq:
+        v128_binary_op<f32x4>(stack, eq);
+        break;
+    case SimdInstr::f32x4_ne:
+        v128_binary_op<f32x4>(stack, ne);
+        break;
+    case SimdInstr::f32x4_lt:
+        v128_binary_op<f32x4>(stack, lt);
+        break;
+    case SimdInstr::f32x4_gt:
+        v128_binary_op<f32x4>(stack, gt);
+        break;
+    case SimdInstr::f32x4_le:
+        v128_binary_op<f32x4>(stack, le);
+        break;
+    case SimdInstr::f32x4_ge:
+        v128_binary_op<f32x4>(stack, ge);
+        break;
+    case SimdInstr::f64x2_eq:
+        v128_binary_op<f64x2>(stack, eq);
+        break;
+    case SimdInstr::f64x2_ne:
+        v128_binary_op<f64x2>(stack, ne);
+        break;
+    case SimdInstr::f64x2_lt:
+        v128_binary_op<f64x2>(stack, lt);
+        break;
+    case SimdInstr::f64x2_gt:
+        v128_binary_op<f64x2>(stack, gt);
+        break;
+    case SimdInstr::f64x2_le:
+        v128_binary_op<f64x2>(stack, le);
+        break;
+    case SimdInstr::f64x2_ge:
+        v128_binary_op<f64x2>(stack, ge);
+        break;
+
+    case SimdInstr::v128_not:
+        v128_unary_op<u64x2>(stack, [](u64x2 a) { return ~a; });
+        break;
+    case SimdInstr::v128_and:
+        v128_binary_op<u64x2>(stack, [](u64x2 a, u64x2 b) { return a & b; });
+        break;
+    case SimdInstr::v128_andnot:
+        v128_binary_op<u64x2>(stack, [](u64x2 a, u64x2 b) { return a & ~b; });
+        break;
+    case SimdInstr::v128_or:
+        v128_binary_op<u64x2>(stack, [](u64x2 a, u64x2 b) { return a | b; });
+        break;
+    case SimdInstr::v128_xor:
+        v128_binary_op<u64x2>(stack, [](u64x2 a, u64x2 b) { return a ^ b; });
+        break;
+    case SimdInstr::v128_bitselect:
+    {
+        const auto mask = pop_v128<u64x2>(stack);
+        v128_binary_op<u64x2>(
+            stack, [mask](u64x2 a, u64x2 b) { return (a & mask) | (b & ~mask); });
+        break;
+    }
+    case SimdInstr::v128_any_true:
+        stack.push(Value{uint32_t{any_true(pop_v128<u64x2>(stack))}});
+        break;
+
+    case SimdInstr::i8x16_abs:
+        v128_unary_op<i8x16>(stack, abs<u8x16, i8x16>);
+        break;
+    case SimdInstr::i8x16_neg:
+        v128_unary_op<u8x16>(stack, neg);
+        break;
+    case SimdInstr::i8x16_popcnt:
+        v128_unary_op<u8x16>(stack, [](u8x16 a) {
+            return map(a, [](uint8_t x) { return static_cast<uint8_t>(popcnt(uint32_t{x})); });
+        });
+        break;
+    case SimdInstr::i8x16_all_true:
+        stack.push(Value{uint32_t{all_true(pop_v128<i8x16>(stack))}});
+        break;
+    case SimdInstr::i8x16_bitmask:
+        stack.push(Value{bitmask(pop_v128<i8x16>(stack))});
+        break;
+    case SimdInstr::i8x16_narrow_i16x8_s:
+        v128_binary_op<i16x8>(stack, narrow<i8x16, i16x8>);
+        break;
+    case SimdInstr::i8x16_narrow_i16x8_u:
+        v128_binary_op<i16x8>(stack, narrow<u8x16, i16x8>);
+        break;
+    case SimdInstr::i8x16_shl:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 8;
+        v128_unary_op<u8x16>(stack, [shift](u8x16 a) { return a << shift; });
+        break;
+    }
+    case SimdInstr::i8x16_shr_s:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 8;
+        v128_unary_op<i8x16>(stack, [shift](i8x16 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i8x16_shr_u:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 8;
+        v128_unary_op<u8x16>(stack, [shift](u8x16 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i8x16_add:
+        v128_binary_op<u8x16>(stack, add<u8x16>);
+        break;
+    case SimdInstr::i8x16_add_sat_s:
+        v128_binary_op<i8x16>(stack, [](i8x16 a, i8x16 b) { return add_sat(a, b); });
+        break;
+    case SimdInstr::i8x16_add_sat_u:
+        v128_binary_op<u8x16>(stack, [](u8x16 a, u8x16 b) { return add_sat(a, b); });
+        break;
+    case SimdInstr::i8x16_sub:
+        v128_binary_op<u8x16>(stack, sub<u8x16>);
+        break;
+    case SimdInstr::i8x16_sub_sat_s:
+        v128_binary_op<i8x16>(stack, [](i8x16 a, i8x16 b) { return sub_sat(a, b); });
+        break;
+    case SimdInstr::i8x16_sub_sat_u:
+        v128_binary_op<u8x16>(stack, [](u8x16 a, u8x16 b) { return sub_sat(a, b); });
+        break;
+    case SimdInstr::i8x16_min_s:
+        v128_binary_op<i8x16>(stack, min);
+        break;
+    case SimdInstr::i8x16_min_u:
+        v128_binary_op<u8x16>(stack, min);
+        break;
+    case SimdInstr::i8x16_max_s:
+        v128_binary_op<i8x16>(stack, max);
+        break;
+    case SimdInstr::i8x16_max_u:
+        v128_binary_op<u8x16>(stack, max);
+        break;
+    case SimdInstr::i8x16_avgr_u:
+        v128_binary_op<u8x16>(stack, [](u8x16 a, u8x16 b) { return avgr(a, b); });
+        break;
+
+    case SimdInstr::i16x8_extadd_pairwise_i8x16_s:
+        v128_unary_op<i8x16>(stack, extadd_pairwise<i16x8, i8x16>);
+        break;
+    case SimdInstr::i16x8_extadd_pairwise_i8x16_u:
+        v128_unary_op<u8x16>(stack, extadd_pairwise<u16x8, u8x16>);
+        break;
+    case SimdInstr::i32x4_extadd_pairwise_i16x8_s:
+        v128_unary_op<i16x8>(stack, extadd_pairwise<i32x4, i16x8>);
+        break;
+    case SimdInstr::i32x4_extadd_pairwise_i16x8_u:
+        v128_unary_op<u16x8>(stack, extadd_pairwise<u32x4, u16x8>);
+        break;
+
+    case SimdInstr::i16x8_abs:
+        v128_unary_op<i16x8>(stack, abs<u16x8, i16x8>);
+        break;
+    case SimdInstr::i16x8_neg:
+        v128_unary_op<u16x8>(stack, neg);
+        break;
+    case SimdInstr::i16x8_q15mulr_sat_s:
+        v128_binary_op<i16x8>(stack, q15mulr_sat);
+        break;
+    case SimdInstr::i16x8_all_true:
+        stack.push(Value{uint32_t{all_true(pop_v128<i16x8>(stack))}});
+        break;
+    case SimdInstr::i16x8_bitmask:
+        stack.push(Value{bitmask(pop_v128<i16x8>(stack))});
+        break;
+    case SimdInstr::i16x8_narrow_i32x4_s:
+        v128_binary_op<i32x4>(stack, narrow<i16x8, i32x4>);
+        break;
+    case SimdInstr::i16x8_narrow_i32x4_u:
+        v128_binary_op<i32x4>(stack, narrow<u16x8, i32x4>);
+        break;
+    case SimdInstr::i16x8_extend_low_i8x16_s:
+        v128_unary_op<i8x16>(stack, extend_low<i16x8, i8x16>);
+        break;
+    case SimdInstr::i16x8_extend_high_i8x16_s:
+        v128_unary_op<i8x16>(stack, extend_high<i16x8, i8x16>);
+        break;
+    case SimdInstr::i16x8_extend_low_i8x16_u:
+        v128_unary_op<u8x16>(stack, extend_low<u16x8, u8x16>);
+        break;
+    case SimdInstr::i16x8_extend_high_i8x16_u:
+        v128_unary_op<u8x16>(stack, extend_high<u16x8, u8x16>);
+        break;
+    case SimdInstr::i16x8_shl:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 16;
+        v128_unary_op<u16x8>(stack, [shift](u16x8 a) { return a << shift; });
+        break;
+    }
+    case SimdInstr::i16x8_shr_s:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 16;
+        v128_unary_op<i16x8>(stack, [shift](i16x8 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i16x8_shr_u:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 16;
+        v128_unary_op<u16x8>(stack, [shift](u16x8 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i16x8_add:
+        v128_binary_op<u16x8>(stack, add<u16x8>);
+        break;
+    case SimdInstr::i16x8_add_sat_s:
+        v128_binary_op<i16x8>(stack, [](i16x8 a, i16x8 b) { return add_sat(a, b); });
+        break;
+    case SimdInstr::i16x8_add_sat_u:
+        v128_binary_op<u16x8>(stack, [](u16x8 a, u16x8 b) { return add_sat(a, b); });
+        break;
+    case SimdInstr::i16x8_sub:
+        v128_binary_op<u16x8>(stack, sub<u16x8>);
+        break;
+    case SimdInstr::i16x8_sub_sat_s:
+        v128_binary_op<i16x8>(stack, [](i16x8 a, i16x8 b) { return sub_sat(a, b); });
+        break;
+    case SimdInstr::i16x8_sub_sat_u:
+        v128_binary_op<u16x8>(stack, [](u16x8 a, u16x8 b) { return sub_sat(a, b); });
+        break;
+    case SimdInstr::i16x8_mul:
+        v128_binary_op<u16x8>(stack, mul<u16x8>);
+        break;
+    case SimdInstr::i16x8_min_s:
+        v128_binary_op<i16x8>(stack, min);
+        break;
+    case SimdInstr::i16x8_min_u:
+        v128_binary_op<u16x8>(stack, min);
+        break;
+    case SimdInstr::i16x8_max_s:
+        v128_binary_op<i16x8>(stack, max);
+        break;
+    case SimdInstr::i16x8_max_u:
+        v128_binary_op<u16x8>(stack, max);
+        break;
+    case SimdInstr::i16x8_avgr_u:
+        v128_binary_op<u16x8>(stack, [](u16x8 a, u16x8 b) { return avgr(a, b); });
+        break;
+    case SimdInstr::i16x8_extmul_low_i8x16_s:
+        v128_binary_op<i8x16>(stack,
+            [](i8x16 a, i8x16 b) { return extend_low<i16x8>(a) * extend_low<i16x8>(b); });
+        break;
+    case SimdInstr::i16x8_extmul_high_i8x16_s:
+        v128_binary_op<i8x16>(stack,
+            [](i8x16 a, i8x16 b) { return extend_high<i16x8>(a) * extend_high<i16x8>(b); });
+        break;
+    case SimdInstr::i16x8_extmul_low_i8x16_u:
+        v128_binary_op<u8x16>(stack,
+            [](u8x16 a, u8x16 b) { return extend_low<u16x8>(a) * extend_low<u16x8>(b); });
+        break;
+    case SimdInstr::i16x8_extmul_high_i8x16_u:
+        v128_binary_op<u8x16>(stack,
+            [](u8x16 a, u8x16 b) { return extend_high<u16x8>(a) * extend_high<u16x8>(b); });
+        break;
+
+    case SimdInstr::i32x4_abs:
+        v128_unary_op<i32x4>(stack, abs<u32x4, i32x4>);
+        break;
+    case SimdInstr::i32x4_neg:
+        v128_unary_op<u32x4>(stack, neg);
+        break;
+    case SimdInstr::i32x4_all_true:
+        stack.push(Value{uint32_t{all_true(pop_v128<i32x4>(stack))}});
+        break;
+    case SimdInstr::i32x4_bitmask:
+        stack.push(Value{bitmask(pop_v128<i32x4>(stack))});
+        break;
+    case SimdInstr::i32x4_extend_low_i16x8_s:
+        v128_unary_op<i16x8>(stack, extend_low<i32x4, i16x8>);
+        break;
+    case SimdInstr::i32x4_extend_high_i16x8_s:
+        v128_unary_op<i16x8>(stack, extend_high<i32x4, i16x8>);
+        break;
+    case SimdInstr::i32x4_extend_low_i16x8_u:
+        v128_unary_op<u16x8>(stack, extend_low<u32x4, u16x8>);
+        break;
+    case SimdInstr::i32x4_extend_high_i16x8_u:
+        v128_unary_op<u16x8>(stack, extend_high<u32x4, u16x8>);
+        break;
+    case SimdInstr::i32x4_shl:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 32;
+        v128_unary_op<u32x4>(stack, [shift](u32x4 a) { return a << shift; });
+        break;
+    }
+    case SimdInstr::i32x4_shr_s:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 32;
+        v128_unary_op<i32x4>(stack, [shift](i32x4 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i32x4_shr_u:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 32;
+        v128_unary_op<u32x4>(stack, [shift](u32x4 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i32x4_add:
+        v128_binary_op<u32x4>(stack, add<u32x4>);
+        break;
+    case SimdInstr::i32x4_sub:
+        v128_binary_op<u32x4>(stack, sub<u32x4>);
+        break;
+    case SimdInstr::i32x4_mul:
+        v128_binary_op<u32x4>(stack, mul<u32x4>);
+        break;
+    case SimdInstr::i32x4_min_s:
+        v128_binary_op<i32x4>(stack, min);
+        break;
+    case SimdInstr::i32x4_min_u:
+        v128_binary_op<u32x4>(stack, min);
+        break;
+    case SimdInstr::i32x4_max_s:
+        v128_binary_op<i32x4>(stack, max);
+        break;
+    case SimdInstr::i32x4_max_u:
+        v128_binary_op<u32x4>(stack, max);
+        break;
+    case SimdInstr::i32x4_dot_i16x8_s:
+        v128_binary_op<i16x8>(stack, dot);
+        break;
+    case SimdInstr::i32x4_extmul_low_i16x8_s:
+        v128_binary_op<i16x8>(stack,
+            [](i16x8 a, i16x8 b) { return extend_low<i32x4>(a) * extend_low<i32x4>(b); });
+        break;
+    case SimdInstr::i32x4_extmul_high_i16x8_s:
+        v128_binary_op<i16x8>(stack,
+            [](i16x8 a, i16x8 b) { return extend_high<i32x4>(a) * extend_high<i32x4>(b); });
+        break;
+    case SimdInstr::i32x4_extmul_low_i16x8_u:
+        v128_binary_op<u16x8>(stack,
+            [](u16x8 a, u16x8 b) { return extend_low<u32x4>(a) * extend_low<u32x4>(b); });
+        break;
+    case SimdInstr::i32x4_extmul_high_i16x8_u:
+        v128_binary_op<u16x8>(stack,
+            [](u16x8 a, u16x8 b) { return extend_high<u32x4>(a) * extend_high<u32x4>(b); });
+        break;
+
+    case SimdInstr::i64x2_abs:
+        v128_unary_op<i64x2>(stack, abs<u64x2, i64x2>);
+        break;
+    case SimdInstr::i64x2_neg:
+        v128_unary_op<u64x2>(stack, neg);
+        break;
+    case SimdInstr::i64x2_all_true:
+        stack.push(Value{uint32_t{all_true(pop_v128<i64x2>(stack))}});
+        break;
+    case SimdInstr::i64x2_bitmask:
+        stack.push(Value{bitmask(pop_v128<i64x2>(stack))});
+        break;
+    case SimdInstr::i64x2_extend_low_i32x4_s:
+        v128_unary_op<i32x4>(stack, extend_low<i64x2, i32x4>);
+        break;
+    case SimdInstr::i64x2_extend_high_i32x4_s:
+        v128_unary_op<i32x4>(stack, extend_high<i64x2, i32x4>);
+        break;
+    case SimdInstr::i64x2_extend_low_i32x4_u:
+        v128_unary_op<u32x4>(stack, extend_low<u64x2, u32x4>);
+        break;
+    case SimdInstr::i64x2_extend_high_i32x4_u:
+        v128_unary_op<u32x4>(stack, extend_high<u64x2, u32x4>);
+        break;
+    case SimdInstr::i64x2_shl:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 64;
+        v128_unary_op<u64x2>(stack, [shift](u64x2 a) { return a << shift; });
+        break;
+    }
+    case SimdInstr::i64x2_shr_s:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 64;
+        v128_unary_op<i64x2>(stack, [shift](i64x2 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i64x2_shr_u:
+    {
+        const auto shift = stack.pop().as<uint32_t>() % 64;
+        v128_unary_op<u64x2>(stack, [shift](u64x2 a) { return a >> shift; });
+        break;
+    }
+    case SimdInstr::i64x2_add:
+        v128_binary_op<u64x2>(stack, add<u64x2>);
+        break;
+    case SimdInstr::i64x2_sub:
+        v128_binary_op<u64x2>(stack, sub<u64x2>);
+        break;
+    case SimdInstr::i64x2_mul:
+        v128_binary_op<u64x2>(stack, mul<u64x2>);
+        break;
+    case SimdInstr::i64x2_extmul_low_i32x4_s:
+        v128_binary_op<i32x4>(stack,
+            [](i32x4 a, i32x4 b) { return extend_low<i64x2>(a) * extend_low<i64x2>(b); });
+        break;
+    case SimdInstr::i64x2_extmul_high_i32x4_s:
+        v128_binary_op<i32x4>(stack,
+            [](i32x4 a, i32x4 b) { return extend_high<i64x2>(a) * extend_high<i64x2>(b); });
+        break;
+    case SimdInstr::i64x2_extmul_low_i32x4_u:
+        v128_binary_op<u32x4>(stack,
+            [](u32x4 a, u32x4 b) { return extend_low<u64x2>(a) * extend_low<u64x2>(b); });
+        break;
+    case SimdInstr::i64x2_extmul_high_i32x4_u:
+        v128_binary_op<u32x4>(stack,
+            [](u32x4 a, u32x4 b) { return extend_high<u64x2>(a) * extend_high<u64x2>(b); });
+        break;
+
+    case SimdInstr::f32x4_abs:
+        v128_unary_op<u32x4>(stack, [](u32x4 a) { return a & F32AbsMask; });
+        break;
+    case SimdInstr::f32x4_neg:
+        v128_unary_op<u32x4>(stack, [](u32x4 a) { return a ^ F32SignMask; });
+        break;
+    case SimdInstr::f32x4_sqrt:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) {
+            return map(a, [](float x) { return std::sqrt(x); });
+        });
+        break;
+    case SimdInstr::f32x4_ceil:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) { return map(a, fceil<float>); });
+        break;
+    case SimdInstr::f32x4_floor:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) { return map(a, ffloor<float>); });
+        break;
+    case SimdInstr::f32x4_trunc:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) { return map(a, ftrunc<float>); });
+        break;
+    case SimdInstr::f32x4_nearest:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) { return map(a, fnearest<float>); });
+        break;
+    case SimdInstr::f32x4_add:
+        v128_binary_op<f32x4>(stack, add<f32x4>);
+        break;
+    case SimdInstr::f32x4_sub:
+        v128_binary_op<f32x4>(stack, sub<f32x4>);
+        break;
+    case SimdInstr::f32x4_mul:
+        v128_binary_op<f32x4>(stack, mul<f32x4>);
+        break;
+    case SimdInstr::f32x4_div:
+        v128_binary_op<f32x4>(stack, simd::fdiv<f32x4>);
+        break;
+    case SimdInstr::f32x4_min:
+        v128_binary_op<f32x4>(stack, [](f32x4 a, f32x4 b) { return map(a, b, fmin<float>); });
+        break;
+    case SimdInstr::f32x4_max:
+        v128_binary_op<f32x4>(stack, [](f32x4 a, f32x4 b) { return map(a, b, fmax<float>); });
+        break;
+    case SimdInstr::f32x4_pmin:
+        v128_binary_op<f32x4>(stack, min);
+        break;
+    case SimdInstr::f32x4_pmax:
+        v128_binary_op<f32x4>(stack, max);
+        break;
+
+    case SimdInstr::f64x2_abs:
+        v128_unary_op<u64x2>(stack, [](u64x2 a) { return a & F64AbsMask; });
+        break;
+    case SimdInstr::f64x2_neg:
+        v128_unary_op<u64x2>(stack, [](u64x2 a) { return a ^ F64SignMask; });
+        break;
+    case SimdInstr::f64x2_sqrt:
+        v128_unary_op<f64x2>(stack, [](f64x2 a) {
+            return map(a, [](double x) { return std::sqrt(x); });
+        });
+        break;
+    case SimdInstr::f64x2_ceil:
+        v128_unary_op<f64x2>(stack, [](f64x2 a) { return map(a, fceil<double>); });
+        break;
+    case SimdInstr::f64x2_floor:
+        v128_unary_op<f64x2>(stack, [](f64x2 a) { return map(a, ffloor<double>); });
+        break;
+    case SimdInstr::f64x2_trunc:
+        v128_unary_op<f64x2>(stack, [](f64x2 a) { return map(a, ftrunc<double>); });
+        break;
+    case SimdInstr::f64x2_nearest:
+        v128_unary_op<f64x2>(stack, [](f64x2 a) { return map(a, fnearest<double>); });
+        break;
+    case SimdInstr::f64x2_add:
+        v128_binary_op<f64x2>(stack, add<f64x2>);
+        break;
+    case SimdInstr::f64x2_sub:
+        v128_binary_op<f64x2>(stack, sub<f64x2>);
+        break;
+    case SimdInstr::f64x2_mul:
+        v128_binary_op<f64x2>(stack, mul<f64x2>);
+        break;
+    case SimdInstr::f64x2_div:
+        v128_binary_op<f64x2>(stack, simd::fdiv<f64x2>);
+        break;
+    case SimdInstr::f64x2_min:
+        v128_binary_op<f64x2>(stack, [](f64x2 a, f64x2 b) { return map(a, b, fmin<double>); });
+        break;
+    case SimdInstr::f64x2_max:
+        v128_binary_op<f64x2>(stack, [](f64x2 a, f64x2 b) { return map(a, b, fmax<double>); });
+        break;
+    case SimdInstr::f64x2_pmin:
+        v128_binary_op<f64x2>(stack, min);
+        break;
+    case SimdInstr::f64x2_pmax:
+        v128_binary_op<f64x2>(stack, max);
+        break;
+
+    case SimdInstr::i32x4_trunc_sat_f32x4_s:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) {
+            return i32x4{trunc_sat<int32_t>(a[0]), trunc_sat<int32_t>(a[1]),
+                trunc_sat<int32_t>(a[2]), trunc_sat<int32_t>(a[3])};
+        });
+        break;
+    case SimdInstr::i32x4_trunc_sat_f32x4_u:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) {
+            return u32x4{trunc_sat<uint32_t>(a[0]), trunc_sat<uint32_t>(a[1]),
+                trunc_sat<uint32_t>(a[2]), trunc_sat<uint32_t>(a[3])};
+        });
+        break;
+    case SimdInstr::f32x4_convert_i32x4_s:
+        v128_unary_op<i32x4>(stack, [](i32x4 a) { return __builtin_convertvector(a, f32x4); });
+        break;
+    case SimdInstr::f32x4_convert_i32x4_u:
+        v128_unary_op<u32x4>(stack, [](u32x4 a) { return __builtin_convertvector(a, f32x4); });
+        break;
+    case SimdInstr::i32x4_trunc_sat_f64x2_s_zero:
+        v128_unary_op<f64x2>(stack, [](f64x2 a) {
+            return i32x4{trunc_sat<int32_t>(a[0]), trunc_sat<int32_t>(a[1]), 0, 0};
+        });
+        break;
+    case SimdInstr::i32x4_trunc_sat_f64x2_u_zero:
+        v128_unary_op<f64x2>(stack, [](f64x2 a) {
+            return u32x4{trunc_sat<uint32_t>(a[0]), trunc_sat<uint32_t>(a[1]), 0, 0};
+        });
+        break;
+    case SimdInstr::f64x2_convert_low_i32x4_s:
+        v128_unary_op<i32x4>(stack, [](i32x4 a) {
+            return f64x2{static_cast<double>(a[0]), static_cast<double>(a[1])};
+        });
+        break;
+    case SimdInstr::f64x2_convert_low_i32x4_u:
+        v128_unary_op<u32x4>(stack, [](u32x4 a) {
+            return f64x2{static_cast<double>(a[0]), static_cast<double>(a[1])};
+        });
+        break;
+    case SimdInstr::f32x4_demote_f64x2_zero:
+        v128_unary_op<f64x2>(
+            stack, [](f64x2 a) { return f32x4{demote(a[0]), demote(a[1]), 0, 0}; });
+        break;
+    case SimdInstr::f64x2_promote_low_f32x4:
+        v128_unary_op<f32x4>(stack, [](f32x4 a) {
+            return f64x2{static_cast<double>(a[0]), static_cast<double>(a[1])};
+        });
+        break;
+
+    default:
+        FIZZY_UNREACHABLE();
+    }
+    return true;
 }
 
+/// Executes the atomic load, store or read-modify-write operation of the given group
+/// (the position of the sub-opcode's group in AtomicInstr, starting with the loads) on the memory
+/// value of type T. The operands are wrapped to T and the results are zero-extended.
+template <typename T>
+inline void execute_atomic_access(OperandStack& stack, uint32_t group, T* ptr) noexcept
+{
+    const atomic_ref<T> ref{*ptr};
+    switch (group)
+    {
+    case 0:
+        stack.top() = uint64_t{ref.load()};
+        break;
+    case 1:
+        ref.store(static_cast<T>(stack.pop().i64));
+        stack.drop(1);
+        break;
+    case 8:
+    {
+        const auto replacement = static_cast<T>(stack.pop().i64);
+        auto expected = static_cast<T>(stack.pop().i64);
+        // On failure, the expected value is replaced with the loaded one.
+        ref.compare_exchange_strong(expected, replacement);
+        stack.top() = uint64_t{expected};
+        break;
+    }
+    default:
+    {
+        const auto arg = static_cast<T>(stack.pop().i64);
+        T old;
+        switch (group)
+        {
+        case 2:
+            old = ref.fetch_add(arg);
+            break;
+        case 3:
+            old = ref.fetch_sub(arg);
+            break;
+        case 4:
+            old = ref.fetch_and(arg);
+            break;
+        case 5:
+            old = ref.fetch_or(arg);
+            break;
+        case 6:
+            old = ref.fetch_xor(arg);
+            break;
+        default:
+            old = ref.exchange(arg);
+            break;
+        }
+        stack.top() = uint64_t{old};
+        break;
+    }
+    }
+}
+
+/// Thrown on a trap to unwind all the frames of the execution at once, up to the public execute()
+/// entry, which converts it to the Trap or Interrupted result. This way the calls between
+/// WebAssembly functions return only on success and need no trap checks. The destructors of
+/// the unwound frames restore ExecutionContext::depth.
+struct TrapUnwind
+{
+    bool interrupted = false;
+};
+
+/// Executes the atomic instruction following the atomic_prefix opcode, starting with its
+/// sub-opcode immediate. Not inlined, so the atomic instructions do not affect the code of the main
+/// interpreter loop. Returns false on trap. Throws TrapUnwind if the wait is interrupted.
+template <typename ImmT>
+__attribute__((noinline)) bool execute_atomic(OperandStack& stack, const uint8_t*& pc,
+    bytes* memory, bool memory_shared, std::vector<uint64_t>& dirty_memory_blocks,
+    const std::atomic<bool>& interrupt_requested)
+{
+    const auto instr = static_cast<AtomicInstr>(read_immediate<ImmT>(pc));
+    if (instr == AtomicInstr::atomic_fence)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return true;
+    }
+
+    // The groups of the loads, stores and read-modify-write operations have 7 sub-opcodes each,
+    // in the order of the accessed types: i32, i64, i32 8u, i32 16u, i64 8u, i64 16u, i64 32u.
+    static constexpr uint8_t access_sizes[]{4, 8, 1, 2, 1, 2, 4};
+    constexpr uint32_t num_access_types = std::size(access_sizes);
+
+    const auto access_index = instr >= AtomicInstr::i32_atomic_load ?
+                                  static_cast<uint32_t>(instr) -
+                                      static_cast<uint32_t>(AtomicInstr::i32_atomic_load) :
+                                  0;
+    const auto group = access_index / num_access_types;
+    size_t size;
+    uint32_t address;
+    switch (instr)
+    {
+    case AtomicInstr::memory_atomic_notify:
+        size = 4;
+        address = stack[1].as<uint32_t>();
+        break;
+    case AtomicInstr::memory_atomic_wait32:
+    case AtomicInstr::memory_atomic_wait64:
+        size = instr == AtomicInstr::memory_atomic_wait32 ? 4 : 8;
+        address = stack[2].as<uint32_t>();
+        break;
+    default:
+        size = access_sizes[access_index % num_access_types];
+        // The address is below the value operand of the stores and read-modify-write operations,
+        // and the expected and replacement operands of cmpxchg.
+        address = stack[group == 0 ? 0 : (group == 8 ? 2 : 1)].as<uint32_t>();
+        break;
+    }
+
+    const auto offset = read_immediate<ImmT>(pc);
+    // Addressing is 32-bit, but we keep the value as 64-bit to detect overflows.
+    const auto effective_address = uint64_t{address} + offset;
+    if (effective_address + size > memory->size() || effective_address % size != 0)
+        return false;
+    auto* const ptr = memory->data() + effective_address;
+
+    switch (instr)
+    {
+    case AtomicInstr::memory_atomic_notify:
+    {
+        const auto count = stack.pop().as<uint32_t>();
+        // There are no waiters of an unshared memory.
+        stack.top() = memory_shared ? atomic_notify(ptr, count) : uint32_t{0};
+        return true;
+    }
+    case AtomicInstr::memory_atomic_wait32:
+    case AtomicInstr::memory_atomic_wait64:
+    {
+        // Waiting on an unshared memory would never end.
+        if (!memory_shared)
+            return false;
+
+        const auto timeout_ns = stack.pop().as<int64_t>();
+        WaitResult result;
+        if (instr == AtomicInstr::memory_atomic_wait32)
+        {
+            const auto expected = stack.pop().as<uint32_t>();
+            result = atomic_wait(
+                reinterpret_cast<uint32_t*>(ptr), expected, timeout_ns, interrupt_requested);
+        }
+        else
+        {
+            const auto expected = stack.pop().as<uint64_t>();
+            result = atomic_wait(
+                reinterpret_cast<uint64_t*>(ptr), expected, timeout_ns, interrupt_requested);
+        }
+        if (result == WaitResult::interrupted)
+            throw TrapUnwind{true};
+        stack.top() = static_cast<uint32_t>(result);
+        return true;
+    }
+    default:
+        break;
+    }
+
+    switch (size)
+    {
+    case 1:
+        execute_atomic_access(stack, group, ptr);
+        break;
+    case 2:
+        execute_atomic_access(stack, group, reinterpret_cast<uint16_t*>(ptr));
+        break;
+    case 4:
+        execute_atomic_access(stack, group, reinterpret_cast<uint32_t*>(ptr));
+        break;
+    default:
+        execute_atomic_access(stack, group, reinterpret_cast<uint64_t*>(ptr));
+        break;
+    }
+
+    if (group != 0 && !dirty_memory_blocks.empty())
+        mark_memory_dirty(dirty_memory_blocks, effective_address, size);
+    return true;
+}
+
+/// Checks whether the execution has been interrupted, see ExecutionContext::interrupt_requested.
+/// The relaxed load is a plain load on common architectures, so the polling is nearly free.
+inline bool is_interrupted(const ExecutionContext& ctx) noexcept
+{
+    return ctx.interrupt_requested.load(std::memory_order_relaxed);
+}
+
+/// Counts the call of the function if it is of the profiled module,
+/// see ExecutionContext::call_counts.
+inline void count_call(const Instance& instance, FuncIdx func_idx, ExecutionContext& ctx) noexcept
+{
+    if (ctx.call_counts != nullptr && instance.module.get() == ctx.call_counts_module)
+    {
+        assert(func_idx < instance.module->get_function_count());
+        ++ctx.call_counts[func_idx];
+    }
+}
+
+/// Checks whether the native stack has reached ExecutionContext::native_stack_limit.
+inline bool is_native_stack_exhausted(const ExecutionContext& ctx) noexcept
+{
+    return reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) < ctx.native_stack_limit;
+}
+
+/// Handles the taken branch if it is backward, i.e. a loop iteration: polls the interrupt flag
+/// and counts the iteration for the promotion of the function to the optimized tier.
+///
+/// @return  false if the execution has been interrupted.
 template <bool MeteringEnabled>
-ExecutionResult execute(
-    Instance& instance, FuncIdx func_idx, const Value* args, ExecutionContext& ctx) noexcept;
+inline bool take_back_edge(Instance& instance, FuncIdx func_idx, const ExecutionContext& ctx,
+    const uint8_t* branch_pc, const uint8_t* target_pc)
+{
+    if (target_pc >= branch_pc)
+        return true;
+
+    if (is_interrupted(ctx))
+        return false;
+
+    if constexpr (!MeteringEnabled)
+    {
+        if (instance.tiering != nullptr)
+            instance.tiering->count_back_edge(func_idx);
+    }
+    return true;
+}
+
+/// Thrown when the execution started with execute_checkpointable() runs out of ticks, to unwind
+/// its frames up to execute_checkpointable(), each frame capturing its state on the way.
+struct CheckpointUnwind
+{};
+
+/// Handles running out of ticks in the middle of an instruction, which has taken its operands
+/// already. Returns true if the execution continues: either it has been paused until it has ticks
+/// again, or the ticks are overdrawn and the checkpoint is taken at the next instruction.
+inline bool continue_out_of_ticks(ExecutionContext& ctx) noexcept
+{
+    return ctx.checkpoint_execution != nullptr || pause(ctx);
+}
+
+/// The tail call made by a function, executed in place of the function's frame after it returns.
+/// The arguments are copied out of the frame's operand stack, because the frame is destroyed
+/// before the callee starts.
+class TailCall
+{
+    /// The size of the pre-allocated storage for the arguments: 64 bytes.
+    static constexpr auto small_storage_size = 64 / sizeof(Value);
+
+    Value m_small_storage[small_storage_size];
+    std::unique_ptr<Value[]> m_large_storage;
+    Value* m_args = nullptr;
+
+public:
+    /// The instance of the callee, or null if no tail call has been made.
+    Instance* instance = nullptr;
+    FuncIdx func_idx = 0;
+
+    /// Records the tail call, copying the arguments.
+    void set(Instance& callee_instance, FuncIdx callee_func_idx, const Value* args, size_t num_args)
+    {
+        if (num_args <= small_storage_size)
+            m_args = m_small_storage;
+        else
+        {
+            m_large_storage = std::make_unique<Value[]>(num_args);
+            m_args = m_large_storage.get();
+        }
+        std::copy_n(args, num_args, m_args);
+        instance = &callee_instance;
+        func_idx = callee_func_idx;
+    }
+
+    const Value* args() const noexcept { return m_args; }
+};
+
+/// Returns the pointer to the 2 slots of the v128 global addressed by the immediate of
+/// the v128_global_get or v128_global_set instruction.
+inline Value* get_v128_global(Instance& instance, uint32_t idx) noexcept
+{
+    if (idx < instance.imported_globals.size())
+        return instance.imported_globals[idx].value;
+
+    const auto module_global_slot = idx - instance.imported_globals.size();
+    assert(module_global_slot + 1 < instance.globals.size());
+    return &instance.globals[module_global_slot];
+}
+
+/// Captures the frame of the execution started with execute_checkpointable() and continues
+/// unwinding it. The frame continues with the instruction at @a pc when resumed, so the ticks
+/// charged for it are refunded.
+[[noreturn]] __attribute__((noinline)) void checkpoint_frame(ExecutionContext& ctx,
+    const Instance& instance, FuncIdx func_idx, const Code& code, bytes_view instructions,
+    const uint8_t* pc, OperandStack& stack)
+{
+    auto& execution = *ctx.checkpoint_execution;
+    if (&instance != &execution.instance)
+        throw TrapUnwind{};
+
+    ctx.ticks += get_instruction_cost_table()[*pc];
+
+    const auto num_locals =
+        get_num_slots(instance.module->get_function_type(func_idx).inputs) + code.local_count;
+    const auto* const locals = &stack.local(0);
+    execution.captured_frames.push_back({func_idx,
+        static_cast<uint32_t>(pc - instructions.data()),
+        std::vector<Value>(locals, locals + num_locals),
+        std::vector<Value>(stack.rbegin(), stack.rend())});
+    throw CheckpointUnwind{};
+}
+
+template <bool MeteringEnabled>
+ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, Value* results,
+    ExecutionContext& ctx);
+
+template <bool MeteringEnabled>
+ExecutionResult execute_bounded(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx);
 
+/// Calls the function with the arguments from the stack and pushes the results.
+/// If bounded, the callee belongs to the bounded call subgraph entered by execute().
 template <bool MeteringEnabled>
-inline bool invoke_function(const FuncType& func_type, uint32_t func_idx, Instance& instance,
-    OperandStack& stack, ExecutionContext& ctx) noexcept
+inline void invoke_function(const FuncType& func_type, uint32_t func_idx, Instance& instance,
+    OperandStack& stack, ExecutionContext& ctx, bool bounded)
 {
-    const auto num_args = func_type.inputs.size();
+    const auto num_args = get_num_slots(func_type.inputs);
     assert(stack.size() >= num_args);
+    // The multiple results are written in place of the arguments, which the callee copies first.
+    // The stack has the space for them, as their height is included in the max stack height.
     const auto call_args = stack.rend() - num_args;
 
-    const auto ret = execute<MeteringEnabled>(instance, func_idx, call_args, ctx);
-    // Bubble up traps
-    if (ret.trapped)
-        return false;
+    const auto ret =
+        bounded ? execute_bounded<MeteringEnabled>(instance, func_idx, call_args, call_args, ctx) :
+                  execute<MeteringEnabled>(instance, func_idx, call_args, call_args, ctx);
+    assert(!ret.trapped);
 
     stack.drop(num_args);
 
-    const auto num_outputs = func_type.outputs.size();
-    // NOTE: we can assume these two from validation
-    assert(num_outputs <= 1);
+    const auto num_outputs = get_num_slots(func_type.outputs);
+    // NOTE: we can assume this from validation
     assert(ret.has_value == (num_outputs == 1));
-    // Push back the result
-    if (num_outputs != 0)
+    // Push back the results
+    if (num_outputs == 1)
         stack.push(ret.value);
-
-    return true;
+    else
+        stack.grow(num_outputs);
 }
 
-template <bool MeteringEnabled>
-ExecutionResult execute(
-    Instance& instance, FuncIdx func_idx, const Value* args, ExecutionContext& ctx) noexcept
+/// Executes the instructions of the function with the index, offset and branch immediates of type
+/// ImmT. The instructions are either the code of the function or its optimized translation.
+/// If bounded, the call depth limit has been checked for the whole call subgraph of the function,
+/// see Code::max_call_depth, so its direct calls skip the call depth bookkeeping.
+/// A tail call is not executed here, but recorded in @a tail_call and left to the caller.
+/// A single result is returned, and multiple results are written to @a results.
+template <bool MeteringEnabled, typename ImmT>
+ExecutionResult execute_code(Instance& instance, FuncIdx func_idx, const Code& code,
+    bytes_view instructions, const Value* args, Value* results, ExecutionContext& ctx,
+    bool bounded, TailCall& tail_call)
 {
-    assert(ctx.depth >= 0);
-    if (ctx.depth >= CallStackLimit)
-        return Trap;
+    // code_offset + stack_drop
+    constexpr auto BranchImmediateSize = 2 * sizeof(ImmT);
+    // opcode + function or type index
+    [[maybe_unused]] constexpr auto CallInstructionSize = 1 + sizeof(ImmT);
 
     const auto& func_type = instance.module->get_function_type(func_idx);
-
-    assert(instance.module->imported_function_types.size() == instance.imported_functions.size());
-    if (func_idx < instance.imported_functions.size())
-        return instance.imported_functions[func_idx].function(instance, args, ctx);
-
-    const auto& code = instance.module->get_code(func_idx);
     auto* const memory = instance.memory.get();
+    auto& dirty_memory_blocks = instance.dirty_memory_blocks;
 
-    const auto local_ctx = ctx.create_local_context();
-
-    OperandStack stack(args, func_type.inputs.size(), code.local_count,
+    OperandStack stack(args, get_num_slots(func_type.inputs), code.local_count,
         static_cast<size_t>(code.max_stack_height));
 
-    const uint8_t* pc = code.instructions.data();
+    const uint8_t* pc = instructions.data();
+
+    if constexpr (MeteringEnabled)
+    {
+        if (ctx.checkpoint_execution != nullptr)
+        {
+            if (const auto* frame = ctx.checkpoint_execution->take_resumed_frame())
+            {
+                assert(frame->func_idx == func_idx);
+                std::copy(frame->locals.begin(), frame->locals.end(), &stack.local(0));
+                for (const auto& value : frame->stack)
+                    stack.push(value);
+                pc += frame->code_offset;
+            }
+        }
+    }
 
     [[maybe_unused]] const auto* cost_table = get_instruction_cost_table();
 
@@ -588,8 +2057,12 @@ ExecutionResult execute(
 
         if constexpr (MeteringEnabled)
         {
-            if ((ctx.ticks -= cost_table[opcode]) < 0)
+            if ((ctx.ticks -= cost_table[opcode]) < 0 && !pause(ctx))
+            {
+                if (ctx.checkpoint_execution != nullptr)
+                    checkpoint_frame(ctx, instance, func_idx, code, instructions, pc - 1, stack);
                 goto trap;
+            }
         }
 
         switch (instruction)
@@ -603,11 +2076,11 @@ ExecutionResult execute(
         case Instr::if_:
         {
             if (stack.pop().as<uint32_t>() != 0)
-                pc += sizeof(uint32_t);  // Skip the immediate for else instruction.
+                pc += sizeof(ImmT);  // Skip the immediate for else instruction.
             else
             {
-                const auto target_pc = read<uint32_t>(pc);
-                pc = code.instructions.data() + target_pc;
+                const auto target_pc = read_immediate<ImmT>(pc);
+                pc = instructions.data() + target_pc;
             }
             break;
         }
@@ -615,14 +2088,14 @@ ExecutionResult execute(
         {
             // We reach else only after executing if block ("then" part),
             // so we need to skip else block now.
-            const auto target_pc = read<uint32_t>(pc);
-            pc = code.instructions.data() + target_pc;
+            const auto target_pc = read_immediate<ImmT>(pc);
+            pc = instructions.data() + target_pc;
             break;
         }
         case Instr::end:
         {
             // End execution if it's a final end instruction.
-            if (pc == code.instructions.data() + code.instructions.size())
+            if (pc == instructions.data() + instructions.size())
                 goto end;
             break;
         }
@@ -630,7 +2103,7 @@ ExecutionResult execute(
         case Instr::br_if:
         case Instr::return_:
         {
-            const auto arity = read<uint32_t>(pc);
+            const auto arity = read_immediate<ImmT>(pc);
 
             // Check condition for br_if.
             if (instruction == Instr::br_if && stack.pop().as<uint32_t>() == 0)
@@ -639,13 +2112,16 @@ ExecutionResult execute(
                 break;
             }
 
-            branch(code, stack, pc, arity);
+            const auto* const branch_pc = pc;
+            branch<ImmT>(instructions.data(), stack, pc, arity);
+            if (!take_back_edge<MeteringEnabled>(instance, func_idx, ctx, branch_pc, pc))
+                goto interrupt;
             break;
         }
         case Instr::br_table:
         {
-            const auto br_table_size = read<uint32_t>(pc);
-            const auto arity = read<uint32_t>(pc);
+            const auto br_table_size = read_immediate<ImmT>(pc);
+            const auto arity = read_immediate<ImmT>(pc);
 
             const auto br_table_idx = stack.pop().as<uint32_t>();
 
@@ -654,24 +2130,42 @@ ExecutionResult execute(
                                               br_table_size * BranchImmediateSize;
             pc += label_idx_offset;
 
-            branch(code, stack, pc, arity);
+            const auto* const branch_pc = pc;
+            branch<ImmT>(instructions.data(), stack, pc, arity);
+            if (!take_back_edge<MeteringEnabled>(instance, func_idx, ctx, branch_pc, pc))
+                goto interrupt;
             break;
         }
         case Instr::call:
         {
-            const auto called_func_idx = read<uint32_t>(pc);
+            const auto called_func_idx = read_immediate<ImmT>(pc);
             const auto& called_func_type = instance.module->get_function_type(called_func_idx);
 
-            if (!invoke_function<MeteringEnabled>(
-                    called_func_type, called_func_idx, instance, stack, ctx))
-                goto trap;
+            if constexpr (MeteringEnabled)
+            {
+                try
+                {
+                    invoke_function<MeteringEnabled>(
+                        called_func_type, called_func_idx, instance, stack, ctx, bounded);
+                }
+                catch (const CheckpointUnwind&)
+                {
+                    checkpoint_frame(ctx, instance, func_idx, code, instructions,
+                        pc - CallInstructionSize, stack);
+                }
+            }
+            else
+            {
+                invoke_function<MeteringEnabled>(
+                    called_func_type, called_func_idx, instance, stack, ctx, bounded);
+            }
             break;
         }
         case Instr::call_indirect:
         {
             assert(instance.table != nullptr);
 
-            const auto expected_type_idx = read<uint32_t>(pc);
+            const auto expected_type_idx = read_immediate<ImmT>(pc);
             assert(expected_type_idx < instance.module->typesec.size());
 
             const auto elem_idx = stack.pop().as<uint32_t>();
@@ -689,11 +2183,62 @@ ExecutionResult execute(
             if (expected_type != actual_type)
                 goto trap;
 
-            if (!invoke_function<MeteringEnabled>(
-                    actual_type, called_func.func_idx, *called_func.instance, stack, ctx))
-                goto trap;
+            if constexpr (MeteringEnabled)
+            {
+                try
+                {
+                    invoke_function<MeteringEnabled>(actual_type, called_func.func_idx,
+                        *called_func.instance, stack, ctx, false);
+                }
+                catch (const CheckpointUnwind&)
+                {
+                    // The call is executed again when resumed, so it needs the element index.
+                    stack.push(elem_idx);
+                    checkpoint_frame(ctx, instance, func_idx, code, instructions,
+                        pc - CallInstructionSize, stack);
+                }
+            }
+            else
+            {
+                invoke_function<MeteringEnabled>(
+                    actual_type, called_func.func_idx, *called_func.instance, stack, ctx, false);
+            }
             break;
         }
+        case Instr::return_call:
+        {
+            const auto called_func_idx = read_immediate<ImmT>(pc);
+            const auto num_args =
+                get_num_slots(instance.module->get_function_type(called_func_idx).inputs);
+
+            tail_call.set(instance, called_func_idx, stack.rend() - num_args, num_args);
+            return Void;
+        }
+        case Instr::return_call_indirect:
+        {
+            assert(instance.table != nullptr);
+
+            const auto expected_type_idx = read_immediate<ImmT>(pc);
+            assert(expected_type_idx < instance.module->typesec.size());
+
+            const auto elem_idx = stack.pop().as<uint32_t>();
+            if (elem_idx >= instance.table->size())
+                goto trap;
+
+            const auto called_func = (*instance.table)[elem_idx];
+            if (!called_func.instance)  // Table element not initialized.
+                goto trap;
+
+            const auto& actual_type =
+                called_func.instance->module->get_function_type(called_func.func_idx);
+            if (instance.module->typesec[expected_type_idx] != actual_type)
+                goto trap;
+
+            const auto num_args = get_num_slots(actual_type.inputs);
+            tail_call.set(*called_func.instance, called_func.func_idx, stack.rend() - num_args,
+                num_args);
+            return Void;
+        }
         case Instr::drop:
         {
             stack.pop();
@@ -711,27 +2256,38 @@ ExecutionResult execute(
                 stack.push(val1);
             break;
         }
+        case Instr::v128_select:
+        {
+            const auto condition = stack.pop().as<uint32_t>();
+            if (condition == 0)
+            {
+                stack[3] = stack[1];
+                stack[2] = stack[0];
+            }
+            stack.drop(2);
+            break;
+        }
         case Instr::local_get:
         {
-            const auto idx = read<uint32_t>(pc);
+            const auto idx = read_immediate<ImmT>(pc);
             stack.push(stack.local(idx));
             break;
         }
         case Instr::local_set:
         {
-            const auto idx = read<uint32_t>(pc);
+            const auto idx = read_immediate<ImmT>(pc);
             stack.local(idx) = stack.pop();
             break;
         }
         case Instr::local_tee:
         {
-            const auto idx = read<uint32_t>(pc);
+            const auto idx = read_immediate<ImmT>(pc);
             stack.local(idx) = stack.top();
             break;
         }
         case Instr::global_get:
         {
-            const auto idx = read<uint32_t>(pc);
+            const auto idx = read_immediate<ImmT>(pc);
             assert(idx < instance.imported_globals.size() + instance.globals.size());
             if (idx < instance.imported_globals.size())
             {
@@ -739,15 +2295,15 @@ ExecutionResult execute(
             }
             else
             {
-                const auto module_global_idx = idx - instance.imported_globals.size();
-                assert(module_global_idx < instance.module->globalsec.size());
-                stack.push(instance.globals[module_global_idx]);
+                const auto module_global_slot = idx - instance.imported_globals.size();
+                assert(module_global_slot < instance.globals.size());
+                stack.push(instance.globals[module_global_slot]);
             }
             break;
         }
         case Instr::global_set:
         {
-            const auto idx = read<uint32_t>(pc);
+            const auto idx = read_immediate<ImmT>(pc);
             if (idx < instance.imported_globals.size())
             {
                 assert(instance.imported_globals[idx].type.is_mutable);
@@ -755,138 +2311,158 @@ ExecutionResult execute(
             }
             else
             {
-                const auto module_global_idx = idx - instance.imported_globals.size();
-                assert(module_global_idx < instance.module->globalsec.size());
-                assert(instance.module->globalsec[module_global_idx].type.is_mutable);
-                instance.globals[module_global_idx] = stack.pop();
+                const auto module_global_slot = idx - instance.imported_globals.size();
+                assert(module_global_slot < instance.globals.size());
+                instance.globals[module_global_slot] = stack.pop();
             }
             break;
         }
+        case Instr::v128_global_get:
+        {
+            const auto* const value = get_v128_global(instance, read_immediate<ImmT>(pc));
+            stack.push(value[0]);
+            stack.push(value[1]);
+            break;
+        }
+        case Instr::v128_global_set:
+        {
+            auto* const value = get_v128_global(instance, read_immediate<ImmT>(pc));
+            value[1] = stack.pop();
+            value[0] = stack.pop();
+            break;
+        }
         case Instr::i32_load:
         {
-            if (!load_from_memory<uint32_t>(*memory, stack, pc))
+            if (!load_from_memory<uint32_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_load:
         {
-            if (!load_from_memory<uint64_t>(*memory, stack, pc))
+            if (!load_from_memory<uint64_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::f32_load:
         {
-            if (!load_from_memory<float>(*memory, stack, pc))
+            if (!load_from_memory<float>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::f64_load:
         {
-            if (!load_from_memory<double>(*memory, stack, pc))
+            if (!load_from_memory<double>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i32_load8_s:
         {
-            if (!load_from_memory<uint32_t, int8_t>(*memory, stack, pc))
+            if (!load_from_memory<uint32_t, int8_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i32_load8_u:
         {
-            if (!load_from_memory<uint32_t, uint8_t>(*memory, stack, pc))
+            if (!load_from_memory<uint32_t, uint8_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i32_load16_s:
         {
-            if (!load_from_memory<uint32_t, int16_t>(*memory, stack, pc))
+            if (!load_from_memory<uint32_t, int16_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i32_load16_u:
         {
-            if (!load_from_memory<uint32_t, uint16_t>(*memory, stack, pc))
+            if (!load_from_memory<uint32_t, uint16_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_load8_s:
         {
-            if (!load_from_memory<uint64_t, int8_t>(*memory, stack, pc))
+            if (!load_from_memory<uint64_t, int8_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_load8_u:
         {
-            if (!load_from_memory<uint64_t, uint8_t>(*memory, stack, pc))
+            if (!load_from_memory<uint64_t, uint8_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_load16_s:
         {
-            if (!load_from_memory<uint64_t, int16_t>(*memory, stack, pc))
+            if (!load_from_memory<uint64_t, int16_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_load16_u:
         {
-            if (!load_from_memory<uint64_t, uint16_t>(*memory, stack, pc))
+            if (!load_from_memory<uint64_t, uint16_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_load32_s:
         {
-            if (!load_from_memory<uint64_t, int32_t>(*memory, stack, pc))
+            if (!load_from_memory<uint64_t, int32_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_load32_u:
         {
-            if (!load_from_memory<uint64_t, uint32_t>(*memory, stack, pc))
+            if (!load_from_memory<uint64_t, uint32_t>(*memory, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i32_store:
         {
-            if (!store_into_memory<uint32_t>(*memory, stack, pc))
+            if (!store_into_memory<uint32_t>(
+                    *memory, dirty_memory_blocks, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_store:
         {
-            if (!store_into_memory<uint64_t>(*memory, stack, pc))
+            if (!store_into_memory<uint64_t>(
+                    *memory, dirty_memory_blocks, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::f32_store:
         {
-            if (!store_into_memory<float>(*memory, stack, pc))
+            if (!store_into_memory<float>(
+                    *memory, dirty_memory_blocks, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::f64_store:
         {
-            if (!store_into_memory<double>(*memory, stack, pc))
+            if (!store_into_memory<double>(
+                    *memory, dirty_memory_blocks, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i32_store8:
         case Instr::i64_store8:
         {
-            if (!store_into_memory<uint8_t>(*memory, stack, pc))
+            if (!store_into_memory<uint8_t>(
+                    *memory, dirty_memory_blocks, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i32_store16:
         case Instr::i64_store16:
         {
-            if (!store_into_memory<uint16_t>(*memory, stack, pc))
+            if (!store_into_memory<uint16_t>(
+                    *memory, dirty_memory_blocks, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
         case Instr::i64_store32:
         {
-            if (!store_into_memory<uint32_t>(*memory, stack, pc))
+            if (!store_into_memory<uint32_t>(
+                    *memory, dirty_memory_blocks, stack, read_immediate<ImmT>(pc)))
                 goto trap;
             break;
         }
@@ -902,7 +2478,8 @@ ExecutionResult execute(
 
             if constexpr (MeteringEnabled)
             {
-                if ((ctx.ticks -= get_grow_memory_cost(delta_pages)) < 0)
+                if ((ctx.ticks -= get_grow_memory_cost(delta_pages)) < 0 &&
+                    !continue_out_of_ticks(ctx))
                     goto trap;
             }
 
@@ -1594,6 +3171,111 @@ ExecutionResult execute(
             break;
         }
 
+        case Instr::memory_init:
+        {
+            const auto data_idx = read_immediate<ImmT>(pc);
+            const auto size = stack.pop().as<uint32_t>();
+            const auto src = stack.pop().as<uint32_t>();
+            const auto dst = stack.pop().as<uint32_t>();
+
+            if constexpr (MeteringEnabled)
+            {
+                if ((ctx.ticks -= get_bulk_memory_cost(size)) < 0 && !continue_out_of_ticks(ctx))
+                    goto trap;
+            }
+
+            const auto data = instance.dropped_data_segments[data_idx] ?
+                                  bytes_view{} :
+                                  bytes_view{instance.module->datasec[data_idx].init};
+            if (!init_memory(*memory, dirty_memory_blocks, dst, data, src, size))
+                goto trap;
+            break;
+        }
+        case Instr::data_drop:
+        {
+            const auto data_idx = read_immediate<ImmT>(pc);
+            instance.dropped_data_segments[data_idx] = true;
+            break;
+        }
+        case Instr::memory_copy:
+        {
+            const auto size = stack.pop().as<uint32_t>();
+            const auto src = stack.pop().as<uint32_t>();
+            const auto dst = stack.pop().as<uint32_t>();
+
+            if constexpr (MeteringEnabled)
+            {
+                if ((ctx.ticks -= get_bulk_memory_cost(size)) < 0 && !continue_out_of_ticks(ctx))
+                    goto trap;
+            }
+
+            if (!copy_memory(*memory, dirty_memory_blocks, dst, src, size))
+                goto trap;
+            break;
+        }
+        case Instr::memory_fill:
+        {
+            const auto size = stack.pop().as<uint32_t>();
+            const auto value = static_cast<uint8_t>(stack.pop().as<uint32_t>());
+            const auto dst = stack.pop().as<uint32_t>();
+
+            if constexpr (MeteringEnabled)
+            {
+                if ((ctx.ticks -= get_bulk_memory_cost(size)) < 0 && !continue_out_of_ticks(ctx))
+                    goto trap;
+            }
+
+            if (!fill_memory(*memory, dirty_memory_blocks, dst, value, size))
+                goto trap;
+            break;
+        }
+        case Instr::simd_prefix:
+        {
+            if (!execute_simd<ImmT>(stack, pc, memory, dirty_memory_blocks))
+                goto trap;
+            break;
+        }
+        case Instr::atomic_prefix:
+        {
+            if (!execute_atomic<ImmT>(stack, pc, memory, instance.memory_limits.shared,
+                    dirty_memory_blocks, ctx.interrupt_requested))
+                goto trap;
+            break;
+        }
+
+        case Instr::i32_add_imm:
+        {
+            const auto value = read<uint32_t>(pc);
+            ++pc;  // Skip i32.add.
+            stack.top() = add(stack.top().as<uint32_t>(), value);
+            break;
+        }
+        case Instr::i32_eqz_br_if:
+        {
+            ++pc;  // Skip br_if.
+            const auto arity = read_immediate<ImmT>(pc);
+            if (stack.pop().as<uint32_t>() != 0)
+            {
+                pc += BranchImmediateSize;
+                break;
+            }
+
+            const auto* const branch_pc = pc;
+            branch<ImmT>(instructions.data(), stack, pc, arity);
+            if (!take_back_edge<MeteringEnabled>(instance, func_idx, ctx, branch_pc, pc))
+                goto interrupt;
+            break;
+        }
+        case Instr::local_get_local_get:
+        {
+            const auto idx1 = read_immediate<ImmT>(pc);
+            ++pc;  // Skip the second local.get.
+            const auto idx2 = read_immediate<ImmT>(pc);
+            stack.push(stack.local(idx1));
+            stack.push(stack.local(idx2));
+            break;
+        }
+
         default:
             FIZZY_UNREACHABLE();
         }
@@ -1601,29 +3283,307 @@ ExecutionResult execute(
 
 end:
     // End of code must be reached.
-    assert(pc == code.instructions.data() + code.instructions.size());
-    assert(stack.size() == instance.module->get_function_type(func_idx).outputs.size());
+    assert(pc == instructions.data() + instructions.size());
+    assert(stack.size() == get_num_slots(instance.module->get_function_type(func_idx).outputs));
 
+    if (stack.size() > 1)
+    {
+        std::copy_n(stack.rbegin(), stack.size(), results);
+        return Void;
+    }
     return stack.size() != 0 ? ExecutionResult{stack.top()} : Void;
 
 trap:
-    return Trap;
+    throw TrapUnwind{};
+
+interrupt:
+    throw TrapUnwind{true};
+}
+
+/// Counts the call for the promotion to the optimized tier and returns the instructions to execute.
+/// Not inlined, so the calls without tiering pay only for the check of Instance::tiering.
+__attribute__((noinline)) bytes_view enter_tiered(
+    Instance& instance, FuncIdx func_idx, bytes_view instructions)
+{
+    assert(&instance.tiering->module() == instance.module.get());
+    if (const auto* optimized = instance.tiering->enter(func_idx))
+        return *optimized;
+    return instructions;
+}
+
+/// Executes the code with the variant of execute_code() matching its immediate size.
+/// The optimized translation of the code is used if the function has been promoted.
+template <bool MeteringEnabled>
+inline ExecutionResult execute_code_variant(Instance& instance, FuncIdx func_idx,
+    const Code& code, const Value* args, Value* results, ExecutionContext& ctx, bool bounded,
+    TailCall& tail_call)
+{
+    auto instructions = instance.module->get_instructions(code);
+    if constexpr (!MeteringEnabled)
+    {
+        if (instance.tiering != nullptr)
+            instructions = enter_tiered(instance, func_idx, instructions);
+    }
+
+    switch (code.immediate_size)
+    {
+    case sizeof(uint8_t):
+        return execute_code<MeteringEnabled, uint8_t>(
+            instance, func_idx, code, instructions, args, results, ctx, bounded, tail_call);
+    case sizeof(uint16_t):
+        return execute_code<MeteringEnabled, uint16_t>(
+            instance, func_idx, code, instructions, args, results, ctx, bounded, tail_call);
+    default:
+        assert(code.immediate_size == sizeof(uint32_t));
+        return execute_code<MeteringEnabled, uint32_t>(
+            instance, func_idx, code, instructions, args, results, ctx, bounded, tail_call);
+    }
+}
+
+/// Calls the imported function.
+inline ExecutionResult execute_imported(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx)
+{
+    // Host functions may modify the memory directly, without tracking.
+    if (!instance.dirty_memory_blocks.empty() && !instance.host_functions_mark_memory_dirty)
+        instance.memory_dirty_untracked = true;
+    auto& function = instance.imported_functions[func_idx];
+
+    // The frames of the executions nested in the host function cannot be checkpointed.
+    auto* const checkpoint_execution = std::exchange(ctx.checkpoint_execution, nullptr);
+    const auto ret = get_num_slots(function.output_types) <= 1 ?
+                         function.function(instance, args, ctx) :
+                         function.function(instance, args, results, ctx);
+    ctx.checkpoint_execution = checkpoint_execution;
+    if (ret.trapped)
+        throw TrapUnwind{ret.interrupted};
+    if (ret.suspended)
+    {
+        // The results of the host function are provided when the execution is resumed.
+        const auto resumed = suspend(ctx, !function.output_types.empty());
+        if (resumed.trapped)
+            throw TrapUnwind{};
+        return resumed;
+    }
+    return ret;
+}
+
+/// Executes the function's code and then the chain of its tail calls, each replacing the frame of
+/// the previous function at the same call depth.
+template <bool MeteringEnabled>
+inline ExecutionResult execute_function_code(Instance& instance, FuncIdx func_idx,
+    const Code& code, const Value* args, Value* results, ExecutionContext& ctx, bool bounded)
+{
+    auto* current_instance = &instance;
+    const auto* current_code = &code;
+
+    if constexpr (MeteringEnabled)
+    {
+        // The frame resumed from a checkpoint may be of a tail callee of the called function.
+        if (ctx.checkpoint_execution != nullptr)
+        {
+            const auto* frame = ctx.checkpoint_execution->next_resumed_frame();
+            if (frame != nullptr && frame->func_idx != func_idx)
+            {
+                func_idx = frame->func_idx;
+                current_code = &instance.module->get_code(func_idx);
+                if (!bounded)
+                {
+                    bounded = current_code->max_call_depth != 0 &&
+                              int64_t{ctx.depth} + int64_t{current_code->max_call_depth} <=
+                                  int64_t{CallStackLimit};
+                }
+            }
+        }
+    }
+
+    TailCall tail_call;
+    while (true)
+    {
+        // The function entries are polled, as the recursion and tail calls may loop without
+        // the back edges. The bounded call subgraph has no cycles, so only its loops are polled.
+        if (!bounded && is_interrupted(ctx))
+            throw TrapUnwind{true};
+
+        // The callee's results are the results of the function, so they have the same destination.
+        const auto ret = execute_code_variant<MeteringEnabled>(
+            *current_instance, func_idx, *current_code, args, results, ctx, bounded, tail_call);
+        if (tail_call.instance == nullptr)
+            return ret;
+
+        current_instance = tail_call.instance;
+        func_idx = tail_call.func_idx;
+        // The callee's operand stack copies the arguments before the next tail call is recorded.
+        args = tail_call.args();
+        tail_call.instance = nullptr;
+
+        count_call(*current_instance, func_idx, ctx);
+
+        if (func_idx < current_instance->imported_functions.size())
+            return execute_imported(*current_instance, func_idx, args, results, ctx);
+
+        // The direct tail calls of a bounded function are in its bounded call subgraph.
+        // Otherwise, the callee may start a bounded subgraph at the current depth.
+        current_code = &current_instance->module->get_code(func_idx);
+        if (!bounded)
+        {
+            bounded = current_code->max_call_depth != 0 &&
+                      int64_t{ctx.depth} + int64_t{current_code->max_call_depth} <=
+                          int64_t{CallStackLimit};
+        }
+    }
+}
+
+template <bool MeteringEnabled>
+ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, Value* results,
+    ExecutionContext& ctx)
+{
+    assert(ctx.depth >= 0);
+    if (ctx.depth >= CallStackLimit || is_native_stack_exhausted(ctx))
+        throw TrapUnwind{};
+
+    count_call(instance, func_idx, ctx);
+
+    assert(instance.module->imported_function_types.size() == instance.imported_functions.size());
+    if (func_idx < instance.imported_functions.size())
+        return execute_imported(instance, func_idx, args, results, ctx);
+
+    const auto& code = instance.module->get_code(func_idx);
+
+    // The depth limit is checked here once for the whole statically bounded call subgraph,
+    // if it fits. Otherwise, every call is checked to trap exactly at the limit.
+    const bool bounded =
+        code.max_call_depth != 0 &&
+        int64_t{ctx.depth} + int64_t{code.max_call_depth} <= int64_t{CallStackLimit};
+
+    const auto local_ctx = ctx.create_local_context();
+    return execute_function_code<MeteringEnabled>(
+        instance, func_idx, code, args, results, ctx, bounded);
+}
+
+template <bool MeteringEnabled>
+ExecutionResult execute_bounded(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx)
+{
+    // The call depth fits the bounded call subgraph, but the native stack may not.
+    if (is_native_stack_exhausted(ctx))
+        throw TrapUnwind{};
+
+    count_call(instance, func_idx, ctx);
+
+    const auto& code = instance.module->get_code(func_idx);
+    assert(code.max_call_depth != 0);
+    return execute_function_code<MeteringEnabled>(
+        instance, func_idx, code, args, results, ctx, true);
 }
 }  // namespace
 
 ExecutionResult execute(
     Instance& instance, FuncIdx func_idx, const Value* args, ExecutionContext& ctx) noexcept
 {
-    if (ctx.metering_enabled)
-        return execute<true>(instance, func_idx, args, ctx);
-    else
-        return execute<false>(instance, func_idx, args, ctx);
+    // There is no place to write more than one result slot to.
+    if (get_num_slots(instance.module->get_function_type(func_idx).outputs) > 1)
+        return Trap;
+
+    try
+    {
+        if (ctx.metering_enabled)
+            return execute<true>(instance, func_idx, args, nullptr, ctx);
+        else
+            return execute<false>(instance, func_idx, args, nullptr, ctx);
+    }
+    catch (const TrapUnwind& unwind)
+    {
+        return unwind.interrupted ? Interrupted : Trap;
+    }
 }
 
 ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args) noexcept
 {
     ExecutionContext ctx;
-    return execute<false>(instance, func_idx, args, ctx);
+    return execute(instance, func_idx, args, ctx);
+}
+
+ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, Value* results,
+    ExecutionContext& ctx) noexcept
+{
+    try
+    {
+        const auto ret = ctx.metering_enabled ?
+                             execute<true>(instance, func_idx, args, results, ctx) :
+                             execute<false>(instance, func_idx, args, results, ctx);
+        if (ret.has_value)
+            results[0] = ret.value;
+        return Void;
+    }
+    catch (const TrapUnwind& unwind)
+    {
+        return unwind.interrupted ? Interrupted : Trap;
+    }
+}
+
+ExecutionResult execute(
+    Instance& instance, FuncIdx func_idx, const Value* args, Value* results) noexcept
+{
+    ExecutionContext ctx;
+    return execute(instance, func_idx, args, results, ctx);
+}
+
+namespace
+{
+/// Executes the function with the frames of the checkpoint execution captured into a new
+/// checkpoint if it runs out of ticks.
+ExecutionResult run_checkpointable(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx, CheckpointExecution& execution,
+    std::optional<Checkpoint>& checkpoint) noexcept
+{
+    assert(ctx.metering_enabled);
+    assert(ctx.checkpoint_execution == nullptr);
+    ctx.checkpoint_execution = &execution;
+    try
+    {
+        const auto ret = execute<true>(instance, func_idx, args, results, ctx);
+        ctx.checkpoint_execution = nullptr;
+        if (ret.has_value)
+            results[0] = ret.value;
+        return Void;
+    }
+    catch (const CheckpointUnwind&)
+    {
+        ctx.checkpoint_execution = nullptr;
+        auto& frames = execution.captured_frames;
+        std::reverse(frames.begin(), frames.end());
+        checkpoint.emplace(Checkpoint{snapshot(instance), std::move(frames), ctx.ticks});
+        return Suspended;
+    }
+    catch (const TrapUnwind& unwind)
+    {
+        ctx.checkpoint_execution = nullptr;
+        return unwind.interrupted ? Interrupted : Trap;
+    }
+}
+}  // namespace
+
+ExecutionResult execute_checkpointable(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx, std::optional<Checkpoint>& checkpoint) noexcept
+{
+    checkpoint.reset();
+    CheckpointExecution execution{instance, {}};
+    return run_checkpointable(instance, func_idx, args, results, ctx, execution, checkpoint);
+}
+
+ExecutionResult resume_checkpoint(Instance& instance, Value* results, ExecutionContext& ctx,
+    std::optional<Checkpoint>& checkpoint) noexcept
+{
+    assert(checkpoint.has_value() && !checkpoint->frames.empty());
+    const auto resumed = std::move(*checkpoint);
+    checkpoint.reset();
+
+    restore(instance, resumed.state);
+    const auto& entry_frame = resumed.frames.front();
+    CheckpointExecution execution{instance, resumed.frames};
+    return run_checkpointable(instance, entry_frame.func_idx, entry_frame.locals.data(), results,
+        ctx, execution, checkpoint);
 }
 
 }  // namespace fizzy
@@ -26,6 +26,11 @@ struct ExecutionResult
     const bool trapped = false;
     /// This is true if value contains valid data.
     const bool has_value = false;
+    /// This is true if the execution has been stopped by ExecutionContext::interrupt_requested.
+    /// The interrupted execution is also trapped.
+    const bool interrupted = false;
+    /// This is true if the execution has been suspended by a host function, see Suspended.
+    const bool suspended = false;
     /// The result value. Valid if `has_value == true`.
     const Value value{};
 
@@ -35,12 +40,23 @@ struct ExecutionResult
     /// Constructs result in "void" or "trap" state depending on the success flag.
     /// Prefer using Void and Trap constants instead.
     constexpr explicit ExecutionResult(bool success) noexcept : trapped{!success} {}
+
+    /// Constructs result without a value in the given state.
+    /// Prefer using Void, Trap, Interrupted and Suspended constants instead.
+    constexpr ExecutionResult(bool success, bool _interrupted, bool _suspended = false) noexcept
+      : trapped{!success}, interrupted{_interrupted}, suspended{_suspended}
+    {}
 };
 
 /// Shortcut for execution that resulted in successful execution, but without a result.
 constexpr ExecutionResult Void{true};
 /// Shortcut for execution that resulted in a trap.
 constexpr ExecutionResult Trap{false};
+/// Shortcut for execution that has been interrupted, see ExecutionContext::interrupt_requested.
+constexpr ExecutionResult Interrupted{false, true};
+/// Shortcut for execution that has been suspended, see execute_suspendable().
+/// A host function returns it to suspend the execution calling it.
+constexpr ExecutionResult Suspended{true, false, true};
 
 
 /// Execute a function from an instance.
@@ -50,9 +66,13 @@ constexpr ExecutionResult Trap{false};
 ///                     (including crash) happens.
 /// @param  args        The pointer to the arguments. The number of items and their types must match
 ///                     the expected number of input parameters of the function, otherwise undefined
-///                     behaviour (including crash) happens.
+///                     behaviour (including crash) happens. Each v128 argument occupies 2 items,
+///                     see get_num_slots().
 /// @param  ctx         Execution context.
 /// @return             The result of the execution.
+///
+/// @note  The function must have at most one result, which is not v128, see the execute() with
+///        results otherwise. A function with more results is not executed and Trap is returned.
 ExecutionResult execute(
     Instance& instance, FuncIdx func_idx, const Value* args, ExecutionContext& ctx) noexcept;
 
@@ -60,4 +80,29 @@ ExecutionResult execute(
 /// metering disabled.
 /// Arguments and behavior is the same as in the other execute().
 ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args) noexcept;
+
+/// Execute a function with any number of results from an instance, writing the results to
+/// the caller-provided array.
+///
+/// @param  instance    The instance.
+/// @param  func_idx    The function index. MUST be a valid index, otherwise undefined behaviour
+///                     (including crash) happens.
+/// @param  args        The pointer to the arguments, as in the other execute().
+/// @param  results     The pointer to the array for the results. It must have the size of
+///                     the number of the function's output slots, see get_num_slots(), and may be
+///                     null if there are none.
+///                     The results are not written if the execution traps.
+/// @param  ctx         Execution context.
+/// @return             Void, Trap if the execution has trapped, or Interrupted if it has been
+///                     stopped by ExecutionContext::interrupt_requested. It is never Suspended:
+///                     a host function returning Suspended suspends the execution started by
+///                     execute_suspendable(), or the execution traps otherwise.
+ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, Value* results,
+    ExecutionContext& ctx) noexcept;
+
+/// Execute a function with any number of results from an instance with execution context starting
+/// with default depth of 0 and metering disabled.
+/// Arguments and behavior is the same as in the other execute() with results.
+ExecutionResult execute(
+    Instance& instance, FuncIdx func_idx, const Value* args, Value* results) noexcept;
 }  // namespace fizzy
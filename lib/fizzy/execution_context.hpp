@@ -4,10 +4,17 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <limits>
+#include <memory>
 
 namespace fizzy
 {
+class CheckpointExecution;
+class SuspendableExecution;
+struct Module;
+
 /// The storage for information shared by calls in the same execution "thread".
 /// Users may decide how to allocate the execution context, but some good defaults are available.
 class ExecutionContext
@@ -36,11 +43,40 @@ class ExecutionContext
 public:
     int depth = 0;  ///< Current call depth.
     /// Current ticks left for execution, if #metering_enabled is true.
-    /// Execution traps when running out of ticks.
+    /// Execution traps when running out of ticks, or is paused if it has been started with
+    /// execute_suspendable().
     /// Ignored if #metering_enabled is false.
     int64_t ticks = std::numeric_limits<int64_t>::max();
     /// Set to true to enable execution metering.
     bool metering_enabled = false;
+    /// Set to true, e.g. from another thread or a timer, to stop the execution.
+    /// It is polled only at loop iterations, at entries of the functions which may recurse
+    /// and periodically while waiting in memory.atomic.wait32/64, which is much cheaper than
+    /// metering. The execution then ends with the Interrupted result.
+    /// It is not reset by the execution, so all following executions are interrupted until
+    /// it is cleared.
+    std::atomic<bool> interrupt_requested{false};
+    /// The optional call counters of the functions of #call_counts_module, indexed by function
+    /// index. If set, each execution of a function of the module increments its counter. This
+    /// allows recording the profile used to lay out the code of frequently called functions
+    /// together, see parse() with call counts.
+    /// It must have an entry for each function of the module. The calls of functions of other
+    /// modules, e.g. via imports or the table, are not counted.
+    uint64_t* call_counts = nullptr;
+    /// The module whose calls are counted in #call_counts.
+    const Module* call_counts_module = nullptr;
+    /// The lowest address of the native stack the execution may use. The calls trap once
+    /// the native stack grows below it, instead of overflowing it. It is set by
+    /// execute_suspendable() and resume() while the execution runs on its own, limited stack.
+    /// The default 0 disables the check.
+    uintptr_t native_stack_limit = 0;
+    /// The state of the execution started with execute_checkpointable() in this context, used to
+    /// capture and re-enter its frames. It is cleared for the executions nested in host functions.
+    CheckpointExecution* checkpoint_execution = nullptr;
+    /// The execution started with execute_suspendable() in this context, until it is finished.
+    /// Resetting it while the execution is suspended cancels the execution.
+    /// It is declared last, so the cancellation still sees the other members.
+    std::shared_ptr<SuspendableExecution> suspendable_execution;
 
     /// Increments the call depth and returns the local call context which
     /// decrements the call depth back to the original value when going out of scope.
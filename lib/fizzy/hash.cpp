@@ -0,0 +1,54 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "hash.hpp"
+
+namespace fizzy
+{
+namespace
+{
+constexpr uint64_t hash_multiplier = 0x9e3779b97f4a7c15;
+
+/// The finalizer of MurmurHash3, mixing all the bits of the input.
+inline uint64_t fmix64(uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t mix_word(uint64_t h, uint64_t word) noexcept
+{
+    h ^= word * hash_multiplier;
+    h = (h << 31) | (h >> 33);
+    return h * 0xbf58476d1ce4e5b9;
+}
+}  // namespace
+
+uint64_t hash_bytes(bytes_view data) noexcept
+{
+    auto h = uint64_t{data.size()} * hash_multiplier;
+
+    const auto* pos = data.data();
+    const auto* const end = pos + data.size();
+    for (; end - pos >= 8; pos += 8)
+    {
+        uint64_t word;
+        __builtin_memcpy(&word, pos, sizeof(word));
+        h = mix_word(h, word);
+    }
+
+    if (pos != end)
+    {
+        uint64_t word = 0;
+        __builtin_memcpy(&word, pos, static_cast<size_t>(end - pos));
+        h = mix_word(h, word);
+    }
+
+    return fmix64(h);
+}
+}  // namespace fizzy
@@ -0,0 +1,14 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include <cstdint>
+
+namespace fizzy
+{
+/// Returns the 64-bit hash of the bytes. Fast, but not cryptographically secure.
+uint64_t hash_bytes(bytes_view data) noexcept;
+}  // namespace fizzy
@@ -0,0 +1,127 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "instance_pool.hpp"
+#include <cstring>
+
+namespace fizzy
+{
+InstancePool::InstancePool(std::shared_ptr<const Module> module,
+    std::vector<ExternalFunction> imported_functions, std::vector<ExternalGlobal> imported_globals,
+    uint32_t memory_pages_limit, size_t max_idle, bool host_functions_mark_memory_dirty)
+  : m_module{std::move(module)},
+    m_imported_functions{std::move(imported_functions)},
+    m_imported_globals{std::move(imported_globals)},
+    m_memory_pages_limit{memory_pages_limit},
+    m_max_idle{max_idle},
+    m_host_functions_mark_memory_dirty{host_functions_mark_memory_dirty}
+{
+    if (!m_module->imported_memory_types.empty())
+        throw instantiate_error{"instance pool does not support imported memory"};
+    if (!m_module->imported_table_types.empty())
+        throw instantiate_error{"instance pool does not support imported table"};
+
+    m_template = instantiate(m_module, m_imported_functions, {}, {}, m_imported_globals,
+        m_memory_pages_limit);
+}
+
+std::unique_ptr<Instance> InstancePool::create_instance() const
+{
+    auto instance = instantiate(m_module, m_imported_functions, {}, {}, m_imported_globals,
+        m_memory_pages_limit);
+
+    if (instance->memory != nullptr)
+    {
+        const auto num_blocks =
+            (instance->memory->size() + DirtyMemoryBlockSize - 1) / DirtyMemoryBlockSize;
+        // Always keep at least one word, the empty bitmap disables the tracking.
+        instance->dirty_memory_blocks.resize(std::max<size_t>((num_blocks + 63) / 64, 1));
+        instance->host_functions_mark_memory_dirty = m_host_functions_mark_memory_dirty;
+    }
+    return instance;
+}
+
+void InstancePool::reset(Instance& instance) const
+{
+    if (instance.memory != nullptr)
+    {
+        auto& memory = *instance.memory;
+        const auto& initial_memory = *m_template->memory;
+
+        if (instance.memory_dirty_untracked)
+        {
+            memory = initial_memory;
+        }
+        else
+        {
+            memory.resize(initial_memory.size());
+
+            auto& blocks = instance.dirty_memory_blocks;
+            for (size_t word_idx = 0; word_idx < blocks.size(); ++word_idx)
+            {
+                for (auto word = blocks[word_idx]; word != 0; word &= word - 1)
+                {
+                    const auto block = word_idx * 64 + static_cast<size_t>(__builtin_ctzll(word));
+                    const auto offset = block * DirtyMemoryBlockSize;
+                    if (offset >= initial_memory.size())
+                        break;
+                    const auto size =
+                        std::min<size_t>(DirtyMemoryBlockSize, initial_memory.size() - offset);
+                    std::memcpy(&memory[offset], &initial_memory[offset], size);
+                }
+            }
+        }
+
+        std::fill(instance.dirty_memory_blocks.begin(), instance.dirty_memory_blocks.end(), 0);
+        instance.memory_dirty_untracked = false;
+    }
+
+    instance.globals = m_template->globals;
+    instance.dropped_data_segments = m_template->dropped_data_segments;
+
+    if (instance.table != nullptr)
+    {
+        auto& table = *instance.table;
+        const auto& initial_table = *m_template->table;
+        table.resize(initial_table.size());
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            // Table is not imported, so the initialized elements refer to the instance itself.
+            const auto& element = initial_table[i];
+            table[i] = {element.instance != nullptr ? &instance : nullptr, element.func_idx, {}};
+        }
+    }
+}
+
+std::unique_ptr<Instance> InstancePool::acquire()
+{
+    {
+        const std::lock_guard lock{m_mutex};
+        if (!m_idle.empty())
+        {
+            auto instance = std::move(m_idle.back());
+            m_idle.pop_back();
+            return instance;
+        }
+    }
+    return create_instance();
+}
+
+void InstancePool::release(std::unique_ptr<Instance> instance)
+{
+    assert(instance != nullptr && instance->module == m_module);
+
+    reset(*instance);
+
+    const std::lock_guard lock{m_mutex};
+    if (m_idle.size() < m_max_idle)
+        m_idle.push_back(std::move(instance));
+}
+
+size_t InstancePool::idle_count() noexcept
+{
+    const std::lock_guard lock{m_mutex};
+    return m_idle.size();
+}
+}  // namespace fizzy
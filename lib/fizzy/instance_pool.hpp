@@ -0,0 +1,80 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "instantiate.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fizzy
+{
+/// The pool of instances of a module, which are reused instead of instantiated for each use.
+///
+/// A released instance is reset to the state after instantiation: the modified memory blocks,
+/// the memory size, the globals and the table are restored. The memory modifications are tracked
+/// by the store instructions, see Instance::dirty_memory_blocks, so the cost of the reset depends
+/// on the amount of memory the instance has modified, not on the memory size. After a call of
+/// an imported function the whole memory is restored, because host functions may modify it
+/// directly, unless the pool is created with the host functions marking their modifications
+/// with mark_memory_dirty().
+///
+/// All instances are reset to the state of the template instance created with the pool, so the
+/// start function of the module is expected to be deterministic. The imported globals are not
+/// reset. Modules importing a memory or a table are not supported, because the state of these is
+/// not owned by the instances.
+///
+/// The acquire() and release() methods are thread-safe.
+class InstancePool
+{
+    std::shared_ptr<const Module> m_module;
+    std::vector<ExternalFunction> m_imported_functions;
+    std::vector<ExternalGlobal> m_imported_globals;
+    uint32_t m_memory_pages_limit = DefaultMemoryPagesLimit;
+    size_t m_max_idle = 0;
+    bool m_host_functions_mark_memory_dirty = false;
+
+    /// The instance the state after instantiation is taken from. It is never handed out.
+    std::unique_ptr<Instance> m_template;
+
+    /// The instances ready to be acquired.
+    std::vector<std::unique_ptr<Instance>> m_idle;
+    std::mutex m_mutex;
+
+    /// Creates a new instance with memory tracking enabled.
+    std::unique_ptr<Instance> create_instance() const;
+
+    /// Restores the instance to the state of the template instance.
+    void reset(Instance& instance) const;
+
+public:
+    /// Creates the pool instantiating the template instance with the given imports.
+    /// Throws instantiate_error in the same way as instantiate().
+    ///
+    /// @param max_idle                          The maximum number of released instances kept
+    ///                                          for reuse.
+    /// @param host_functions_mark_memory_dirty  Set if the imported functions call
+    ///                                          mark_memory_dirty() for all their modifications
+    ///                                          of the memory, so it is restored as tracked.
+    explicit InstancePool(std::shared_ptr<const Module> module,
+        std::vector<ExternalFunction> imported_functions = {},
+        std::vector<ExternalGlobal> imported_globals = {},
+        uint32_t memory_pages_limit = DefaultMemoryPagesLimit, size_t max_idle = 64,
+        bool host_functions_mark_memory_dirty = false);
+
+    InstancePool(const InstancePool&) = delete;
+    InstancePool& operator=(const InstancePool&) = delete;
+
+    /// Returns an instance in the state after instantiation, reusing a released one if possible.
+    std::unique_ptr<Instance> acquire();
+
+    /// Resets the instance and keeps it for reuse, or destroys it if the pool has enough idle
+    /// instances. The instance must have been acquired from this pool.
+    void release(std::unique_ptr<Instance> instance);
+
+    /// Returns the number of instances ready to be acquired.
+    size_t idle_count() noexcept;
+};
+}  // namespace fizzy
@@ -35,6 +35,15 @@ void match_imported_functions(const std::vector<FuncType>& module_imported_types
             throw instantiate_error{"function " + std::to_string(i) +
                                     " type doesn't match module's imported function type"};
         }
+
+        // The host functions return a single Value in ExecutionResult, so neither multiple
+        // results nor the v128 result occupying 2 slots are supported.
+        if (get_num_slots(imported_functions[i].output_types) > 1 &&
+            imported_functions[i].function.get_host_function() != nullptr)
+        {
+            throw instantiate_error{"function " + std::to_string(i) +
+                                    " is a host function with multi-slot results, not supported"};
+        }
     }
 }
 
@@ -112,6 +121,12 @@ void match_imported_memories(const std::vector<Memory>& module_imported_memories
 
         match_limits(imported_memories[0].limits, module_imported_memories[0].limits);
 
+        if (imported_memories[0].limits.shared != module_imported_memories[0].limits.shared)
+        {
+            throw instantiate_error{
+                "provided imported memory sharing doesn't match module's imported memory"};
+        }
+
         if (imported_memories[0].data == nullptr)
             throw instantiate_error{"provided imported memory has a null pointer to data"};
 
@@ -175,8 +190,11 @@ std::tuple<table_ptr, Limits> allocate_table(
         return {table_ptr{nullptr, null_delete}, Limits{}};
 }
 
+/// Allocates the memory defined by the module or takes the imported one.
+/// The memory defined by the module is initialized with the @p image, if provided.
 std::tuple<bytes_ptr, Limits> allocate_memory(const std::vector<Memory>& module_memories,
-    const std::vector<ExternalMemory>& imported_memories, uint32_t memory_pages_limit)
+    const std::vector<ExternalMemory>& imported_memories, uint32_t memory_pages_limit,
+    const MemoryImage* image)
 {
     static const auto bytes_delete = [](bytes* b) noexcept { delete b; };
     static const auto null_delete = [](bytes*) noexcept {};
@@ -210,10 +228,27 @@ std::tuple<bytes_ptr, Limits> allocate_memory(const std::vector<Memory>& module_
             throw instantiate_error{"cannot allocate more than " +
                                     std::to_string(std::numeric_limits<size_t>::max()) + " bytes"};
         }
-        // NOTE: fill it with zeroes
         // can_narrow guarantees that memory_min_bytes won't overflow size_t
         assert(memory_min_bytes <= std::numeric_limits<size_t>::max());
-        bytes_ptr memory{new bytes(static_cast<size_t>(memory_min_bytes), 0), bytes_delete};
+        const auto memory_size = static_cast<size_t>(memory_min_bytes);
+        if (image == nullptr)
+        {
+            // NOTE: fill it with zeroes
+            bytes_ptr memory{new bytes(memory_size, 0), bytes_delete};
+            return {std::move(memory), module_memories[0].limits};
+        }
+
+        // Write every byte once: the runs of the image and zeroes in the gaps between them.
+        // The parser guarantees the image fits in the minimal memory size.
+        bytes_ptr memory{new bytes, bytes_delete};
+        memory->reserve(memory_size);
+        for (const auto& run : image->runs)
+        {
+            assert(run.offset + run.data.size() <= memory_size);
+            memory->resize(run.offset, 0);
+            memory->append(run.data);
+        }
+        memory->resize(memory_size, 0);
         return {std::move(memory), module_memories[0].limits};
     }
     else if (imported_memories.size() == 1)
@@ -273,6 +308,11 @@ ExternalFunction find_imported_function(const std::string& module, const std::st
         throw instantiate_error{"function " + module + "." + name +
                                 " input types don't match imported function in module"};
     }
+    if (module_func_type.outputs.size() > 1)
+    {
+        throw instantiate_error{"function " + module + "." + name +
+                                " has multiple outputs, not supported for host functions"};
+    }
     if (module_func_type.outputs.empty() && it->output.has_value())
     {
         throw instantiate_error{
@@ -337,7 +377,21 @@ ExecutionResult ExecuteFunction::operator()(
         return m_host_function(m_host_context, instance, args, ctx);
 }
 
-std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
+ExecutionResult ExecuteFunction::operator()(
+    Instance& instance, const Value* args, Value* results, ExecutionContext& ctx) noexcept
+{
+    if (m_instance)
+        return execute(*m_instance, m_func_idx, args, results, ctx);
+
+    const auto ret = m_host_function(m_host_context, instance, args, ctx);
+    if (ret.trapped || ret.suspended)
+        return ret;
+    if (ret.has_value)
+        results[0] = ret.value;
+    return Void;
+}
+
+std::unique_ptr<Instance> instantiate(std::shared_ptr<const Module> module,
     std::vector<ExternalFunction> imported_functions, std::vector<ExternalTable> imported_tables,
     std::vector<ExternalMemory> imported_memories, std::vector<ExternalGlobal> imported_globals,
     uint32_t memory_pages_limit /*= DefaultMemoryPagesLimit*/)
@@ -360,12 +414,23 @@ std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
 
         const auto value = eval_constant_expression(global.expression, imported_globals, globals);
         globals.emplace_back(value);
+
+        // The v128 global occupies 2 slots, see Module::global_slots.
+        if (global.type.value_type == ValType::v128)
+        {
+            const auto& expr = global.expression;
+            globals.emplace_back(expr.kind == ConstantExpression::Kind::Constant ?
+                                     expr.constant_high :
+                                     imported_globals[expr.value.global_index].value[1]);
+        }
     }
 
     auto [table, table_limits] = allocate_table(module->tablesec, imported_tables);
 
+    const auto* const memory_image =
+        module->memory_image.has_value() ? &*module->memory_image : nullptr;
     auto [memory, memory_limits] =
-        allocate_memory(module->memorysec, imported_memories, memory_pages_limit);
+        allocate_memory(module->memorysec, imported_memories, memory_pages_limit, memory_image);
     // In case upper limit for local/imported memory is defined,
     // we adjust the hard memory limit, to ensure memory.grow will fail when exceeding it.
     // Note: allocate_memory ensures memory's max limit is always below memory_pages_limit.
@@ -374,21 +439,42 @@ std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
         assert(*memory_limits.max <= memory_pages_limit);
         memory_pages_limit = *memory_limits.max;
     }
+    // The shared memory is accessed by other threads concurrently, so it cannot be reallocated
+    // and memory.grow fails, except for growing by 0 pages.
+    if (memory_limits.shared)
+        memory_pages_limit = static_cast<uint32_t>(memory->size() / PageSize);
 
     // Before starting to fill memory and table,
     // check that data and element segments are within bounds.
     std::vector<uint64_t> datasec_offsets;
-    datasec_offsets.reserve(module->datasec.size());
-    for (const auto& data : module->datasec)
+    if (memory_image != nullptr)
     {
-        // Offset is validated to be i32, but it's used in 64-bit calculation below.
-        const uint64_t offset =
-            eval_constant_expression(data.offset, imported_globals, globals).i32;
-
-        if (offset + data.init.size() > memory->size())
+        // The image covers all the data segments.
+        if (!memory_image->runs.empty() &&
+            uint64_t{memory_image->runs.back().offset} + memory_image->runs.back().data.size() >
+                memory->size())
             throw instantiate_error{"data segment is out of memory bounds"};
+    }
+    else
+    {
+        datasec_offsets.reserve(module->datasec.size());
+        for (const auto& data : module->datasec)
+        {
+            if (data.passive)
+            {
+                datasec_offsets.emplace_back(0);
+                continue;
+            }
+
+            // Offset is validated to be i32, but it's used in 64-bit calculation below.
+            const uint64_t offset =
+                eval_constant_expression(data.offset, imported_globals, globals).i32;
+
+            if (offset + data.init.size() > memory->size())
+                throw instantiate_error{"data segment is out of memory bounds"};
 
-        datasec_offsets.emplace_back(offset);
+            datasec_offsets.emplace_back(offset);
+        }
     }
 
     assert(module->elementsec.empty() || table != nullptr);
@@ -407,11 +493,18 @@ std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
     }
 
     // Fill out memory based on data segments
-    for (size_t i = 0; i < module->datasec.size(); ++i)
+    // The memory defined by the module is already initialized with the image by allocate_memory().
+    if (memory_image == nullptr)
     {
-        // NOTE: these instructions can overlap
-        std::copy(module->datasec[i].init.begin(), module->datasec[i].init.end(),
-            memory->data() + datasec_offsets[i]);
+        for (size_t i = 0; i < module->datasec.size(); ++i)
+        {
+            if (module->datasec[i].passive)
+                continue;
+
+            // NOTE: these instructions can overlap
+            std::copy(module->datasec[i].init.begin(), module->datasec[i].init.end(),
+                memory->data() + datasec_offsets[i]);
+        }
     }
 
     // We need to create instance before filling table,
@@ -423,6 +516,11 @@ std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
         memory_pages_limit, std::move(table), table_limits, std::move(globals),
         std::move(imported_functions), std::move(imported_globals));
 
+    // The active data segments are dropped after being applied.
+    instance->dropped_data_segments.reserve(instance->module->datasec.size());
+    for (const auto& data : instance->module->datasec)
+        instance->dropped_data_segments.push_back(!data.passive);
+
     // Fill the table based on elements segment
     for (size_t i = 0; i < instance->module->elementsec.size(); ++i)
     {
@@ -536,8 +634,10 @@ std::optional<ExternalGlobal> find_exported_global(
     else
     {
         // global owned by instance
-        const auto module_global_idx = global_idx - instance.imported_globals.size();
-        return ExternalGlobal{&instance.globals[module_global_idx],
+        const auto module_global_idx =
+            static_cast<uint32_t>(global_idx - instance.imported_globals.size());
+        const auto module_global_slot = instance.module->get_global_slot(module_global_idx);
+        return ExternalGlobal{&instance.globals[module_global_slot],
             instance.module->globalsec[module_global_idx].type};
     }
 }
@@ -559,8 +659,8 @@ std::optional<ExternalMemory> find_exported_memory(
         return std::nullopt;
 
     // Memory lower limit should be updated in case it was grown.
-    const Limits limits{
-        static_cast<uint32_t>(instance.memory->size() / PageSize), instance.memory_limits.max};
+    const Limits limits{static_cast<uint32_t>(instance.memory->size() / PageSize),
+        instance.memory_limits.max, instance.memory_limits.shared};
     return ExternalMemory{instance.memory.get(), limits};
 }
 
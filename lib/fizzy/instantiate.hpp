@@ -10,7 +10,9 @@
 #include "module.hpp"
 #include "types.hpp"
 #include "value.hpp"
+#include <algorithm>
 #include <any>
+#include <cassert>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -22,6 +24,7 @@ namespace fizzy
 struct ExecutionResult;
 class ExecutionContext;
 struct Instance;
+class TieringManager;
 
 /// Function pointer to the execution function.
 using HostFunctionPtr = ExecutionResult (*)(
@@ -67,6 +70,11 @@ public:
     ExecutionResult operator()(
         Instance& instance, const Value* args, ExecutionContext& ctx) noexcept;
 
+    /// Function call operator writing the results to @a results, see execute() with results.
+    /// Host functions can have at most one result.
+    ExecutionResult operator()(
+        Instance& instance, const Value* args, Value* results, ExecutionContext& ctx) noexcept;
+
     /// Function pointer stored inside this object.
     HostFunctionPtr get_host_function() const noexcept { return m_host_function; }
 };
@@ -119,6 +127,7 @@ struct ExternalMemory
 
 struct ExternalGlobal
 {
+    /// Pointer to global value. The v128 value occupies 2 consecutive Values, see get_num_slots().
     Value* value = nullptr;
     GlobalType type;
 };
@@ -129,7 +138,8 @@ using bytes_ptr = std::unique_ptr<bytes, void (*)(bytes*)>;
 struct Instance
 {
     /// Module of this instance.
-    std::unique_ptr<const Module> module;
+    /// The module is immutable, so it can be shared by any number of instances.
+    std::shared_ptr<const Module> module;
 
     /// Instance memory.
     /// Memory is either allocated and owned by the instance or imported as already allocated bytes
@@ -153,6 +163,7 @@ struct Instance
     Limits table_limits;
 
     /// Instance globals (excluding imported globals).
+    /// The v128 globals occupy 2 slots, see Module::get_global_slot().
     std::vector<Value> globals;
 
     /// Imported functions.
@@ -161,7 +172,26 @@ struct Instance
     /// Imported globals.
     std::vector<ExternalGlobal> imported_globals;
 
-    Instance(std::unique_ptr<const Module> _module, bytes_ptr _memory, Limits _memory_limits,
+    /// The bitmap of memory blocks of DirtyMemoryBlockSize bytes modified by store instructions.
+    /// Empty if the tracking is disabled. Used by InstancePool to restore only the modified memory.
+    std::vector<uint64_t> dirty_memory_blocks;
+
+    /// Set when the memory may have been modified without tracking, i.e. by an imported function.
+    bool memory_dirty_untracked = false;
+
+    /// Set if the imported functions mark their memory modifications with mark_memory_dirty(),
+    /// so their calls keep the memory tracked.
+    bool host_functions_mark_memory_dirty = false;
+
+    /// The flags of the data segments dropped by data.drop or, for the active ones,
+    /// by instantiation. memory.init treats the dropped segments as empty.
+    std::vector<bool> dropped_data_segments;
+
+    /// The optional manager of the optimized tier of the module's functions, which may be shared
+    /// by all instances of the module. Unused by executions with metering enabled.
+    std::shared_ptr<TieringManager> tiering;
+
+    Instance(std::shared_ptr<const Module> _module, bytes_ptr _memory, Limits _memory_limits,
         uint32_t _memory_pages_limit, table_ptr _table, Limits _table_limits,
         std::vector<Value> _globals, std::vector<ExternalFunction> _imported_functions,
         std::vector<ExternalGlobal> _imported_globals)
@@ -177,8 +207,38 @@ struct Instance
     {}
 };
 
+/// The granularity of tracking memory modifications, see Instance::dirty_memory_blocks.
+constexpr uint32_t DirtyMemoryBlockSize = 4096;
+
+/// Marks the memory range as modified in the non-empty dirty memory blocks bitmap.
+/// The blocks outside of the bitmap are ignored.
+inline void mark_memory_dirty(
+    std::vector<uint64_t>& dirty_memory_blocks, uint64_t offset, uint64_t size) noexcept
+{
+    assert(!dirty_memory_blocks.empty());
+    if (size == 0)
+        return;
+
+    const auto num_blocks = uint64_t{dirty_memory_blocks.size()} * 64;
+    const auto first_block = offset / DirtyMemoryBlockSize;
+    const auto last_block = std::min((offset + size - 1) / DirtyMemoryBlockSize, num_blocks - 1);
+    for (auto block = first_block; block <= last_block; ++block)
+        dirty_memory_blocks[block / 64] |= uint64_t{1} << (block % 64);
+}
+
+/// Marks the memory range of the instance as modified, if the instance tracks modifications.
+/// Embedders writing directly into the memory of an instance acquired from InstancePool must call
+/// it, otherwise the modification is not reverted when the instance is released.
+inline void mark_memory_dirty(Instance& instance, uint64_t offset, uint64_t size) noexcept
+{
+    if (!instance.dirty_memory_blocks.empty())
+        mark_memory_dirty(instance.dirty_memory_blocks, offset, size);
+}
+
 /// Instantiate a module.
-std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
+/// The instance shares the ownership of the module, so the same module can be instantiated
+/// many times without copying it.
+std::unique_ptr<Instance> instantiate(std::shared_ptr<const Module> module,
     std::vector<ExternalFunction> imported_functions = {},
     std::vector<ExternalTable> imported_tables = {},
     std::vector<ExternalMemory> imported_memories = {},
@@ -219,7 +279,7 @@ struct ImportedGlobal
     /// Global name.
     std::string name;
 
-    /// Pointer to global value.
+    /// Pointer to global value, see ExternalGlobal::value.
     Value* value = nullptr;
 
     /// Value type of global.
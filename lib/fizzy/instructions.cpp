@@ -31,9 +31,9 @@ constexpr InstructionType instruction_type_table[256] = {
 
     /* call                = 0x10 */ {{}, {}},
     /* call_indirect       = 0x11 */ {{ValType::i32}, {}},
+    /* return_call         = 0x12 */ {{}, {}},
+    /* return_call_indirect = 0x13 */ {{ValType::i32}, {}},
 
-    /*                       0x12 */ {},
-    /*                       0x13 */ {},
     /*                       0x14 */ {},
     /*                       0x15 */ {},
     /*                       0x16 */ {},
@@ -249,9 +249,9 @@ constexpr uint8_t instruction_max_align_table[256] = {
     /* return_             = 0x0f */ 0,
     /* call                = 0x10 */ 0,
     /* call_indirect       = 0x11 */ 0,
+    /* return_call         = 0x12 */ 0,
+    /* return_call_indirect = 0x13 */ 0,
 
-    /*                       0x12 */ 0,
-    /*                       0x13 */ 0,
     /*                       0x14 */ 0,
     /*                       0x15 */ 0,
     /*                       0x16 */ 0,
@@ -465,9 +465,9 @@ constexpr int16_t instruction_cost_table[256] = {
     /* return_             = 0x0f */ 1,
     /* call                = 0x10 */ 1,
     /* call_indirect       = 0x11 */ 1,
+    /* return_call         = 0x12 */ 1,
+    /* return_call_indirect = 0x13 */ 1,
 
-    /*                       0x12 */ 1,
-    /*                       0x13 */ 1,
     /*                       0x14 */ 1,
     /*                       0x15 */ 1,
     /*                       0x16 */ 1,
@@ -659,6 +659,72 @@ constexpr int16_t instruction_cost_table[256] = {
     /* i64_reinterpret_f64 = 0xbd */ 1,
     /* f32_reinterpret_i32 = 0xbe */ 1,
     /* f64_reinterpret_i64 = 0xbf */ 1,
+
+    /*                       0xc0 */ 0,
+    /*                       0xc1 */ 0,
+    /*                       0xc2 */ 0,
+    /*                       0xc3 */ 0,
+    /*                       0xc4 */ 0,
+    /*                       0xc5 */ 0,
+    /*                       0xc6 */ 0,
+    /*                       0xc7 */ 0,
+    /*                       0xc8 */ 0,
+    /*                       0xc9 */ 0,
+    /*                       0xca */ 0,
+    /*                       0xcb */ 0,
+    /*                       0xcc */ 0,
+    /*                       0xcd */ 0,
+    /*                       0xce */ 0,
+    /*                       0xcf */ 0,
+    /*                       0xd0 */ 0,
+    /*                       0xd1 */ 0,
+    /*                       0xd2 */ 0,
+    /*                       0xd3 */ 0,
+    /*                       0xd4 */ 0,
+    /*                       0xd5 */ 0,
+    /*                       0xd6 */ 0,
+    /*                       0xd7 */ 0,
+    /*                       0xd8 */ 0,
+    /*                       0xd9 */ 0,
+    /*                       0xda */ 0,
+    /*                       0xdb */ 0,
+    /*                       0xdc */ 0,
+    /*                       0xdd */ 0,
+    /*                       0xde */ 0,
+    /*                       0xdf */ 0,
+
+    // Internal instructions, see Instr.
+    /* i32_add_imm         = 0xe0 */ 2,
+    /* i32_eqz_br_if       = 0xe1 */ 2,
+    /* local_get_local_get = 0xe2 */ 2,
+    /*                       0xe3 */ 0,
+    /*                       0xe4 */ 0,
+    /*                       0xe5 */ 0,
+    /*                       0xe6 */ 0,
+    /*                       0xe7 */ 0,
+    /*                       0xe8 */ 0,
+    /*                       0xe9 */ 0,
+    /*                       0xea */ 0,
+    /*                       0xeb */ 0,
+    /*                       0xec */ 0,
+    /*                       0xed */ 0,
+    /*                       0xee */ 0,
+    /*                       0xef */ 0,
+    /* memory_init         = 0xf0 */ 1,
+    /* data_drop           = 0xf1 */ 1,
+    /* memory_copy         = 0xf2 */ 1,
+    /* memory_fill         = 0xf3 */ 1,
+    /* v128_select         = 0xf4 */ 1,
+    /* v128_global_get     = 0xf5 */ 1,
+    /* v128_global_set     = 0xf6 */ 1,
+    /*                       0xf7 */ 0,
+    /*                       0xf8 */ 0,
+    /*                       0xf9 */ 0,
+    /*                       0xfa */ 0,
+    /*                       0xfb */ 0,
+    /*                       0xfc */ 0,
+    /* simd_prefix         = 0xfd */ 1,
+    /* atomic_prefix       = 0xfe */ 1,
 };
 }  // namespace
 
@@ -37,4 +37,11 @@ inline constexpr auto get_grow_memory_cost(uint32_t delta_pages) noexcept
     return delta_pages * 65536;
 }
 
+/// Calculates the cost of the memory range processed by a bulk memory instruction, in addition to
+/// the cost of the instruction. Currently set at 1 per byte, the same as memory expansion.
+inline constexpr int64_t get_bulk_memory_cost(uint32_t size) noexcept
+{
+    return size;
+}
+
 }  // namespace fizzy
@@ -19,6 +19,10 @@ inline std::pair<T, const uint8_t*> leb128u_decode(const uint8_t* pos, const uin
 {
     static_assert(!std::numeric_limits<T>::is_signed);
 
+    // Single byte encodings are the most common by far.
+    if (pos != end && (*pos & 0x80) == 0)
+        return {*pos, pos + 1};
+
     T result = 0;
     int result_shift = 0;
 
@@ -46,6 +50,11 @@ inline std::pair<T, const uint8_t*> leb128s_decode(const uint8_t* pos, const uin
     static_assert(std::numeric_limits<T>::is_signed);
 
     using T_unsigned = typename std::make_unsigned<T>::type;
+
+    // Single byte encodings are the most common by far. Extend the sign bit of the 7-bit value.
+    if (pos != end && (*pos & 0x80) == 0)
+        return {static_cast<T>(static_cast<int8_t>(*pos << 1) >> 1), pos + 1};
+
     T_unsigned result = 0;
     size_t result_shift = 0;
 
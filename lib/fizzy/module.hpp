@@ -35,6 +35,8 @@ struct Module
     std::vector<Code> codesec;
     // https://webassembly.github.io/spec/core/binary/modules.html#data-section
     std::vector<Data> datasec;
+    // https://webassembly.github.io/spec/core/binary/modules.html#data-count-section
+    std::optional<uint32_t> datacount;
 
     // Types of functions defined in import section
     std::vector<FuncType> imported_function_types;
@@ -45,6 +47,30 @@ struct Module
     // Types of globals defined in import section
     std::vector<GlobalType> imported_global_types;
 
+    /// The first Value slots of the globals defined by the module in Instance::globals.
+    /// It is only present if any of them is v128, see get_num_slots(). Otherwise, each global
+    /// occupies the slot equal to its index in the global section.
+    std::vector<uint32_t> global_slots;
+
+    /// The initial memory content built from the data segments by the parser.
+    /// It is only present if the memory is defined by the module, and all data segments have
+    /// constant offsets and fit in the minimal memory size. Instantiation writes it into memory
+    /// in one pass instead of applying the data segments one by one. The payloads of the active
+    /// data segments are released once the image is built, see Data::init.
+    std::optional<MemoryImage> memory_image;
+
+    /// The translated instructions of all functions, stored contiguously in the order chosen by
+    /// the parser. The Code entries refer to their ranges of it.
+    bytes code_buffer;
+
+    /// The operand stack heights at the instructions of all functions, stored contiguously.
+    /// The Code entries refer to their ranges of it.
+    bytes stack_heights_buffer;
+
+    /// The hash of the wasm binary the module has been parsed from, see hash_bytes().
+    /// It identifies the module independently of the code layout chosen by the parser.
+    uint64_t binary_hash = 0;
+
     size_t get_function_count() const noexcept
     {
         return imported_function_types.size() + funcsec.size();
@@ -76,6 +102,13 @@ struct Module
                    globalsec[idx - imported_global_types.size()].type;
     }
 
+    /// Returns the first Value slot of the global defined by the module in Instance::globals.
+    uint32_t get_global_slot(uint32_t module_global_idx) const noexcept
+    {
+        assert(module_global_idx < globalsec.size());
+        return global_slots.empty() ? module_global_idx : global_slots[module_global_idx];
+    }
+
     const Code& get_code(FuncIdx func_idx) const noexcept
     {
         assert(func_idx >= imported_function_types.size());  // Cannot be imported function.
@@ -84,6 +117,21 @@ struct Module
         return codesec[code_idx];
     }
 
+    /// Returns the instructions of the code from the code buffer.
+    bytes_view get_instructions(const Code& code) const noexcept
+    {
+        assert(size_t{code.instructions_offset} + code.instructions_size <= code_buffer.size());
+        return {code_buffer.data() + code.instructions_offset, code.instructions_size};
+    }
+
+    /// Returns the stack heights of the code from the stack heights buffer.
+    bytes_view get_stack_heights(const Code& code) const noexcept
+    {
+        assert(size_t{code.stack_heights_offset} + code.stack_heights_size <=
+               stack_heights_buffer.size());
+        return {stack_heights_buffer.data() + code.stack_heights_offset, code.stack_heights_size};
+    }
+
     bool has_table() const noexcept { return !tablesec.empty() || !imported_table_types.empty(); }
 
     bool has_memory() const noexcept
@@ -0,0 +1,171 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "module_cache.hpp"
+#include "parser.hpp"
+#include <iterator>
+
+namespace fizzy
+{
+namespace
+{
+template <typename T>
+inline size_t get_elements_size(const std::vector<T>& v) noexcept
+{
+    return v.size() * sizeof(T);
+}
+
+inline size_t get_func_types_size(const std::vector<FuncType>& types) noexcept
+{
+    auto size = get_elements_size(types);
+    for (const auto& type : types)
+        size += get_elements_size(type.inputs) + get_elements_size(type.outputs);
+    return size;
+}
+}  // namespace
+
+size_t get_module_size(const Module& module) noexcept
+{
+    auto size = sizeof(Module) + get_func_types_size(module.typesec) +
+                get_elements_size(module.importsec) + get_elements_size(module.funcsec) +
+                get_elements_size(module.tablesec) + get_elements_size(module.memorysec) +
+                get_elements_size(module.globalsec) + get_elements_size(module.exportsec) +
+                get_elements_size(module.elementsec) + get_elements_size(module.codesec) +
+                get_elements_size(module.datasec) +
+                get_func_types_size(module.imported_function_types) +
+                get_elements_size(module.imported_table_types) +
+                get_elements_size(module.imported_memory_types) +
+                get_elements_size(module.imported_global_types) +
+                get_elements_size(module.global_slots) + module.code_buffer.size() +
+                module.stack_heights_buffer.size();
+
+    for (const auto& import : module.importsec)
+        size += import.module.size() + import.name.size();
+    for (const auto& export_ : module.exportsec)
+        size += export_.name.size();
+    for (const auto& element : module.elementsec)
+        size += get_elements_size(element.init);
+    for (const auto& data : module.datasec)
+        size += data.init.size();
+    if (module.memory_image)
+    {
+        size += get_elements_size(module.memory_image->runs);
+        for (const auto& run : module.memory_image->runs)
+            size += run.data.size();
+    }
+
+    return size;
+}
+
+std::shared_ptr<const Module> ModuleCache::find_locked(uint64_t hash, bytes_view input)
+{
+    const auto [first, last] = m_index.equal_range(hash);
+    for (auto it = first; it != last; ++it)
+    {
+        const auto entry_it = it->second;
+        // Hash collisions are told apart by the binaries.
+        if (entry_it->binary == input)
+        {
+            m_entries.splice(m_entries.begin(), m_entries, entry_it);
+            return entry_it->module;
+        }
+    }
+    return nullptr;
+}
+
+void ModuleCache::unindex_locked(std::list<Entry>::iterator entry_it) noexcept
+{
+    const auto [first, last] = m_index.equal_range(entry_it->hash);
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second == entry_it)
+        {
+            m_index.erase(it);
+            return;
+        }
+    }
+}
+
+void ModuleCache::evict_locked() noexcept
+{
+    while (m_used > m_capacity && !m_entries.empty())
+    {
+        const auto lru_it = std::prev(m_entries.end());
+        m_used -= lru_it->cost;
+        unindex_locked(lru_it);
+        m_entries.erase(lru_it);
+    }
+}
+
+std::shared_ptr<const Module> ModuleCache::find(bytes_view input)
+{
+    const auto hash = hash_bytes(input);
+    const std::lock_guard lock{m_mutex};
+    return find_locked(hash, input);
+}
+
+std::shared_ptr<const Module> ModuleCache::get_or_parse(bytes_view input)
+{
+    const auto hash = hash_bytes(input);
+    {
+        const std::lock_guard lock{m_mutex};
+        if (auto module = find_locked(hash, input); module != nullptr)
+        {
+            ++m_hits;
+            return module;
+        }
+        ++m_misses;
+    }
+
+    // The lookup hash is passed on, so the binary is hashed once also on the miss.
+    std::shared_ptr<const Module> module = parse(input, hash);
+    const auto cost = input.size() + get_module_size(*module);
+
+    const std::lock_guard lock{m_mutex};
+    // Another thread may have cached the same binary in the meantime, use its module then.
+    if (auto cached_module = find_locked(hash, input); cached_module != nullptr)
+        return cached_module;
+
+    if (cost > m_capacity)
+        return module;
+
+    m_entries.push_front({hash, bytes{input}, module, cost});
+    m_index.emplace(hash, m_entries.begin());
+    m_used += cost;
+    evict_locked();
+    return module;
+}
+
+void ModuleCache::clear() noexcept
+{
+    const std::lock_guard lock{m_mutex};
+    m_index.clear();
+    m_entries.clear();
+    m_used = 0;
+}
+
+size_t ModuleCache::size() const noexcept
+{
+    const std::lock_guard lock{m_mutex};
+    return m_entries.size();
+}
+
+size_t ModuleCache::used_bytes() const noexcept
+{
+    const std::lock_guard lock{m_mutex};
+    return m_used;
+}
+
+size_t ModuleCache::hits() const noexcept
+{
+    const std::lock_guard lock{m_mutex};
+    return m_hits;
+}
+
+size_t ModuleCache::misses() const noexcept
+{
+    const std::lock_guard lock{m_mutex};
+    return m_misses;
+}
+}  // namespace fizzy
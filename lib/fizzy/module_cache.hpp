@@ -0,0 +1,97 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include "hash.hpp"
+#include "module.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace fizzy
+{
+/// Returns the approximate number of bytes of memory held by the parsed module: its sections,
+/// including the payloads of data segments, its translated code and its memory image.
+size_t get_module_size(const Module& module) noexcept;
+
+/// The cache of parsed modules keyed by the content of their WebAssembly binaries.
+///
+/// The cache holds the modules up to the given byte budget and evicts the least recently used
+/// ones when the budget is exceeded. The cost of a module is the size of its binary, which is kept
+/// to compare against on hits, plus get_module_size() of the parsed module.
+/// The binaries with colliding hashes are cached side by side, so a binary crafted to collide
+/// with another one cannot evict it from the cache.
+/// All the methods are thread-safe.
+class ModuleCache
+{
+    struct Entry
+    {
+        uint64_t hash = 0;
+        bytes binary;
+        std::shared_ptr<const Module> module;
+        size_t cost = 0;
+    };
+
+    /// The entries in the order of use, the most recently used first.
+    std::list<Entry> m_entries;
+
+    /// The index of the entries by the hash of the binary.
+    std::unordered_multimap<uint64_t, std::list<Entry>::iterator> m_index;
+
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+
+    mutable std::mutex m_mutex;
+
+    /// Finds the module by the hash and the binary and marks it as the most recently used.
+    /// Must be called with the mutex locked.
+    std::shared_ptr<const Module> find_locked(uint64_t hash, bytes_view input);
+
+    /// Removes the entry from the index. Must be called with the mutex locked.
+    void unindex_locked(std::list<Entry>::iterator entry_it) noexcept;
+
+    /// Evicts the least recently used entries until the budget is kept.
+    /// Must be called with the mutex locked.
+    void evict_locked() noexcept;
+
+public:
+    /// Creates the cache with the budget of @p capacity bytes.
+    explicit ModuleCache(size_t capacity) noexcept : m_capacity{capacity} {}
+
+    ModuleCache(const ModuleCache&) = delete;
+    ModuleCache& operator=(const ModuleCache&) = delete;
+
+    /// Returns the cached module parsed from @p input or nullptr if there is none.
+    std::shared_ptr<const Module> find(bytes_view input);
+
+    /// Returns the cached module parsed from @p input, or parses the input and caches the module.
+    ///
+    /// The parsing happens without holding the lock, so concurrent lookups are not blocked by it.
+    /// Throws parser_error or validation_error in the same way as parse(), invalid binaries are
+    /// not cached.
+    std::shared_ptr<const Module> get_or_parse(bytes_view input);
+
+    /// Removes all the modules from the cache. The modules still in use by instances are kept
+    /// alive by them.
+    void clear() noexcept;
+
+    /// Returns the number of cached modules.
+    size_t size() const noexcept;
+
+    /// Returns the total cost of cached modules in bytes.
+    size_t used_bytes() const noexcept;
+
+    /// Returns the number of get_or_parse() calls which found the module in the cache.
+    size_t hits() const noexcept;
+
+    /// Returns the number of get_or_parse() calls which had to parse the module.
+    size_t misses() const noexcept;
+};
+}  // namespace fizzy
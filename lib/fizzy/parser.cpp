@@ -4,11 +4,14 @@
 
 #include "parser.hpp"
 #include "asserts.hpp"
+#include "hash.hpp"
 #include "leb128.hpp"
 #include "limits.hpp"
 #include "types.hpp"
 #include "utf8.hpp"
+#include <algorithm>
 #include <cassert>
+#include <numeric>
 #include <unordered_set>
 
 namespace fizzy
@@ -32,6 +35,14 @@ void validate_constant_expression(
     if (global_type.value_type != expected_type)
         throw validation_error{"constant expression type mismatch"};
 }
+
+/// Returns the position of the section in the required order of non-custom sections.
+/// The data count section goes between the element and code sections.
+constexpr int get_section_order(SectionId id) noexcept
+{
+    return id == SectionId::data_count ? 2 * static_cast<int>(SectionId::element) + 1 :
+                                         2 * static_cast<int>(id);
+}
 }  // namespace
 
 /// The reference to the `code` in the wasm binary.
@@ -83,6 +94,8 @@ ValType validate_valtype(uint8_t byte)
         return ValType::f32;
     case 0x7C:
         return ValType::f64;
+    case 0x7B:
+        return ValType::v128;
     default:
         throw parser_error{"invalid valtype " + std::to_string(byte)};
     }
@@ -111,10 +124,6 @@ inline parser_result<FuncType> parse(const uint8_t* pos, const uint8_t* end)
     FuncType result;
     std::tie(result.inputs, pos) = parse_vec<ValType>(pos, end);
     std::tie(result.outputs, pos) = parse_vec<ValType>(pos, end);
-
-    if (result.outputs.size() > 1)
-        throw validation_error{"function has more than one result"};
-
     return {result, pos};
 }
 
@@ -192,6 +201,22 @@ inline parser_result<ConstantExpression> parse_constant_expression(
         std::tie(result.value.constant, pos) = parse_value<uint64_t>(pos, end);
         constant_actual_type = ValType::f64;
         break;
+    case Instr::simd_prefix:
+    {
+        uint32_t simd_opcode;
+        std::tie(simd_opcode, pos) = leb128u_decode<uint32_t>(pos, end);
+        if (simd_opcode != static_cast<uint32_t>(SimdInstr::v128_const))
+        {
+            throw validation_error{"unexpected instruction in the constant expression: " +
+                                   std::to_string(opcode) + " " + std::to_string(simd_opcode)};
+        }
+
+        result.kind = ConstantExpression::Kind::Constant;
+        std::tie(result.value.constant, pos) = parse_value<uint64_t>(pos, end);
+        std::tie(result.constant_high, pos) = parse_value<uint64_t>(pos, end);
+        constant_actual_type = ValType::v128;
+        break;
+    }
     }
 
     uint8_t end_opcode;
@@ -216,7 +241,10 @@ inline parser_result<Global> parse(const uint8_t* pos, const uint8_t* end)
     return {result, pos};
 }
 
-inline parser_result<Limits> parse_limits(const uint8_t* pos, const uint8_t* end)
+/// Parses the limits. The shared limits of the threads proposal are accepted only if
+/// @p allow_shared is true, i.e. for memories.
+inline parser_result<Limits> parse_limits(
+    const uint8_t* pos, const uint8_t* end, bool allow_shared = false)
 {
     Limits result;
 
@@ -228,14 +256,23 @@ inline parser_result<Limits> parse_limits(const uint8_t* pos, const uint8_t* end
         std::tie(result.min, pos) = leb128u_decode<uint32_t>(pos, end);
         return {result, pos};
     case 0x01:
+    case 0x03:
+        if (kind == 0x03 && !allow_shared)
+            break;
+        result.shared = (kind == 0x03);
         std::tie(result.min, pos) = leb128u_decode<uint32_t>(pos, end);
         std::tie(result.max, pos) = leb128u_decode<uint32_t>(pos, end);
         if (result.min > *result.max)
             throw validation_error{"malformed limits (minimum is larger than maximum)"};
         return {result, pos};
+    case 0x02:
+        if (allow_shared)
+            throw validation_error{"shared memory must have maximum"};
+        break;
     default:
-        throw parser_error{"invalid limits " + std::to_string(kind)};
+        break;
     }
+    throw parser_error{"invalid limits " + std::to_string(kind)};
 }
 
 template <>
@@ -256,7 +293,7 @@ template <>
 inline parser_result<Memory> parse(const uint8_t* pos, const uint8_t* end)
 {
     Limits limits;
-    std::tie(limits, pos) = parse_limits(pos, end);
+    std::tie(limits, pos) = parse_limits(pos, end, true);
     if ((limits.min > MaxMemoryPagesLimit) ||
         (limits.max.has_value() && *limits.max > MaxMemoryPagesLimit))
         throw validation_error{"maximum memory page limit exceeded"};
@@ -391,53 +428,215 @@ inline parser_result<code_view> parse(const uint8_t* pos, const uint8_t* end)
     return {{code_begin, code_size}, code_end};
 }
 
-inline Code parse_code(code_view code_binary, FuncIdx func_idx, const Module& module)
+/// Parses the code entry. If EmitCode is false, the code is only validated and the returned code
+/// is empty.
+template <bool EmitCode>
+inline ParsedCode parse_code(code_view code_binary, FuncIdx func_idx, const Module& module,
+    std::pmr::memory_resource* resource)
 {
     const auto begin = code_binary.begin();
     const auto end = code_binary.end();
     const auto [locals_vec, pos1] = parse_vec<Locals>(begin, end);
 
+    // The number of Value slots of the locals, see get_num_slots().
     uint64_t local_count = 0;
     for (const auto& l : locals_vec)
     {
-        local_count += l.count;
+        local_count += uint64_t{l.count} * get_num_slots(l.type);
         if (local_count > std::numeric_limits<uint32_t>::max())
             throw parser_error{"too many local variables"};
     }
 
     // TODO: Clarify in spec what happens if count of locals and arguments exceed uint32_t::max()
     //       Leave this assert here for the time being.
-    assert((uint64_t{local_count} + module.typesec[module.funcsec[func_idx]].inputs.size()) <=
+    assert(local_count + get_num_slots(module.typesec[module.funcsec[func_idx]].inputs) <=
            std::numeric_limits<uint32_t>::max());
 
-    auto [code, pos2] = parse_expr(pos1, end, func_idx, locals_vec, module);
+    if constexpr (EmitCode)
+    {
+        // The code with 4-byte immediates is only temporary, the compacted code is the one
+        // allocated from the resource.
+        std::pmr::monotonic_buffer_resource code_resource;
+        auto [code, pos2] = parse_expr(pos1, end, func_idx, locals_vec, module, &code_resource);
 
-    // Size is the total bytes of locals and expressions.
-    if (pos2 != end)
-        throw parser_error{"malformed size field for function"};
+        // Size is the total bytes of locals and expressions.
+        if (pos2 != end)
+            throw parser_error{"malformed size field for function"};
 
-    code.local_count = static_cast<uint32_t>(local_count);
-    return code;
+        code.local_count = static_cast<uint32_t>(local_count);
+        return compact_code(code, resource);
+    }
+    else
+    {
+        (void)resource;
+        if (validate_expr(pos1, end, func_idx, locals_vec, module) != end)
+            throw parser_error{"malformed size field for function"};
+        return {};
+    }
+}
+
+/// Copies the code of all functions into the module's code buffer and creates the code entries.
+/// If call counts are provided, the functions are placed in the order of descending call counts,
+/// otherwise in the order of the code section.
+inline void layout_code(
+    Module& module, const std::vector<ParsedCode>& parsed_codes, span<const uint64_t> call_counts)
+{
+    std::vector<size_t> order(parsed_codes.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    if (!std::empty(call_counts))
+    {
+        const auto get_call_count = [&](size_t code_idx) noexcept {
+            const auto func_idx = module.imported_function_types.size() + code_idx;
+            return func_idx < std::size(call_counts) ? call_counts[func_idx] : 0;
+        };
+        std::stable_sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return get_call_count(a) > get_call_count(b); });
+    }
+
+    size_t code_buffer_size = 0;
+    size_t stack_heights_buffer_size = 0;
+    for (const auto& parsed_code : parsed_codes)
+    {
+        code_buffer_size += parsed_code.instructions.size();
+        stack_heights_buffer_size += parsed_code.stack_heights.size();
+    }
+    if (code_buffer_size > std::numeric_limits<uint32_t>::max() ||
+        stack_heights_buffer_size > std::numeric_limits<uint32_t>::max())
+        throw parser_error{"translated code too large"};
+
+    module.code_buffer.reserve(code_buffer_size);
+    module.stack_heights_buffer.reserve(stack_heights_buffer_size);
+    module.codesec.resize(parsed_codes.size());
+    for (const auto code_idx : order)
+    {
+        const auto& parsed_code = parsed_codes[code_idx];
+        module.codesec[code_idx] = {parsed_code.max_stack_height, parsed_code.local_count,
+            static_cast<uint32_t>(module.code_buffer.size()),
+            static_cast<uint32_t>(parsed_code.instructions.size()), parsed_code.immediate_size, 0,
+            static_cast<uint32_t>(module.stack_heights_buffer.size()),
+            static_cast<uint32_t>(parsed_code.stack_heights.size())};
+        module.code_buffer.append(parsed_code.instructions.begin(), parsed_code.instructions.end());
+        module.stack_heights_buffer.append(
+            parsed_code.stack_heights.begin(), parsed_code.stack_heights.end());
+    }
+}
+
+/// Computes Code::max_call_depth of all functions from the call graph of the module.
+/// The graph is traversed depth-first without recursion, because call chains can be long.
+inline void compute_max_call_depths(Module& module, const std::vector<ParsedCode>& parsed_codes)
+{
+    enum class State : uint8_t
+    {
+        unvisited,
+        visiting,
+        visited
+    };
+
+    const auto num_imported = module.imported_function_types.size();
+    std::vector<State> states(parsed_codes.size(), State::unvisited);
+
+    struct Frame
+    {
+        size_t code_idx;
+        size_t next_callee = 0;
+        uint32_t max_callee_depth = 0;
+        bool bounded = true;
+    };
+    std::vector<Frame> path;
+
+    for (size_t root = 0; root < parsed_codes.size(); ++root)
+    {
+        if (states[root] != State::unvisited)
+            continue;
+
+        states[root] = State::visiting;
+        path.push_back({root});
+        while (!path.empty())
+        {
+            auto& frame = path.back();
+            const auto& parsed_code = parsed_codes[frame.code_idx];
+            if (frame.bounded && frame.next_callee < parsed_code.callees.size())
+            {
+                const auto callee = parsed_code.callees[frame.next_callee++];
+                if (callee < num_imported)
+                {
+                    frame.bounded = false;
+                    continue;
+                }
+
+                const auto callee_code_idx = callee - num_imported;
+                switch (states[callee_code_idx])
+                {
+                case State::unvisited:
+                    states[callee_code_idx] = State::visiting;
+                    path.push_back({callee_code_idx});  // Invalidates the frame reference.
+                    break;
+                case State::visiting:
+                    // Recursion. The functions on the cycle become unbounded when the path
+                    // unwinds back to the callee.
+                    frame.bounded = false;
+                    break;
+                case State::visited:
+                {
+                    const auto callee_depth = module.codesec[callee_code_idx].max_call_depth;
+                    if (callee_depth == 0)
+                        frame.bounded = false;
+                    frame.max_callee_depth = std::max(frame.max_callee_depth, callee_depth);
+                    break;
+                }
+                }
+                continue;
+            }
+
+            uint32_t depth = 0;
+            // Depths exceeding the call stack limit are not useful, the check would always fail.
+            if (frame.bounded && !parsed_code.has_call_indirect &&
+                frame.max_callee_depth < static_cast<uint32_t>(CallStackLimit))
+                depth = frame.max_callee_depth + 1;
+            module.codesec[frame.code_idx].max_call_depth = depth;
+            states[frame.code_idx] = State::visited;
+            path.pop_back();
+
+            if (!path.empty())
+            {
+                auto& caller = path.back();
+                if (depth == 0)
+                    caller.bounded = false;
+                caller.max_callee_depth = std::max(caller.max_callee_depth, depth);
+            }
+        }
+    }
 }
 
 template <>
 inline parser_result<Data> parse(const uint8_t* pos, const uint8_t* end)
 {
-    MemIdx memory_index;
-    std::tie(memory_index, pos) = leb128u_decode<uint32_t>(pos, end);
-
-    // TODO: The check should be memory_index < num_of_memories (0 or 1),
-    //       but access to the memory section of the module is needed.
-    if (memory_index != 0)
+    // The segment kind: 0 - active in memory 0, 1 - passive, 2 - active with the memory index.
+    uint32_t kind;
+    std::tie(kind, pos) = leb128u_decode<uint32_t>(pos, end);
+    if (kind > 2)
+        throw parser_error{"invalid data segment kind " + std::to_string(kind)};
+
+    const bool passive = kind == 1;
+    if (kind == 2)
     {
-        throw validation_error{
-            "invalid memory index " + std::to_string(memory_index) + " (only memory 0 is allowed)"};
+        MemIdx memory_index;
+        std::tie(memory_index, pos) = leb128u_decode<uint32_t>(pos, end);
+
+        // TODO: The check should be memory_index < num_of_memories (0 or 1),
+        //       but access to the memory section of the module is needed.
+        if (memory_index != 0)
+        {
+            throw validation_error{"invalid memory index " + std::to_string(memory_index) +
+                                   " (only memory 0 is allowed)"};
+        }
     }
 
     ConstantExpression offset;
     // Offset expression is required to have i32 result value
     // https://webassembly.github.io/spec/core/valid/modules.html#data-segments
-    std::tie(offset, pos) = parse_constant_expression(ValType::i32, pos, end);
+    if (!passive)
+        std::tie(offset, pos) = parse_constant_expression(ValType::i32, pos, end);
 
     // NOTE: this is an optimised version of parse_vec<uint8_t>
     uint32_t size;
@@ -450,17 +649,91 @@ inline parser_result<Data> parse(const uint8_t* pos, const uint8_t* end)
     auto init = bytes(pos, pos + size);
     pos += size;
 
-    return {{offset, std::move(init)}, pos};
+    return {{offset, std::move(init), passive}, pos};
+}
+
+/// Builds the memory image from the data segments, see Module::memory_image.
+inline std::optional<MemoryImage> build_memory_image(const Module& module)
+{
+    // The imported memory has live content in the gaps between the segments, so the image
+    // cannot be written over it.
+    if (module.memorysec.empty())
+        return std::nullopt;
+
+    if (std::all_of(module.datasec.begin(), module.datasec.end(),
+            [](const Data& data) { return data.passive; }))
+        return std::nullopt;
+
+    const auto& memory_limits = module.memorysec[0].limits;
+
+    // The ranges of the non-empty segments, merged into the runs later.
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    uint64_t end = 0;
+    for (const auto& data : module.datasec)
+    {
+        if (data.passive)
+            continue;
+
+        // The offsets depending on imported globals are only known at instantiation.
+        if (data.offset.kind != ConstantExpression::Kind::Constant)
+            return std::nullopt;
+
+        const uint64_t offset = data.offset.value.constant.i32;
+        end = std::max(end, offset + data.init.size());
+        if (!data.init.empty())
+            ranges.emplace_back(offset, offset + data.init.size());
+    }
+
+    // The segments out of bounds of the minimal memory are left for instantiation, which reports
+    // the error unless an imported memory is big enough.
+    if (end > memory_pages_to_bytes(memory_limits.min))
+        return std::nullopt;
+
+    std::sort(ranges.begin(), ranges.end());
+    MemoryImage image;
+    uint64_t run_end = 0;
+    for (const auto& [range_begin, range_end] : ranges)
+    {
+        if (image.runs.empty() || range_begin > run_end)
+        {
+            image.runs.push_back({static_cast<uint32_t>(range_begin), {}});
+            run_end = range_begin;
+        }
+        run_end = std::max(run_end, range_end);
+        image.runs.back().data.resize(static_cast<size_t>(run_end - image.runs.back().offset));
+    }
+
+    for (const auto& data : module.datasec)
+    {
+        if (data.passive || data.init.empty())
+            continue;
+
+        // NOTE: segments can overlap, the later ones overwrite the earlier ones.
+        const auto offset = data.offset.value.constant.i32;
+        auto run = std::upper_bound(image.runs.begin(), image.runs.end(), offset,
+            [](uint32_t value, const MemoryImage::Run& r) { return value < r.offset; });
+        assert(run != image.runs.begin());
+        --run;
+        std::copy(data.init.begin(), data.init.end(), run->data.begin() + (offset - run->offset));
+    }
+    return image;
 }
 
-std::unique_ptr<const Module> parse(bytes_view input)
+/// Parses the module. If EmitCode is false, the code of functions is only validated and
+/// not kept in the module.
+template <bool EmitCode>
+std::unique_ptr<Module> parse_module(bytes_view input, std::pmr::memory_resource* upstream,
+    span<const uint64_t> call_counts, uint64_t binary_hash)
 {
     if (input.substr(0, wasm_prefix.size()) != wasm_prefix)
         throw parser_error{"invalid wasm module prefix"};
 
+    auto module{std::make_unique<Module>()};
+    if constexpr (EmitCode)
+        module->binary_hash = binary_hash;
+
     input.remove_prefix(wasm_prefix.size());
 
-    auto module{std::make_unique<Module>()};
     std::vector<code_view> code_binaries;
     SectionId last_id = SectionId::custom;
     for (auto it = input.begin(); it != input.end();)
@@ -468,7 +741,7 @@ std::unique_ptr<const Module> parse(bytes_view input)
         const auto id = static_cast<SectionId>(*it++);
         if (id != SectionId::custom)
         {
-            if (id <= last_id)
+            if (get_section_order(id) <= get_section_order(last_id))
                 throw parser_error{"unexpected out-of-order section type"};
             last_id = id;
         }
@@ -516,6 +789,9 @@ std::unique_ptr<const Module> parse(bytes_view input)
         case SectionId::data:
             std::tie(module->datasec, it) = parse_vec<Data>(it, input.end());
             break;
+        case SectionId::data_count:
+            std::tie(module->datacount, it) = leb128u_decode<uint32_t>(it, input.end());
+            break;
         case SectionId::custom:
             // NOTE: this section can be ignored, but the name must be parseable (and valid UTF-8)
             parse_string(it, expected_section_end);
@@ -582,19 +858,25 @@ std::unique_ptr<const Module> parse(bytes_view input)
             "both module memory and imported memory are defined (at most one of them is allowed)"};
     }
 
-    if (!module->datasec.empty() && !module->has_memory())
-    {
-        throw validation_error{
-            "invalid memory index 0 (data section encountered without a memory section)"};
-    }
-
     for (const auto& data : module->datasec)
     {
+        if (data.passive)
+            continue;
+
+        if (!module->has_memory())
+        {
+            throw validation_error{
+                "invalid memory index 0 (data section encountered without a memory section)"};
+        }
+
         // Offset expression is required to have i32 result value
         // https://webassembly.github.io/spec/core/valid/modules.html#data-segments
         validate_constant_expression(data.offset, *module, ValType::i32);
     }
 
+    if (module->datacount.has_value() && *module->datacount != module->datasec.size())
+        throw validation_error{"data count and data section have inconsistent lengths"};
+
     if (module->imported_table_types.size() > 1)
         throw validation_error{"too many imported tables (at most one is allowed)"};
 
@@ -639,6 +921,19 @@ std::unique_ptr<const Module> parse(bytes_view input)
         }
     }
 
+    // The v128 globals occupy 2 slots in Instance::globals, so the slots of the globals following
+    // them are shifted.
+    if (std::any_of(module->globalsec.begin(), module->globalsec.end(),
+            [](const Global& g) noexcept { return g.type.value_type == ValType::v128; }))
+    {
+        module->global_slots.reserve(module->globalsec.size());
+        uint32_t slot = 0;
+        for (const auto& global : module->globalsec)
+        {
+            module->global_slots.push_back(slot);
+            slot += get_num_slots(global.type.value_type);
+        }
+    }
 
     if (module->funcsec.size() != code_binaries.size())
         throw parser_error{"malformed binary: number of function and code entries must match"};
@@ -683,14 +978,63 @@ std::unique_ptr<const Module> parse(bytes_view input)
     }
 
     // Process code. TODO: This can be done lazily.
-    module->codesec.reserve(code_binaries.size());
-    for (size_t i = 0; i < code_binaries.size(); ++i)
-        module->codesec.emplace_back(
-            parse_code(code_binaries[i], static_cast<FuncIdx>(i), *module));
+    if constexpr (EmitCode)
+    {
+        // The translated code of functions is kept until it is copied to the code buffer.
+        std::pmr::monotonic_buffer_resource parsed_code_resource{upstream};
+        std::vector<ParsedCode> parsed_codes;
+        parsed_codes.reserve(code_binaries.size());
+        for (size_t i = 0; i < code_binaries.size(); ++i)
+        {
+            parsed_codes.emplace_back(parse_code<true>(
+                code_binaries[i], static_cast<FuncIdx>(i), *module, &parsed_code_resource));
+        }
+        layout_code(*module, parsed_codes, call_counts);
+        compute_max_call_depths(*module, parsed_codes);
+
+        module->memory_image = build_memory_image(*module);
+        if (module->memory_image.has_value())
+        {
+            // The image is the only copy of the active segments kept, see Data::init.
+            for (auto& data : module->datasec)
+            {
+                if (!data.passive)
+                    data.init = bytes{};
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < code_binaries.size(); ++i)
+            parse_code<false>(code_binaries[i], static_cast<FuncIdx>(i), *module, upstream);
+    }
 
     return module;
 }
 
+std::unique_ptr<const Module> parse(bytes_view input, std::pmr::memory_resource* upstream)
+{
+    return parse_module<true>(input, upstream, {}, hash_bytes(input));
+}
+
+std::unique_ptr<const Module> parse(
+    bytes_view input, span<const uint64_t> call_counts, std::pmr::memory_resource* upstream)
+{
+    return parse_module<true>(input, upstream, call_counts, hash_bytes(input));
+}
+
+std::unique_ptr<const Module> parse(
+    bytes_view input, uint64_t binary_hash, std::pmr::memory_resource* upstream)
+{
+    assert(binary_hash == hash_bytes(input));
+    return parse_module<true>(input, upstream, {}, binary_hash);
+}
+
+void validate(bytes_view input)
+{
+    parse_module<false>(input, std::pmr::null_memory_resource(), {}, 0);
+}
+
 parser_result<std::vector<uint32_t>> parse_vec_i32(const uint8_t* pos, const uint8_t* end)
 {
     return parse_vec<uint32_t>(pos, end);
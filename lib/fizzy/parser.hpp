@@ -4,10 +4,13 @@
 
 #pragma once
 
+#include "cxx20/span.hpp"
 #include "exceptions.hpp"
 #include "leb128.hpp"
 #include "module.hpp"
 #include <memory>
+#include <memory_resource>
+#include <utility>
 
 namespace fizzy
 {
@@ -21,8 +24,42 @@ using parser_result = std::pair<T, const uint8_t*>;
 ///
 /// @param  input    The WebAssembly binary. No need to persist by the caller, since all relevant
 ///                  parts will be copied.
+/// @param  upstream The memory resource the temporary memory of the code translation is obtained
+///                  from.
 /// @return          The parsed module.
-std::unique_ptr<const Module> parse(bytes_view input);
+std::unique_ptr<const Module> parse(
+    bytes_view input, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+/// Parses `input` into a Module and lays out the code of functions in the order of descending
+/// call counts. This places the frequently called functions next to each other in the module's
+/// code buffer.
+///
+/// @param  input       The WebAssembly binary.
+/// @param  call_counts The call counts of functions indexed by function index, e.g. recorded in
+///                     a profiling run with ExecutionContext::call_counts. Missing entries count
+///                     as 0.
+/// @param  upstream    The memory resource the temporary memory of the code translation is
+///                     obtained from.
+/// @return             The parsed module.
+std::unique_ptr<const Module> parse(bytes_view input, span<const uint64_t> call_counts,
+    std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+/// Parses `input` into a Module, reusing the hash of the binary already computed by the caller,
+/// e.g. for a cache lookup.
+///
+/// @param  input       The WebAssembly binary.
+/// @param  binary_hash The hash of `input` returned by hash_bytes(), see Module::binary_hash.
+/// @param  upstream    The memory resource the temporary memory of the code translation is
+///                     obtained from.
+/// @return             The parsed module.
+std::unique_ptr<const Module> parse(bytes_view input, uint64_t binary_hash,
+    std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+/// Validates `input` the same way as parse(), but without building the code of functions.
+/// Throws the same errors as parse() for invalid input.
+///
+/// @param  input    The WebAssembly binary.
+void validate(bytes_view input);
 
 inline parser_result<uint8_t> parse_byte(const uint8_t* pos, const uint8_t* end)
 {
@@ -44,6 +81,11 @@ inline parser_result<T> parse_value(const uint8_t* pos, const uint8_t* end)
     return {value, pos + size};
 }
 
+/// The version of the code built by parse_expr() and compact_code(). It must be increased with
+/// any change of the opcodes or the layout of the immediates, because the checkpoints refer to
+/// the instructions by their offsets in the code.
+constexpr uint32_t CodeFormatVersion = 1;
+
 /// Parses `expr`, i.e. a function's instructions residing in the code section.
 /// https://webassembly.github.io/spec/core/binary/instructions.html#binary-expr
 ///
@@ -52,10 +94,44 @@ inline parser_result<T> parse_value(const uint8_t* pos, const uint8_t* end)
 /// @param  func_idx    Index of the function being parsed.
 /// @param  locals      Vector of local type and counts for the function being parsed.
 /// @param  module      Module that this code is part of.
+/// @param  resource    Memory resource to allocate the resulting instructions from.
 /// @return             The parsed code.
-parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
+parser_result<ParsedCode> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
+    const std::vector<Locals>& locals, const Module& module,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/// Validates `expr` the same way as parse_expr(), but without building the code.
+///
+/// @param  pos         The beginning of the expr binary input.
+/// @param  end         The end of the binary input.
+/// @param  func_idx    Index of the function being validated.
+/// @param  locals      Vector of local type and counts for the function being validated.
+/// @param  module      Module that this code is part of.
+/// @return             The end position of the expr.
+const uint8_t* validate_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
     const std::vector<Locals>& locals, const Module& module);
 
+/// Re-encodes the code built by parse_expr() using the smallest immediate size (1, 2 or 4 bytes)
+/// that fits all the index, offset and branch immediates of the function.
+///
+/// @param  code        The code with 4-byte immediates, as built by parse_expr().
+/// @param  resource    Memory resource to allocate the resulting instructions from.
+/// @return             The compacted code.
+ParsedCode compact_code(const ParsedCode& code, std::pmr::memory_resource* resource);
+
+/// Returns the number of index, offset and branch immediates following the instruction,
+/// and the size of the raw bytes following them: the const instruction value or the SIMD lane
+/// indices.
+///
+/// @param  instr           The pointer to the instruction opcode in the code built by parse_expr().
+/// @param  immediate_size  The size of the immediates: 4 bytes in the code built by parse_expr(),
+///                         Code::immediate_size in the compacted code.
+std::pair<uint32_t, size_t> get_immediates_layout(
+    const uint8_t* instr, size_t immediate_size) noexcept;
+
+/// Checks if the immediate of the given index following the instruction is a code offset.
+bool is_code_offset_immediate(uint8_t opcode, uint32_t immediate_idx) noexcept;
+
 /// Parses a string and validates it against UTF-8 encoding rules.
 /// @param  pos    The beginning of the string input.
 /// @param  end    The end of the string input.
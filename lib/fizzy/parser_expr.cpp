@@ -7,7 +7,11 @@
 #include "module.hpp"
 #include "parser.hpp"
 #include "stack.hpp"
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstddef>
+#include <memory_resource>
 
 namespace fizzy
 {
@@ -20,13 +24,35 @@ inline void store(uint8_t* dst, T value) noexcept
 }
 
 template <typename T>
-inline void push(std::vector<uint8_t>& b, T value)
+inline void push(std::pmr::vector<uint8_t>& b, T value)
 {
     uint8_t storage[sizeof(T)];
     store(storage, value);
     b.insert(b.end(), std::begin(storage), std::end(storage));
 }
 
+/// The replacement of the instructions buffer used in validation only mode. Discards all the code.
+struct NullCodeBuffer
+{
+    explicit NullCodeBuffer(std::pmr::memory_resource* /*resource*/) noexcept {}
+
+    void push_back(uint8_t /*byte*/) noexcept {}
+    void emplace_back(uint8_t /*byte*/) noexcept {}
+    static constexpr size_t size() noexcept { return 0; }
+};
+
+template <typename T>
+inline void push(NullCodeBuffer& /*b*/, T /*value*/) noexcept
+{}
+
+/// The type of a block: the types of its parameters and results.
+/// The types point to the module's type section, or to the static storage of a single result type.
+struct BlockType
+{
+    span<const ValType> inputs;
+    span<const ValType> outputs;
+};
+
 /// The control frame to keep information about labels and blocks as defined in
 /// Wasm Validation Algorithm https://webassembly.github.io/spec/core/appendix/algorithm.html.
 struct ControlFrame
@@ -34,8 +60,8 @@ struct ControlFrame
     /// The instruction that created the label.
     const Instr instruction{Instr::unreachable};
 
-    /// Return result type of the frame.
-    const std::optional<ValType> type;
+    /// The type of the frame.
+    const BlockType type;
 
     /// The target instruction code offset.
     const size_t code_offset{0};
@@ -48,14 +74,30 @@ struct ControlFrame
     bool unreachable{false};
 
     /// Offsets of br/br_if/br_table instruction immediates, to be filled at the end of the block
-    std::vector<size_t> br_immediate_offsets{};
+    std::pmr::vector<size_t> br_immediate_offsets;
 
-    ControlFrame(Instr _instruction, std::optional<ValType> _type, int _parent_stack_height,
-        size_t _code_offset = 0) noexcept
+    /// Makes the frame allocator-aware so that a control stack using a polymorphic allocator
+    /// passes its memory resource down to br_immediate_offsets.
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    ControlFrame(std::allocator_arg_t, const allocator_type& allocator, Instr _instruction,
+        BlockType _type, int _parent_stack_height, size_t _code_offset = 0) noexcept
       : instruction{_instruction},
         type{_type},
         code_offset{_code_offset},
-        parent_stack_height{_parent_stack_height}
+        parent_stack_height{_parent_stack_height},
+        br_immediate_offsets{allocator}
+    {}
+
+    ControlFrame(ControlFrame&& other) noexcept = default;
+
+    ControlFrame(std::allocator_arg_t, const allocator_type& allocator, ControlFrame&& other)
+      : instruction{other.instruction},
+        type{other.type},
+        code_offset{other.code_offset},
+        parent_stack_height{other.parent_stack_height},
+        unreachable{other.unreachable},
+        br_immediate_offsets{std::move(other.br_immediate_offsets), allocator}
     {}
 };
 
@@ -66,8 +108,11 @@ enum class OperandStackType : uint8_t
     i64 = static_cast<uint8_t>(ValType::i64),
     f32 = static_cast<uint8_t>(ValType::f32),
     f64 = static_cast<uint8_t>(ValType::f64),
+    v128 = static_cast<uint8_t>(ValType::v128),  ///< Each of the 2 slots of the v128 value.
 };
 
+using OperandTypeStack = Stack<OperandStackType, std::pmr::polymorphic_allocator<OperandStackType>>;
+
 inline OperandStackType from_valtype(ValType val_type) noexcept
 {
     return static_cast<OperandStackType>(val_type);
@@ -89,26 +134,44 @@ inline bool type_matches(OperandStackType actual_type, OperandStackType expected
     return expected_type == actual_type;
 }
 
-/// Parses blocktype.
+/// Parses blocktype: empty, a single result value type or the index of a function type.
 ///
-/// Spec: https://webassembly.github.io/spec/core/binary/types.html#binary-blocktype.
-/// @return optional type of the block result.
-parser_result<std::optional<ValType>> parse_blocktype(const uint8_t* pos, const uint8_t* end)
+/// Spec: https://webassembly.github.io/spec/core/binary/instructions.html#control-instructions.
+/// @return The type of the block.
+parser_result<BlockType> parse_blocktype(const uint8_t* pos, const uint8_t* end, const Module& module)
 {
     // The byte meaning an empty wasm result type.
     // https://webassembly.github.io/spec/core/binary/types.html#result-types
     constexpr uint8_t BlockTypeEmpty = 0x40;
 
+    const auto* const type_begin = pos;
     uint8_t type;
     std::tie(type, pos) = parse_byte(pos, end);
 
     if (type == BlockTypeEmpty)
-        return {std::nullopt, pos};
+        return {{}, pos};
+
+    // The empty type and the value types are encoded as the negative single byte s33 values.
+    if ((type & 0xc0) == 0x40)
+    {
+        static constexpr ValType single_types[]{
+            ValType::i32, ValType::i64, ValType::f32, ValType::f64, ValType::v128};
+        const auto* const single_type =
+            std::find(std::begin(single_types), std::end(single_types), validate_valtype(type));
+        return {{{}, {single_type, 1}}, pos};
+    }
+
+    // Otherwise, the type index is encoded as the non-negative s33 value.
+    int64_t type_idx;
+    std::tie(type_idx, pos) = leb128s_decode<int64_t>(type_begin, end);
+    if (type_idx < 0 || static_cast<uint64_t>(type_idx) >= module.typesec.size())
+        throw validation_error{"invalid type index with block"};
 
-    return {validate_valtype(type), pos};
+    const auto& func_type = module.typesec[static_cast<size_t>(type_idx)];
+    return {{func_type.inputs, func_type.outputs}, pos};
 }
 
-void update_operand_stack(const ControlFrame& frame, Stack<OperandStackType>& operand_stack,
+void update_operand_stack(const ControlFrame& frame, OperandTypeStack& operand_stack,
     span<const ValType> inputs, span<const ValType> outputs)
 {
     const auto frame_stack_height = static_cast<int>(operand_stack.size());
@@ -137,8 +200,8 @@ void update_operand_stack(const ControlFrame& frame, Stack<OperandStackType>& op
         operand_stack.push(from_valtype(output_type));
 }
 
-inline void drop_operand(const ControlFrame& frame, Stack<OperandStackType>& operand_stack,
-    OperandStackType expected_type)
+inline void drop_operand(
+    const ControlFrame& frame, OperandTypeStack& operand_stack, OperandStackType expected_type)
 {
     if (!frame.unreachable &&
         static_cast<int>(operand_stack.size()) < frame.parent_stack_height + 1)
@@ -155,51 +218,160 @@ inline void drop_operand(const ControlFrame& frame, Stack<OperandStackType>& ope
 }
 
 inline void drop_operand(
-    const ControlFrame& frame, Stack<OperandStackType>& operand_stack, ValType expected_type)
+    const ControlFrame& frame, OperandTypeStack& operand_stack, ValType expected_type)
 {
-    return drop_operand(frame, operand_stack, from_valtype(expected_type));
+    drop_operand(frame, operand_stack, from_valtype(expected_type));
+    if (expected_type == ValType::v128)
+        drop_operand(frame, operand_stack, OperandStackType::v128);
 }
 
-void update_result_stack(const ControlFrame& frame, Stack<OperandStackType>& operand_stack)
+/// Drops the operands of the types, the last type being on the top of the stack.
+inline void drop_operands(
+    const ControlFrame& frame, OperandTypeStack& operand_stack, span<const ValType> expected_types)
+{
+    for (auto it = expected_types.rbegin(); it != expected_types.rend(); ++it)
+        drop_operand(frame, operand_stack, *it);
+}
+
+/// The sub-opcodes of the instructions with the Instr::misc_prefix.
+enum class MiscInstr : uint32_t
+{
+    memory_init = 0x08,
+    data_drop = 0x09,
+    memory_copy = 0x0a,
+    memory_fill = 0x0b,
+};
+
+/// Parses the memory index immediate of a memory instruction and checks the module has memory.
+const uint8_t* parse_memory_index(const uint8_t* pos, const uint8_t* end, const Module& module)
+{
+    uint8_t memory_idx;
+    std::tie(memory_idx, pos) = parse_byte(pos, end);
+    if (memory_idx != 0)
+        throw parser_error{"invalid memory index encountered"};
+
+    if (!module.has_memory())
+        throw validation_error{"memory instructions require imported or defined memory"};
+    return pos;
+}
+
+/// Returns the scalar type of the lanes of the SIMD instruction taking or returning a lane value:
+/// splat, extract_lane and replace_lane.
+constexpr ValType get_simd_lane_type(SimdInstr instr) noexcept
+{
+    switch (instr)
+    {
+    case SimdInstr::i64x2_splat:
+    case SimdInstr::i64x2_extract_lane:
+    case SimdInstr::i64x2_replace_lane:
+        return ValType::i64;
+    case SimdInstr::f32x4_splat:
+    case SimdInstr::f32x4_extract_lane:
+    case SimdInstr::f32x4_replace_lane:
+        return ValType::f32;
+    case SimdInstr::f64x2_splat:
+    case SimdInstr::f64x2_extract_lane:
+    case SimdInstr::f64x2_replace_lane:
+        return ValType::f64;
+    default:
+        return ValType::i32;
+    }
+}
+
+/// Returns the number of lanes accessed by the lane index immediate of the SIMD instruction.
+constexpr uint8_t get_simd_lane_count(SimdInstr instr) noexcept
+{
+    switch (instr)
+    {
+    case SimdInstr::i8x16_extract_lane_s:
+    case SimdInstr::i8x16_extract_lane_u:
+    case SimdInstr::i8x16_replace_lane:
+    case SimdInstr::v128_load8_lane:
+    case SimdInstr::v128_store8_lane:
+        return 16;
+    case SimdInstr::i16x8_extract_lane_s:
+    case SimdInstr::i16x8_extract_lane_u:
+    case SimdInstr::i16x8_replace_lane:
+    case SimdInstr::v128_load16_lane:
+    case SimdInstr::v128_store16_lane:
+        return 8;
+    case SimdInstr::i32x4_extract_lane:
+    case SimdInstr::i32x4_replace_lane:
+    case SimdInstr::f32x4_extract_lane:
+    case SimdInstr::f32x4_replace_lane:
+    case SimdInstr::v128_load32_lane:
+    case SimdInstr::v128_store32_lane:
+        return 4;
+    default:
+        return 2;
+    }
+}
+
+/// Returns the log2 of the size of the memory accessed by the SIMD memory instruction, which is
+/// the max alignment.
+constexpr uint8_t get_simd_max_align(SimdInstr instr) noexcept
+{
+    switch (instr)
+    {
+    case SimdInstr::v128_load8_splat:
+    case SimdInstr::v128_load8_lane:
+    case SimdInstr::v128_store8_lane:
+        return 0;
+    case SimdInstr::v128_load16_splat:
+    case SimdInstr::v128_load16_lane:
+    case SimdInstr::v128_store16_lane:
+        return 1;
+    case SimdInstr::v128_load32_splat:
+    case SimdInstr::v128_load32_zero:
+    case SimdInstr::v128_load32_lane:
+    case SimdInstr::v128_store32_lane:
+        return 2;
+    case SimdInstr::v128_load:
+    case SimdInstr::v128_store:
+        return 4;
+    default:
+        return 3;
+    }
+}
+
+void update_result_stack(const ControlFrame& frame, OperandTypeStack& operand_stack)
 {
     const auto frame_stack_height = static_cast<int>(operand_stack.size());
 
     // This is checked by "stack underflow".
     assert(frame_stack_height >= frame.parent_stack_height);
 
-    const auto arity = frame.type.has_value() ? 1 : 0;
+    const auto arity = static_cast<int>(get_num_slots(frame.type.outputs));
 
     if (frame_stack_height > frame.parent_stack_height + arity)
         throw validation_error{"too many results"};
 
-    if (arity != 0)
-        drop_operand(frame, operand_stack, from_valtype(*frame.type));
+    drop_operands(frame, operand_stack, frame.type.outputs);
 }
 
-inline std::optional<ValType> get_branch_frame_type(const ControlFrame& frame) noexcept
+inline span<const ValType> get_branch_frame_type(const ControlFrame& frame) noexcept
 {
-    // For loops arity is considered always 0, because br executed in loop jumps to the top,
-    // resetting frame stack to 0, so it should not keep top stack value even if loop has a result.
-    return frame.instruction == Instr::loop ? std::nullopt : frame.type;
+    // The br executed in loop jumps to the top, so it passes the loop parameters, not the results.
+    return frame.instruction == Instr::loop ? frame.type.inputs : frame.type.outputs;
 }
 
+/// Returns the number of Value slots of the values passed by the branch.
 inline uint32_t get_branch_arity(const ControlFrame& frame) noexcept
 {
-    return get_branch_frame_type(frame).has_value() ? 1 : 0;
+    return get_num_slots(get_branch_frame_type(frame));
 }
 
 inline void update_branch_stack(const ControlFrame& current_frame, const ControlFrame& branch_frame,
-    Stack<OperandStackType>& operand_stack)
+    OperandTypeStack& operand_stack)
 {
     assert(static_cast<int>(operand_stack.size()) >= current_frame.parent_stack_height);
 
-    const auto branch_frame_type = get_branch_frame_type(branch_frame);
-    if (branch_frame_type.has_value())
-        drop_operand(current_frame, operand_stack, from_valtype(*branch_frame_type));
+    drop_operands(current_frame, operand_stack, get_branch_frame_type(branch_frame));
 }
 
+template <typename CodeBuffer>
 void push_branch_immediates(
-    const ControlFrame& branch_frame, int stack_height, std::vector<uint8_t>& instructions)
+    const ControlFrame& branch_frame, int stack_height, CodeBuffer& instructions)
 {
     // How many stack items to drop when taking the branch.
     const auto stack_drop = stack_height - branch_frame.parent_stack_height;
@@ -210,54 +382,225 @@ void push_branch_immediates(
     push(instructions, static_cast<uint32_t>(stack_drop));
 }
 
-inline void mark_frame_unreachable(
-    ControlFrame& frame, Stack<OperandStackType>& operand_stack) noexcept
+inline void mark_frame_unreachable(ControlFrame& frame, OperandTypeStack& operand_stack) noexcept
 {
     frame.unreachable = true;
     operand_stack.shrink(static_cast<size_t>(frame.parent_stack_height));
 }
 
-inline void push_operand(Stack<OperandStackType>& operand_stack, ValType type)
+inline void push_operand(OperandTypeStack& operand_stack, ValType type)
 {
     operand_stack.push(from_valtype(type));
+    if (type == ValType::v128)
+        operand_stack.push(OperandStackType::v128);
 }
 
-inline void push_operand(Stack<OperandStackType>& operand_stack, OperandStackType type)
+inline void push_operand(OperandTypeStack& operand_stack, OperandStackType type)
 {
     operand_stack.push(type);
 }
 
-ValType find_local_type(
-    const std::vector<ValType>& params, const std::vector<Locals>& locals, LocalIdx idx)
+inline void push_operands(OperandTypeStack& operand_stack, span<const ValType> types)
 {
-    if (idx < params.size())
-        return params[idx];
+    for (const auto type : types)
+        push_operand(operand_stack, type);
+}
+
+/// Updates the operand stack with the inputs and outputs of a SIMD instruction. Unlike
+/// update_operand_stack(), it supports the v128 operands occupying 2 slots.
+void update_simd_operand_stack(const ControlFrame& frame, OperandTypeStack& operand_stack,
+    span<const ValType> inputs, span<const ValType> outputs)
+{
+    for (auto it = inputs.rbegin(); it != inputs.rend(); ++it)
+        drop_operand(frame, operand_stack, *it);
+    for (const auto output_type : outputs)
+        push_operand(operand_stack, output_type);
+}
 
-    // TODO: Consider more efficient algorithm with calculating cumulative sums only once and then
-    // using binary search for each local instruction.
-    const auto local_idx = idx - params.size();
+/// Updates the operand stack with the inputs and outputs of a call. Unlike update_operand_stack(),
+/// it supports the v128 arguments and results occupying 2 slots.
+void update_call_operand_stack(const ControlFrame& frame, OperandTypeStack& operand_stack,
+    span<const ValType> inputs, span<const ValType> outputs)
+{
+    const auto frame_stack_height = static_cast<int>(operand_stack.size());
+    const auto num_input_slots = static_cast<int>(get_num_slots(inputs));
+    if (!frame.unreachable && frame_stack_height < frame.parent_stack_height + num_input_slots)
+        throw validation_error{"stack underflow"};
+
+    drop_operands(frame, operand_stack, inputs);
+    push_operands(operand_stack, outputs);
+}
+
+/// Emits the global.get or global.set instruction. The globals defined by the module are addressed
+/// by the index of their first Value slot in Instance::globals following the imported globals.
+template <typename CodeBuffer>
+void emit_global(CodeBuffer& instructions, const Module& module, Instr instr, ValType type,
+    GlobalIdx global_idx)
+{
+    if (type == ValType::v128)
+        instr = instr == Instr::global_get ? Instr::v128_global_get : Instr::v128_global_set;
+    instructions.push_back(static_cast<uint8_t>(instr));
+
+    const auto num_imported_globals = static_cast<uint32_t>(module.imported_global_types.size());
+    push(instructions, global_idx < num_imported_globals ?
+                           global_idx :
+                           num_imported_globals +
+                               module.get_global_slot(global_idx - num_imported_globals));
+}
+
+/// Appends the stack heights of the instructions emitted for one wasm instruction, starting at
+/// @a begin, to the code's stack heights, see ParsedCode::stack_heights.
+/// The wasm instructions emitted as multiple instructions are the v128 drop and local
+/// instructions, each of which moves a single slot: local_get pushes it, local_set and drop pop it.
+///
+/// @param  stack_height    The stack height before the wasm instruction, or -1 if it is
+///                         unreachable.
+void push_stack_heights(const std::pmr::vector<uint8_t>& instructions, size_t begin,
+    int stack_height, std::pmr::vector<uint8_t>& stack_heights)
+{
+    for (auto pos = begin; pos < instructions.size();)
+    {
+        // LEB128 of the height plus 1, 0 if unreachable.
+        auto value = static_cast<uint32_t>(stack_height + 1);
+        for (; value >= 0x80; value >>= 7)
+            stack_heights.push_back(static_cast<uint8_t>(value | 0x80));
+        stack_heights.push_back(static_cast<uint8_t>(value));
+
+        const auto opcode = instructions[pos];
+        const auto [count, value_size] =
+            get_immediates_layout(&instructions[pos], sizeof(uint32_t));
+        pos += 1 + count * sizeof(uint32_t) + value_size;
+
+        if (stack_height >= 0)
+            stack_height += opcode == static_cast<uint8_t>(Instr::local_get) ? 1 : -1;
+    }
+}
+
+/// Computes the end indices of the runs of locals, i.e. the cumulative sums of Locals::count.
+/// This allows finding the type of a local with binary search in find_local_type().
+std::pmr::vector<uint64_t> get_local_ends(
+    const std::vector<Locals>& locals, std::pmr::memory_resource* resource)
+{
+    std::pmr::vector<uint64_t> local_ends{resource};
+    local_ends.reserve(locals.size());
     uint64_t local_count = 0;
     for (const auto& l : locals)
     {
-        if (local_idx >= local_count && local_idx < local_count + l.count)
-            return l.type;
         local_count += l.count;
+        local_ends.push_back(local_count);
     }
+    return local_ends;
+}
+
+/// Computes the end Value slots of the runs of locals if any of them is v128, see get_num_slots().
+/// Otherwise, returns an empty vector, because each local occupies the slot equal to its index.
+std::pmr::vector<uint64_t> get_local_slot_ends(
+    const std::vector<Locals>& locals, std::pmr::memory_resource* resource)
+{
+    std::pmr::vector<uint64_t> local_slot_ends{resource};
+    if (std::none_of(locals.begin(), locals.end(),
+            [](const Locals& l) noexcept { return l.type == ValType::v128; }))
+        return local_slot_ends;
 
-    throw validation_error{"invalid local index"};
+    local_slot_ends.reserve(locals.size());
+    uint64_t slot_count = 0;
+    for (const auto& l : locals)
+    {
+        slot_count += uint64_t{l.count} * get_num_slots(l.type);
+        local_slot_ends.push_back(slot_count);
+    }
+    return local_slot_ends;
 }
-}  // namespace
 
-parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
-    const std::vector<Locals>& locals, const Module& module)
+/// Computes the first Value slots of the parameters followed by their total number of slots
+/// if any of them is v128, see get_num_slots(). Otherwise, returns an empty vector, because each
+/// parameter occupies the slot equal to its index.
+std::pmr::vector<uint32_t> get_param_slots(
+    const std::vector<ValType>& params, std::pmr::memory_resource* resource)
+{
+    std::pmr::vector<uint32_t> param_slots{resource};
+    if (std::find(params.begin(), params.end(), ValType::v128) == params.end())
+        return param_slots;
+
+    param_slots.reserve(params.size() + 1);
+    uint32_t slot_count = 0;
+    for (const auto type : params)
+    {
+        param_slots.push_back(slot_count);
+        slot_count += get_num_slots(type);
+    }
+    param_slots.push_back(slot_count);
+    return param_slots;
+}
+
+/// Returns the first Value slot of the valid local.
+uint32_t find_local_slot(size_t num_params, const std::pmr::vector<uint32_t>& param_slots,
+    const std::vector<Locals>& locals, const std::pmr::vector<uint64_t>& local_ends,
+    const std::pmr::vector<uint64_t>& local_slot_ends, LocalIdx idx) noexcept
 {
-    Code code;
+    if (idx < num_params)
+        return param_slots.empty() ? idx : param_slots[idx];
+
+    // The locals follow the slots of the parameters.
+    const auto num_param_slots = param_slots.empty() ? num_params : param_slots.back();
+    const auto local_idx = uint64_t{idx} - num_params;
+    if (local_slot_ends.empty())
+        return static_cast<uint32_t>(num_param_slots + local_idx);
+
+    const auto run =
+        static_cast<size_t>(std::upper_bound(local_ends.begin(), local_ends.end(), local_idx) -
+                            local_ends.begin());
+    assert(run < local_ends.size());
+    const auto run_begin = run == 0 ? 0 : local_ends[run - 1];
+    const auto run_slot_begin = run == 0 ? 0 : local_slot_ends[run - 1];
+    return static_cast<uint32_t>(num_param_slots + run_slot_begin +
+                                 (local_idx - run_begin) * get_num_slots(locals[run].type));
+}
+
+ValType find_local_type(const std::vector<ValType>& params, const std::vector<Locals>& locals,
+    const std::pmr::vector<uint64_t>& local_ends, LocalIdx idx)
+{
+    if (idx < params.size())
+        return params[idx];
+
+    // The first run ending after the local index contains it. Empty runs are skipped, because
+    // their end is equal to the end of the previous run.
+    const auto local_idx = uint64_t{idx} - params.size();
+    const auto it = std::upper_bound(local_ends.begin(), local_ends.end(), local_idx);
+    if (it == local_ends.end())
+        throw validation_error{"invalid local index"};
+
+    return locals[static_cast<size_t>(it - local_ends.begin())].type;
+}
+
+/// Parses and validates the expr. If EmitCode is false, only the validation is performed
+/// and the returned code is empty.
+template <bool EmitCode>
+parser_result<ParsedCode> parse_or_validate_expr(const uint8_t* pos, const uint8_t* end,
+    FuncIdx func_idx, const std::vector<Locals>& locals, const Module& module,
+    std::pmr::memory_resource* resource)
+{
+    // All temporary allocations of the validation algorithm and the code being built are served
+    // from a scratch arena, backed by a stack buffer big enough for most functions.
+    // The scratch memory is released at once when parsing of the function is finished.
+    alignas(std::max_align_t) std::byte scratch_buffer[8192];
+    std::pmr::monotonic_buffer_resource scratch{scratch_buffer, sizeof(scratch_buffer)};
+
+    int max_stack_height = 0;
+    std::conditional_t<EmitCode, std::pmr::vector<uint8_t>, NullCodeBuffer> instructions{&scratch};
+    if constexpr (EmitCode)
+        instructions.reserve(static_cast<size_t>(end - pos));
+    std::pmr::vector<FuncIdx> callees{&scratch};
+    [[maybe_unused]] bool has_call_indirect = false;
+    std::pmr::vector<uint8_t> stack_heights{&scratch};
+    [[maybe_unused]] size_t instr_code_offset = 0;
+    [[maybe_unused]] int instr_stack_height = 0;
 
     // The stack of control frames allowing to distinguish between block/if/else and label
     // instructions as defined in Wasm Validation Algorithm.
-    Stack<ControlFrame> control_stack;
+    Stack<ControlFrame, std::pmr::polymorphic_allocator<ControlFrame>> control_stack{&scratch};
 
-    Stack<OperandStackType> operand_stack;
+    OperandTypeStack operand_stack{&scratch};
 
     const auto func_type_idx = module.funcsec[func_idx];
     assert(func_type_idx < module.typesec.size());
@@ -265,9 +608,11 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
     const auto& func_inputs = func_type.inputs;
     const auto& func_outputs = func_type.outputs;
+    const auto local_ends = get_local_ends(locals, &scratch);
+    const auto local_slot_ends = get_local_slot_ends(locals, &scratch);
+    const auto param_slots = get_param_slots(func_inputs, &scratch);
     // The function's implicit block.
-    control_stack.emplace(Instr::block,
-        func_outputs.empty() ? std::nullopt : std::optional<ValType>{func_outputs[0]}, 0);
+    control_stack.emplace(Instr::block, BlockType{{}, func_outputs}, 0);
 
     const auto type_table = get_instruction_type_table();
     const auto max_align_table = get_instruction_max_align_table();
@@ -288,9 +633,17 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         // This way the update is skipped for end/else instructions (because their frame is
         // already popped/reset), but it does not matter, as these instructions do not modify
         // stack height anyway.
-        if (!frame.unreachable)
-            code.max_stack_height =
-                std::max(code.max_stack_height, static_cast<int>(operand_stack.size()));
+        if constexpr (EmitCode)
+        {
+            if (!frame.unreachable)
+                max_stack_height =
+                    std::max(max_stack_height, static_cast<int>(operand_stack.size()));
+
+            // Record the stack heights of the previous instruction, now that it is emitted.
+            push_stack_heights(instructions, instr_code_offset, instr_stack_height, stack_heights);
+            instr_code_offset = instructions.size();
+            instr_stack_height = frame.unreachable ? -1 : static_cast<int>(operand_stack.size());
+        }
 
         update_operand_stack(frame, operand_stack, type.inputs, type.outputs);
 
@@ -305,8 +658,21 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
             break;
 
         case Instr::drop:
+        {
+            const auto frame_stack_height = static_cast<int>(operand_stack.size());
+            const auto operand_type = frame_stack_height > frame.parent_stack_height ?
+                                          operand_stack.top() :
+                                          OperandStackType::Unknown;
             drop_operand(frame, operand_stack, OperandStackType::Unknown);
+
+            // The v128 value is dropped with 2 drop instructions, one for each slot.
+            if (operand_type == OperandStackType::v128)
+            {
+                drop_operand(frame, operand_stack, OperandStackType::v128);
+                instructions.push_back(opcode);
+            }
             break;
+        }
 
         case Instr::select:
         {
@@ -322,6 +688,15 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
                                           operand_stack[0] :
                                           OperandStackType::Unknown;
 
+            if (operand_type == OperandStackType::v128)
+            {
+                drop_operand(frame, operand_stack, ValType::v128);
+                drop_operand(frame, operand_stack, ValType::v128);
+                push_operand(operand_stack, ValType::v128);
+                instructions.push_back(static_cast<uint8_t>(Instr::v128_select));
+                continue;
+            }
+
             drop_operand(frame, operand_stack, operand_type);
             drop_operand(frame, operand_stack, operand_type);
             push_operand(operand_stack, operand_type);
@@ -456,36 +831,43 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
         case Instr::block:
         {
-            std::optional<ValType> block_type;
-            std::tie(block_type, pos) = parse_blocktype(pos, end);
+            const auto [block_type, block_type_end] = parse_blocktype(pos, end, module);
+            pos = block_type_end;
 
+            // The block parameters are moved from the enclosing frame to the block's frame.
+            drop_operands(frame, operand_stack, block_type.inputs);
             // Push label with immediates offset after arity.
             control_stack.emplace(Instr::block, block_type, static_cast<int>(operand_stack.size()),
-                code.instructions.size());
+                instructions.size());
+            push_operands(operand_stack, block_type.inputs);
             break;
         }
 
         case Instr::loop:
         {
-            std::optional<ValType> loop_type;
-            std::tie(loop_type, pos) = parse_blocktype(pos, end);
+            const auto [loop_type, loop_type_end] = parse_blocktype(pos, end, module);
+            pos = loop_type_end;
 
+            drop_operands(frame, operand_stack, loop_type.inputs);
             control_stack.emplace(Instr::loop, loop_type, static_cast<int>(operand_stack.size()),
-                code.instructions.size());
+                instructions.size());
+            push_operands(operand_stack, loop_type.inputs);
             break;
         }
 
         case Instr::if_:
         {
-            std::optional<ValType> if_type;
-            std::tie(if_type, pos) = parse_blocktype(pos, end);
+            const auto [if_type, if_type_end] = parse_blocktype(pos, end, module);
+            pos = if_type_end;
 
+            drop_operands(frame, operand_stack, if_type.inputs);
             control_stack.emplace(Instr::if_, if_type, static_cast<int>(operand_stack.size()),
-                code.instructions.size());
+                instructions.size());
+            push_operands(operand_stack, if_type.inputs);
 
             // Placeholders for immediate values, filled at the matching end or else instructions.
-            code.instructions.push_back(opcode);
-            push(code.instructions, uint32_t{0});  // Diff to the else instruction
+            instructions.push_back(opcode);
+            push(instructions, uint32_t{0});  // Diff to the else instruction
             continue;
         }
 
@@ -502,21 +884,26 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
             control_stack.pop();
             control_stack.emplace(Instr::else_, frame_type, static_cast<int>(operand_stack.size()),
-                code.instructions.size());
+                instructions.size());
             // br immediates from `then` branch will need to be filled at the end of `else`
             control_stack.top().br_immediate_offsets = std::move(frame_br_immediate_offsets);
+            // The else branch starts with the same parameters as the then branch.
+            push_operands(operand_stack, frame_type.inputs);
 
-            code.instructions.push_back(opcode);
+            instructions.push_back(opcode);
 
             // Placeholder for the immediate value, filled at the matching end instructions.
-            push(code.instructions, uint32_t{0});  // Diff to the end instruction.
+            push(instructions, uint32_t{0});  // Diff to the end instruction.
 
             // Fill in if's immediate with the offset of first instruction in else block.
-            const auto target_pc = static_cast<uint32_t>(code.instructions.size());
+            const auto target_pc = static_cast<uint32_t>(instructions.size());
 
             // Set the imm values for if instruction.
-            auto* if_imm = code.instructions.data() + if_imm_offset;
-            store(if_imm, target_pc);
+            if constexpr (EmitCode)
+            {
+                auto* if_imm = instructions.data() + if_imm_offset;
+                store(if_imm, target_pc);
+            }
             continue;
         }
 
@@ -524,33 +911,39 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         {
             update_result_stack(frame, operand_stack);
 
-            if (frame.type.has_value() && frame.instruction == Instr::if_)
+            // Without else, the parameters of if are its results.
+            if (frame.instruction == Instr::if_ &&
+                !std::equal(frame.type.inputs.begin(), frame.type.inputs.end(),
+                    frame.type.outputs.begin(), frame.type.outputs.end()))
                 throw validation_error{"missing result in else branch"};
 
-            if (frame.instruction != Instr::loop)  // If end of block/if/else instruction.
+            if constexpr (EmitCode)
             {
-                // In case it's an outermost implicit function block,
-                // we want br to jump to the final end of the function.
-                // Otherwise jump to the next instruction after block's end.
-                const auto target_pc = control_stack.size() == 1 ?
-                                           static_cast<uint32_t>(code.instructions.size()) :
-                                           static_cast<uint32_t>(code.instructions.size() + 1);
-
-                if (frame.instruction == Instr::if_ || frame.instruction == Instr::else_)
+                if (frame.instruction != Instr::loop)  // If end of block/if/else instruction.
                 {
-                    // We're at the end instruction of the if block without else or at the end of
-                    // else block. Fill in if/else's immediate with the offset of first instruction
-                    // after if/else block.
-                    auto* if_imm = code.instructions.data() + frame.code_offset + 1;
-                    store(if_imm, target_pc);
-                }
-
-                // Fill in immediates all br/br_table instructions jumping out of this block.
-                for (const auto br_imm_offset : frame.br_immediate_offsets)
-                {
-                    auto* br_imm = code.instructions.data() + br_imm_offset;
-                    store(br_imm, static_cast<uint32_t>(target_pc));
-                    // stack drop and arity were already stored in br handler
+                    // In case it's an outermost implicit function block,
+                    // we want br to jump to the final end of the function.
+                    // Otherwise jump to the next instruction after block's end.
+                    const auto target_pc = control_stack.size() == 1 ?
+                                               static_cast<uint32_t>(instructions.size()) :
+                                               static_cast<uint32_t>(instructions.size() + 1);
+
+                    if (frame.instruction == Instr::if_ || frame.instruction == Instr::else_)
+                    {
+                        // We're at the end instruction of the if block without else or at the end
+                        // of else block. Fill in if/else's immediate with the offset of first
+                        // instruction after if/else block.
+                        auto* if_imm = instructions.data() + frame.code_offset + 1;
+                        store(if_imm, target_pc);
+                    }
+
+                    // Fill in immediates all br/br_table instructions jumping out of this block.
+                    for (const auto br_imm_offset : frame.br_immediate_offsets)
+                    {
+                        auto* br_imm = instructions.data() + br_imm_offset;
+                        store(br_imm, static_cast<uint32_t>(target_pc));
+                        // stack drop and arity were already stored in br handler
+                    }
                 }
             }
             const auto frame_type = frame.type;
@@ -559,8 +952,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
             if (control_stack.empty())
                 continue_parsing = false;
-            else if (frame_type.has_value())
-                push_operand(operand_stack, *frame_type);
+            else
+                push_operands(operand_stack, frame_type.outputs);
             break;
         }
 
@@ -577,24 +970,23 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
             update_branch_stack(frame, branch_frame, operand_stack);
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, get_branch_arity(branch_frame));
+            instructions.push_back(opcode);
+            push(instructions, get_branch_arity(branch_frame));
 
             // Remember this br immediates offset to fill it at end instruction.
-            branch_frame.br_immediate_offsets.push_back(code.instructions.size());
+            if constexpr (EmitCode)
+                branch_frame.br_immediate_offsets.push_back(instructions.size());
 
             push_branch_immediates(
-                branch_frame, static_cast<int>(operand_stack.size()), code.instructions);
+                branch_frame, static_cast<int>(operand_stack.size()), instructions);
 
             if (instr == Instr::br)
                 mark_frame_unreachable(frame, operand_stack);
             else
             {
                 // For the case when branch is not taken for br_if,
-                // we push back the block result value, that was popped in update_branch_stack.
-                const auto branch_frame_type = get_branch_frame_type(branch_frame);
-                if (branch_frame_type.has_value())
-                    push_operand(operand_stack, *branch_frame.type);
+                // we push back the branch values, that were popped in update_branch_stack.
+                push_operands(operand_stack, get_branch_frame_type(branch_frame));
             }
 
             continue;
@@ -616,8 +1008,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
             if (default_label_idx >= control_stack.size())
                 throw validation_error{"invalid label index"};
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, static_cast<uint32_t>(label_indices.size()));
+            instructions.push_back(opcode);
+            push(instructions, static_cast<uint32_t>(label_indices.size()));
 
             auto& default_branch_frame = control_stack[default_label_idx];
             const auto default_branch_type = get_branch_frame_type(default_branch_frame);
@@ -625,23 +1017,27 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
             update_branch_stack(frame, default_branch_frame, operand_stack);
 
             // arity is the same for all indices, so we push it once
-            push(code.instructions, get_branch_arity(default_branch_frame));
+            push(instructions, get_branch_arity(default_branch_frame));
 
             // Remember immediates offset for all br items to fill them at end instruction.
             for (const auto idx : label_indices)
             {
                 auto& branch_frame = control_stack[idx];
 
-                if (get_branch_frame_type(branch_frame) != default_branch_type)
+                const auto branch_type = get_branch_frame_type(branch_frame);
+                if (!std::equal(branch_type.begin(), branch_type.end(),
+                        default_branch_type.begin(), default_branch_type.end()))
                     throw validation_error{"br_table labels have inconsistent types"};
 
-                branch_frame.br_immediate_offsets.push_back(code.instructions.size());
+                if constexpr (EmitCode)
+                    branch_frame.br_immediate_offsets.push_back(instructions.size());
                 push_branch_immediates(
-                    branch_frame, static_cast<int>(operand_stack.size()), code.instructions);
+                    branch_frame, static_cast<int>(operand_stack.size()), instructions);
             }
-            default_branch_frame.br_immediate_offsets.push_back(code.instructions.size());
+            if constexpr (EmitCode)
+                default_branch_frame.br_immediate_offsets.push_back(instructions.size());
             push_branch_immediates(
-                default_branch_frame, static_cast<int>(operand_stack.size()), code.instructions);
+                default_branch_frame, static_cast<int>(operand_stack.size()), instructions);
 
             mark_frame_unreachable(frame, operand_stack);
 
@@ -658,13 +1054,14 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
             update_branch_stack(frame, branch_frame, operand_stack);
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, get_branch_arity(branch_frame));
+            instructions.push_back(opcode);
+            push(instructions, get_branch_arity(branch_frame));
 
-            branch_frame.br_immediate_offsets.push_back(code.instructions.size());
+            if constexpr (EmitCode)
+                branch_frame.br_immediate_offsets.push_back(instructions.size());
 
             push_branch_immediates(
-                branch_frame, static_cast<int>(operand_stack.size()), code.instructions);
+                branch_frame, static_cast<int>(operand_stack.size()), instructions);
 
             mark_frame_unreachable(frame, operand_stack);
             continue;
@@ -679,11 +1076,13 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
                 throw validation_error{"invalid funcidx encountered with call"};
 
             const auto& callee_func_type = module.get_function_type(callee_func_idx);
-            update_operand_stack(
+            update_call_operand_stack(
                 frame, operand_stack, callee_func_type.inputs, callee_func_type.outputs);
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, callee_func_idx);
+            instructions.push_back(opcode);
+            push(instructions, callee_func_idx);
+            if constexpr (EmitCode)
+                callees.push_back(callee_func_idx);
             continue;
         }
 
@@ -699,7 +1098,7 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
                 throw validation_error{"invalid type index with call_indirect"};
 
             const auto& callee_func_type = module.typesec[callee_type_idx];
-            update_operand_stack(
+            update_call_operand_stack(
                 frame, operand_stack, callee_func_type.inputs, callee_func_type.outputs);
 
             uint8_t table_idx;
@@ -707,46 +1106,102 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
             if (table_idx != 0)
                 throw parser_error{"invalid tableidx encountered with call_indirect"};
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, callee_type_idx);
+            instructions.push_back(opcode);
+            push(instructions, callee_type_idx);
+            has_call_indirect = true;
             continue;
         }
 
-        case Instr::local_get:
+        case Instr::return_call:
         {
-            LocalIdx local_idx;
-            std::tie(local_idx, pos) = leb128u_decode<uint32_t>(pos, end);
+            FuncIdx callee_func_idx;
+            std::tie(callee_func_idx, pos) = leb128u_decode<uint32_t>(pos, end);
+
+            if (callee_func_idx >= module.imported_function_types.size() + module.funcsec.size())
+                throw validation_error{"invalid funcidx encountered with return_call"};
+
+            // The callee's results become the results of the function.
+            const auto& callee_func_type = module.get_function_type(callee_func_idx);
+            if (callee_func_type.outputs != func_outputs)
+                throw validation_error{"return_call result type mismatch"};
+            update_call_operand_stack(frame, operand_stack, callee_func_type.inputs, {});
 
-            push_operand(operand_stack, find_local_type(func_inputs, locals, local_idx));
+            instructions.push_back(opcode);
+            push(instructions, callee_func_idx);
+            if constexpr (EmitCode)
+                callees.push_back(callee_func_idx);
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, local_idx);
+            mark_frame_unreachable(frame, operand_stack);
             continue;
         }
 
-        case Instr::local_set:
+        case Instr::return_call_indirect:
         {
-            LocalIdx local_idx;
-            std::tie(local_idx, pos) = leb128u_decode<uint32_t>(pos, end);
+            if (!module.has_table())
+                throw validation_error{"return_call_indirect without defined table"};
 
-            drop_operand(frame, operand_stack, find_local_type(func_inputs, locals, local_idx));
+            TypeIdx callee_type_idx;
+            std::tie(callee_type_idx, pos) = leb128u_decode<uint32_t>(pos, end);
+
+            if (callee_type_idx >= module.typesec.size())
+                throw validation_error{"invalid type index with return_call_indirect"};
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, local_idx);
+            const auto& callee_func_type = module.typesec[callee_type_idx];
+            if (callee_func_type.outputs != func_outputs)
+                throw validation_error{"return_call_indirect result type mismatch"};
+            update_call_operand_stack(frame, operand_stack, callee_func_type.inputs, {});
+
+            uint8_t table_idx;
+            std::tie(table_idx, pos) = parse_byte(pos, end);
+            if (table_idx != 0)
+                throw parser_error{"invalid tableidx encountered with return_call_indirect"};
+
+            instructions.push_back(opcode);
+            push(instructions, callee_type_idx);
+            has_call_indirect = true;
+
+            mark_frame_unreachable(frame, operand_stack);
             continue;
         }
 
+        case Instr::local_get:
+        case Instr::local_set:
         case Instr::local_tee:
         {
             LocalIdx local_idx;
             std::tie(local_idx, pos) = leb128u_decode<uint32_t>(pos, end);
 
-            const auto local_type = find_local_type(func_inputs, locals, local_idx);
-            drop_operand(frame, operand_stack, local_type);
-            push_operand(operand_stack, local_type);
-
-            code.instructions.push_back(opcode);
-            push(code.instructions, local_idx);
+            const auto local_type = find_local_type(func_inputs, locals, local_ends, local_idx);
+            if (instr != Instr::local_get)
+                drop_operand(frame, operand_stack, local_type);
+            if (instr != Instr::local_set)
+                push_operand(operand_stack, local_type);
+
+            // The instructions address the locals by the Value slot.
+            const auto slot = find_local_slot(
+                func_inputs.size(), param_slots, locals, local_ends, local_slot_ends, local_idx);
+            const auto emit_local = [&instructions](Instr local_instr, uint32_t local_slot) {
+                instructions.push_back(static_cast<uint8_t>(local_instr));
+                push(instructions, local_slot);
+            };
+
+            if (local_type != ValType::v128)
+                emit_local(instr, slot);
+            else
+            {
+                // The v128 local is accessed with 2 instructions, one for each slot.
+                // The value is pushed to the stack with the low half first.
+                if (instr != Instr::local_get)
+                {
+                    emit_local(Instr::local_set, slot + 1);
+                    emit_local(Instr::local_set, slot);
+                }
+                if (instr != Instr::local_set)
+                {
+                    emit_local(Instr::local_get, slot);
+                    emit_local(Instr::local_get, slot + 1);
+                }
+            }
             continue;
         }
 
@@ -758,10 +1213,10 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
             if (global_idx >= module.get_global_count())
                 throw validation_error{"accessing global with invalid index"};
 
-            push_operand(operand_stack, module.get_global_type(global_idx).value_type);
+            const auto global_type = module.get_global_type(global_idx).value_type;
+            push_operand(operand_stack, global_type);
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, global_idx);
+            emit_global(instructions, module, instr, global_type, global_idx);
             continue;
         }
 
@@ -776,10 +1231,10 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
             if (!module.get_global_type(global_idx).is_mutable)
                 throw validation_error{"trying to mutate immutable global"};
 
-            drop_operand(frame, operand_stack, module.get_global_type(global_idx).value_type);
+            const auto global_type = module.get_global_type(global_idx).value_type;
+            drop_operand(frame, operand_stack, global_type);
 
-            code.instructions.push_back(opcode);
-            push(code.instructions, global_idx);
+            emit_global(instructions, module, instr, global_type, global_idx);
             continue;
         }
 
@@ -787,8 +1242,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         {
             int32_t value;
             std::tie(value, pos) = leb128s_decode<int32_t>(pos, end);
-            code.instructions.push_back(opcode);
-            push(code.instructions, static_cast<uint32_t>(value));
+            instructions.push_back(opcode);
+            push(instructions, static_cast<uint32_t>(value));
             continue;
         }
 
@@ -796,8 +1251,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         {
             int64_t value;
             std::tie(value, pos) = leb128s_decode<int64_t>(pos, end);
-            code.instructions.push_back(opcode);
-            push(code.instructions, static_cast<uint64_t>(value));
+            instructions.push_back(opcode);
+            push(instructions, static_cast<uint64_t>(value));
             continue;
         }
 
@@ -805,8 +1260,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         {
             uint32_t value;
             std::tie(value, pos) = parse_value<uint32_t>(pos, end);
-            code.instructions.push_back(opcode);
-            push(code.instructions, value);
+            instructions.push_back(opcode);
+            push(instructions, value);
             continue;
         }
 
@@ -814,8 +1269,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         {
             uint64_t value;
             std::tie(value, pos) = parse_value<uint64_t>(pos, end);
-            code.instructions.push_back(opcode);
-            push(code.instructions, value);
+            instructions.push_back(opcode);
+            push(instructions, value);
             continue;
         }
 
@@ -852,8 +1307,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
             uint32_t offset;
             std::tie(offset, pos) = leb128u_decode<uint32_t>(pos, end);
-            code.instructions.push_back(opcode);
-            push(code.instructions, offset);
+            instructions.push_back(opcode);
+            push(instructions, offset);
 
             if (!module.has_memory())
                 throw validation_error{"memory instructions require imported or defined memory"};
@@ -862,20 +1317,738 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
 
         case Instr::memory_size:
         case Instr::memory_grow:
+            pos = parse_memory_index(pos, end, module);
+            break;
+
+        case Instr::misc_prefix:
         {
-            uint8_t memory_idx;
-            std::tie(memory_idx, pos) = parse_byte(pos, end);
-            if (memory_idx != 0)
-                throw parser_error{"invalid memory index encountered"};
+            uint32_t misc_opcode;
+            std::tie(misc_opcode, pos) = leb128u_decode<uint32_t>(pos, end);
+
+            // All bulk memory instructions take 3 i32 operands, except data.drop.
+            static constexpr ValType bulk_memory_inputs[]{ValType::i32, ValType::i32, ValType::i32};
+
+            switch (static_cast<MiscInstr>(misc_opcode))
+            {
+            default:
+                throw parser_error{"invalid instruction " + std::to_string(opcode) + " " +
+                                   std::to_string(misc_opcode)};
+
+            case MiscInstr::memory_init:
+            case MiscInstr::data_drop:
+            {
+                uint32_t data_idx;
+                std::tie(data_idx, pos) = leb128u_decode<uint32_t>(pos, end);
+
+                if (!module.datacount.has_value())
+                    throw validation_error{"data count section required"};
+                if (data_idx >= *module.datacount)
+                    throw validation_error{"invalid data segment index"};
+
+                if (static_cast<MiscInstr>(misc_opcode) == MiscInstr::memory_init)
+                {
+                    pos = parse_memory_index(pos, end, module);
+                    update_operand_stack(frame, operand_stack, bulk_memory_inputs, {});
+                    instructions.push_back(static_cast<uint8_t>(Instr::memory_init));
+                }
+                else
+                    instructions.push_back(static_cast<uint8_t>(Instr::data_drop));
+                push(instructions, data_idx);
+                continue;
+            }
+
+            case MiscInstr::memory_copy:
+                pos = parse_memory_index(pos, end, module);
+                pos = parse_memory_index(pos, end, module);
+                update_operand_stack(frame, operand_stack, bulk_memory_inputs, {});
+                instructions.push_back(static_cast<uint8_t>(Instr::memory_copy));
+                continue;
+
+            case MiscInstr::memory_fill:
+                pos = parse_memory_index(pos, end, module);
+                update_operand_stack(frame, operand_stack, bulk_memory_inputs, {});
+                instructions.push_back(static_cast<uint8_t>(Instr::memory_fill));
+                continue;
+            }
+        }
+
+        case Instr::simd_prefix:
+        {
+            uint32_t simd_opcode;
+            std::tie(simd_opcode, pos) = leb128u_decode<uint32_t>(pos, end);
+
+            static constexpr ValType v128_x1[]{ValType::v128};
+            static constexpr ValType v128_x2[]{ValType::v128, ValType::v128};
+            static constexpr ValType v128_x3[]{ValType::v128, ValType::v128, ValType::v128};
+            static constexpr ValType i32_x1[]{ValType::i32};
+            static constexpr ValType i32_v128[]{ValType::i32, ValType::v128};
+            static constexpr ValType v128_i32[]{ValType::v128, ValType::i32};
+
+            const auto simd_instr = static_cast<SimdInstr>(simd_opcode);
+            const auto invalid_instruction = [opcode, simd_opcode] {
+                return parser_error{"invalid instruction " + std::to_string(opcode) + " " +
+                                    std::to_string(simd_opcode)};
+            };
+            if (simd_opcode > 0xff)
+                throw invalid_instruction();
+
+            // The sub-opcode is emitted as the first immediate.
+            instructions.push_back(opcode);
+            push(instructions, simd_opcode);
+
+            switch (simd_instr)
+            {
+            default:
+                throw invalid_instruction();
+
+            case SimdInstr::v128_load:
+            case SimdInstr::v128_load8x8_s:
+            case SimdInstr::v128_load8x8_u:
+            case SimdInstr::v128_load16x4_s:
+            case SimdInstr::v128_load16x4_u:
+            case SimdInstr::v128_load32x2_s:
+            case SimdInstr::v128_load32x2_u:
+            case SimdInstr::v128_load8_splat:
+            case SimdInstr::v128_load16_splat:
+            case SimdInstr::v128_load32_splat:
+            case SimdInstr::v128_load64_splat:
+            case SimdInstr::v128_load32_zero:
+            case SimdInstr::v128_load64_zero:
+            case SimdInstr::v128_store:
+            case SimdInstr::v128_load8_lane:
+            case SimdInstr::v128_load16_lane:
+            case SimdInstr::v128_load32_lane:
+            case SimdInstr::v128_load64_lane:
+            case SimdInstr::v128_store8_lane:
+            case SimdInstr::v128_store16_lane:
+            case SimdInstr::v128_store32_lane:
+            case SimdInstr::v128_store64_lane:
+            {
+                uint32_t align;
+                std::tie(align, pos) = leb128u_decode<uint32_t>(pos, end);
+                if (align > get_simd_max_align(simd_instr))
+                    throw validation_error{"alignment cannot exceed operand size"};
+
+                uint32_t offset;
+                std::tie(offset, pos) = leb128u_decode<uint32_t>(pos, end);
+                push(instructions, offset);
+
+                if (!module.has_memory())
+                {
+                    throw validation_error{
+                        "memory instructions require imported or defined memory"};
+                }
+
+                if (simd_instr >= SimdInstr::v128_load8_lane &&
+                    simd_instr <= SimdInstr::v128_store64_lane)
+                {
+                    uint8_t lane;
+                    std::tie(lane, pos) = parse_byte(pos, end);
+                    if (lane >= get_simd_lane_count(simd_instr))
+                        throw validation_error{"invalid lane index"};
+                    instructions.push_back(lane);
+
+                    if (simd_instr <= SimdInstr::v128_load64_lane)
+                        update_simd_operand_stack(frame, operand_stack, i32_v128, v128_x1);
+                    else
+                        update_simd_operand_stack(frame, operand_stack, i32_v128, {});
+                }
+                else if (simd_instr == SimdInstr::v128_store)
+                    update_simd_operand_stack(frame, operand_stack, i32_v128, {});
+                else
+                    update_simd_operand_stack(frame, operand_stack, i32_x1, v128_x1);
+                continue;
+            }
+
+            case SimdInstr::v128_const:
+            case SimdInstr::i8x16_shuffle:
+            {
+                std::array<uint8_t, 16> value;
+                std::tie(value, pos) = parse_value<std::array<uint8_t, 16>>(pos, end);
+                if (simd_instr == SimdInstr::i8x16_shuffle)
+                {
+                    if (std::any_of(value.begin(), value.end(), [](uint8_t l) { return l >= 32; }))
+                        throw validation_error{"invalid lane index"};
+                    update_simd_operand_stack(frame, operand_stack, v128_x2, v128_x1);
+                }
+                else
+                    update_simd_operand_stack(frame, operand_stack, {}, v128_x1);
+                for (const auto byte : value)
+                    instructions.push_back(byte);
+                continue;
+            }
+
+            case SimdInstr::i8x16_splat:
+            case SimdInstr::i16x8_splat:
+            case SimdInstr::i32x4_splat:
+            case SimdInstr::i64x2_splat:
+            case SimdInstr::f32x4_splat:
+            case SimdInstr::f64x2_splat:
+            {
+                const ValType inputs[]{get_simd_lane_type(simd_instr)};
+                update_simd_operand_stack(frame, operand_stack, inputs, v128_x1);
+                continue;
+            }
+
+            case SimdInstr::i8x16_extract_lane_s:
+            case SimdInstr::i8x16_extract_lane_u:
+            case SimdInstr::i8x16_replace_lane:
+            case SimdInstr::i16x8_extract_lane_s:
+            case SimdInstr::i16x8_extract_lane_u:
+            case SimdInstr::i16x8_replace_lane:
+            case SimdInstr::i32x4_extract_lane:
+            case SimdInstr::i32x4_replace_lane:
+            case SimdInstr::i64x2_extract_lane:
+            case SimdInstr::i64x2_replace_lane:
+            case SimdInstr::f32x4_extract_lane:
+            case SimdInstr::f32x4_replace_lane:
+            case SimdInstr::f64x2_extract_lane:
+            case SimdInstr::f64x2_replace_lane:
+            {
+                uint8_t lane;
+                std::tie(lane, pos) = parse_byte(pos, end);
+                if (lane >= get_simd_lane_count(simd_instr))
+                    throw validation_error{"invalid lane index"};
+                instructions.push_back(lane);
+
+                const auto lane_type = get_simd_lane_type(simd_instr);
+                const ValType lane_types[]{lane_type};
+                const ValType replace_inputs[]{ValType::v128, lane_type};
+                const bool is_replace = simd_instr == SimdInstr::i8x16_replace_lane ||
+                                        simd_instr == SimdInstr::i16x8_replace_lane ||
+                                        simd_instr == SimdInstr::i32x4_replace_lane ||
+                                        simd_instr == SimdInstr::i64x2_replace_lane ||
+                                        simd_instr == SimdInstr::f32x4_replace_lane ||
+                                        simd_instr == SimdInstr::f64x2_replace_lane;
+                if (is_replace)
+                    update_simd_operand_stack(frame, operand_stack, replace_inputs, v128_x1);
+                else
+                    update_simd_operand_stack(frame, operand_stack, v128_x1, lane_types);
+                continue;
+            }
+
+            case SimdInstr::v128_not:
+            case SimdInstr::f32x4_demote_f64x2_zero:
+            case SimdInstr::f64x2_promote_low_f32x4:
+            case SimdInstr::i8x16_abs:
+            case SimdInstr::i8x16_neg:
+            case SimdInstr::i8x16_popcnt:
+            case SimdInstr::f32x4_ceil:
+            case SimdInstr::f32x4_floor:
+            case SimdInstr::f32x4_trunc:
+            case SimdInstr::f32x4_nearest:
+            case SimdInstr::f64x2_ceil:
+            case SimdInstr::f64x2_floor:
+            case SimdInstr::f64x2_trunc:
+            case SimdInstr::f64x2_nearest:
+            case SimdInstr::i16x8_extadd_pairwise_i8x16_s:
+            case SimdInstr::i16x8_extadd_pairwise_i8x16_u:
+            case SimdInstr::i32x4_extadd_pairwise_i16x8_s:
+            case SimdInstr::i32x4_extadd_pairwise_i16x8_u:
+            case SimdInstr::i16x8_abs:
+            case SimdInstr::i16x8_neg:
+            case SimdInstr::i16x8_extend_low_i8x16_s:
+            case SimdInstr::i16x8_extend_high_i8x16_s:
+            case SimdInstr::i16x8_extend_low_i8x16_u:
+            case SimdInstr::i16x8_extend_high_i8x16_u:
+            case SimdInstr::i32x4_abs:
+            case SimdInstr::i32x4_neg:
+            case SimdInstr::i32x4_extend_low_i16x8_s:
+            case SimdInstr::i32x4_extend_high_i16x8_s:
+            case SimdInstr::i32x4_extend_low_i16x8_u:
+            case SimdInstr::i32x4_extend_high_i16x8_u:
+            case SimdInstr::i64x2_abs:
+            case SimdInstr::i64x2_neg:
+            case SimdInstr::i64x2_extend_low_i32x4_s:
+            case SimdInstr::i64x2_extend_high_i32x4_s:
+            case SimdInstr::i64x2_extend_low_i32x4_u:
+            case SimdInstr::i64x2_extend_high_i32x4_u:
+            case SimdInstr::f32x4_abs:
+            case SimdInstr::f32x4_neg:
+            case SimdInstr::f32x4_sqrt:
+            case SimdInstr::f64x2_abs:
+            case SimdInstr::f64x2_neg:
+            case SimdInstr::f64x2_sqrt:
+            case SimdInstr::i32x4_trunc_sat_f32x4_s:
+            case SimdInstr::i32x4_trunc_sat_f32x4_u:
+            case SimdInstr::f32x4_convert_i32x4_s:
+            case SimdInstr::f32x4_convert_i32x4_u:
+            case SimdInstr::i32x4_trunc_sat_f64x2_s_zero:
+            case SimdInstr::i32x4_trunc_sat_f64x2_u_zero:
+            case SimdInstr::f64x2_convert_low_i32x4_s:
+            case SimdInstr::f64x2_convert_low_i32x4_u:
+                update_simd_operand_stack(frame, operand_stack, v128_x1, v128_x1);
+                continue;
+
+            case SimdInstr::i8x16_swizzle:
+            case SimdInstr::i8x16_eq:
+            case SimdInstr::i8x16_ne:
+            case SimdInstr::i8x16_lt_s:
+            case SimdInstr::i8x16_lt_u:
+            case SimdInstr::i8x16_gt_s:
+            case SimdInstr::i8x16_gt_u:
+            case SimdInstr::i8x16_le_s:
+            case SimdInstr::i8x16_le_u:
+            case SimdInstr::i8x16_ge_s:
+            case SimdInstr::i8x16_ge_u:
+            case SimdInstr::i16x8_eq:
+            case SimdInstr::i16x8_ne:
+            case SimdInstr::i16x8_lt_s:
+            case SimdInstr::i16x8_lt_u:
+            case SimdInstr::i16x8_gt_s:
+            case SimdInstr::i16x8_gt_u:
+            case SimdInstr::i16x8_le_s:
+            case SimdInstr::i16x8_le_u:
+            case SimdInstr::i16x8_ge_s:
+            case SimdInstr::i16x8_ge_u:
+            case SimdInstr::i32x4_eq:
+            case SimdInstr::i32x4_ne:
+            case SimdInstr::i32x4_lt_s:
+            case SimdInstr::i32x4_lt_u:
+            case SimdInstr::i32x4_gt_s:
+            case SimdInstr::i32x4_gt_u:
+            case SimdInstr::i32x4_le_s:
+            case SimdInstr::i32x4_le_u:
+            case SimdInstr::i32x4_ge_s:
+            case SimdInstr::i32x4_ge_u:
+            case SimdInstr::f32x4_eq:
+            case SimdInstr::f32x4_ne:
+            case SimdInstr::f32x4_lt:
+            case SimdInstr::f32x4_gt:
+            case SimdInstr::f32x4_le:
+            case SimdInstr::f32x4_ge:
+            case SimdInstr::f64x2_eq:
+            case SimdInstr::f64x2_ne:
+            case SimdInstr::f64x2_lt:
+            case SimdInstr::f64x2_gt:
+            case SimdInstr::f64x2_le:
+            case SimdInstr::f64x2_ge:
+            case SimdInstr::v128_and:
+            case SimdInstr::v128_andnot:
+            case SimdInstr::v128_or:
+            case SimdInstr::v128_xor:
+            case SimdInstr::i8x16_narrow_i16x8_s:
+            case SimdInstr::i8x16_narrow_i16x8_u:
+            case SimdInstr::i8x16_add:
+            case SimdInstr::i8x16_add_sat_s:
+            case SimdInstr::i8x16_add_sat_u:
+            case SimdInstr::i8x16_sub:
+            case SimdInstr::i8x16_sub_sat_s:
+            case SimdInstr::i8x16_sub_sat_u:
+            case SimdInstr::i8x16_min_s:
+            case SimdInstr::i8x16_min_u:
+            case SimdInstr::i8x16_max_s:
+            case SimdInstr::i8x16_max_u:
+            case SimdInstr::i8x16_avgr_u:
+            case SimdInstr::i16x8_q15mulr_sat_s:
+            case SimdInstr::i16x8_narrow_i32x4_s:
+            case SimdInstr::i16x8_narrow_i32x4_u:
+            case SimdInstr::i16x8_add:
+            case SimdInstr::i16x8_add_sat_s:
+            case SimdInstr::i16x8_add_sat_u:
+            case SimdInstr::i16x8_sub:
+            case SimdInstr::i16x8_sub_sat_s:
+            case SimdInstr::i16x8_sub_sat_u:
+            case SimdInstr::i16x8_mul:
+            case SimdInstr::i16x8_min_s:
+            case SimdInstr::i16x8_min_u:
+            case SimdInstr::i16x8_max_s:
+            case SimdInstr::i16x8_max_u:
+            case SimdInstr::i16x8_avgr_u:
+            case SimdInstr::i16x8_extmul_low_i8x16_s:
+            case SimdInstr::i16x8_extmul_high_i8x16_s:
+            case SimdInstr::i16x8_extmul_low_i8x16_u:
+            case SimdInstr::i16x8_extmul_high_i8x16_u:
+            case SimdInstr::i32x4_add:
+            case SimdInstr::i32x4_sub:
+            case SimdInstr::i32x4_mul:
+            case SimdInstr::i32x4_min_s:
+            case SimdInstr::i32x4_min_u:
+            case SimdInstr::i32x4_max_s:
+            case SimdInstr::i32x4_max_u:
+            case SimdInstr::i32x4_dot_i16x8_s:
+            case SimdInstr::i32x4_extmul_low_i16x8_s:
+            case SimdInstr::i32x4_extmul_high_i16x8_s:
+            case SimdInstr::i32x4_extmul_low_i16x8_u:
+            case SimdInstr::i32x4_extmul_high_i16x8_u:
+            case SimdInstr::i64x2_add:
+            case SimdInstr::i64x2_sub:
+            case SimdInstr::i64x2_mul:
+            case SimdInstr::i64x2_eq:
+            case SimdInstr::i64x2_ne:
+            case SimdInstr::i64x2_lt_s:
+            case SimdInstr::i64x2_gt_s:
+            case SimdInstr::i64x2_le_s:
+            case SimdInstr::i64x2_ge_s:
+            case SimdInstr::i64x2_extmul_low_i32x4_s:
+            case SimdInstr::i64x2_extmul_high_i32x4_s:
+            case SimdInstr::i64x2_extmul_low_i32x4_u:
+            case SimdInstr::i64x2_extmul_high_i32x4_u:
+            case SimdInstr::f32x4_add:
+            case SimdInstr::f32x4_sub:
+            case SimdInstr::f32x4_mul:
+            case SimdInstr::f32x4_div:
+            case SimdInstr::f32x4_min:
+            case SimdInstr::f32x4_max:
+            case SimdInstr::f32x4_pmin:
+            case SimdInstr::f32x4_pmax:
+            case SimdInstr::f64x2_add:
+            case SimdInstr::f64x2_sub:
+            case SimdInstr::f64x2_mul:
+            case SimdInstr::f64x2_div:
+            case SimdInstr::f64x2_min:
+            case SimdInstr::f64x2_max:
+            case SimdInstr::f64x2_pmin:
+            case SimdInstr::f64x2_pmax:
+                update_simd_operand_stack(frame, operand_stack, v128_x2, v128_x1);
+                continue;
+
+            case SimdInstr::v128_bitselect:
+                update_simd_operand_stack(frame, operand_stack, v128_x3, v128_x1);
+                continue;
+
+            case SimdInstr::v128_any_true:
+            case SimdInstr::i8x16_all_true:
+            case SimdInstr::i8x16_bitmask:
+            case SimdInstr::i16x8_all_true:
+            case SimdInstr::i16x8_bitmask:
+            case SimdInstr::i32x4_all_true:
+            case SimdInstr::i32x4_bitmask:
+            case SimdInstr::i64x2_all_true:
+            case SimdInstr::i64x2_bitmask:
+                update_simd_operand_stack(frame, operand_stack, v128_x1, i32_x1);
+                continue;
+
+            case SimdInstr::i8x16_shl:
+            case SimdInstr::i8x16_shr_s:
+            case SimdInstr::i8x16_shr_u:
+            case SimdInstr::i16x8_shl:
+            case SimdInstr::i16x8_shr_s:
+            case SimdInstr::i16x8_shr_u:
+            case SimdInstr::i32x4_shl:
+            case SimdInstr::i32x4_shr_s:
+            case SimdInstr::i32x4_shr_u:
+            case SimdInstr::i64x2_shl:
+            case SimdInstr::i64x2_shr_s:
+            case SimdInstr::i64x2_shr_u:
+                update_simd_operand_stack(frame, operand_stack, v128_i32, v128_x1);
+                continue;
+            }
+        }
+        case Instr::atomic_prefix:
+        {
+            uint32_t atomic_opcode;
+            std::tie(atomic_opcode, pos) = leb128u_decode<uint32_t>(pos, end);
+
+            const auto atomic_instr = static_cast<AtomicInstr>(atomic_opcode);
+            if ((atomic_instr > AtomicInstr::atomic_fence &&
+                    atomic_instr < AtomicInstr::i32_atomic_load) ||
+                atomic_opcode > static_cast<uint8_t>(AtomicInstr::i64_atomic_rmw32_cmpxchg_u))
+            {
+                throw parser_error{"invalid instruction " + std::to_string(opcode) + " " +
+                                   std::to_string(atomic_opcode)};
+            }
+
+            // The sub-opcode is emitted as the first immediate.
+            instructions.push_back(opcode);
+            push(instructions, atomic_opcode);
+
+            if (atomic_instr == AtomicInstr::atomic_fence)
+            {
+                uint8_t fence_flags;
+                std::tie(fence_flags, pos) = parse_byte(pos, end);
+                if (fence_flags != 0)
+                    throw parser_error{"invalid atomic.fence flags"};
+                continue;
+            }
+
+            // The inputs, the output and the log2 of the accessed size, which is the only valid
+            // alignment.
+            ValType inputs[3]{ValType::i32, ValType::i32, ValType::i32};
+            size_t num_inputs = 0;
+            std::optional<ValType> output = ValType::i32;
+            uint32_t natural_align = 2;
+            switch (atomic_instr)
+            {
+            case AtomicInstr::memory_atomic_notify:
+                num_inputs = 2;
+                break;
+            case AtomicInstr::memory_atomic_wait32:
+            case AtomicInstr::memory_atomic_wait64:
+                if (atomic_instr == AtomicInstr::memory_atomic_wait64)
+                {
+                    inputs[1] = ValType::i64;
+                    natural_align = 3;
+                }
+                inputs[2] = ValType::i64;
+                num_inputs = 3;
+                break;
+            default:
+            {
+                // The groups of the loads, stores and read-modify-write operations have
+                // 7 sub-opcodes each, in the order of the accessed types:
+                // i32, i64, i32 8u, i32 16u, i64 8u, i64 16u, i64 32u.
+                static constexpr ValType operand_types[]{ValType::i32, ValType::i64,
+                    ValType::i32, ValType::i32, ValType::i64, ValType::i64, ValType::i64};
+                static constexpr uint8_t aligns[]{2, 3, 0, 1, 0, 1, 2};
+                const auto index = atomic_opcode - uint32_t{0x10};
+                const auto operand_type = operand_types[index % 7];
+                const auto group = index / 7;
+                natural_align = aligns[index % 7];
+                inputs[1] = inputs[2] = operand_type;
+                output = operand_type;
+                if (group == 0)  // Load.
+                    num_inputs = 1;
+                else if (group == 1)  // Store.
+                {
+                    num_inputs = 2;
+                    output.reset();
+                }
+                else if (atomic_instr >= AtomicInstr::i32_atomic_rmw_cmpxchg)
+                    num_inputs = 3;
+                else
+                    num_inputs = 2;
+                break;
+            }
+            }
+
+            uint32_t align;
+            std::tie(align, pos) = leb128u_decode<uint32_t>(pos, end);
+            if (align != natural_align)
+                throw validation_error{"atomic alignment must be equal to operand size"};
+
+            uint32_t offset;
+            std::tie(offset, pos) = leb128u_decode<uint32_t>(pos, end);
+            push(instructions, offset);
 
             if (!module.has_memory())
                 throw validation_error{"memory instructions require imported or defined memory"};
-            break;
+
+            update_operand_stack(frame, operand_stack, {inputs, num_inputs},
+                output.has_value() ? span<const ValType>{&*output, 1} : span<const ValType>{});
+            continue;
         }
         }
-        code.instructions.emplace_back(opcode);
+        instructions.emplace_back(opcode);
     }
     assert(control_stack.empty());
-    return {code, pos};
+
+    if constexpr (EmitCode)
+    {
+        // The final end is the target of the branches to the function's frame, so it is reachable
+        // with the results on the stack even if it cannot be reached by the preceding instruction.
+        push_stack_heights(instructions, instr_code_offset,
+            static_cast<int>(get_num_slots(func_outputs)), stack_heights);
+
+        // Copy the final code into the target memory resource, without any excess capacity.
+        ParsedCode code{max_stack_height, 0, {instructions.begin(), instructions.end(), resource},
+            sizeof(uint32_t), {callees.begin(), callees.end(), resource}, has_call_indirect,
+            {stack_heights.begin(), stack_heights.end(), resource}};
+        return {std::move(code), pos};
+    }
+    else
+        return {ParsedCode{}, pos};
+}
+
+}  // namespace
+
+parser_result<ParsedCode> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
+    const std::vector<Locals>& locals, const Module& module, std::pmr::memory_resource* resource)
+{
+    return parse_or_validate_expr<true>(pos, end, func_idx, locals, module, resource);
+}
+
+const uint8_t* validate_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
+    const std::vector<Locals>& locals, const Module& module)
+{
+    return parse_or_validate_expr<false>(
+        pos, end, func_idx, locals, module, std::pmr::null_memory_resource())
+        .second;
+}
+
+namespace
+{
+/// Reads the immediate of the given size.
+inline uint32_t read_immediate(const uint8_t* pos, size_t immediate_size) noexcept
+{
+    if (immediate_size == sizeof(uint8_t))
+        return *pos;
+    if (immediate_size == sizeof(uint16_t))
+    {
+        uint16_t value;
+        __builtin_memcpy(&value, pos, sizeof(value));
+        return value;
+    }
+    uint32_t value;
+    __builtin_memcpy(&value, pos, sizeof(value));
+    return value;
+}
+}  // namespace
+
+std::pair<uint32_t, size_t> get_immediates_layout(
+    const uint8_t* instr, size_t immediate_size) noexcept
+{
+    const auto opcode = *instr;
+    if (opcode >= static_cast<uint8_t>(Instr::i32_load) &&
+        opcode <= static_cast<uint8_t>(Instr::i64_store32))
+        return {1, 0};  // Memory offset.
+
+    switch (static_cast<Instr>(opcode))
+    {
+    case Instr::if_:
+    case Instr::else_:
+    case Instr::call:
+    case Instr::call_indirect:
+    case Instr::return_call:
+    case Instr::return_call_indirect:
+    case Instr::local_get:
+    case Instr::local_set:
+    case Instr::local_tee:
+    case Instr::global_get:
+    case Instr::global_set:
+    case Instr::v128_global_get:
+    case Instr::v128_global_set:
+    case Instr::memory_init:
+    case Instr::data_drop:
+        return {1, 0};
+    case Instr::br:
+    case Instr::br_if:
+    case Instr::return_:
+        return {3, 0};  // Arity, code offset, stack drop.
+    case Instr::br_table:
+    {
+        // Size, arity and the code offset and stack drop pair for each label and the default one.
+        const auto size = read_immediate(instr + 1, immediate_size);
+        return {2 + 2 * (size + 1), 0};
+    }
+    case Instr::simd_prefix:
+    {
+        // The sub-opcode, followed by the memory offset and the lane index of memory instructions,
+        // the lane index of lane instructions, or the 16 bytes of v128.const and i8x16.shuffle.
+        const auto simd_instr = static_cast<SimdInstr>(read_immediate(instr + 1, immediate_size));
+        if (simd_instr == SimdInstr::v128_const || simd_instr == SimdInstr::i8x16_shuffle)
+            return {1, 16};
+        if (simd_instr <= SimdInstr::v128_store)
+            return {2, 0};
+        if (simd_instr >= SimdInstr::i8x16_extract_lane_s &&
+            simd_instr <= SimdInstr::f64x2_replace_lane)
+            return {1, 1};
+        if (simd_instr >= SimdInstr::v128_load8_lane && simd_instr <= SimdInstr::v128_store64_lane)
+            return {2, 1};
+        if (simd_instr == SimdInstr::v128_load32_zero || simd_instr == SimdInstr::v128_load64_zero)
+            return {2, 0};
+        return {1, 0};
+    }
+    case Instr::atomic_prefix:
+        // The sub-opcode, followed by the memory offset, except for atomic.fence.
+        if (static_cast<AtomicInstr>(read_immediate(instr + 1, immediate_size)) ==
+            AtomicInstr::atomic_fence)
+            return {1, 0};
+        return {2, 0};
+    case Instr::i32_const:
+    case Instr::f32_const:
+        return {0, sizeof(uint32_t)};
+    case Instr::i64_const:
+    case Instr::f64_const:
+        return {0, sizeof(uint64_t)};
+    default:
+        return {0, 0};
+    }
+}
+
+bool is_code_offset_immediate(uint8_t opcode, uint32_t immediate_idx) noexcept
+{
+    switch (static_cast<Instr>(opcode))
+    {
+    case Instr::if_:
+    case Instr::else_:
+        return true;
+    case Instr::br:
+    case Instr::br_if:
+    case Instr::return_:
+        return immediate_idx == 1;
+    case Instr::br_table:
+        return immediate_idx >= 2 && immediate_idx % 2 == 0;
+    default:
+        return false;
+    }
+}
+
+ParsedCode compact_code(const ParsedCode& code, std::pmr::memory_resource* resource)
+{
+    const auto* const begin = code.instructions.data();
+    const auto* const end = begin + code.instructions.size();
+
+    // Find the max value of the immediates other than code offsets (these get smaller),
+    // and for each instruction the number of immediates preceding it. The latter gives the
+    // instruction's offset in the compacted code.
+    std::vector<uint32_t> preceding_immediates(code.instructions.size() + 1);
+    uint32_t num_immediates = 0;
+    uint32_t max_immediate = 0;
+    for (const auto* pos = begin; pos != end;)
+    {
+        preceding_immediates[static_cast<size_t>(pos - begin)] = num_immediates;
+        const auto opcode = *pos;
+        const auto [count, value_size] = get_immediates_layout(pos++, sizeof(uint32_t));
+        for (uint32_t i = 0; i < count; ++i, pos += sizeof(uint32_t))
+        {
+            if (!is_code_offset_immediate(opcode, i))
+            {
+                uint32_t immediate;
+                __builtin_memcpy(&immediate, pos, sizeof(immediate));
+                max_immediate = std::max(max_immediate, immediate);
+            }
+        }
+        num_immediates += count;
+        pos += value_size;
+    }
+    preceding_immediates.back() = num_immediates;
+
+    // Code offsets are bounded by the size of the compacted code.
+    uint8_t immediate_size = sizeof(uint32_t);
+    for (const uint8_t candidate_size : {uint8_t{1}, uint8_t{2}})
+    {
+        const auto limit = uint64_t{1} << (8 * candidate_size);
+        const auto compact_code_size =
+            code.instructions.size() - size_t{num_immediates} * (sizeof(uint32_t) - candidate_size);
+        if (max_immediate < limit && compact_code_size < limit)
+        {
+            immediate_size = candidate_size;
+            break;
+        }
+    }
+
+    const auto size_reduction = sizeof(uint32_t) - immediate_size;
+    std::pmr::vector<uint8_t> instructions{resource};
+    instructions.reserve(code.instructions.size() - size_t{num_immediates} * size_reduction);
+    for (const auto* pos = begin; pos != end;)
+    {
+        const auto opcode = *pos;
+        const auto [count, value_size] = get_immediates_layout(pos, sizeof(uint32_t));
+        instructions.push_back(*pos++);
+        for (uint32_t i = 0; i < count; ++i, pos += sizeof(uint32_t))
+        {
+            uint32_t immediate;
+            __builtin_memcpy(&immediate, pos, sizeof(immediate));
+            if (is_code_offset_immediate(opcode, i))
+            {
+                immediate -=
+                    static_cast<uint32_t>(preceding_immediates[immediate] * size_reduction);
+            }
+
+            if (immediate_size == 1)
+                push(instructions, static_cast<uint8_t>(immediate));
+            else if (immediate_size == 2)
+                push(instructions, static_cast<uint16_t>(immediate));
+            else
+                push(instructions, immediate);
+        }
+        instructions.insert(instructions.end(), pos, pos + value_size);
+        pos += value_size;
+    }
+
+    return {code.max_stack_height, code.local_count, std::move(instructions), immediate_size,
+        {code.callees.begin(), code.callees.end(), resource}, code.has_call_indirect,
+        {code.stack_heights.begin(), code.stack_heights.end(), resource}};
 }
 }  // namespace fizzy
@@ -0,0 +1,273 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "preinit.hpp"
+#include "execute.hpp"
+#include "leb128.hpp"
+#include "limits.hpp"
+#include "parser.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace fizzy
+{
+namespace
+{
+/// The minimal number of zero bytes between non-zero memory contents which makes them separate
+/// data segments. Shorter gaps are cheaper to include than the overhead of a new segment.
+constexpr size_t DataSegmentMinGap = 16;
+
+void append_leb128u(bytes& out, uint64_t value)
+{
+    do
+    {
+        auto byte = static_cast<uint8_t>(value & 0x7f);
+        value >>= 7;
+        if (value != 0)
+            byte |= 0x80;
+        out.push_back(byte);
+    } while (value != 0);
+}
+
+void append_leb128s(bytes& out, int64_t value)
+{
+    while (true)
+    {
+        const auto byte = static_cast<uint8_t>(value & 0x7f);
+        value >>= 7;  // Arithmetic shift keeps the sign.
+        if ((value == 0 && (byte & 0x40) == 0) || (value == -1 && (byte & 0x40) != 0))
+        {
+            out.push_back(byte);
+            return;
+        }
+        out.push_back(byte | 0x80);
+    }
+}
+
+void append_section(bytes& out, SectionId id, const bytes& contents)
+{
+    out.push_back(static_cast<uint8_t>(id));
+    append_leb128u(out, contents.size());
+    out += contents;
+}
+
+bytes encode_memory_section(const Memory& memory, uint32_t memory_pages)
+{
+    bytes contents;
+    append_leb128u(contents, 1);
+    // The shared memory of the threads proposal always has the maximum.
+    contents.push_back(memory.limits.shared ? 0x03 : memory.limits.max.has_value() ? 0x01 : 0x00);
+    append_leb128u(contents, memory_pages);
+    if (memory.limits.max.has_value())
+        append_leb128u(contents, *memory.limits.max);
+    return contents;
+}
+
+bytes encode_global_section(const std::vector<Global>& globals, const std::vector<Value>& values)
+{
+    bytes contents;
+    append_leb128u(contents, globals.size());
+    size_t slot = 0;
+    for (const auto& global : globals)
+    {
+        const auto type = global.type;
+        contents.push_back(static_cast<uint8_t>(type.value_type));
+        contents.push_back(type.is_mutable ? 0x01 : 0x00);
+
+        // The v128 global occupies 2 slots, see Module::global_slots.
+        const auto value = values[slot];
+        slot += get_num_slots(type.value_type);
+        switch (type.value_type)
+        {
+        case ValType::i32:
+            contents.push_back(0x41);
+            append_leb128s(contents, value.as<int32_t>());
+            break;
+        case ValType::i64:
+            contents.push_back(0x42);
+            append_leb128s(contents, value.as<int64_t>());
+            break;
+        case ValType::f32:
+        {
+            const auto f = value.as<float>();
+            uint8_t encoded[sizeof(f)];
+            std::memcpy(encoded, &f, sizeof(f));
+            contents.push_back(0x43);
+            contents.append(encoded, sizeof(encoded));
+            break;
+        }
+        case ValType::f64:
+        {
+            const auto f = value.as<double>();
+            uint8_t encoded[sizeof(f)];
+            std::memcpy(encoded, &f, sizeof(f));
+            contents.push_back(0x44);
+            contents.append(encoded, sizeof(encoded));
+            break;
+        }
+        case ValType::v128:
+        {
+            // v128.const with the low half first.
+            const uint64_t halves[]{value.i64, values[slot - 1].i64};
+            uint8_t encoded[sizeof(halves)];
+            std::memcpy(encoded, halves, sizeof(halves));
+            contents.push_back(0xfd);
+            append_leb128u(contents, static_cast<uint32_t>(SimdInstr::v128_const));
+            contents.append(encoded, sizeof(encoded));
+            break;
+        }
+        }
+        contents.push_back(0x0b);
+    }
+    return contents;
+}
+
+bytes encode_export_section(const std::vector<Export>& exports, std::string_view skipped_function)
+{
+    bytes contents;
+    uint32_t count = 0;
+    for (const auto& e : exports)
+    {
+        if (e.kind == ExternalKind::Function && e.name == skipped_function)
+            continue;
+        append_leb128u(contents, e.name.size());
+        contents.append(reinterpret_cast<const uint8_t*>(e.name.data()), e.name.size());
+        contents.push_back(static_cast<uint8_t>(e.kind));
+        append_leb128u(contents, e.index);
+        ++count;
+    }
+
+    bytes section;
+    append_leb128u(section, count);
+    return section + contents;
+}
+
+/// Encodes the non-zero contents of the memory as active data segments.
+bytes encode_data_section(bytes_view memory)
+{
+    bytes contents;
+    uint32_t count = 0;
+
+    size_t pos = 0;
+    while (true)
+    {
+        while (pos < memory.size() && memory[pos] == 0)
+            ++pos;
+        if (pos == memory.size())
+            break;
+
+        const auto begin = pos;
+        auto end = pos;
+        while (pos < memory.size())
+        {
+            if (memory[pos] != 0)
+                end = ++pos;
+            else if (pos - end >= DataSegmentMinGap)
+                break;
+            else
+                ++pos;
+        }
+
+        contents.push_back(0x00);  // Memory index 0 with offset expression.
+        contents.push_back(0x41);
+        append_leb128s(contents, static_cast<int32_t>(begin));
+        contents.push_back(0x0b);
+        append_leb128u(contents, end - begin);
+        contents.append(memory.substr(begin, end - begin));
+        ++count;
+    }
+
+    bytes section;
+    append_leb128u(section, count);
+    return section + contents;
+}
+}  // namespace
+
+bytes preinitialize(bytes_view wasm_binary, std::string_view init_function_name,
+    std::vector<ExternalFunction> imported_functions, std::vector<ExternalGlobal> imported_globals,
+    uint32_t memory_pages_limit)
+{
+    std::shared_ptr<const Module> module = parse(wasm_binary);
+    if (!module->imported_memory_types.empty())
+        throw instantiate_error{"pre-initialization of modules importing memory is not supported"};
+    // The data segments are replaced, so the indices used by memory.init and data.drop would break.
+    if (module->datacount.has_value() ||
+        std::any_of(module->datasec.begin(), module->datasec.end(),
+            [](const Data& data) { return data.passive; }))
+    {
+        throw instantiate_error{
+            "pre-initialization of modules with passive data segments is not supported"};
+    }
+
+    const auto instance = instantiate(module, std::move(imported_functions), {}, {},
+        std::move(imported_globals), memory_pages_limit);
+
+    const auto init_func_idx = find_exported_function_index(*module, init_function_name);
+    if (init_func_idx.has_value())
+    {
+        const auto& type = module->get_function_type(*init_func_idx);
+        if (!type.inputs.empty() || !type.outputs.empty())
+            throw instantiate_error{"initialization function must have no parameters and results"};
+
+        if (execute(*instance, *init_func_idx, nullptr).trapped)
+            throw instantiate_error{"initialization function failed to execute"};
+    }
+
+    // The input is valid, so the section headers need no checks.
+    bytes output{wasm_binary.substr(0, 8)};
+    bool data_written = false;
+    const auto write_data_section = [&] {
+        if (instance->memory != nullptr)
+            append_section(output, SectionId::data, encode_data_section(*instance->memory));
+        data_written = true;
+    };
+
+    const auto* pos = wasm_binary.data() + 8;
+    const auto* const end = wasm_binary.data() + wasm_binary.size();
+    while (pos != end)
+    {
+        const auto* const section_begin = pos;
+        const auto id = static_cast<SectionId>(*pos++);
+        uint32_t size;
+        std::tie(size, pos) = leb128u_decode<uint32_t>(pos, end);
+        pos += size;
+
+        switch (id)
+        {
+        case SectionId::memory:
+            if (!module->memorysec.empty())
+            {
+                const auto pages = static_cast<uint32_t>(instance->memory->size() / PageSize);
+                append_section(output, id, encode_memory_section(module->memorysec[0], pages));
+            }
+            break;
+        case SectionId::global:
+            append_section(output, id, encode_global_section(module->globalsec, instance->globals));
+            break;
+        case SectionId::export_:
+            append_section(
+                output, id, encode_export_section(module->exportsec, init_function_name));
+            break;
+        case SectionId::start:
+            break;
+        case SectionId::code:
+            output.append(section_begin, static_cast<size_t>(pos - section_begin));
+            write_data_section();
+            break;
+        case SectionId::data:
+            if (!data_written)
+                write_data_section();
+            break;
+        default:
+            output.append(section_begin, static_cast<size_t>(pos - section_begin));
+            break;
+        }
+    }
+
+    if (!data_written)
+        write_data_section();
+
+    return output;
+}
+}  // namespace fizzy
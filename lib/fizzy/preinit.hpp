@@ -0,0 +1,39 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include "instantiate.hpp"
+#include <string_view>
+#include <vector>
+
+namespace fizzy
+{
+/// The name of the exported function called by preinitialize() by default.
+constexpr std::string_view DefaultInitFunctionName = "_initialize";
+
+/// Pre-initializes the module: instantiates it, runs its start function and the exported
+/// initialization function, and returns the new WebAssembly binary with the resulting state
+/// baked in, so instantiating it skips the initialization.
+///
+/// The output module has:
+/// - the memory section with the minimum size of the memory after initialization,
+/// - the global section with the values of the globals after initialization as constant
+///   initializers,
+/// - the data section with the non-zero contents of the memory,
+/// - no start section and no export of the initialization function.
+/// All other sections are copied unchanged.
+///
+/// The initialization function is optional, but if exported it must have no parameters and no
+/// results. Modules importing memory or using passive data segments are not supported.
+/// Modifications of imported globals and side effects of imported functions are not captured.
+///
+/// Throws parser_error or validation_error if the input is invalid, and instantiate_error if
+/// instantiation or initialization fails.
+bytes preinitialize(bytes_view wasm_binary, std::string_view init_function_name,
+    std::vector<ExternalFunction> imported_functions = {},
+    std::vector<ExternalGlobal> imported_globals = {},
+    uint32_t memory_pages_limit = DefaultMemoryPagesLimit);
+}  // namespace fizzy
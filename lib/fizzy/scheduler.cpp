@@ -0,0 +1,170 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "scheduler.hpp"
+#include "suspend.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace fizzy
+{
+Scheduler::Scheduler(SchedulerConfig config) : m_config{config}
+{
+    assert(m_config.num_threads > 0);
+    assert(m_config.quantum > 0);
+
+    m_workers.reserve(m_config.num_threads);
+    for (unsigned i = 0; i < m_config.num_threads; ++i)
+        m_workers.emplace_back(&Scheduler::worker_loop, this);
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        const std::lock_guard lock{m_mutex};
+        m_stopping = true;
+    }
+    m_ready_cv.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+
+    // The workers have re-queued the executions they have been running.
+    for (auto& tenant : m_tenants)
+    {
+        for (auto& jobs : tenant.ready)
+        {
+            for (auto& job : jobs)
+            {
+                job->ctx.suspendable_execution.reset();
+                job->promise.set_value(Trap);
+            }
+        }
+    }
+}
+
+Scheduler::TenantId Scheduler::add_tenant(int64_t quota)
+{
+    const std::lock_guard lock{m_mutex};
+    m_tenants.emplace_back().quota = quota;
+    return static_cast<TenantId>(m_tenants.size() - 1);
+}
+
+int64_t Scheduler::remaining_quota(TenantId tenant)
+{
+    const std::lock_guard lock{m_mutex};
+    return m_tenants[tenant].quota;
+}
+
+std::future<ExecutionResult> Scheduler::submit(TenantId tenant, Priority priority,
+    Instance& instance, FuncIdx func_idx, const Value* args, Value* results)
+{
+    const auto num_inputs = get_num_slots(instance.module->get_function_type(func_idx).inputs);
+    auto job = std::make_unique<Job>(
+        instance, func_idx, std::vector<Value>(args, args + num_inputs), results, tenant, priority);
+    job->ctx.metering_enabled = true;
+    job->ctx.ticks = 0;
+    auto future = job->promise.get_future();
+
+    {
+        const std::lock_guard lock{m_mutex};
+        push_ready(std::move(job));
+    }
+    m_ready_cv.notify_one();
+    return future;
+}
+
+void Scheduler::push_ready(std::unique_ptr<Job> job)
+{
+    const auto priority = static_cast<size_t>(job->priority);
+    auto& jobs = m_tenants[job->tenant].ready[priority];
+    // The tenant waits for its turn behind the tenants already having ready executions.
+    if (jobs.empty())
+        m_ready_tenants[priority].push_back(job->tenant);
+    jobs.push_back(std::move(job));
+}
+
+bool Scheduler::has_ready() const noexcept
+{
+    return std::any_of(std::begin(m_ready_tenants), std::end(m_ready_tenants),
+        [](const auto& tenants) { return !tenants.empty(); });
+}
+
+std::unique_ptr<Scheduler::Job> Scheduler::pop_ready()
+{
+    for (size_t priority = 0; priority < NumPriorities; ++priority)
+    {
+        auto& tenants = m_ready_tenants[priority];
+        if (tenants.empty())
+            continue;
+
+        const auto tenant = tenants.front();
+        tenants.pop_front();
+        auto& jobs = m_tenants[tenant].ready[priority];
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        if (!jobs.empty())
+            tenants.push_back(tenant);
+        return job;
+    }
+    return nullptr;
+}
+
+std::optional<ExecutionResult> Scheduler::run_slice(Job& job, int64_t ticks) noexcept
+{
+    auto& ctx = job.ctx;
+
+    // The ticks left negative by the paused execution are paid from the new quantum.
+    // Without any, the quota of the tenant is exhausted.
+    ctx.ticks += ticks;
+    if (ticks <= 0)
+    {
+        ctx.suspendable_execution.reset();
+        return Trap;
+    }
+
+    const auto result = job.started ? resume(ctx, nullptr) :
+                                      execute_suspendable(job.instance, job.func_idx,
+                                          job.args.data(), job.results, ctx);
+    job.started = true;
+    if (!result.suspended)
+        return result;
+    if (ctx.ticks < 0)
+        return std::nullopt;
+
+    // Suspended by a host function, which is not supported.
+    ctx.suspendable_execution.reset();
+    return Trap;
+}
+
+void Scheduler::worker_loop()
+{
+    std::unique_lock lock{m_mutex};
+    while (true)
+    {
+        m_ready_cv.wait(lock, [this] { return m_stopping || has_ready(); });
+        if (m_stopping)
+            return;
+
+        auto job = pop_ready();
+        auto& quota = m_tenants[job->tenant].quota;
+        const auto ticks = std::min(m_config.quantum, quota);
+        quota -= ticks;
+        lock.unlock();
+
+        const auto result = run_slice(*job, ticks);
+
+        lock.lock();
+        if (!result.has_value())
+        {
+            push_ready(std::move(job));
+            continue;
+        }
+
+        // The ticks left by the finished execution are given back to its tenant.
+        m_tenants[job->tenant].quota += std::max(job->ctx.ticks, int64_t{0});
+        job->promise.set_value(*result);
+    }
+}
+}  // namespace fizzy
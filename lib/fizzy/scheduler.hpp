@@ -0,0 +1,161 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "execute.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace fizzy
+{
+/// The priority class of a scheduled execution, see Scheduler.
+enum class Priority : uint8_t
+{
+    high,
+    normal,
+    low,
+};
+
+/// The configuration of Scheduler.
+struct SchedulerConfig
+{
+    /// The number of worker threads running the executions.
+    unsigned num_threads = 1;
+
+    /// The number of ticks an execution runs for before it is paused and re-queued.
+    int64_t quantum = 100000;
+};
+
+/// Runs many executions on a fixed number of worker threads, time-slicing them with metering.
+///
+/// Each execution is started with execute_suspendable() with metering enabled and runs for
+/// a quantum of ticks. Running out of ticks pauses it instead of trapping, and it is re-queued
+/// behind the other ready executions, so a long-running execution does not hold a worker thread.
+/// A paused execution may be continued by any worker thread.
+///
+/// The next execution is taken from the highest priority class having a ready one, so the lower
+/// classes run only when the higher ones have nothing to run. Within a class the tenants take
+/// turns, one quantum each, and the executions of a tenant take turns in the order they have been
+/// queued, so a tenant submitting many executions does not delay the other tenants.
+///
+/// Each tenant has a quota of ticks its executions may consume in total. The quantum is charged
+/// to the quota when it starts, and the ticks left by a finished execution are given back.
+/// An execution of a tenant with the quota exhausted traps, as if it ran out of ticks.
+///
+/// The host functions must not suspend the scheduled executions, see Suspended. An execution
+/// suspended this way is cancelled and traps.
+///
+/// All the methods are thread-safe.
+class Scheduler
+{
+    /// The number of priority classes.
+    static constexpr size_t NumPriorities = 3;
+
+    struct Job
+    {
+        Instance& instance;
+        const FuncIdx func_idx;
+        const std::vector<Value> args;
+        Value* const results;
+        const uint32_t tenant;
+        const Priority priority;
+
+        /// Set once the execution has been started with execute_suspendable().
+        bool started = false;
+        ExecutionContext ctx;
+        std::promise<ExecutionResult> promise;
+
+        Job(Instance& _instance, FuncIdx _func_idx, std::vector<Value> _args, Value* _results,
+            uint32_t _tenant, Priority _priority) noexcept
+          : instance{_instance},
+            func_idx{_func_idx},
+            args(std::move(_args)),
+            results{_results},
+            tenant{_tenant},
+            priority{_priority}
+        {}
+    };
+
+    struct Tenant
+    {
+        /// The ticks the executions of the tenant may still consume.
+        int64_t quota = 0;
+
+        /// The ready executions of the tenant, in each priority class.
+        std::deque<std::unique_ptr<Job>> ready[NumPriorities];
+    };
+
+    SchedulerConfig m_config;
+
+    /// The tenants, indexed by TenantId. They are never removed.
+    std::deque<Tenant> m_tenants;
+
+    /// The tenants having a ready execution, in each priority class, in the order of their turns.
+    std::deque<uint32_t> m_ready_tenants[NumPriorities];
+
+    std::mutex m_mutex;
+    std::condition_variable m_ready_cv;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
+
+    /// Queues the ready execution behind the other ones of its tenant and priority class.
+    void push_ready(std::unique_ptr<Job> job);
+
+    /// Checks if there is a ready execution.
+    bool has_ready() const noexcept;
+
+    /// Takes the execution to run next, or returns nullptr if there is no ready one.
+    std::unique_ptr<Job> pop_ready();
+
+    /// Runs the execution for the given number of ticks, and returns its result, or nullopt
+    /// if it has been paused.
+    static std::optional<ExecutionResult> run_slice(Job& job, int64_t ticks) noexcept;
+
+    void worker_loop();
+
+public:
+    /// The identifier of a tenant, see add_tenant().
+    using TenantId = uint32_t;
+
+    /// Starts the worker threads.
+    explicit Scheduler(SchedulerConfig config = {});
+
+    /// Stops the worker threads after their current quanta. The executions not finished by then
+    /// are cancelled and end with Trap.
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /// Adds a tenant with the quota of ticks its executions may consume in total.
+    TenantId add_tenant(int64_t quota = std::numeric_limits<int64_t>::max());
+
+    /// Returns the ticks the executions of the tenant may still consume.
+    int64_t remaining_quota(TenantId tenant);
+
+    /// Queues the execution of a function, like execute_suspendable().
+    ///
+    /// @param  tenant      The tenant, whose quota the execution consumes.
+    /// @param  priority    The priority class.
+    /// @param  instance    The instance. It must stay alive until the execution is finished.
+    ///                     The execution may run on any worker thread, so the instance must not
+    ///                     be used by other executions until then.
+    /// @param  func_idx    The function index, as in execute().
+    /// @param  args        The pointer to the arguments, as in execute(). They are copied.
+    /// @param  results     The pointer to the array for the results, as in execute() with results.
+    ///                     It must stay valid until the execution is finished.
+    /// @return             The future of the result of the execution: Void or Trap.
+    std::future<ExecutionResult> submit(TenantId tenant, Priority priority, Instance& instance,
+        FuncIdx func_idx, const Value* args, Value* results);
+};
+}  // namespace fizzy
@@ -0,0 +1,410 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+/// The kernels of the SIMD instructions operating on the lanes of v128 values.
+///
+/// The v128 values are represented by the vector extension types of GCC and Clang, so the lane-wise
+/// arithmetic, bitwise and comparison operators compile to the SIMD instructions of the target.
+/// The operations with no operator are implemented with the SSE intrinsics when the target
+/// supports them, and with the lane-wise loops otherwise.
+namespace fizzy::simd
+{
+using i8x16 = int8_t __attribute__((vector_size(16)));
+using u8x16 = uint8_t __attribute__((vector_size(16)));
+using i16x8 = int16_t __attribute__((vector_size(16)));
+using u16x8 = uint16_t __attribute__((vector_size(16)));
+using i32x4 = int32_t __attribute__((vector_size(16)));
+using u32x4 = uint32_t __attribute__((vector_size(16)));
+using i64x2 = int64_t __attribute__((vector_size(16)));
+using u64x2 = uint64_t __attribute__((vector_size(16)));
+using f32x4 = float __attribute__((vector_size(16)));
+using f64x2 = double __attribute__((vector_size(16)));
+
+/// The type of the lanes of the vector type.
+template <typename V>
+using lane_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<V&>()[0])>>;
+
+/// The number of the lanes of the vector type.
+template <typename V>
+inline constexpr size_t num_lanes = sizeof(V) / sizeof(lane_t<V>);
+
+/// Reinterprets the bits of the v128 value as another vector type.
+template <typename DstV, typename SrcV>
+inline DstV as(SrcV v) noexcept
+{
+    static_assert(sizeof(DstV) == 16 && sizeof(SrcV) == 16);
+    DstV r;
+    __builtin_memcpy(&r, &v, sizeof(r));
+    return r;
+}
+
+/// Returns the vector with all the lanes set to the value.
+template <typename V>
+inline V splat(lane_t<V> value) noexcept
+{
+    V r;
+    for (size_t i = 0; i < num_lanes<V>; ++i)
+        r[i] = value;
+    return r;
+}
+
+/// Applies the scalar operation to each lane.
+template <typename V, typename Op>
+inline V map(V a, Op op) noexcept
+{
+    V r;
+    for (size_t i = 0; i < num_lanes<V>; ++i)
+        r[i] = op(a[i]);
+    return r;
+}
+
+/// Applies the scalar operation to each pair of the lanes at the same position.
+template <typename V, typename Op>
+inline V map(V a, V b, Op op) noexcept
+{
+    V r;
+    for (size_t i = 0; i < num_lanes<V>; ++i)
+        r[i] = op(a[i], b[i]);
+    return r;
+}
+
+/// The lane-wise floating-point division, where the division by 0 is defined by IEEE 754.
+template <typename V>
+__attribute__((no_sanitize("float-divide-by-zero"))) inline V fdiv(V a, V b) noexcept
+{
+    return a / b;
+}
+
+/// The lane-wise absolute value of signed integers, returned as the unsigned lanes, so
+/// the minimal value is its own absolute value, as in WebAssembly.
+template <typename UnsignedV, typename V>
+inline UnsignedV abs(V a) noexcept
+{
+    const auto u = as<UnsignedV>(a);
+    return a < 0 ? -u : u;
+}
+
+/// Widens the lanes of the low half of the vector to the lanes of double width.
+template <typename DstV, typename SrcV>
+inline DstV extend_low(SrcV v) noexcept
+{
+    static_assert(num_lanes<SrcV> == 2 * num_lanes<DstV>);
+    DstV r;
+    for (size_t i = 0; i < num_lanes<DstV>; ++i)
+        r[i] = v[i];
+    return r;
+}
+
+/// Widens the lanes of the high half of the vector to the lanes of double width.
+template <typename DstV, typename SrcV>
+inline DstV extend_high(SrcV v) noexcept
+{
+    static_assert(num_lanes<SrcV> == 2 * num_lanes<DstV>);
+    DstV r;
+    for (size_t i = 0; i < num_lanes<DstV>; ++i)
+        r[i] = v[num_lanes<DstV> + i];
+    return r;
+}
+
+/// Adds the pairs of the adjacent lanes to the lanes of double width.
+template <typename DstV, typename SrcV>
+inline DstV extadd_pairwise(SrcV v) noexcept
+{
+    static_assert(num_lanes<SrcV> == 2 * num_lanes<DstV>);
+    using DstLaneT = lane_t<DstV>;
+    DstV r;
+    for (size_t i = 0; i < num_lanes<DstV>; ++i)
+        r[i] = static_cast<DstLaneT>(DstLaneT{v[2 * i]} + DstLaneT{v[2 * i + 1]});
+    return r;
+}
+
+#if defined(__SSE2__)
+template <typename V>
+inline __m128i to_m128i(V v) noexcept
+{
+    __m128i r;
+    __builtin_memcpy(&r, &v, sizeof(r));
+    return r;
+}
+
+template <typename V>
+inline V from_m128i(__m128i v) noexcept
+{
+    V r;
+    __builtin_memcpy(&r, &v, sizeof(r));
+    return r;
+}
+#endif
+
+/// Saturates the integer value to the range of the lane type.
+template <typename LaneT>
+inline constexpr LaneT saturate(int32_t value) noexcept
+{
+    return static_cast<LaneT>(std::clamp<int32_t>(value, std::numeric_limits<LaneT>::min(),
+        std::numeric_limits<LaneT>::max()));
+}
+
+/// The lane-wise saturating addition and subtraction of 8-bit and 16-bit integers.
+template <typename V>
+inline V add_sat(V a, V b) noexcept
+{
+    using LaneT = lane_t<V>;
+    return map(a, b, [](LaneT x, LaneT y) { return saturate<LaneT>(int32_t{x} + int32_t{y}); });
+}
+
+template <typename V>
+inline V sub_sat(V a, V b) noexcept
+{
+    using LaneT = lane_t<V>;
+    return map(a, b, [](LaneT x, LaneT y) { return saturate<LaneT>(int32_t{x} - int32_t{y}); });
+}
+
+/// The lane-wise unsigned rounding average (a + b + 1) / 2.
+template <typename V>
+inline V avgr(V a, V b) noexcept
+{
+    using LaneT = lane_t<V>;
+    static_assert(std::is_unsigned_v<LaneT>);
+    return map(a, b, [](LaneT x, LaneT y) {
+        return static_cast<LaneT>((uint32_t{x} + uint32_t{y} + 1) / 2);
+    });
+}
+
+/// Narrows the lanes of a and b (in this order) to the lanes of half width, saturating them
+/// to the range of the destination lane type.
+template <typename DstV, typename SrcV>
+inline DstV narrow(SrcV a, SrcV b) noexcept
+{
+    static_assert(num_lanes<DstV> == 2 * num_lanes<SrcV>);
+    using DstLaneT = lane_t<DstV>;
+    DstV r;
+    for (size_t i = 0; i < num_lanes<SrcV>; ++i)
+    {
+        r[i] = saturate<DstLaneT>(a[i]);
+        r[num_lanes<SrcV> + i] = saturate<DstLaneT>(b[i]);
+    }
+    return r;
+}
+
+#if defined(__SSE2__)
+inline i8x16 add_sat(i8x16 a, i8x16 b) noexcept
+{
+    return from_m128i<i8x16>(_mm_adds_epi8(to_m128i(a), to_m128i(b)));
+}
+
+inline u8x16 add_sat(u8x16 a, u8x16 b) noexcept
+{
+    return from_m128i<u8x16>(_mm_adds_epu8(to_m128i(a), to_m128i(b)));
+}
+
+inline i16x8 add_sat(i16x8 a, i16x8 b) noexcept
+{
+    return from_m128i<i16x8>(_mm_adds_epi16(to_m128i(a), to_m128i(b)));
+}
+
+inline u16x8 add_sat(u16x8 a, u16x8 b) noexcept
+{
+    return from_m128i<u16x8>(_mm_adds_epu16(to_m128i(a), to_m128i(b)));
+}
+
+inline i8x16 sub_sat(i8x16 a, i8x16 b) noexcept
+{
+    return from_m128i<i8x16>(_mm_subs_epi8(to_m128i(a), to_m128i(b)));
+}
+
+inline u8x16 sub_sat(u8x16 a, u8x16 b) noexcept
+{
+    return from_m128i<u8x16>(_mm_subs_epu8(to_m128i(a), to_m128i(b)));
+}
+
+inline i16x8 sub_sat(i16x8 a, i16x8 b) noexcept
+{
+    return from_m128i<i16x8>(_mm_subs_epi16(to_m128i(a), to_m128i(b)));
+}
+
+inline u16x8 sub_sat(u16x8 a, u16x8 b) noexcept
+{
+    return from_m128i<u16x8>(_mm_subs_epu16(to_m128i(a), to_m128i(b)));
+}
+
+inline u8x16 avgr(u8x16 a, u8x16 b) noexcept
+{
+    return from_m128i<u8x16>(_mm_avg_epu8(to_m128i(a), to_m128i(b)));
+}
+
+inline u16x8 avgr(u16x8 a, u16x8 b) noexcept
+{
+    return from_m128i<u16x8>(_mm_avg_epu16(to_m128i(a), to_m128i(b)));
+}
+
+template <>
+inline i8x16 narrow<i8x16>(i16x8 a, i16x8 b) noexcept
+{
+    return from_m128i<i8x16>(_mm_packs_epi16(to_m128i(a), to_m128i(b)));
+}
+
+template <>
+inline u8x16 narrow<u8x16>(i16x8 a, i16x8 b) noexcept
+{
+    return from_m128i<u8x16>(_mm_packus_epi16(to_m128i(a), to_m128i(b)));
+}
+
+template <>
+inline i16x8 narrow<i16x8>(i32x4 a, i32x4 b) noexcept
+{
+    return from_m128i<i16x8>(_mm_packs_epi32(to_m128i(a), to_m128i(b)));
+}
+#endif
+
+#if defined(__SSE4_1__)
+template <>
+inline u16x8 narrow<u16x8>(i32x4 a, i32x4 b) noexcept
+{
+    return from_m128i<u16x8>(_mm_packus_epi32(to_m128i(a), to_m128i(b)));
+}
+#endif
+
+/// Selects the lanes of a by the indices in s. The indices out of range select 0.
+inline u8x16 swizzle(u8x16 a, u8x16 s) noexcept
+{
+#if defined(__SSSE3__)
+    // The saturating addition sets the highest bit of the indices out of range,
+    // which makes pshufb select 0.
+    const auto indices = _mm_adds_epu8(to_m128i(s), _mm_set1_epi8(0x70));
+    return from_m128i<u8x16>(_mm_shuffle_epi8(to_m128i(a), indices));
+#else
+    u8x16 r;
+    for (size_t i = 0; i < 16; ++i)
+        r[i] = s[i] < 16 ? a[s[i]] : uint8_t{0};
+    return r;
+#endif
+}
+
+/// Selects the lanes of the concatenation of a and b by the indices in s, all less than 32.
+inline u8x16 shuffle(u8x16 a, u8x16 b, const uint8_t* s) noexcept
+{
+    u8x16 r;
+    for (size_t i = 0; i < 16; ++i)
+        r[i] = s[i] < 16 ? a[s[i]] : b[s[i] - 16];
+    return r;
+}
+
+/// The lane-wise signed Q15 multiplication with rounding and saturation.
+inline i16x8 q15mulr_sat(i16x8 a, i16x8 b) noexcept
+{
+#if defined(__SSSE3__)
+    // pmulhrsw differs only by wrapping 0x8000 * 0x8000 to 0x8000, where 0x7fff is expected.
+    const auto r = _mm_mulhrs_epi16(to_m128i(a), to_m128i(b));
+    return from_m128i<i16x8>(_mm_xor_si128(r, _mm_cmpeq_epi16(r, _mm_set1_epi16(-0x8000))));
+#else
+    return map(a, b, [](int16_t x, int16_t y) {
+        return saturate<int16_t>((int32_t{x} * int32_t{y} + 0x4000) >> 15);
+    });
+#endif
+}
+
+/// Multiplies the signed 16-bit lanes and adds the pairs of the adjacent 32-bit products.
+inline i32x4 dot(i16x8 a, i16x8 b) noexcept
+{
+#if defined(__SSE2__)
+    return from_m128i<i32x4>(_mm_madd_epi16(to_m128i(a), to_m128i(b)));
+#else
+    i32x4 r;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        // The sum of the two products of -0x8000 wraps around.
+        const auto p1 = static_cast<uint32_t>(int32_t{a[2 * i]} * int32_t{b[2 * i]});
+        const auto p2 = static_cast<uint32_t>(int32_t{a[2 * i + 1]} * int32_t{b[2 * i + 1]});
+        r[i] = static_cast<int32_t>(p1 + p2);
+    }
+    return r;
+#endif
+}
+
+/// Collects the sign bits of the lanes into an integer, lane 0 in the lowest bit.
+template <typename V>
+inline uint32_t bitmask(V v) noexcept
+{
+    uint32_t r = 0;
+    for (size_t i = 0; i < num_lanes<V>; ++i)
+        r |= uint32_t{v[i] < 0} << i;
+    return r;
+}
+
+/// Checks if all the lanes are non-zero.
+template <typename V>
+inline bool all_true(V v) noexcept
+{
+    for (size_t i = 0; i < num_lanes<V>; ++i)
+    {
+        if (v[i] == 0)
+            return false;
+    }
+    return true;
+}
+
+#if defined(__SSE2__)
+inline uint32_t bitmask(i8x16 v) noexcept
+{
+    return static_cast<uint32_t>(_mm_movemask_epi8(to_m128i(v)));
+}
+
+inline uint32_t bitmask(i16x8 v) noexcept
+{
+    // The saturating narrowing keeps the sign bits.
+    const auto packed = _mm_packs_epi16(to_m128i(v), _mm_setzero_si128());
+    return static_cast<uint32_t>(_mm_movemask_epi8(packed));
+}
+
+inline uint32_t bitmask(i32x4 v) noexcept
+{
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(to_m128i(v))));
+}
+
+inline uint32_t bitmask(i64x2 v) noexcept
+{
+    return static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(to_m128i(v))));
+}
+
+inline bool all_true(i8x16 v) noexcept
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(to_m128i(v), _mm_setzero_si128())) == 0;
+}
+
+inline bool all_true(i16x8 v) noexcept
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi16(to_m128i(v), _mm_setzero_si128())) == 0;
+}
+
+inline bool all_true(i32x4 v) noexcept
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(to_m128i(v), _mm_setzero_si128())) == 0;
+}
+#endif
+
+/// Checks if any bit of the v128 value is set.
+inline bool any_true(u64x2 v) noexcept
+{
+    return (v[0] | v[1]) != 0;
+}
+}  // namespace fizzy::simd
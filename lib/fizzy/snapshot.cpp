@@ -0,0 +1,86 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "snapshot.hpp"
+#include <cassert>
+
+namespace fizzy
+{
+namespace
+{
+/// Copies the table elements, replacing the references to instance @a from with @a to.
+void copy_table(table_elements& dst, const table_elements& src, const Instance* from, Instance& to)
+{
+    dst.resize(src.size());
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        if (src[i].instance == from)
+            dst[i] = {&to, src[i].func_idx, {}};
+        else
+            dst[i] = src[i];
+    }
+}
+}  // namespace
+
+Snapshot snapshot(const Instance& instance)
+{
+    Snapshot result{
+        instance.module, &instance, {}, instance.globals, {}, instance.dropped_data_segments};
+    if (instance.memory != nullptr)
+        result.memory = *instance.memory;
+    if (instance.table != nullptr)
+        result.table = *instance.table;
+    return result;
+}
+
+void restore(Instance& instance, const Snapshot& snapshot)
+{
+    assert(instance.module == snapshot.module);
+
+    if (snapshot.memory.has_value())
+    {
+        *instance.memory = *snapshot.memory;
+        // The memory has been modified without tracking.
+        if (!instance.dirty_memory_blocks.empty())
+            instance.memory_dirty_untracked = true;
+    }
+
+    instance.globals = snapshot.globals;
+    instance.dropped_data_segments = snapshot.dropped_data_segments;
+
+    if (snapshot.table.has_value())
+        copy_table(*instance.table, *snapshot.table, snapshot.source, instance);
+}
+
+std::unique_ptr<Instance> copy_instance(const Instance& instance)
+{
+    static const auto bytes_delete = [](bytes* b) noexcept { delete b; };
+    static const auto bytes_null_delete = [](bytes*) noexcept {};
+    static const auto table_delete = [](table_elements* t) noexcept { delete t; };
+    static const auto table_null_delete = [](table_elements*) noexcept {};
+
+    const auto& module = *instance.module;
+
+    // Owned memory and table are copied, imported ones are shared.
+    bytes_ptr memory{instance.memory.get(), bytes_null_delete};
+    if (!module.memorysec.empty())
+        memory = bytes_ptr{new bytes(*instance.memory), bytes_delete};
+
+    table_ptr table{instance.table.get(), table_null_delete};
+    if (!module.tablesec.empty())
+        table = table_ptr{new table_elements, table_delete};
+
+    auto copy = std::make_unique<Instance>(instance.module, std::move(memory),
+        instance.memory_limits, instance.memory_pages_limit, std::move(table),
+        instance.table_limits, instance.globals, instance.imported_functions,
+        instance.imported_globals);
+    copy->dropped_data_segments = instance.dropped_data_segments;
+    copy->tiering = instance.tiering;
+
+    if (!module.tablesec.empty())
+        copy_table(*copy->table, *instance.table, &instance, *copy);
+
+    return copy;
+}
+}  // namespace fizzy
@@ -0,0 +1,54 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "instantiate.hpp"
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace fizzy
+{
+/// The captured state of an instance: the contents of its memory, globals and table.
+struct Snapshot
+{
+    /// Module of the snapshotted instance. The snapshot can be restored only into instances of it.
+    std::shared_ptr<const Module> module;
+
+    /// The snapshotted instance, used only to recognize the table elements referring to it.
+    /// It is never dereferenced, so the snapshot stays valid after the instance is destroyed.
+    const Instance* source = nullptr;
+
+    /// Memory contents or empty optional if the instance has no memory.
+    std::optional<bytes> memory;
+
+    /// Instance globals (excluding imported globals).
+    std::vector<Value> globals;
+
+    /// Table contents or empty optional if the instance has no table.
+    std::optional<table_elements> table;
+
+    /// The flags of the dropped data segments.
+    std::vector<bool> dropped_data_segments;
+};
+
+/// Captures the state of the instance.
+Snapshot snapshot(const Instance& instance);
+
+/// Restores the state of the instance of the same module to the snapshot.
+/// The table elements referring to the snapshotted instance are made to refer to @a instance.
+/// Imported memory and table are restored as well, so this affects other instances sharing them.
+void restore(Instance& instance, const Snapshot& snapshot);
+
+/// Creates a new instance of the same module with a copy of the state of @a instance.
+///
+/// The memory, the globals and the table owned by the instance are copied eagerly, so the cost
+/// is proportional to the size of the memory, not to the part of it the copy later modifies.
+/// The imports are shared with the original instance in the same way as if the module was
+/// instantiated with the same imports. The start function is not executed. This is meant for
+/// initializing an instance once, with all the expensive setup done by its start function or
+/// exported functions, and then creating copies of it without repeating the setup.
+std::unique_ptr<Instance> copy_instance(const Instance& instance);
+}  // namespace fizzy
@@ -13,12 +13,17 @@
 
 namespace fizzy
 {
-template <typename T>
+template <typename T, typename Allocator = std::allocator<T>>
 class Stack
 {
-    std::vector<T> m_container;
+    std::vector<T, Allocator> m_container;
 
 public:
+    Stack() = default;
+
+    /// Constructs the stack with its storage obtained from the given allocator.
+    explicit Stack(const Allocator& allocator) : m_container(allocator) {}
+
     void push(T val) { m_container.emplace_back(val); }
 
     template <typename... Args>
@@ -30,7 +35,7 @@ public:
     T pop() noexcept
     {
         assert(!m_container.empty());
-        const auto res = m_container.back();
+        auto res = std::move(m_container.back());
         m_container.pop_back();
         return res;
     }
@@ -169,10 +174,21 @@ public:
         m_top -= num;
     }
 
+    /// Increases the stack height by @a num, making the values stored above the top item,
+    /// see rend(), the new top items.
+    /// The stack max height limit is not checked.
+    void grow(size_t num) noexcept { m_top += num; }
+
     /// Returns iterator to the bottom of the stack.
     const Value* rbegin() const noexcept { return m_bottom; }
 
     /// Returns end iterator counting from the bottom of the stack.
     const Value* rend() const noexcept { return m_top + 1; }
+
+    /// Returns mutable iterator to the bottom of the stack.
+    Value* rbegin() noexcept { return m_bottom; }
+
+    /// Returns mutable end iterator counting from the bottom of the stack.
+    Value* rend() noexcept { return m_top + 1; }
 };
 }  // namespace fizzy
@@ -0,0 +1,326 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+// The ucontext functions are deprecated in macOS and declared only with this.
+#define _XOPEN_SOURCE 600
+#endif
+
+#include "suspend.hpp"
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define FIZZY_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define FIZZY_ASAN 1
+#endif
+#endif
+
+#if defined(__SANITIZE_THREAD__)
+#define FIZZY_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define FIZZY_TSAN 1
+#endif
+#endif
+
+#ifdef FIZZY_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#ifdef FIZZY_TSAN
+#include <sanitizer/tsan_interface.h>
+#endif
+
+namespace fizzy
+{
+namespace
+{
+/// The size of the native stack of a suspendable execution. It matches the common size of
+/// the main thread stack, which fits the frames up to CallStackLimit. The frames instrumented by
+/// AddressSanitizer are several times bigger. The stack is mapped without reserving swap space,
+/// so only its touched pages take memory, and many executions can be in flight at once.
+#ifdef FIZZY_ASAN
+constexpr size_t StackSize = 32 * 1024 * 1024;
+#else
+constexpr size_t StackSize = 8 * 1024 * 1024;
+#endif
+
+/// The size of the stack kept free below ExecutionContext::native_stack_limit for the frame
+/// checking the limit, the trap unwinding and the host functions called by the last frame.
+constexpr size_t StackReserve = 256 * 1024;
+
+/// The native stack with a guard page below it, so its overflow crashes instead of corrupting
+/// the memory.
+class FiberStack
+{
+    size_t m_guard_size = 0;
+    size_t m_size = 0;
+    uint8_t* m_mapping = nullptr;
+
+public:
+    FiberStack()
+      : m_guard_size{static_cast<size_t>(sysconf(_SC_PAGESIZE))},
+        m_size{StackSize},
+        m_mapping{static_cast<uint8_t*>(mmap(nullptr, m_guard_size + m_size,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0))}
+    {
+        if (m_mapping == MAP_FAILED)
+            throw std::bad_alloc{};
+        mprotect(m_mapping, m_guard_size, PROT_NONE);
+    }
+
+    FiberStack(const FiberStack&) = delete;
+    FiberStack& operator=(const FiberStack&) = delete;
+
+    ~FiberStack() noexcept { munmap(m_mapping, m_guard_size + m_size); }
+
+    uint8_t* bottom() const noexcept { return m_mapping + m_guard_size; }
+
+    size_t size() const noexcept { return m_size; }
+};
+
+/// Informs AddressSanitizer about the switch to the given stack, see
+/// https://github.com/google/sanitizers/issues/189.
+inline void start_switch_stack(
+    [[maybe_unused]] void** fake_stack, [[maybe_unused]] const void* bottom,
+    [[maybe_unused]] size_t size) noexcept
+{
+#ifdef FIZZY_ASAN
+    __sanitizer_start_switch_fiber(fake_stack, bottom, size);
+#endif
+}
+
+/// Informs AddressSanitizer that the switch started with start_switch_stack() has completed, and
+/// returns the stack switched from.
+inline void finish_switch_stack([[maybe_unused]] void* fake_stack,
+    [[maybe_unused]] const void** bottom_old, [[maybe_unused]] size_t* size_old) noexcept
+{
+#ifdef FIZZY_ASAN
+    __sanitizer_finish_switch_fiber(fake_stack, bottom_old, size_old);
+#endif
+}
+
+/// Returns the ThreadSanitizer's fiber of the running stack, or null without ThreadSanitizer.
+inline void* get_current_fiber() noexcept
+{
+#ifdef FIZZY_TSAN
+    return __tsan_get_current_fiber();
+#else
+    return nullptr;
+#endif
+}
+
+/// Creates the ThreadSanitizer's fiber for a new stack, or returns null without ThreadSanitizer.
+inline void* create_fiber() noexcept
+{
+#ifdef FIZZY_TSAN
+    return __tsan_create_fiber(0);
+#else
+    return nullptr;
+#endif
+}
+
+/// Destroys the fiber created with create_fiber().
+inline void destroy_fiber([[maybe_unused]] void* fiber) noexcept
+{
+#ifdef FIZZY_TSAN
+    __tsan_destroy_fiber(fiber);
+#endif
+}
+
+/// Informs ThreadSanitizer about the switch to the given fiber, see
+/// https://github.com/google/sanitizers/issues/1112. It must directly precede the switch.
+inline void switch_to_fiber([[maybe_unused]] void* fiber) noexcept
+{
+#ifdef FIZZY_TSAN
+    __tsan_switch_to_fiber(fiber, 0);
+#endif
+}
+}  // namespace
+
+/// The execution running on its own native stack, switched to and from with the ucontext
+/// functions. This way its frames stay on the native stack while it is suspended, and only
+/// the host functions' calls switch the stacks.
+class SuspendableExecution
+{
+    Instance& m_instance;
+    const FuncIdx m_func_idx;
+    const Value* const m_args;
+    Value* const m_results;
+    ExecutionContext& m_ctx;
+
+    FiberStack m_stack;
+    ucontext_t m_fiber_context{};
+    ucontext_t m_caller_context{};
+
+    /// The stack of the caller switching to the execution and the fake stack of the execution,
+    /// used by AddressSanitizer only.
+    const void* m_caller_stack_bottom = nullptr;
+    size_t m_caller_stack_size = 0;
+    void* m_fake_stack = nullptr;
+
+    /// The fibers of the execution and of its caller, used by ThreadSanitizer only.
+    void* m_fiber = create_fiber();
+    void* m_caller_fiber = nullptr;
+
+    /// The entry of the execution's stack. The pointer to the execution is split into two
+    /// arguments, because makecontext() passes the int arguments only.
+    static void run(uint32_t address_high, uint32_t address_low) noexcept
+    {
+        const auto address = (uint64_t{address_high} << 32) | address_low;
+        auto& execution = *reinterpret_cast<SuspendableExecution*>(static_cast<uintptr_t>(address));
+        finish_switch_stack(
+            nullptr, &execution.m_caller_stack_bottom, &execution.m_caller_stack_size);
+
+        execution.result.emplace(execute(execution.m_instance, execution.m_func_idx,
+            execution.m_args, execution.m_results, execution.m_ctx));
+
+        // The execution's stack is not switched to anymore, so its fake stack is released.
+        start_switch_stack(nullptr, execution.m_caller_stack_bottom, execution.m_caller_stack_size);
+        switch_to_fiber(execution.m_caller_fiber);
+        setcontext(&execution.m_caller_context);
+    }
+
+public:
+    /// The result of the execution, once it is finished.
+    std::optional<ExecutionResult> result;
+    /// The results of the host function passed to resume().
+    const Value* host_results = nullptr;
+    /// Set when the suspended execution is cancelled.
+    bool cancelled = false;
+
+    SuspendableExecution(Instance& instance, FuncIdx func_idx, const Value* args, Value* results,
+        ExecutionContext& ctx)
+      : m_instance{instance}, m_func_idx{func_idx}, m_args{args}, m_results{results}, m_ctx{ctx}
+    {
+        getcontext(&m_fiber_context);
+        m_fiber_context.uc_stack.ss_sp = m_stack.bottom();
+        m_fiber_context.uc_stack.ss_size = m_stack.size();
+        m_fiber_context.uc_link = nullptr;
+        const auto address = uint64_t{reinterpret_cast<uintptr_t>(this)};
+        makecontext(&m_fiber_context, reinterpret_cast<void (*)()>(&run), 2,
+            static_cast<uint32_t>(address >> 32), static_cast<uint32_t>(address));
+    }
+
+    SuspendableExecution(const SuspendableExecution&) = delete;
+    SuspendableExecution& operator=(const SuspendableExecution&) = delete;
+
+    ~SuspendableExecution() noexcept
+    {
+        // The suspended execution is resumed to unwind its frames, as suspend() returns a trap.
+        if (!result.has_value())
+        {
+            cancelled = true;
+            switch_to_execution();
+        }
+        destroy_fiber(m_fiber);
+    }
+
+    /// Runs the execution until it is finished or suspended.
+    void switch_to_execution() noexcept
+    {
+        // The stack grows down, so its overflow is detected before reaching the guard page.
+        // The limit applies only while the execution runs, not to the caller's stack.
+        const auto caller_stack_limit = m_ctx.native_stack_limit;
+        m_ctx.native_stack_limit = reinterpret_cast<uintptr_t>(m_stack.bottom()) + StackReserve;
+
+        void* caller_fake_stack = nullptr;
+        start_switch_stack(&caller_fake_stack, m_stack.bottom(), m_stack.size());
+        // The execution may be resumed from another thread.
+        m_caller_fiber = get_current_fiber();
+        switch_to_fiber(m_fiber);
+        swapcontext(&m_caller_context, &m_fiber_context);
+        finish_switch_stack(caller_fake_stack, nullptr, nullptr);
+
+        m_ctx.native_stack_limit = caller_stack_limit;
+    }
+
+    /// Suspends the execution, returning to the caller of switch_to_execution().
+    void switch_to_caller() noexcept
+    {
+        start_switch_stack(&m_fake_stack, m_caller_stack_bottom, m_caller_stack_size);
+        switch_to_fiber(m_caller_fiber);
+        swapcontext(&m_fiber_context, &m_caller_context);
+        // The execution may be resumed from another stack.
+        finish_switch_stack(m_fake_stack, &m_caller_stack_bottom, &m_caller_stack_size);
+    }
+};
+
+namespace
+{
+/// Runs the execution of the context until it is finished or suspended.
+ExecutionResult run(ExecutionContext& ctx) noexcept
+{
+    auto& execution = *ctx.suspendable_execution;
+    execution.switch_to_execution();
+    if (!execution.result.has_value())
+        return Suspended;
+
+    const auto result = *execution.result;
+    ctx.suspendable_execution.reset();
+    return result;
+}
+}  // namespace
+
+ExecutionResult execute_suspendable(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx) noexcept
+{
+    assert(ctx.suspendable_execution == nullptr);
+    try
+    {
+        ctx.suspendable_execution =
+            std::make_shared<SuspendableExecution>(instance, func_idx, args, results, ctx);
+    }
+    catch (const std::bad_alloc&)
+    {
+        // Mapping the native stack fails when the address space or memory commit is exhausted.
+        return Trap;
+    }
+    return run(ctx);
+}
+
+ExecutionResult resume(ExecutionContext& ctx, const Value* results) noexcept
+{
+    assert(ctx.suspendable_execution != nullptr);
+    ctx.suspendable_execution->host_results = results;
+    return run(ctx);
+}
+
+ExecutionResult suspend(ExecutionContext& ctx, bool has_result) noexcept
+{
+    // The execution is kept by the pointer, as the context no longer owns it when cancelling.
+    auto* const execution = ctx.suspendable_execution.get();
+    if (execution == nullptr)
+        return Trap;
+
+    execution->switch_to_caller();
+    if (execution->cancelled)
+        return Trap;
+    return has_result ? ExecutionResult{execution->host_results[0]} : Void;
+}
+
+bool pause(ExecutionContext& ctx) noexcept
+{
+    auto* const execution = ctx.suspendable_execution.get();
+    if (execution == nullptr)
+        return false;
+
+    // The ticks added before resuming may not cover the cost of the instruction.
+    while (ctx.ticks < 0)
+    {
+        execution->switch_to_caller();
+        if (execution->cancelled)
+            return false;
+    }
+    return true;
+}
+}  // namespace fizzy
@@ -0,0 +1,70 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "execute.hpp"
+
+namespace fizzy
+{
+/// Executes a function like execute() with results, but on a separate native stack, so the host
+/// functions it calls may suspend it by returning Suspended.
+///
+/// The suspended execution keeps its frames in ExecutionContext::suspendable_execution and this
+/// function returns Suspended, so the thread is not blocked while the host function waits for
+/// its asynchronous operation. The execution is continued with resume(), possibly in another
+/// thread. Destroying the context, or resetting its suspendable_execution, cancels the suspended
+/// execution, which unwinds its frames as if the host function trapped.
+///
+/// With metering enabled, the execution running out of ticks is paused instead of trapped: it is
+/// suspended in the same way, leaving ExecutionContext::ticks negative. The caller adds ticks and
+/// continues it with resume(), so a long-running execution can be time-sliced, see Scheduler.
+///
+/// @param  instance    The instance. It must stay alive until the execution is finished or
+///                     cancelled.
+/// @param  func_idx    The function index, as in execute().
+/// @param  args        The pointer to the arguments, as in execute(). They are copied before
+///                     the first suspension.
+/// @param  results     The pointer to the array for the results, as in execute() with results.
+///                     It must stay valid until the execution is finished.
+/// @param  ctx         Execution context. It must not have a suspended execution already.
+/// @return             Void, Trap, Interrupted, or Suspended if a host function has suspended
+///                     the execution or it has run out of ticks. Trap is also returned if
+///                     the native stack of the execution cannot be allocated.
+ExecutionResult execute_suspendable(Instance& instance, FuncIdx func_idx, const Value* args,
+    Value* results, ExecutionContext& ctx) noexcept;
+
+/// Resumes the execution suspended in the context.
+///
+/// It must not be called before the execute_suspendable() or resume() returning Suspended has
+/// returned, so the host function completing its operation in another thread must synchronize
+/// with the thread which has suspended the execution, e.g. by posting the completion to it.
+///
+/// @param  ctx         The execution context with the suspended execution.
+/// @param  results     The pointer to the results of the host function which has suspended
+///                     the execution. It may be null if the function has no outputs, or if
+///                     the execution has run out of ticks.
+/// @return             The result of the execution as in execute_suspendable(), which may be
+///                     Suspended again.
+ExecutionResult resume(ExecutionContext& ctx, const Value* results) noexcept;
+
+/// Suspends the execution running in the context after a host function has returned Suspended.
+/// This is used by execute() and switches back to the caller of execute_suspendable() or
+/// resume().
+///
+/// @param  ctx         The execution context.
+/// @param  has_result  Whether the host function has a result.
+/// @return             The result of the host function passed to resume(), or Trap if
+///                     the execution is not suspendable or has been cancelled.
+ExecutionResult suspend(ExecutionContext& ctx, bool has_result) noexcept;
+
+/// Pauses the execution running in the context after it has run out of ticks. This is used by
+/// execute() and switches back to the caller of execute_suspendable() or resume() until
+/// the execution is resumed with non-negative ticks.
+///
+/// @param  ctx         The execution context.
+/// @return             True if the execution may continue, false if it is not suspendable or has
+///                     been cancelled, so it traps.
+bool pause(ExecutionContext& ctx) noexcept;
+}  // namespace fizzy
@@ -0,0 +1,201 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "tiering.hpp"
+#include "parser.hpp"
+#include <cstring>
+
+namespace fizzy
+{
+namespace
+{
+/// Returns the size of the instruction in the code with immediates of the given size.
+size_t get_instruction_size(const uint8_t* instr, uint8_t immediate_size) noexcept
+{
+    const auto [count, value_size] = get_immediates_layout(instr, immediate_size);
+    return 1 + size_t{count} * immediate_size + value_size;
+}
+
+/// Reads the immediate of the given size.
+uint32_t read_immediate(const uint8_t* pos, uint8_t immediate_size) noexcept
+{
+    if (immediate_size == sizeof(uint8_t))
+        return *pos;
+    if (immediate_size == sizeof(uint16_t))
+    {
+        uint16_t value;
+        std::memcpy(&value, pos, sizeof(value));
+        return value;
+    }
+    uint32_t value;
+    std::memcpy(&value, pos, sizeof(value));
+    return value;
+}
+
+/// Returns the flags of the code offsets being branch targets.
+std::vector<bool> find_branch_targets(bytes_view instructions, uint8_t immediate_size)
+{
+    std::vector<bool> targets(instructions.size() + 1);
+    const auto* const end = instructions.data() + instructions.size();
+    for (const auto* pos = instructions.data(); pos != end;)
+    {
+        const auto opcode = *pos;
+        const auto count = get_immediates_layout(pos, immediate_size).first;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (is_code_offset_immediate(opcode, i))
+                targets[read_immediate(pos + 1 + i * immediate_size, immediate_size)] = true;
+        }
+        pos += get_instruction_size(pos, immediate_size);
+    }
+    return targets;
+}
+
+/// Returns the superinstruction replacing the pair of instructions, or nop if there is none.
+Instr get_superinstruction(Instr first, Instr second) noexcept
+{
+    if (first == Instr::i32_const && (second == Instr::i32_add || second == Instr::i32_sub))
+        return Instr::i32_add_imm;
+    if (first == Instr::i32_eqz && second == Instr::br_if)
+        return Instr::i32_eqz_br_if;
+    if (first == Instr::local_get && second == Instr::local_get)
+        return Instr::local_get_local_get;
+    return Instr::nop;
+}
+}  // namespace
+
+bytes optimize_instructions(bytes_view instructions, uint8_t immediate_size)
+{
+    bytes optimized{instructions};
+    const auto targets = find_branch_targets(instructions, immediate_size);
+
+    size_t pos = 0;
+    while (pos != optimized.size())
+    {
+        const auto first = static_cast<Instr>(optimized[pos]);
+        const auto second_pos = pos + get_instruction_size(&optimized[pos], immediate_size);
+        if (second_pos == optimized.size())
+            break;
+
+        const auto second = static_cast<Instr>(optimized[second_pos]);
+        const auto superinstruction = get_superinstruction(first, second);
+
+        // The second instruction is skipped by the superinstruction, so it cannot be jumped to.
+        if (superinstruction == Instr::nop || targets[second_pos])
+        {
+            pos = second_pos;
+            continue;
+        }
+
+        optimized[pos] = static_cast<uint8_t>(superinstruction);
+        if (second == Instr::i32_sub)
+        {
+            uint32_t value;
+            std::memcpy(&value, &optimized[pos + 1], sizeof(value));
+            value = 0 - value;
+            std::memcpy(&optimized[pos + 1], &value, sizeof(value));
+        }
+        pos = second_pos + get_instruction_size(&optimized[second_pos], immediate_size);
+    }
+    return optimized;
+}
+
+TieringManager::TieringManager(std::shared_ptr<const Module> module, TieringConfig config)
+  : m_module{std::move(module)},
+    m_config{config},
+    m_num_imported_functions{static_cast<uint32_t>(m_module->imported_function_types.size())},
+    m_call_counts(m_module->codesec.size()),
+    m_back_edge_counts(m_module->codesec.size()),
+    m_promoted(m_module->codesec.size()),
+    m_optimized(m_module->codesec.size()),
+    m_optimized_storage(m_module->codesec.size())
+{
+    for (size_t i = 0; i < m_module->codesec.size(); ++i)
+    {
+        m_call_counts[i].store(0, std::memory_order_relaxed);
+        m_back_edge_counts[i].store(0, std::memory_order_relaxed);
+        m_promoted[i].store(false, std::memory_order_relaxed);
+        m_optimized[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    if (m_config.background)
+        m_worker = std::thread{&TieringManager::worker_loop, this};
+}
+
+TieringManager::~TieringManager()
+{
+    if (m_worker.joinable())
+    {
+        {
+            const std::lock_guard lock{m_queue_mutex};
+            m_stopping = true;
+        }
+        m_queue_cv.notify_all();
+        m_worker.join();
+    }
+}
+
+void TieringManager::promote(uint32_t code_idx)
+{
+    if (m_promoted[code_idx].exchange(true))
+        return;
+
+    if (!m_config.background)
+    {
+        optimize(code_idx);
+        return;
+    }
+
+    {
+        const std::lock_guard lock{m_queue_mutex};
+        m_queue.push_back(code_idx);
+    }
+    m_queue_cv.notify_all();
+}
+
+void TieringManager::optimize(uint32_t code_idx)
+{
+    const auto& code = m_module->codesec[code_idx];
+    auto optimized = std::make_unique<const bytes>(
+        optimize_instructions(m_module->get_instructions(code), code.immediate_size));
+
+    // Only the thread which has promoted the function writes its storage slot.
+    m_optimized_storage[code_idx] = std::move(optimized);
+    m_optimized[code_idx].store(m_optimized_storage[code_idx].get(), std::memory_order_release);
+}
+
+void TieringManager::worker_loop()
+{
+    std::unique_lock lock{m_queue_mutex};
+    while (true)
+    {
+        m_queue_cv.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_stopping)
+            return;
+
+        const auto code_idx = m_queue.front();
+        m_queue.pop_front();
+        ++m_num_in_progress;
+        lock.unlock();
+        optimize(code_idx);
+        lock.lock();
+        --m_num_in_progress;
+        m_queue_cv.notify_all();
+    }
+}
+
+bool TieringManager::is_optimized(FuncIdx func_idx) const noexcept
+{
+    if (func_idx < m_num_imported_functions)
+        return false;
+    return m_optimized[func_idx - m_num_imported_functions].load(std::memory_order_acquire) !=
+           nullptr;
+}
+
+void TieringManager::wait_idle()
+{
+    std::unique_lock lock{m_queue_mutex};
+    m_queue_cv.wait(lock, [this] { return m_queue.empty() && m_num_in_progress == 0; });
+}
+}  // namespace fizzy
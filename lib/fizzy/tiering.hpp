@@ -0,0 +1,135 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include "module.hpp"
+#include "types.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fizzy
+{
+/// The configuration of TieringManager.
+struct TieringConfig
+{
+    /// The number of calls of a function promoting it to the optimized tier.
+    uint32_t call_threshold = 1000;
+
+    /// The number of taken backward branches (loop iterations) of a function promoting it to
+    /// the optimized tier.
+    uint32_t back_edge_threshold = 10000;
+
+    /// If true, the functions are optimized on a background thread, and the calls keep executing
+    /// the plain code until the optimized one is ready. Otherwise, the function is optimized by
+    /// the call reaching the threshold.
+    bool background = false;
+};
+
+/// Translates the instructions of a function to the optimized tier, which replaces the pairs of
+/// frequent instructions with superinstructions and folds their constant immediates.
+/// The optimized code has the same size and the same code offsets as the input.
+///
+/// @param  instructions    The instructions of the function, as stored in Module::code_buffer.
+/// @param  immediate_size  The size of the immediates, see Code::immediate_size.
+/// @return                 The optimized instructions.
+bytes optimize_instructions(bytes_view instructions, uint8_t immediate_size);
+
+/// Manages the promotion of the hot functions of a module to the optimized tier.
+///
+/// The functions start executing the plain code. Each call and each taken backward branch of
+/// a function is counted, and the function reaching a threshold of TieringConfig is translated
+/// by optimize_instructions(). The optimized code is used starting from the next call; the frames
+/// already executing the function keep executing the plain code.
+///
+/// The manager is attached to instances of its module via Instance::tiering. It is shared by
+/// the instances and may be used from multiple threads. The counters are approximate if
+/// the function is executed by multiple threads concurrently.
+/// Executions with metering enabled always use the plain code and are not counted, because
+/// the superinstructions would change the charged ticks.
+class TieringManager
+{
+    std::shared_ptr<const Module> m_module;
+    TieringConfig m_config;
+    uint32_t m_num_imported_functions = 0;
+
+    /// The per-function counters, indexed by the code index.
+    std::vector<std::atomic<uint32_t>> m_call_counts;
+    std::vector<std::atomic<uint32_t>> m_back_edge_counts;
+
+    /// Set when the function is queued or optimized, so it is promoted only once.
+    std::vector<std::atomic<bool>> m_promoted;
+
+    /// The published optimized instructions, or nullptr if not optimized yet.
+    std::vector<std::atomic<const bytes*>> m_optimized;
+
+    /// The storage of the optimized instructions, written once before publishing.
+    std::vector<std::unique_ptr<const bytes>> m_optimized_storage;
+
+    std::mutex m_queue_mutex;
+    std::condition_variable m_queue_cv;
+    std::deque<uint32_t> m_queue;
+    uint32_t m_num_in_progress = 0;
+    bool m_stopping = false;
+    std::thread m_worker;
+
+    void promote(uint32_t code_idx);
+    void optimize(uint32_t code_idx);
+    void worker_loop();
+
+public:
+    explicit TieringManager(std::shared_ptr<const Module> module, TieringConfig config = {});
+    ~TieringManager();
+
+    TieringManager(const TieringManager&) = delete;
+    TieringManager& operator=(const TieringManager&) = delete;
+
+    /// The module of the managed functions.
+    const Module& module() const noexcept { return *m_module; }
+
+    /// Counts the call of the defined function and returns its optimized instructions,
+    /// or nullptr if the plain code must be executed.
+    const bytes* enter(FuncIdx func_idx)
+    {
+        const auto code_idx = func_idx - m_num_imported_functions;
+        if (const auto* optimized = m_optimized[code_idx].load(std::memory_order_acquire))
+            return optimized;
+
+        // The increment is not atomic, because lost counts only delay the promotion.
+        auto& counter = m_call_counts[code_idx];
+        const auto count = counter.load(std::memory_order_relaxed) + 1;
+        counter.store(count, std::memory_order_relaxed);
+        if (count == m_config.call_threshold)
+        {
+            promote(code_idx);
+            return m_optimized[code_idx].load(std::memory_order_acquire);
+        }
+        return nullptr;
+    }
+
+    /// Counts the taken backward branch in the defined function.
+    void count_back_edge(FuncIdx func_idx)
+    {
+        const auto code_idx = func_idx - m_num_imported_functions;
+        auto& counter = m_back_edge_counts[code_idx];
+        const auto count = counter.load(std::memory_order_relaxed) + 1;
+        counter.store(count, std::memory_order_relaxed);
+        if (count == m_config.back_edge_threshold)
+            promote(code_idx);
+    }
+
+    /// Checks if the optimized code of the defined function is in use.
+    bool is_optimized(FuncIdx func_idx) const noexcept;
+
+    /// Waits until the background thread optimizes all the promoted functions.
+    void wait_idle();
+};
+}  // namespace fizzy
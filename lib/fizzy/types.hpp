@@ -5,8 +5,10 @@
 #pragma once
 
 #include "bytes.hpp"
+#include "cxx20/span.hpp"
 #include "value.hpp"
 #include <cstdint>
+#include <memory_resource>
 #include <optional>
 #include <string>
 #include <vector>
@@ -21,8 +23,26 @@ enum class ValType : uint8_t
     i64 = 0x7e,
     f32 = 0x7d,
     f64 = 0x7c,
+    v128 = 0x7b,
 };
 
+/// Returns the number of Value slots occupied by a value of the type in the operand stack,
+/// the locals, the arguments and results of functions and the globals. The v128 values occupy
+/// 2 consecutive slots, the low half in the first one.
+inline constexpr uint32_t get_num_slots(ValType type) noexcept
+{
+    return type == ValType::v128 ? 2 : 1;
+}
+
+/// Returns the number of Value slots occupied by the values of the types.
+inline uint32_t get_num_slots(span<const ValType> types) noexcept
+{
+    uint32_t num_slots = 0;
+    for (const auto type : types)
+        num_slots += get_num_slots(type);
+    return num_slots;
+}
+
 // https://webassembly.github.io/spec/core/binary/types.html#table-types
 constexpr uint8_t FuncRef = 0x70;
 
@@ -48,6 +68,9 @@ struct Limits
 {
     uint32_t min = 0;
     std::optional<uint32_t> max;
+
+    /// The shared memory flag of the threads proposal. Always false for tables.
+    bool shared = false;
 };
 
 // https://webassembly.github.io/spec/core/binary/modules.html#binary-typeidx
@@ -92,6 +115,8 @@ enum class Instr : uint8_t
     return_ = 0x0f,
     call = 0x10,
     call_indirect = 0x11,
+    return_call = 0x12,
+    return_call_indirect = 0x13,
 
     // 5.4.2 Parametric instructions
     drop = 0x1a,
@@ -269,6 +294,350 @@ enum class Instr : uint8_t
     f32_reinterpret_i32 = 0xbe,
     f64_reinterpret_i64 = 0xbf,
 
+    // Internal superinstructions emitted only by the optimizing tier (see tiering.hpp) in place of
+    // pairs of instructions. Each keeps the encoding of the pair it replaces and skips the opcode
+    // of the second instruction. The parser rejects them in the binary input.
+    i32_add_imm = 0xe0,          ///< i32.const + i32.add, or i32.sub with the negated constant.
+    i32_eqz_br_if = 0xe1,        ///< i32.eqz + br_if
+    local_get_local_get = 0xe2,  ///< local.get + local.get
+
+    // Bulk memory instructions, encoded in the binary with the misc_prefix and a sub-opcode,
+    // are emitted in the code with these internal opcodes.
+    memory_init = 0xf0,
+    data_drop = 0xf1,
+    memory_copy = 0xf2,
+    memory_fill = 0xf3,
+
+    /// The select instruction with v128 operands.
+    v128_select = 0xf4,
+    /// The global.get and global.set instructions with v128 globals.
+    v128_global_get = 0xf5,
+    v128_global_set = 0xf6,
+
+    misc_prefix = 0xfc,
+
+    /// The SIMD instructions are emitted in the code with this opcode followed by the SimdInstr
+    /// sub-opcode as the first immediate.
+    simd_prefix = 0xfd,
+
+    /// The atomic instructions are emitted in the code with this opcode followed by the
+    /// AtomicInstr sub-opcode as the first immediate.
+    atomic_prefix = 0xfe,
+};
+
+/// The sub-opcodes of the SIMD instructions with the Instr::simd_prefix.
+/// https://webassembly.github.io/spec/core/binary/instructions.html#vector-instructions
+enum class SimdInstr : uint8_t
+{
+    v128_load = 0x00,
+    v128_load8x8_s = 0x01,
+    v128_load8x8_u = 0x02,
+    v128_load16x4_s = 0x03,
+    v128_load16x4_u = 0x04,
+    v128_load32x2_s = 0x05,
+    v128_load32x2_u = 0x06,
+    v128_load8_splat = 0x07,
+    v128_load16_splat = 0x08,
+    v128_load32_splat = 0x09,
+    v128_load64_splat = 0x0a,
+    v128_store = 0x0b,
+    v128_const = 0x0c,
+    i8x16_shuffle = 0x0d,
+    i8x16_swizzle = 0x0e,
+    i8x16_splat = 0x0f,
+    i16x8_splat = 0x10,
+    i32x4_splat = 0x11,
+    i64x2_splat = 0x12,
+    f32x4_splat = 0x13,
+    f64x2_splat = 0x14,
+    i8x16_extract_lane_s = 0x15,
+    i8x16_extract_lane_u = 0x16,
+    i8x16_replace_lane = 0x17,
+    i16x8_extract_lane_s = 0x18,
+    i16x8_extract_lane_u = 0x19,
+    i16x8_replace_lane = 0x1a,
+    i32x4_extract_lane = 0x1b,
+    i32x4_replace_lane = 0x1c,
+    i64x2_extract_lane = 0x1d,
+    i64x2_replace_lane = 0x1e,
+    f32x4_extract_lane = 0x1f,
+    f32x4_replace_lane = 0x20,
+    f64x2_extract_lane = 0x21,
+    f64x2_replace_lane = 0x22,
+    i8x16_eq = 0x23,
+    i8x16_ne = 0x24,
+    i8x16_lt_s = 0x25,
+    i8x16_lt_u = 0x26,
+    i8x16_gt_s = 0x27,
+    i8x16_gt_u = 0x28,
+    i8x16_le_s = 0x29,
+    i8x16_le_u = 0x2a,
+    i8x16_ge_s = 0x2b,
+    i8x16_ge_u = 0x2c,
+    i16x8_eq = 0x2d,
+    i16x8_ne = 0x2e,
+    i16x8_lt_s = 0x2f,
+    i16x8_lt_u = 0x30,
+    i16x8_gt_s = 0x31,
+    i16x8_gt_u = 0x32,
+    i16x8_le_s = 0x33,
+    i16x8_le_u = 0x34,
+    i16x8_ge_s = 0x35,
+    i16x8_ge_u = 0x36,
+    i32x4_eq = 0x37,
+    i32x4_ne = 0x38,
+    i32x4_lt_s = 0x39,
+    i32x4_lt_u = 0x3a,
+    i32x4_gt_s = 0x3b,
+    i32x4_gt_u = 0x3c,
+    i32x4_le_s = 0x3d,
+    i32x4_le_u = 0x3e,
+    i32x4_ge_s = 0x3f,
+    i32x4_ge_u = 0x40,
+    f32x4_eq = 0x41,
+    f32x4_ne = 0x42,
+    f32x4_lt = 0x43,
+    f32x4_gt = 0x44,
+    f32x4_le = 0x45,
+    f32x4_ge = 0x46,
+    f64x2_eq = 0x47,
+    f64x2_ne = 0x48,
+    f64x2_lt = 0x49,
+    f64x2_gt = 0x4a,
+    f64x2_le = 0x4b,
+    f64x2_ge = 0x4c,
+    v128_not = 0x4d,
+    v128_and = 0x4e,
+    v128_andnot = 0x4f,
+    v128_or = 0x50,
+    v128_xor = 0x51,
+    v128_bitselect = 0x52,
+    v128_any_true = 0x53,
+    v128_load8_lane = 0x54,
+    v128_load16_lane = 0x55,
+    v128_load32_lane = 0x56,
+    v128_load64_lane = 0x57,
+    v128_store8_lane = 0x58,
+    v128_store16_lane = 0x59,
+    v128_store32_lane = 0x5a,
+    v128_store64_lane = 0x5b,
+    v128_load32_zero = 0x5c,
+    v128_load64_zero = 0x5d,
+    f32x4_demote_f64x2_zero = 0x5e,
+    f64x2_promote_low_f32x4 = 0x5f,
+    i8x16_abs = 0x60,
+    i8x16_neg = 0x61,
+    i8x16_popcnt = 0x62,
+    i8x16_all_true = 0x63,
+    i8x16_bitmask = 0x64,
+    i8x16_narrow_i16x8_s = 0x65,
+    i8x16_narrow_i16x8_u = 0x66,
+    f32x4_ceil = 0x67,
+    f32x4_floor = 0x68,
+    f32x4_trunc = 0x69,
+    f32x4_nearest = 0x6a,
+    i8x16_shl = 0x6b,
+    i8x16_shr_s = 0x6c,
+    i8x16_shr_u = 0x6d,
+    i8x16_add = 0x6e,
+    i8x16_add_sat_s = 0x6f,
+    i8x16_add_sat_u = 0x70,
+    i8x16_sub = 0x71,
+    i8x16_sub_sat_s = 0x72,
+    i8x16_sub_sat_u = 0x73,
+    f64x2_ceil = 0x74,
+    f64x2_floor = 0x75,
+    i8x16_min_s = 0x76,
+    i8x16_min_u = 0x77,
+    i8x16_max_s = 0x78,
+    i8x16_max_u = 0x79,
+    f64x2_trunc = 0x7a,
+    i8x16_avgr_u = 0x7b,
+    i16x8_extadd_pairwise_i8x16_s = 0x7c,
+    i16x8_extadd_pairwise_i8x16_u = 0x7d,
+    i32x4_extadd_pairwise_i16x8_s = 0x7e,
+    i32x4_extadd_pairwise_i16x8_u = 0x7f,
+    i16x8_abs = 0x80,
+    i16x8_neg = 0x81,
+    i16x8_q15mulr_sat_s = 0x82,
+    i16x8_all_true = 0x83,
+    i16x8_bitmask = 0x84,
+    i16x8_narrow_i32x4_s = 0x85,
+    i16x8_narrow_i32x4_u = 0x86,
+    i16x8_extend_low_i8x16_s = 0x87,
+    i16x8_extend_high_i8x16_s = 0x88,
+    i16x8_extend_low_i8x16_u = 0x89,
+    i16x8_extend_high_i8x16_u = 0x8a,
+    i16x8_shl = 0x8b,
+    i16x8_shr_s = 0x8c,
+    i16x8_shr_u = 0x8d,
+    i16x8_add = 0x8e,
+    i16x8_add_sat_s = 0x8f,
+    i16x8_add_sat_u = 0x90,
+    i16x8_sub = 0x91,
+    i16x8_sub_sat_s = 0x92,
+    i16x8_sub_sat_u = 0x93,
+    f64x2_nearest = 0x94,
+    i16x8_mul = 0x95,
+    i16x8_min_s = 0x96,
+    i16x8_min_u = 0x97,
+    i16x8_max_s = 0x98,
+    i16x8_max_u = 0x99,
+    i16x8_avgr_u = 0x9b,
+    i16x8_extmul_low_i8x16_s = 0x9c,
+    i16x8_extmul_high_i8x16_s = 0x9d,
+    i16x8_extmul_low_i8x16_u = 0x9e,
+    i16x8_extmul_high_i8x16_u = 0x9f,
+    i32x4_abs = 0xa0,
+    i32x4_neg = 0xa1,
+    i32x4_all_true = 0xa3,
+    i32x4_bitmask = 0xa4,
+    i32x4_extend_low_i16x8_s = 0xa7,
+    i32x4_extend_high_i16x8_s = 0xa8,
+    i32x4_extend_low_i16x8_u = 0xa9,
+    i32x4_extend_high_i16x8_u = 0xaa,
+    i32x4_shl = 0xab,
+    i32x4_shr_s = 0xac,
+    i32x4_shr_u = 0xad,
+    i32x4_add = 0xae,
+    i32x4_sub = 0xb1,
+    i32x4_mul = 0xb5,
+    i32x4_min_s = 0xb6,
+    i32x4_min_u = 0xb7,
+    i32x4_max_s = 0xb8,
+    i32x4_max_u = 0xb9,
+    i32x4_dot_i16x8_s = 0xba,
+    i32x4_extmul_low_i16x8_s = 0xbc,
+    i32x4_extmul_high_i16x8_s = 0xbd,
+    i32x4_extmul_low_i16x8_u = 0xbe,
+    i32x4_extmul_high_i16x8_u = 0xbf,
+    i64x2_abs = 0xc0,
+    i64x2_neg = 0xc1,
+    i64x2_all_true = 0xc3,
+    i64x2_bitmask = 0xc4,
+    i64x2_extend_low_i32x4_s = 0xc7,
+    i64x2_extend_high_i32x4_s = 0xc8,
+    i64x2_extend_low_i32x4_u = 0xc9,
+    i64x2_extend_high_i32x4_u = 0xca,
+    i64x2_shl = 0xcb,
+    i64x2_shr_s = 0xcc,
+    i64x2_shr_u = 0xcd,
+    i64x2_add = 0xce,
+    i64x2_sub = 0xd1,
+    i64x2_mul = 0xd5,
+    i64x2_eq = 0xd6,
+    i64x2_ne = 0xd7,
+    i64x2_lt_s = 0xd8,
+    i64x2_gt_s = 0xd9,
+    i64x2_le_s = 0xda,
+    i64x2_ge_s = 0xdb,
+    i64x2_extmul_low_i32x4_s = 0xdc,
+    i64x2_extmul_high_i32x4_s = 0xdd,
+    i64x2_extmul_low_i32x4_u = 0xde,
+    i64x2_extmul_high_i32x4_u = 0xdf,
+    f32x4_abs = 0xe0,
+    f32x4_neg = 0xe1,
+    f32x4_sqrt = 0xe3,
+    f32x4_add = 0xe4,
+    f32x4_sub = 0xe5,
+    f32x4_mul = 0xe6,
+    f32x4_div = 0xe7,
+    f32x4_min = 0xe8,
+    f32x4_max = 0xe9,
+    f32x4_pmin = 0xea,
+    f32x4_pmax = 0xeb,
+    f64x2_abs = 0xec,
+    f64x2_neg = 0xed,
+    f64x2_sqrt = 0xef,
+    f64x2_add = 0xf0,
+    f64x2_sub = 0xf1,
+    f64x2_mul = 0xf2,
+    f64x2_div = 0xf3,
+    f64x2_min = 0xf4,
+    f64x2_max = 0xf5,
+    f64x2_pmin = 0xf6,
+    f64x2_pmax = 0xf7,
+    i32x4_trunc_sat_f32x4_s = 0xf8,
+    i32x4_trunc_sat_f32x4_u = 0xf9,
+    f32x4_convert_i32x4_s = 0xfa,
+    f32x4_convert_i32x4_u = 0xfb,
+    i32x4_trunc_sat_f64x2_s_zero = 0xfc,
+    i32x4_trunc_sat_f64x2_u_zero = 0xfd,
+    f64x2_convert_low_i32x4_s = 0xfe,
+    f64x2_convert_low_i32x4_u = 0xff,
+};
+
+/// The sub-opcodes of the atomic instructions with the Instr::atomic_prefix.
+/// https://github.com/WebAssembly/threads/blob/main/proposals/threads/Overview.md
+enum class AtomicInstr : uint8_t
+{
+    memory_atomic_notify = 0x00,
+    memory_atomic_wait32 = 0x01,
+    memory_atomic_wait64 = 0x02,
+    atomic_fence = 0x03,
+    i32_atomic_load = 0x10,
+    i64_atomic_load = 0x11,
+    i32_atomic_load8_u = 0x12,
+    i32_atomic_load16_u = 0x13,
+    i64_atomic_load8_u = 0x14,
+    i64_atomic_load16_u = 0x15,
+    i64_atomic_load32_u = 0x16,
+    i32_atomic_store = 0x17,
+    i64_atomic_store = 0x18,
+    i32_atomic_store8 = 0x19,
+    i32_atomic_store16 = 0x1a,
+    i64_atomic_store8 = 0x1b,
+    i64_atomic_store16 = 0x1c,
+    i64_atomic_store32 = 0x1d,
+    i32_atomic_rmw_add = 0x1e,
+    i64_atomic_rmw_add = 0x1f,
+    i32_atomic_rmw8_add_u = 0x20,
+    i32_atomic_rmw16_add_u = 0x21,
+    i64_atomic_rmw8_add_u = 0x22,
+    i64_atomic_rmw16_add_u = 0x23,
+    i64_atomic_rmw32_add_u = 0x24,
+    i32_atomic_rmw_sub = 0x25,
+    i64_atomic_rmw_sub = 0x26,
+    i32_atomic_rmw8_sub_u = 0x27,
+    i32_atomic_rmw16_sub_u = 0x28,
+    i64_atomic_rmw8_sub_u = 0x29,
+    i64_atomic_rmw16_sub_u = 0x2a,
+    i64_atomic_rmw32_sub_u = 0x2b,
+    i32_atomic_rmw_and = 0x2c,
+    i64_atomic_rmw_and = 0x2d,
+    i32_atomic_rmw8_and_u = 0x2e,
+    i32_atomic_rmw16_and_u = 0x2f,
+    i64_atomic_rmw8_and_u = 0x30,
+    i64_atomic_rmw16_and_u = 0x31,
+    i64_atomic_rmw32_and_u = 0x32,
+    i32_atomic_rmw_or = 0x33,
+    i64_atomic_rmw_or = 0x34,
+    i32_atomic_rmw8_or_u = 0x35,
+    i32_atomic_rmw16_or_u = 0x36,
+    i64_atomic_rmw8_or_u = 0x37,
+    i64_atomic_rmw16_or_u = 0x38,
+    i64_atomic_rmw32_or_u = 0x39,
+    i32_atomic_rmw_xor = 0x3a,
+    i64_atomic_rmw_xor = 0x3b,
+    i32_atomic_rmw8_xor_u = 0x3c,
+    i32_atomic_rmw16_xor_u = 0x3d,
+    i64_atomic_rmw8_xor_u = 0x3e,
+    i64_atomic_rmw16_xor_u = 0x3f,
+    i64_atomic_rmw32_xor_u = 0x40,
+    i32_atomic_rmw_xchg = 0x41,
+    i64_atomic_rmw_xchg = 0x42,
+    i32_atomic_rmw8_xchg_u = 0x43,
+    i32_atomic_rmw16_xchg_u = 0x44,
+    i64_atomic_rmw8_xchg_u = 0x45,
+    i64_atomic_rmw16_xchg_u = 0x46,
+    i64_atomic_rmw32_xchg_u = 0x47,
+    i32_atomic_rmw_cmpxchg = 0x48,
+    i64_atomic_rmw_cmpxchg = 0x49,
+    i32_atomic_rmw8_cmpxchg_u = 0x4a,
+    i32_atomic_rmw16_cmpxchg_u = 0x4b,
+    i64_atomic_rmw8_cmpxchg_u = 0x4c,
+    i64_atomic_rmw16_cmpxchg_u = 0x4d,
+    i64_atomic_rmw32_cmpxchg_u = 0x4e,
 };
 
 // https://webassembly.github.io/spec/core/binary/modules.html#table-section
@@ -297,6 +666,9 @@ struct ConstantExpression
         Value constant{};
         uint32_t global_index;
     } value;
+
+    /// The high half of the v128 constant, whose low half is in value.constant.
+    Value constant_high{};
 };
 
 // https://webassembly.github.io/spec/core/binary/types.html#binary-globaltype
@@ -352,17 +724,66 @@ struct Element
     std::vector<FuncIdx> init;
 };
 
+/// The function code translated by parse_expr(), before it is placed in the module's code buffer.
+struct ParsedCode
+{
+    int max_stack_height = 0;
+
+    uint32_t local_count = 0;
+
+    /// The instructions bytecode interleaved with decoded immediate values.
+    /// https://webassembly.github.io/spec/core/binary/instructions.html
+    std::pmr::vector<uint8_t> instructions;
+
+    /// The size in bytes (1, 2 or 4) of the index, offset and branch immediates in instructions.
+    /// The values of the const instructions and the SIMD lane indices are always stored in full
+    /// size.
+    uint8_t immediate_size = sizeof(uint32_t);
+
+    /// The indices of functions called by the call instructions, used for the call graph analysis.
+    /// The tail calls are included, as if they were regular calls.
+    std::pmr::vector<FuncIdx> callees;
+
+    /// True if the code contains the call_indirect or return_call_indirect instruction.
+    bool has_call_indirect = false;
+
+    /// The operand stack heights at the starts of the instructions, in their order, each encoded
+    /// as LEB128 of the height plus 1, or 0 if the instruction is unreachable. These are the only
+    /// offsets the execution can be resumed at from a checkpoint.
+    std::pmr::vector<uint8_t> stack_heights;
+};
+
 /// The element of the code section.
 /// https://webassembly.github.io/spec/core/binary/modules.html#code-section
+/// The instructions of all functions are stored in the module's code buffer, see
+/// Module::get_instructions().
 struct Code
 {
     int max_stack_height = 0;
 
     uint32_t local_count = 0;
 
-    /// The instructions bytecode interleaved with decoded immediate values.
-    /// https://webassembly.github.io/spec/core/binary/instructions.html
-    std::vector<uint8_t> instructions;
+    /// The offset of the function's instructions in the module's code buffer.
+    uint32_t instructions_offset = 0;
+
+    /// The size of the function's instructions.
+    uint32_t instructions_size = 0;
+
+    /// The size in bytes (1, 2 or 4) of the index, offset and branch immediates in instructions.
+    uint8_t immediate_size = sizeof(uint32_t);
+
+    /// The maximum call depth reached by executing the function, including its own frame,
+    /// if it is statically known, i.e. the function and all the functions it calls have no indirect
+    /// calls, no calls to imported functions and no recursion. Zero if unbounded.
+    /// The execution checks the call depth limit once for the whole bounded call subgraph.
+    uint32_t max_call_depth = 0;
+
+    /// The offset of the function's stack heights in the module's stack heights buffer,
+    /// see ParsedCode::stack_heights and Module::get_stack_heights().
+    uint32_t stack_heights_offset = 0;
+
+    /// The size of the function's stack heights.
+    uint32_t stack_heights_size = 0;
 };
 
 // https://webassembly.github.io/spec/core/binary/modules.html#data-section
@@ -370,7 +791,31 @@ struct Code
 struct Data
 {
     ConstantExpression offset;
+    /// The payload of the segment. It is empty for the active segments included in
+    /// Module::memory_image.
     bytes init;
+    /// Passive segments are not applied at instantiation, but copied by memory.init instructions.
+    /// Their offset is unused.
+    bool passive = false;
+};
+
+/// The initial memory content combined from the data segments.
+struct MemoryImage
+{
+    /// The content of overlapping or adjacent data segments.
+    struct Run
+    {
+        /// The memory offset of the run, i.e. the lowest offset of its data segments.
+        uint32_t offset = 0;
+
+        /// The content of the data segments at their offsets relative to the run offset, applied
+        /// in the order of the data section.
+        bytes data;
+    };
+
+    /// The runs in the order of their offsets. The gaps between them are zeros, so these are
+    /// not stored.
+    std::vector<Run> runs;
 };
 
 enum class SectionId : uint8_t
@@ -386,7 +831,8 @@ enum class SectionId : uint8_t
     start = 8,
     element = 9,
     code = 10,
-    data = 11
+    data = 11,
+    data_count = 12
 };
 
 }  // namespace fizzy
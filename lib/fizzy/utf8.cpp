@@ -3,8 +3,13 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "utf8.hpp"
+#include "cxx20/bit.hpp"
 #include <cassert>
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 /*
  * The Unicode Standard, Version 6.0
  * (https://www.unicode.org/versions/Unicode6.0.0/ch03.pdf)
@@ -45,17 +50,107 @@ enum class Rule
     Range90BF,  // 90..BF
     Range808F,  // 80..8F
 };
+
+/// The function skipping the ASCII characters in blocks of bytes.
+/// It returns the position of the first non-ASCII byte or the position where less than a block
+/// of bytes is left to the end of the input. The remaining bytes are handled by the caller.
+using SkipAsciiFn = const uint8_t* (*)(const uint8_t* pos, const uint8_t* end) noexcept;
+
+/// Skips ASCII characters in blocks of 8 bytes, using 64-bit words.
+[[maybe_unused]] const uint8_t* skip_ascii_word(const uint8_t* pos, const uint8_t* end) noexcept
+{
+    constexpr auto block_size = sizeof(uint64_t);
+    while (static_cast<size_t>(end - pos) >= block_size)
+    {
+        uint64_t word;
+        __builtin_memcpy(&word, pos, block_size);
+        const auto non_ascii = word & 0x8080808080808080;
+        if (non_ascii != 0)
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return pos + fizzy::countl_zero(non_ascii) / 8;
+#else
+            return pos + fizzy::countr_zero(non_ascii) / 8;
+#endif
+        }
+        pos += block_size;
+    }
+    return pos;
+}
+
+#if defined(__SSE2__)
+/// Skips ASCII characters in blocks of 16 bytes, using SSE2 instructions.
+const uint8_t* skip_ascii_sse2(const uint8_t* pos, const uint8_t* end) noexcept
+{
+    constexpr auto block_size = sizeof(__m128i);
+    while (static_cast<size_t>(end - pos) >= block_size)
+    {
+        const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        // The mask of the most significant bits of all bytes, i.e. the non-ASCII ones.
+        const auto non_ascii = static_cast<uint32_t>(_mm_movemask_epi8(block));
+        if (non_ascii != 0)
+            return pos + fizzy::countr_zero(non_ascii);
+        pos += block_size;
+    }
+    return pos;
+}
+#endif
+
+#if defined(__x86_64__)
+/// Skips ASCII characters in blocks of 32 bytes, using AVX2 instructions.
+/// It must only be used if the CPU supports AVX2.
+[[gnu::target("avx2")]] const uint8_t* skip_ascii_avx2(
+    const uint8_t* pos, const uint8_t* end) noexcept
+{
+    constexpr auto block_size = sizeof(__m256i);
+    while (static_cast<size_t>(end - pos) >= block_size)
+    {
+        const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+        const auto non_ascii = static_cast<uint32_t>(_mm256_movemask_epi8(block));
+        if (non_ascii != 0)
+            return pos + fizzy::countr_zero(non_ascii);
+        pos += block_size;
+    }
+    // Finish with the smaller blocks, there are many short strings.
+    return skip_ascii_sse2(pos, end);
+}
+#endif
+
+/// Selects the best implementation of skipping ASCII characters supported by the CPU.
+SkipAsciiFn select_skip_ascii() noexcept
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return skip_ascii_avx2;
+#endif
+#if defined(__SSE2__)
+    return skip_ascii_sse2;
+#else
+    return skip_ascii_word;
+#endif
+}
 }  // namespace
 
 namespace fizzy
 {
 bool utf8_validate(const uint8_t* pos, const uint8_t* end) noexcept
 {
+    static const auto skip_ascii = select_skip_ascii();
+
     while (pos < end)
     {
+        if (*pos <= 0x7F)
+        {
+            // Shortcut for valid ASCII (also valid UTF-8): skip whole blocks of ASCII characters,
+            // then the rest of them one by one.
+            pos = skip_ascii(pos, end);
+            while (pos < end && *pos <= 0x7F)
+                ++pos;
+            continue;
+        }
+
         const uint8_t byte1 = *pos++;
-        if (byte1 <= 0x7F)
-            continue;  // Shortcut for valid ASCII (also valid UTF-8)
 
         if (byte1 < 0xC2)
             return false;
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <benchmark/benchmark.h>
+#include <fizzy/fizzy.h>
 #include <test/utils/hex.hpp>
 #include <test/utils/wasm_engine.hpp>
 #include <filesystem>
@@ -64,6 +65,23 @@ void benchmark_parse(
         benchmark::Counter(static_cast<double>(num_bytes_parsed), benchmark::Counter::kIsRate);
 }
 
+void benchmark_validate(benchmark::State& state, const fizzy::bytes& wasm_binary)
+{
+    if (!fizzy_validate(wasm_binary.data(), wasm_binary.size(), nullptr))
+        state.SkipWithError("Validation failed");
+
+    const auto input_size = wasm_binary.size();
+    auto num_bytes_validated = uint64_t{0};
+    for ([[maybe_unused]] auto _ : state)
+    {
+        fizzy_validate(wasm_binary.data(), wasm_binary.size(), nullptr);
+        num_bytes_validated += input_size;
+    }
+    state.counters["size"] = benchmark::Counter(static_cast<double>(input_size));
+    state.counters["rate"] =
+        benchmark::Counter(static_cast<double>(num_bytes_validated), benchmark::Counter::kIsRate);
+}
+
 void benchmark_instantiate(
     benchmark::State& state, EngineCreateFn create_fn, const fizzy::bytes& wasm_binary)
 {
@@ -225,6 +243,10 @@ void load_benchmark(const fs::path& path, const std::string& name_prefix)
                 benchmark::State& state) { benchmark_parse(state, create_fn, *wasm_binary); });
     }
 
+    // Register validate benchmark, using the C API as it is only exposed there.
+    register_benchmark("fizzyc/validate/" + base_name,
+        [wasm_binary](benchmark::State& state) { benchmark_validate(state, *wasm_binary); });
+
     for (const auto& entry : engine_registry)  // Register instantiate benchmark.
     {
         register_benchmark(std::string{entry.name} + "/instantiate/" + base_name,
@@ -0,0 +1,235 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+/// Benchmarks of execution of call-heavy code.
+
+#include "execute.hpp"
+#include "instantiate.hpp"
+#include "parser.hpp"
+#include "tiering.hpp"
+#include <benchmark/benchmark.h>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (func $fib (param i32) (result i32)
+    (if (result i32) (i32.lt_u (local.get 0) (i32.const 2))
+      (then (local.get 0))
+      (else (i32.add
+        (call $fib (i32.sub (local.get 0) (i32.const 1)))
+        (call $fib (i32.sub (local.get 0) (i32.const 2)))))))
+*/
+const auto wasm_fib = from_hex(
+    "0061736d0100000001060160017f017f030201000a1e011c002000410249047f200005200041016b100020004102"
+    "6b10006a0b0b");
+
+/* wat2wasm
+  (func $square (param i32) (result i32) (i32.mul (local.get 0) (local.get 0)))
+  (func $sum_squares (param $n i32) (result i32) (local $acc i32)
+    (block (loop
+      (br_if 1 (i32.eqz (local.get $n)))
+      (local.set $acc (i32.add (local.get $acc) (call $square (local.get $n))))
+      (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+      (br 0)))
+    (local.get $acc))
+*/
+const auto wasm_sum_squares = from_hex(
+    "0061736d0100000001060160017f017f03030200000a2d020700200020006c0b2301017f024003402000450d0120"
+    "01200010006a2101200041016b21000c000b0b20010b");
+
+/* wat2wasm --enable-bulk-memory
+  (memory 1)
+  (func $fill_loop (param $dst i32) (param $val i32) (param $n i32)
+    (block (loop
+      (br_if 1 (i32.eqz (local.get $n)))
+      (i32.store8 (local.get $dst) (local.get $val))
+      (local.set $dst (i32.add (local.get $dst) (i32.const 1)))
+      (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+      (br 0))))
+  (func $fill (param i32 i32 i32) (memory.fill (local.get 0) (local.get 1) (local.get 2)))
+*/
+const auto wasm_memory_fill = from_hex(
+    "0061736d0100000001070160037f7f7f00030302000005030100010a32022400024003402002450d0120002001"
+    "3a0000200041016a2100200241016b21020c000b0b0b0b00200020012002fc0b000b");
+
+/* wat2wasm --enable-simd
+  (memory 1)
+  (func $sum (param $n i32) (result i32) (local $i i32) (local $acc i32)
+    (block (loop
+      (br_if 1 (i32.ge_u (local.get $i) (local.get $n)))
+      (local.set $acc (i32.add (local.get $acc) (i32.load (local.get $i))))
+      (local.set $i (i32.add (local.get $i) (i32.const 4)))
+      (br 0)))
+    (local.get $acc))
+  (func $sum_simd (param $n i32) (result i32) (local $i i32) (local $acc v128)
+    (block (loop
+      (br_if 1 (i32.ge_u (local.get $i) (local.get $n)))
+      (local.set $acc (i32x4.add (local.get $acc) (v128.load (local.get $i))))
+      (local.set $i (i32.add (local.get $i) (i32.const 16)))
+      (br 0)))
+    (i32.add
+      (i32.add (i32x4.extract_lane 0 (local.get $acc)) (i32x4.extract_lane 1 (local.get $acc)))
+      (i32.add (i32x4.extract_lane 2 (local.get $acc)) (i32x4.extract_lane 3 (local.get $acc)))))
+*/
+const auto wasm_memory_sum = from_hex(
+    "0061736d0100000001060160017f017f030302000005030100010a69022601027f02400340200120004f0d0120"
+    "0220012802006a2102200141046a21010c000b0b20020b4002017f017b02400340200120004f0d0120022001fd"
+    "000400fdae012102200141106a21010c000b0b2002fd1b002002fd1b016a2002fd1b022002fd1b036a6a0b");
+
+/* wat2wasm --enable-tail-call
+  (func $sum_tail (param $n i32) (param $acc i32) (result i32)
+    (if (result i32) (i32.eqz (local.get $n))
+      (then (local.get $acc))
+      (else (return_call $sum_tail (i32.sub (local.get $n) (i32.const 1))
+        (i32.add (local.get $n) (local.get $acc))))))
+  (func $sum_loop (param $n i32) (param $acc i32) (result i32)
+    (block (loop
+      (br_if 1 (i32.eqz (local.get $n)))
+      (local.set $acc (i32.add (local.get $acc) (local.get $n)))
+      (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+      (br 0)))
+    (local.get $acc))
+*/
+const auto wasm_tail_sum = from_hex(
+    "0061736d0100000001070160027f7f017f03030200000a39021700200045047f200105200041016b200020016a"
+    "12000b0b1f00024003402000450d01200120006a2101200041016b21000c000b0b20010b");
+
+void execute_fib(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const auto instance = fizzy::instantiate(fizzy::parse(wasm_fib));
+    const fizzy::Value args[]{n};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        const auto result = fizzy::execute(*instance, 0, args);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+/// Calls a leaf function in a loop. The call depth of $sum_squares is known statically.
+void execute_leaf_calls(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const auto instance = fizzy::instantiate(fizzy::parse(wasm_sum_squares));
+    const fizzy::Value args[]{n};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        const auto result = fizzy::execute(*instance, 1, args);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+/// Executes the functions in the plain code or, if the second argument is non-zero, promoted to
+/// the optimized tier.
+void execute_tiered(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const std::shared_ptr<const fizzy::Module> module = fizzy::parse(wasm_sum_squares);
+    const auto instance = fizzy::instantiate(module);
+    if (state.range(1) != 0)
+        instance->tiering = std::make_shared<fizzy::TieringManager>(module);
+    const fizzy::Value args[]{n};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        const auto result = fizzy::execute(*instance, 1, args);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+/// Fills the memory with a byte loop or, if the second argument is non-zero, with memory.fill.
+void execute_memory_fill(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const auto instance = fizzy::instantiate(fizzy::parse(wasm_memory_fill));
+    const auto func_idx = state.range(1) != 0 ? 1u : 0u;
+    const fizzy::Value args[]{0, 0x5a, n};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        const auto result = fizzy::execute(*instance, func_idx, args);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+/// Stores the bytes with the byte loop without or, if the second argument is non-zero, with
+/// the memory modifications tracked as in the instances of InstancePool.
+void execute_memory_store(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const auto instance = fizzy::instantiate(fizzy::parse(wasm_memory_fill));
+    if (state.range(1) != 0)
+        instance->dirty_memory_blocks.resize(1);
+    const fizzy::Value args[]{0, 0x5a, n};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        const auto result = fizzy::execute(*instance, 0, args);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(int64_t{n} * state.iterations());
+}
+
+/// Sums the i32 values in the memory with a scalar loop or, if the second argument is non-zero,
+/// with the i32x4 lanes.
+void execute_memory_sum(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const auto instance = fizzy::instantiate(fizzy::parse(wasm_memory_sum));
+    const auto func_idx = state.range(1) != 0 ? 1u : 0u;
+    const fizzy::Value args[]{n};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        const auto result = fizzy::execute(*instance, func_idx, args);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+/// Runs the loop with calls without or, if the second argument is non-zero, with metering.
+/// The loop iterations and calls poll the interrupt flag in both cases.
+void execute_metering(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const auto instance = fizzy::instantiate(fizzy::parse(wasm_sum_squares));
+    const fizzy::Value args[]{n};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        fizzy::ExecutionContext ctx;
+        ctx.metering_enabled = state.range(1) != 0;
+        const auto result = fizzy::execute(*instance, 1, args, ctx);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+/// Runs the tail-recursive loop or, if the second argument is non-zero, the equivalent loop.
+void execute_tail_calls(benchmark::State& state)
+{
+    const auto n = static_cast<uint32_t>(state.range(0));
+    const auto instance = fizzy::instantiate(fizzy::parse(wasm_tail_sum));
+    const auto func_idx = state.range(1) != 0 ? 1u : 0u;
+    const fizzy::Value args[]{n, 0};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        const auto result = fizzy::execute(*instance, func_idx, args);
+        benchmark::DoNotOptimize(result);
+    }
+}
+}  // namespace
+
+BENCHMARK(execute_fib)->Arg(20)->Arg(25)->Unit(benchmark::kMicrosecond);
+BENCHMARK(execute_leaf_calls)->Arg(100000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(execute_tiered)->Args({100000, 0})->Args({100000, 1})->Unit(benchmark::kMicrosecond);
+BENCHMARK(execute_memory_fill)->Args({65536, 0})->Args({65536, 1})->Unit(benchmark::kMicrosecond);
+BENCHMARK(execute_memory_store)->Args({65536, 0})->Args({65536, 1})->Unit(benchmark::kMicrosecond);
+BENCHMARK(execute_memory_sum)->Args({65536, 0})->Args({65536, 1})->Unit(benchmark::kMicrosecond);
+BENCHMARK(execute_metering)->Args({100000, 0})->Args({100000, 1})->Unit(benchmark::kMicrosecond);
+BENCHMARK(execute_tail_calls)->Args({100000, 0})->Args({100000, 1})->Unit(benchmark::kMicrosecond);
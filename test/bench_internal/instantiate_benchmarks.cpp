@@ -0,0 +1,142 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+/// Benchmarks of instantiation of modules with large data segments.
+
+#include "execute.hpp"
+#include "instance_pool.hpp"
+#include "instantiate.hpp"
+#include "limits.hpp"
+#include "parser.hpp"
+#include <benchmark/benchmark.h>
+#include <test/utils/hex.hpp>
+#include <test/utils/wasm_binary.hpp>
+
+using namespace fizzy::test;
+
+namespace
+{
+constexpr size_t SegmentSize = 64 * 1024;
+
+/// Creates wasm binary of i32.const instruction with the non-negative value.
+/// Unlike i32_const(), it extends the encoding if needed to keep the sign bit clear.
+fizzy::bytes i32_const_non_negative(uint32_t value)
+{
+    auto encoded = leb128u_encode(value);
+    if ((encoded.back() & 0x40) != 0)
+    {
+        encoded.back() |= 0x80;
+        encoded.push_back(0x00);
+    }
+    return uint8_t{0x41} + encoded;
+}
+
+/// Creates a module with the memory of the given size in pages, where all but the last page are
+/// filled with data segments of 64 KiB each. If host_call is true, the module imports the function
+/// "env" "host" and its function 1 calls it.
+fizzy::bytes make_module_with_data(uint32_t memory_pages, bool host_call = false)
+{
+    fizzy::bytes sections;
+    if (host_call)
+    {
+        sections += make_section(1, make_vec({"600000"_bytes})) +
+                    make_section(2, make_vec({"03656e7604686f73740000"_bytes})) +
+                    make_section(3, make_vec({"00"_bytes}));
+    }
+    sections += make_section(5, make_vec({"00"_bytes + leb128u_encode(memory_pages)}));
+    if (host_call)
+        sections += make_section(10, make_vec({"040010000b"_bytes}));
+
+    const auto segment_count = memory_pages - 1;
+    auto data_section_contents = leb128u_encode(segment_count);
+    for (uint32_t i = 0; i < segment_count; ++i)
+    {
+        const auto offset = static_cast<uint32_t>(i * SegmentSize);
+        data_section_contents += "00"_bytes + i32_const_non_negative(offset) + "0b"_bytes +
+                                 leb128u_encode(SegmentSize) + fizzy::bytes(SegmentSize, 0xa5);
+    }
+    sections += make_section(11, data_section_contents);
+    return "0061736d01000000"_bytes + sections;
+}
+
+/// Instantiates the module using the memory image built by the parser, or applying the data
+/// segments one by one, if MemoryImage is false.
+template <bool MemoryImage>
+void instantiate_data(benchmark::State& state)
+{
+    const auto memory_pages = static_cast<uint32_t>(state.range(0));
+    auto parsed_module = fizzy::parse(make_module_with_data(memory_pages));
+    if (!parsed_module->memory_image.has_value())
+        return state.SkipWithError("memory image not built");
+
+    auto module = std::make_shared<fizzy::Module>(*parsed_module);
+    if constexpr (!MemoryImage)
+    {
+        // The payloads of the segments have been released by the parser building the image.
+        module->memory_image.reset();
+        for (auto& data : module->datasec)
+            data.init.assign(SegmentSize, 0xa5);
+    }
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto instance = fizzy::instantiate(module, {}, {}, {}, {}, fizzy::MaxMemoryPagesLimit);
+        benchmark::DoNotOptimize(instance->memory->data());
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(fizzy::memory_pages_to_bytes(memory_pages)) * state.iterations());
+}
+
+/// Acquires an instance from InstancePool, modifies few bytes of its memory and releases it.
+/// Compare with instantiate_data<true>, which creates the same instance from scratch.
+void instance_pool_acquire_release(benchmark::State& state)
+{
+    const auto memory_pages = static_cast<uint32_t>(state.range(0));
+    fizzy::InstancePool pool{
+        fizzy::parse(make_module_with_data(memory_pages)), {}, {}, fizzy::MaxMemoryPagesLimit};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto instance = pool.acquire();
+        (*instance->memory)[0] = 0x01;
+        fizzy::mark_memory_dirty(*instance, 0, 1);
+        benchmark::DoNotOptimize(instance->memory->data());
+        pool.release(std::move(instance));
+    }
+}
+
+/// Acquires an instance from InstancePool, calls the host function modifying few bytes of its
+/// memory and releases it. If the second argument is non-zero, the pool is created with the host
+/// function marking the modification with mark_memory_dirty(), so only the modified block is
+/// restored instead of the whole memory.
+void instance_pool_host_call(benchmark::State& state)
+{
+    const auto memory_pages = static_cast<uint32_t>(state.range(0));
+    const bool host_function_marks_memory_dirty = state.range(1) != 0;
+    constexpr auto host = [](std::any&, fizzy::Instance& instance, const fizzy::Value*,
+                              fizzy::ExecutionContext&) noexcept {
+        (*instance.memory)[0] = 0x01;
+        fizzy::mark_memory_dirty(instance, 0, 1);
+        return fizzy::Void;
+    };
+    const std::shared_ptr<const fizzy::Module> module =
+        fizzy::parse(make_module_with_data(memory_pages, true));
+    fizzy::InstancePool pool{module, {{{host}, module->typesec[0]}}, {},
+        fizzy::MaxMemoryPagesLimit, 64, host_function_marks_memory_dirty};
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto instance = pool.acquire();
+        const auto result = fizzy::execute(*instance, 1, nullptr);
+        benchmark::DoNotOptimize(result);
+        pool.release(std::move(instance));
+    }
+}
+}  // namespace
+
+BENCHMARK_TEMPLATE(instantiate_data, true)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK_TEMPLATE(instantiate_data, false)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK(instance_pool_acquire_release)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK(instance_pool_host_call)->ArgsProduct({{4, 64, 1024}, {0, 1}});
@@ -5,8 +5,11 @@
 #include "experimental.hpp"
 #include "parser.hpp"
 #include <benchmark/benchmark.h>
+#include <test/utils/hex.hpp>
 #include <test/utils/leb128_encode.hpp>
+#include <test/utils/wasm_binary.hpp>
 #include <algorithm>
+#include <limits>
 #include <random>
 #include <vector>
 
@@ -14,14 +17,20 @@ namespace
 {
 std::mt19937_64 g_gen{std::random_device{}()};
 
+/// Generates random values of the given bit width.
+/// For the bit width 0 the width of each value is also random.
 template <typename T>
-std::vector<T> generate_samples(size_t count)
+std::vector<T> generate_samples(size_t count, int bits = std::numeric_limits<T>::digits)
 {
     std::uniform_int_distribution<T> dist;
+    std::uniform_int_distribution<int> bits_dist{1, std::numeric_limits<T>::digits};
 
     std::vector<T> samples;
     samples.reserve(count);
-    std::generate_n(std::back_inserter(samples), count, [&] { return dist(g_gen); });
+    std::generate_n(std::back_inserter(samples), count, [&] {
+        const auto shift = std::numeric_limits<T>::digits - (bits != 0 ? bits : bits_dist(g_gen));
+        return static_cast<T>(dist(g_gen) >> shift);
+    });
     return samples;
 }
 
@@ -37,6 +46,38 @@ fizzy::bytes generate_ascii_vec(size_t size)
     return result;
 }
 
+/// Creates a module with the given number of functions of the type (func (param i32) (result i32)),
+/// each summing the numbers from its argument down to 1 and passing the sum to the next function.
+fizzy::bytes make_module_with_functions(size_t num_functions)
+{
+    using namespace fizzy::test;
+
+    /* wat2wasm
+      (func (param i32) (result i32) (local i32)
+        (block (loop
+          (br_if 1 (i32.eqz (local.get 0)))
+          (local.set 1 (i32.add (local.get 1) (local.get 0)))
+          (local.set 0 (i32.sub (local.get 0) (i32.const 1)))
+          (br 0)))
+        (call $next (local.get 1)))
+    */
+    const auto body_prefix =
+        "01017f024003402000450d01200120006a2101200041016b21000c000b0b200110"_bytes;
+
+    auto code_section_contents = leb128u_encode(num_functions);
+    for (size_t i = 0; i < num_functions; ++i)
+    {
+        const auto next_func_idx = leb128u_encode((i + 1) % num_functions);
+        code_section_contents += add_size_prefix(body_prefix + next_func_idx + "0b"_bytes);
+    }
+
+    const auto type_section = make_section(1, make_vec({"60017f017f"_bytes}));
+    const auto function_section =
+        make_section(3, leb128u_encode(num_functions) + fizzy::bytes(num_functions, 0x00));
+    const auto code_section = make_section(10, code_section_contents);
+    return "0061736d01000000"_bytes + type_section + function_section + code_section;
+}
+
 [[gnu::noinline]] std::pair<uint64_t, const uint8_t*> nop(const uint8_t* p, const uint8_t* end)
 {
     auto n = p + 10;
@@ -57,7 +98,7 @@ template <decltype(fizzy::leb128u_decode<uint64_t>) Fn>
 static void leb128u_decode_u64(benchmark::State& state)
 {
     constexpr size_t size = 1024;
-    const auto samples = generate_samples<uint64_t>(size);
+    const auto samples = generate_samples<uint64_t>(size, static_cast<int>(state.range(0)));
 
     fizzy::bytes input;
     input.reserve(size * ((sizeof(uint64_t) * 8) / 7 + 1));
@@ -80,10 +121,17 @@ static void leb128u_decode_u64(benchmark::State& state)
             state.SkipWithError("Not all input processed");
     }
 }
-BENCHMARK_TEMPLATE(leb128u_decode_u64, nop);
-BENCHMARK_TEMPLATE(leb128u_decode_u64, fizzy::leb128u_decode<uint64_t>);
-BENCHMARK_TEMPLATE(leb128u_decode_u64, leb128u_decode_u64_noinline);
-BENCHMARK_TEMPLATE(leb128u_decode_u64, decodeULEB128);
+/// Sets the bit widths of the random values, each 7 bits make one byte of the encoding.
+/// The 0 is for the random mix of widths.
+static void leb128_decode_args(benchmark::internal::Benchmark* b)
+{
+    for (const auto bits : {0, 7, 14, 21, 35, 56, 64})
+        b->Arg(bits);
+}
+BENCHMARK_TEMPLATE(leb128u_decode_u64, nop)->Apply(leb128_decode_args);
+BENCHMARK_TEMPLATE(leb128u_decode_u64, fizzy::leb128u_decode<uint64_t>)->Apply(leb128_decode_args);
+BENCHMARK_TEMPLATE(leb128u_decode_u64, leb128u_decode_u64_noinline)->Apply(leb128_decode_args);
+BENCHMARK_TEMPLATE(leb128u_decode_u64, decodeULEB128)->Apply(leb128_decode_args);
 
 static void parse_string(benchmark::State& state)
 {
@@ -101,3 +149,31 @@ static void parse_string(benchmark::State& state)
     state.SetItemsProcessed(static_cast<int64_t>(size));
 }
 BENCHMARK(parse_string)->RangeMultiplier(2)->Range(16, 4 * 1024);
+
+/// Parses the module with many functions and destroys it.
+static void parse_functions(benchmark::State& state)
+{
+    const auto wasm = make_module_with_functions(static_cast<size_t>(state.range(0)));
+
+    for ([[maybe_unused]] auto _ : state)
+        benchmark::DoNotOptimize(fizzy::parse(wasm));
+
+    state.SetBytesProcessed(static_cast<int64_t>(wasm.size()) * state.iterations());
+}
+BENCHMARK(parse_functions)->RangeMultiplier(16)->Range(16, 4096);
+
+/// Destroys the parsed module with many functions. The iterations are limited, because each of
+/// them also parses the module, which takes much longer than the measured destruction.
+static void destroy_module(benchmark::State& state)
+{
+    const auto wasm = make_module_with_functions(static_cast<size_t>(state.range(0)));
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        state.PauseTiming();
+        auto module = fizzy::parse(wasm);
+        state.ResumeTiming();
+        module.reset();
+    }
+}
+BENCHMARK(destroy_module)->RangeMultiplier(16)->Range(16, 4096)->Iterations(1000);
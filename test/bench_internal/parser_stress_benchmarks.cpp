@@ -0,0 +1,55 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+/// Benchmarks of parsing and validation of pathological modules of growing sizes.
+/// The time must grow linearly with the module size, i.e. the bytes per second rate must stay
+/// flat and the fitted complexity must be O(N). This is checked by the parser_stress unit tests.
+
+#include "parser.hpp"
+#include <benchmark/benchmark.h>
+#include <test/utils/parser_stress.hpp>
+
+using namespace fizzy::test;
+
+namespace
+{
+void parse_module(fizzy::bytes_view wasm)
+{
+    benchmark::DoNotOptimize(fizzy::parse(wasm));
+}
+
+void validate_module(fizzy::bytes_view wasm)
+{
+    fizzy::validate(wasm);
+}
+}  // namespace
+
+template <fizzy::bytes (*Generator)(size_t), void (*Fn)(fizzy::bytes_view)>
+static void parse_stress(benchmark::State& state)
+{
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto wasm = Generator(n);
+
+    for ([[maybe_unused]] auto _ : state)
+        Fn(wasm);
+
+    state.SetComplexityN(state.range(0));
+    state.SetBytesProcessed(static_cast<int64_t>(wasm.size()) * state.iterations());
+}
+#define STRESS_BENCHMARK(GENERATOR)                                                              \
+    BENCHMARK_TEMPLATE(parse_stress, GENERATOR, parse_module)                                    \
+        ->RangeMultiplier(4)                                                                     \
+        ->Range(1 << 8, 1 << 16)                                                                 \
+        ->Complexity();                                                                          \
+    BENCHMARK_TEMPLATE(parse_stress, GENERATOR, validate_module)                                 \
+        ->RangeMultiplier(4)                                                                     \
+        ->Range(1 << 8, 1 << 16)                                                                 \
+        ->Complexity()
+
+STRESS_BENCHMARK(deep_nesting);
+STRESS_BENCHMARK(deep_br_table);
+STRESS_BENCHMARK(huge_br_table);
+STRESS_BENCHMARK(many_locals);
+STRESS_BENCHMARK(long_locals_run);
+STRESS_BENCHMARK(deep_operand_stack);
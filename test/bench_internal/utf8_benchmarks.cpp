@@ -5,6 +5,7 @@
 #include "utf8.hpp"
 #include <benchmark/benchmark.h>
 #include <test/utils/utf8_demo.hpp>
+#include <string>
 
 static void utf8_demo(benchmark::State& state)
 {
@@ -20,3 +21,19 @@ static void utf8_demo(benchmark::State& state)
     state.SetBytesProcessed(static_cast<int64_t>(utf8_demo_size));
 }
 BENCHMARK(utf8_demo);
+
+static void utf8_ascii(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    const std::string input(size, 'a');
+    const auto input_beg = reinterpret_cast<const uint8_t*>(input.data());
+    const auto input_end = input_beg + size;
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        benchmark::DoNotOptimize(fizzy::utf8_validate(input_beg, input_end));
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(size) * state.iterations());
+}
+BENCHMARK(utf8_ascii)->RangeMultiplier(4)->Range(8, 16 * 1024);
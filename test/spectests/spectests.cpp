@@ -65,6 +65,39 @@ fizzy::bytes load_wasm_file(const fs::path& json_file_path, std::string_view fil
         std::istreambuf_iterator<char>{wasm_file}, std::istreambuf_iterator<char>{});
 }
 
+/// The error of parsing or validating an invalid module.
+struct module_error
+{
+    /// The type of the error: "parser error" or "validation error", empty if there is none.
+    std::string type;
+    std::string message;
+};
+
+/// Calls the function parsing or validating a module and returns the error it throws.
+template <typename Func>
+module_error get_module_error(Func func)
+{
+    try
+    {
+        func();
+    }
+    catch (fizzy::parser_error const& ex)
+    {
+        return {"parser error", ex.what()};
+    }
+    catch (fizzy::validation_error const& ex)
+    {
+        return {"validation error", ex.what()};
+    }
+    return {};
+}
+
+/// Describes the outcome of parsing or validating a module.
+std::string describe(const module_error& error)
+{
+    return error.type.empty() ? "succeeded" : "threw " + error.type + ": " + error.message;
+}
+
 struct test_settings
 {
     bool skip_validation = false;
@@ -291,29 +324,28 @@ public:
 
                 const auto filename = cmd.at("filename").get<std::string>();
                 const auto wasm_binary = load_wasm_file(path, filename);
-                try
-                {
-                    fizzy::parse(wasm_binary);
-                }
-                catch (fizzy::parser_error const& ex)
+
+                // validate() must reject the module the same way as parse().
+                const auto validate_error =
+                    get_module_error([&wasm_binary] { fizzy::validate(wasm_binary); });
+                const auto parse_error =
+                    get_module_error([&wasm_binary] { fizzy::parse(wasm_binary); });
+                if (validate_error.type != parse_error.type)
                 {
-                    if (type == "assert_malformed")
-                        pass(ex.what());
-                    else
-                        fail(std::string{"Unexpected parser error: "} + ex.what());
+                    fail("validate() and parse() disagree: validate() " + describe(validate_error) +
+                         ", parse() " + describe(parse_error));
                     continue;
                 }
-                catch (fizzy::validation_error const& ex)
+
+                if (validate_error.type.empty())
                 {
-                    if (type == "assert_invalid")
-                        pass(ex.what());
-                    else
-                        fail(std::string{"Unexpected validation error: "} + ex.what());
-                    continue;
+                    fail("Invalid module parsed successfully. Expected error: " +
+                         cmd.at("text").get<std::string>());
                 }
-
-                fail("Invalid module parsed successfully. Expected error: " +
-                     cmd.at("text").get<std::string>());
+                else if ((type == "assert_malformed") == (validate_error.type == "parser error"))
+                    pass(validate_error.message);
+                else
+                    fail("Unexpected " + validate_error.type + ": " + validate_error.message);
             }
             else if (type == "assert_unlinkable" || type == "assert_uninstantiable")
             {
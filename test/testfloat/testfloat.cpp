@@ -233,6 +233,8 @@ constexpr TypedValue from_bits(ValType ty, uint64_t bits) noexcept
     case ValType::i64:
     case ValType::f64:  // For f64 interpret bits as integer value not to convert sNaN -> qNaN.
         return {ty, bits};
+    case ValType::v128:  // Not used in function types.
+        break;
     }
     __builtin_unreachable();
 }
@@ -256,6 +258,8 @@ std::ostream& operator<<(std::ostream& os, const TypedValue& value)
     case ValType::f64:
         os << std::setw(16) << FP{value.value.f64}.as_uint();
         break;
+    case ValType::v128:  // Not used in function types.
+        break;
     }
     os.copyfmt(os_state);
     return os;
@@ -298,6 +302,8 @@ bool eq(TypedValue v, uint64_t expected_bits, bool ignore_nan_payloads)
         }
         return fp_value == expected;
     }
+    case ValType::v128:  // Not used in function types.
+        break;
     }
     __builtin_unreachable();
 }
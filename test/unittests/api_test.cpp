@@ -74,6 +74,34 @@ TEST(api, execution_result_value_constructor)
     EXPECT_EQ(result.value.i32, 1234_u32);
 }
 
+TEST(api, execute_function_host_with_results)
+{
+    auto instance = instantiate(parse("0061736d01000000"_bytes));
+    ExecutionContext ctx;
+
+    Value results[1]{};
+    EXPECT_THAT(function_returning_value(42)(*instance, nullptr, results, ctx), Result());
+    EXPECT_EQ(results[0].i32, 42);
+
+    // The trapped and suspended results are forwarded, without writing the results.
+    const ExecutionResult forwarded[]{Trap, Interrupted, Suspended};
+    for (const auto& expected : forwarded)
+    {
+        ExecuteFunction function{
+            [](std::any& host_context, Instance&, const Value*, ExecutionContext&) noexcept {
+                return *std::any_cast<ExecutionResult>(&host_context);
+            },
+            std::make_any<ExecutionResult>(expected)};
+
+        results[0] = Value{1};
+        const auto ret = function(*instance, nullptr, results, ctx);
+        EXPECT_EQ(ret.trapped, expected.trapped);
+        EXPECT_EQ(ret.interrupted, expected.interrupted);
+        EXPECT_EQ(ret.suspended, expected.suspended);
+        EXPECT_EQ(results[0].i32, 1);
+    }
+}
+
 TEST(api, resolve_imported_functions)
 {
     /* wat2wasm
@@ -39,6 +39,43 @@ TEST(capi_execute, execute)
     fizzy_free_instance(instance);
 }
 
+TEST(capi_execute, execute_multi)
+{
+    /* wat2wasm
+      (func (param i32 i64) (result i64 i32) (local.get 1) (local.get 0))
+      (func unreachable)
+      (func (result i32) i32.const 42)
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010f0360027f7e027e7f6000006000017f0304030001020a11030600200120000b0300000b"
+        "0400412a0b");
+
+    auto module = fizzy_parse(wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module, nullptr);
+
+    auto instance = fizzy_instantiate(
+        module, nullptr, 0, nullptr, nullptr, nullptr, 0, FizzyMemoryPagesLimitDefault, nullptr);
+    ASSERT_NE(instance, nullptr);
+
+    const FizzyValue args[] = {{1}, {2}};
+    FizzyValue results[2] = {};
+    EXPECT_TRUE(fizzy_execute_multi(instance, 0, args, results, nullptr));
+    EXPECT_EQ(results[0].i64, 2);
+    EXPECT_EQ(results[1].i32, 1);
+
+    EXPECT_FALSE(fizzy_execute_multi(instance, 1, nullptr, nullptr, nullptr));
+
+    FizzyValue result{};
+    EXPECT_TRUE(fizzy_execute_multi(instance, 2, nullptr, &result, nullptr));
+    EXPECT_EQ(result.i32, 42);
+
+    // The single result API does not execute functions with multiple results.
+    EXPECT_THAT(fizzy_execute(instance, 0, args, nullptr), CTraps());
+    EXPECT_THAT(fizzy_execute(instance, 2, nullptr, nullptr), CResult(42_u32));
+
+    fizzy_free_instance(instance);
+}
+
 TEST(capi_execute, execute_with_host_function)
 {
     /* wat2wasm
@@ -56,14 +93,14 @@ TEST(capi_execute, execute_with_host_function)
     FizzyExternalFunction host_funcs[] = {
         {{FizzyValueTypeI32, nullptr, 0},
             [](void*, FizzyInstance*, const FizzyValue*, FizzyExecutionContext*) noexcept {
-                return FizzyExecutionResult{false, true, {42}};
+                return FizzyExecutionResult{false, true, {42}, false};
             },
             nullptr},
         {{FizzyValueTypeI32, &inputs[0], 2},
             [](void*, FizzyInstance*, const FizzyValue* args, FizzyExecutionContext*) noexcept {
                 FizzyValue v;
                 v.i32 = args[0].i32 / args[1].i32;
-                return FizzyExecutionResult{false, true, {v}};
+                return FizzyExecutionResult{false, true, {v}, false};
             },
             nullptr}};
 
@@ -94,7 +131,7 @@ TEST(capi_execute, imported_function_traps)
 
     FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeI32, nullptr, 0},
         [](void*, FizzyInstance*, const FizzyValue*, FizzyExecutionContext*) noexcept {
-            return FizzyExecutionResult{true, false, {}};
+            return FizzyExecutionResult{true, false, {}, false};
         },
         nullptr}};
 
@@ -124,7 +161,7 @@ TEST(capi_execute, imported_function_void)
     FizzyExternalFunction host_funcs[] = {{{},
         [](void* context, FizzyInstance*, const FizzyValue*, FizzyExecutionContext*) noexcept {
             *static_cast<bool*>(context) = true;
-            return FizzyExecutionResult{false, false, {}};
+            return FizzyExecutionResult{false, false, {}, false};
         },
         &called}};
 
@@ -454,3 +491,110 @@ TEST(capi_execute, execute_with_metered_execution_conext)
     fizzy_free_execution_context(ctx);
     fizzy_free_instance(instance);
 }
+
+TEST(capi_execute, execute_interrupted)
+{
+    /* wat2wasm
+    (func (export "loop") (loop (br 0)))
+    (func (return_call 1))
+    (func (result i32) (i32.const 1))
+    (func unreachable)
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000108026000006000017f03050400000100070801046c6f6f7000000a1704070003400c000b"
+        "0b040012010b040041010b0300000b");
+
+    auto module = fizzy_parse(wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module, nullptr);
+
+    auto instance = fizzy_instantiate(
+        module, nullptr, 0, nullptr, nullptr, nullptr, 0, FizzyMemoryPagesLimitDefault, nullptr);
+    ASSERT_NE(instance, nullptr);
+
+    auto* ctx = fizzy_create_execution_context(0);
+    EXPECT_FALSE(fizzy_get_execution_context_interrupt_requested(ctx));
+    const auto trap = fizzy_execute(instance, 3, nullptr, ctx);
+    EXPECT_THAT(trap, CTraps());
+    EXPECT_FALSE(trap.interrupted);
+
+    // The request is not cleared by the execution.
+    fizzy_set_execution_context_interrupt_requested(ctx, true);
+    for (const uint32_t func_idx : {0u, 1u})
+    {
+        const auto result = fizzy_execute(instance, func_idx, nullptr, ctx);
+        EXPECT_THAT(result, CTraps());
+        EXPECT_TRUE(result.interrupted);
+        EXPECT_FALSE(fizzy_execute_multi(instance, func_idx, nullptr, nullptr, ctx));
+        EXPECT_TRUE(fizzy_get_execution_context_interrupt_requested(ctx));
+    }
+
+    fizzy_set_execution_context_interrupt_requested(ctx, false);
+    EXPECT_FALSE(fizzy_get_execution_context_interrupt_requested(ctx));
+    const auto result = fizzy_execute(instance, 2, nullptr, ctx);
+    EXPECT_THAT(result, CResult(1_u32));
+    EXPECT_FALSE(result.interrupted);
+
+    fizzy_free_execution_context(ctx);
+    fizzy_free_instance(instance);
+}
+
+TEST(capi_execute, imported_function_interrupted)
+{
+    /* wat2wasm
+      (func (import "m" "foo"))
+      (func
+        call 0
+      )
+    */
+    const auto wasm =
+        from_hex("0061736d01000000010401600000020901016d03666f6f0000030201000a0601040010000b");
+    auto module = fizzy_parse(wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module, nullptr);
+
+    FizzyExternalFunction host_funcs[] = {{{},
+        [](void*, FizzyInstance*, const FizzyValue*, FizzyExecutionContext*) noexcept {
+            return FizzyExecutionResult{true, false, {}, true};
+        },
+        nullptr}};
+
+    auto instance = fizzy_instantiate(
+        module, host_funcs, 1, nullptr, nullptr, nullptr, 0, FizzyMemoryPagesLimitDefault, nullptr);
+    ASSERT_NE(instance, nullptr);
+
+    const auto result = fizzy_execute(instance, 1, nullptr, nullptr);
+    EXPECT_THAT(result, CTraps());
+    EXPECT_TRUE(result.interrupted);
+
+    fizzy_free_instance(instance);
+}
+
+TEST(capi_execute, imported_function_interrupted_ignored_without_trap)
+{
+    /* wat2wasm
+      (func (import "m" "foo") (result i32))
+      (func (result i32)
+        call 0
+      )
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000105016000017f020901016d03666f6f0000030201000a0601040010000b");
+    auto module = fizzy_parse(wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module, nullptr);
+
+    // The interrupted flag of a successful host function result is ignored.
+    FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeI32, nullptr, 0},
+        [](void*, FizzyInstance*, const FizzyValue*, FizzyExecutionContext*) noexcept {
+            return FizzyExecutionResult{false, true, {42}, true};
+        },
+        nullptr}};
+
+    auto instance = fizzy_instantiate(
+        module, host_funcs, 1, nullptr, nullptr, nullptr, 0, FizzyMemoryPagesLimitDefault, nullptr);
+    ASSERT_NE(instance, nullptr);
+
+    const auto result = fizzy_execute(instance, 1, nullptr, nullptr);
+    EXPECT_THAT(result, CResult(42_u32));
+    EXPECT_FALSE(result.interrupted);
+
+    fizzy_free_instance(instance);
+}
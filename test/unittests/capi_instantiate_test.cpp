@@ -306,7 +306,7 @@ TEST(capi_instantiate, resolve_instantiate_functions)
 
     FizzyExternalFn host_fn = [](void* context, FizzyInstance*, const FizzyValue*,
                                   FizzyExecutionContext*) noexcept {
-        return FizzyExecutionResult{false, true, *static_cast<FizzyValue*>(context)};
+        return FizzyExecutionResult{false, true, *static_cast<FizzyValue*>(context), false};
     };
 
     const FizzyValueType input_type = FizzyValueTypeI32;
@@ -380,7 +380,7 @@ TEST(capi_instantiate, resolve_instantiate_function_duplicate)
 
     FizzyExternalFn host_fn = [](void*, FizzyInstance*, const FizzyValue*,
                                   FizzyExecutionContext*) noexcept {
-        return FizzyExecutionResult{false, true, FizzyValue{42}};
+        return FizzyExecutionResult{false, true, FizzyValue{42}, false};
     };
 
     FizzyExternalFunction mod1foo1 = {{FizzyValueTypeI32, nullptr, 0}, host_fn, nullptr};
@@ -428,7 +428,7 @@ TEST(capi_instantiate, resolve_instantiate_globals)
 
     FizzyExternalFn host_fn = [](void*, FizzyInstance*, const FizzyValue*,
                                   FizzyExecutionContext*) noexcept {
-        return FizzyExecutionResult{true, false, {0}};
+        return FizzyExecutionResult{true, false, {0}, false};
     };
     FizzyImportedFunction mod1foo1 = {
         "mod1", "foo1", {{FizzyValueTypeVoid, nullptr, 0}, host_fn, nullptr}};
@@ -586,6 +586,34 @@ TEST(capi_instantiate, get_instance_module)
     ASSERT_NE(instance_module, nullptr);
 
     EXPECT_EQ(fizzy_get_function_type(instance_module, 0).inputs_size, 2);
+    EXPECT_EQ(instance_module, module);
 
     fizzy_free_instance(instance);
 }
+
+TEST(capi_instantiate, get_instance_module_clone)
+{
+    /* wat2wasm
+      (func (param i32 i32))
+    */
+    const auto wasm = from_hex("0061736d0100000001060160027f7f00030201000a040102000b");
+    auto module = fizzy_parse(wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module, nullptr);
+
+    auto instance = fizzy_instantiate(
+        module, nullptr, 0, nullptr, nullptr, nullptr, 0, FizzyMemoryPagesLimitDefault, nullptr);
+    ASSERT_NE(instance, nullptr);
+
+    // The clone of the instance's module outlives the instance.
+    const auto* module_clone = fizzy_clone_module(fizzy_get_instance_module(instance));
+    ASSERT_NE(module_clone, nullptr);
+    fizzy_free_instance(instance);
+
+    EXPECT_EQ(fizzy_get_function_type(module_clone, 0).inputs_size, 2);
+
+    auto instance2 = fizzy_instantiate(module_clone, nullptr, 0, nullptr, nullptr, nullptr, 0,
+        FizzyMemoryPagesLimitDefault, nullptr);
+    ASSERT_NE(instance2, nullptr);
+    EXPECT_EQ(fizzy_get_instance_module(instance2), module_clone);
+    fizzy_free_instance(instance2);
+}
@@ -49,6 +49,33 @@ TEST(capi_module, get_function_type)
     fizzy_free_module(module);
 }
 
+TEST(capi_module, get_function_outputs)
+{
+    /* wat2wasm
+      (func (param i32 i64) (result i64 i32) (local.get 1) (local.get 0))
+      (func unreachable)
+      (func (result i32) i32.const 42)
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010f0360027f7e027e7f6000006000017f0304030001020a11030600200120000b0300000b"
+        "0400412a0b");
+    const auto module = fizzy_parse(wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module, nullptr);
+
+    const FizzyValueType* outputs = nullptr;
+    ASSERT_EQ(fizzy_get_function_outputs(module, 0, &outputs), 2);
+    EXPECT_EQ(outputs[0], FizzyValueTypeI64);
+    EXPECT_EQ(outputs[1], FizzyValueTypeI32);
+    EXPECT_EQ(fizzy_get_function_type(module, 0).output, FizzyValueTypeI64);
+
+    EXPECT_EQ(fizzy_get_function_outputs(module, 1, &outputs), 0);
+
+    ASSERT_EQ(fizzy_get_function_outputs(module, 2, &outputs), 1);
+    EXPECT_EQ(outputs[0], FizzyValueTypeI32);
+
+    fizzy_free_module(module);
+}
+
 TEST(capi_module, has_table)
 {
     /* wat2wasm
@@ -203,6 +203,41 @@ TEST(capi, clone_module)
     fizzy_free_module(module1);
 }
 
+TEST(capi, parse_cached)
+{
+    /* wat2wasm
+      (func (param i32 i32) (result i32) (i32.const 0))
+    */
+    const auto wasm = from_hex("0061736d0100000001070160027f7f017f030201000a0601040041000b");
+
+    auto* cache = fizzy_create_module_cache(1024);
+    ASSERT_NE(cache, nullptr);
+
+    FizzyError error;
+    const auto* module1 = fizzy_parse_cached(cache, wasm.data(), wasm.size(), &error);
+    ASSERT_NE(module1, nullptr);
+    EXPECT_EQ(error.code, FizzySuccess);
+    const auto* module2 = fizzy_parse_cached(cache, wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module2, nullptr);
+    EXPECT_NE(module1, module2);
+    EXPECT_EQ(fizzy_get_function_type(module2, 0).inputs_size, 2);
+
+    const uint8_t invalid_wasm[]{0x00, 0x61, 0x73, 0x6d};
+    EXPECT_EQ(fizzy_parse_cached(cache, invalid_wasm, sizeof(invalid_wasm), &error), nullptr);
+    EXPECT_EQ(error.code, FizzyErrorMalformedModule);
+    EXPECT_STREQ(error.message, "invalid wasm module prefix");
+
+    // The modules are independent of the cache.
+    fizzy_free_module_cache(cache);
+    auto* instance = fizzy_instantiate(
+        module1, nullptr, 0, nullptr, nullptr, nullptr, 0, FizzyMemoryPagesLimitDefault, nullptr);
+    ASSERT_NE(instance, nullptr);
+    fizzy_free_instance(instance);
+    fizzy_free_module(module2);
+
+    fizzy_free_module_cache(nullptr);
+}
+
 TEST(capi, memory_access_no_memory)
 {
     /* wat2wasm
@@ -0,0 +1,310 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "checkpoint.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+#include <algorithm>
+#include <limits>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (type $t (func (param i32) (result i32)))
+  (table 1 funcref)
+  (elem (i32.const 0) $sum)
+  (memory 1)
+  (global $g (mut i32) (i32.const 0))
+  (func $sum (param i32) (result i32) (local i32)
+    (loop
+      (local.set 1 (i32.add (local.get 1) (local.get 0)))
+      (global.set $g (i32.add (global.get $g) (i32.const 1)))
+      (i32.store (i32.const 0) (local.get 1))
+      (br_if 0 (local.tee 0 (i32.sub (local.get 0) (i32.const 1)))))
+    (local.get 1))
+  (func $rec (param i32) (result i32)
+    (if (result i32) (local.get 0)
+      (then (i32.add (local.get 0) (call $rec (i32.sub (local.get 0) (i32.const 1)))))
+      (else (call_indirect (type $t) (i32.const 100) (i32.const 0)))))
+  (func $tail (param i32) (result i32) (return_call $rec (local.get 0)))
+  (func (param i32) (result i32)
+    (i32.add (i32.add (call $tail (local.get 0)) (i32.load (i32.const 0))) (global.get $g)))
+*/
+const auto wasm = from_hex(
+    "0061736d0100000001060160017f017f0305040000000004040170000105030100010606017f0141000b090701"
+    "0041000b01000a5b042701017f0340200120006a2101230041016a240041002001360200200041016b22000d00"
+    "0b20010b1a002000047f2000200041016b10016a0541e40041001100000b0b0600200012010b0f002000100241"
+    "002802006a23006a0b");
+
+/// The ticks granted to each part of the execution.
+constexpr int64_t TicksPerPart = 50;
+
+/// Returns the ticks consumed by the execution of the function 3 without checkpoints.
+int64_t get_execution_cost(Instance& instance)
+{
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = std::numeric_limits<int64_t>::max();
+    EXPECT_THAT(execute(instance, 3, {10}, ctx), Result(10255));
+    return std::numeric_limits<int64_t>::max() - ctx.ticks;
+}
+}  // namespace
+
+TEST(checkpoint, execute_without_running_out_of_ticks)
+{
+    const auto instance = instantiate(parse(wasm));
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = 100000;
+    const Value args[]{10};
+    Value result{};
+    std::optional<Checkpoint> checkpoint;
+    EXPECT_THAT(execute_checkpointable(*instance, 3, args, &result, ctx, checkpoint), Result());
+    EXPECT_EQ(result.i32, 10255);
+    EXPECT_FALSE(checkpoint.has_value());
+    EXPECT_EQ(ctx.checkpoint_execution, nullptr);
+}
+
+TEST(checkpoint, resume)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto cost = get_execution_cost(*instantiate(module));
+    const auto instance = instantiate(module);
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = TicksPerPart;
+    const Value args[]{10};
+    Value result{};
+    std::optional<Checkpoint> checkpoint;
+    std::optional<ExecutionResult> ret;
+    ret.emplace(execute_checkpointable(*instance, 3, args, &result, ctx, checkpoint));
+
+    int64_t num_parts = 1;
+    size_t max_num_frames = 0;
+    while (ret->suspended)
+    {
+        ASSERT_TRUE(checkpoint.has_value());
+        EXPECT_EQ(ctx.depth, 0);
+        max_num_frames = std::max(max_num_frames, checkpoint->frames.size());
+
+        ctx.ticks = checkpoint->ticks + TicksPerPart;
+        ++num_parts;
+        ret.emplace(resume_checkpoint(*instance, &result, ctx, checkpoint));
+    }
+    EXPECT_THAT(*ret, Result());
+    EXPECT_EQ(result.i32, 10255);
+    EXPECT_FALSE(checkpoint.has_value());
+
+    // The frames of the recursion, the tail callee and the function called indirectly.
+    EXPECT_EQ(max_num_frames, 13);
+    // The instructions executed again when resumed are not charged twice.
+    EXPECT_EQ(num_parts * TicksPerPart - ctx.ticks, cost);
+}
+
+TEST(checkpoint, resume_in_new_instance)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = TicksPerPart;
+    const Value args[]{10};
+    Value result{};
+    std::optional<Checkpoint> checkpoint;
+    auto instance = instantiate(module);
+    std::optional<ExecutionResult> ret;
+    ret.emplace(execute_checkpointable(*instance, 3, args, &result, ctx, checkpoint));
+
+    int num_parts = 1;
+    while (ret->suspended)
+    {
+        // The instance is replaced, as it was lost with the process.
+        const auto serialized = serialize_checkpoint(*checkpoint);
+        checkpoint.reset();
+        instance = instantiate(module);
+        checkpoint = deserialize_checkpoint(serialized, *instance);
+
+        ctx.ticks = checkpoint->ticks + TicksPerPart;
+        ++num_parts;
+        ret.emplace(resume_checkpoint(*instance, &result, ctx, checkpoint));
+    }
+    EXPECT_THAT(*ret, Result());
+    EXPECT_EQ(result.i32, 10255);
+    EXPECT_GT(num_parts, 10);
+    EXPECT_EQ(instance->globals[0].i32, 100);
+}
+
+TEST(checkpoint, resume_in_module_with_other_code_layout)
+{
+    // The module parsed with a profile lays out the code of the functions in another order.
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const uint64_t call_counts[]{1, 1, 1, 1000};
+    const std::shared_ptr<const Module> profiled_module = parse(wasm, call_counts);
+    ASSERT_NE(profiled_module->code_buffer, module->code_buffer);
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = TicksPerPart;
+    const Value args[]{10};
+    Value result{};
+    std::optional<Checkpoint> checkpoint;
+    const auto instance = instantiate(module);
+    ASSERT_TRUE(execute_checkpointable(*instance, 3, args, &result, ctx, checkpoint).suspended);
+
+    const auto profiled_instance = instantiate(profiled_module);
+    checkpoint = deserialize_checkpoint(serialize_checkpoint(*checkpoint), *profiled_instance);
+    ctx.ticks = std::numeric_limits<int64_t>::max();
+    EXPECT_THAT(resume_checkpoint(*profiled_instance, &result, ctx, checkpoint), Result());
+    EXPECT_EQ(result.i32, 10255);
+}
+
+TEST(checkpoint, deserialize_invalid)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto instance = instantiate(module);
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = 1000;
+    const Value args[]{10};
+    Value result{};
+    std::optional<Checkpoint> checkpoint;
+    ASSERT_TRUE(execute_checkpointable(*instance, 3, args, &result, ctx, checkpoint).suspended);
+    const auto serialized = serialize_checkpoint(*checkpoint);
+    EXPECT_EQ(
+        deserialize_checkpoint(serialized, *instance).frames.size(), checkpoint->frames.size());
+
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(serialized.substr(0, serialized.size() - 1),
+                             *instance),
+        parser_error, "unexpected end of checkpoint");
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(serialized + uint8_t{0}, *instance), parser_error,
+        "unexpected data at the end of checkpoint");
+    EXPECT_THROW_MESSAGE(
+        deserialize_checkpoint(wasm, *instance), parser_error, "invalid checkpoint magic");
+
+    /* wat2wasm
+      (func (param i32) (result i32) (local.get 0))
+    */
+    const auto other_wasm = from_hex("0061736d0100000001060160017f017f030201000a0601040020000b");
+    const auto other_instance = instantiate(parse(other_wasm));
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(serialized, *other_instance), instantiate_error,
+        "checkpoint of another module");
+
+    // The same code with another initial value of the global.
+    auto other_global_wasm = wasm;
+    const auto global_pos = other_global_wasm.find(from_hex("0606017f0141000b"));
+    ASSERT_NE(global_pos, bytes::npos);
+    other_global_wasm[global_pos + 6] = 0x01;
+    const auto other_global_instance = instantiate(parse(other_global_wasm));
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(serialized, *other_global_instance),
+        instantiate_error, "checkpoint of another module");
+}
+
+TEST(checkpoint, deserialize_at_every_instruction)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto cost = get_execution_cost(*instantiate(module));
+
+    // Checkpoints are taken at the start of each executed instruction and at each call site.
+    for (int64_t ticks = 0; ticks < cost; ++ticks)
+    {
+        ExecutionContext ctx;
+        ctx.metering_enabled = true;
+        ctx.ticks = ticks;
+        const Value args[]{10};
+        Value result{};
+        std::optional<Checkpoint> checkpoint;
+        const auto instance = instantiate(module);
+        ASSERT_TRUE(execute_checkpointable(*instance, 3, args, &result, ctx, checkpoint).suspended);
+
+        const auto resumed_instance = instantiate(module);
+        checkpoint = deserialize_checkpoint(serialize_checkpoint(*checkpoint), *resumed_instance);
+        ctx.ticks = std::numeric_limits<int64_t>::max();
+        EXPECT_THAT(resume_checkpoint(*resumed_instance, &result, ctx, checkpoint), Result());
+        EXPECT_EQ(result.i32, 10255);
+    }
+}
+
+TEST(checkpoint, deserialize_v128_locals)
+{
+    /* wat2wasm --enable-simd
+      (func (param i32) (result i32) (local v128)
+        (local.set 0 (i32.add (local.get 0) (i32.const 1)))
+        (drop (local.tee 1 (i32x4.splat (local.get 0))))
+        (i32x4.extract_lane 3 (local.get 1)))
+    */
+    const auto simd_wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a19011701017b200041016a21002000fd1122011a20"
+        "01fd1b030b");
+    const std::shared_ptr<const Module> module = parse(simd_wasm);
+    const auto instance = instantiate(module);
+
+    // The v128 local.tee and drop are executed as multiple instructions, each moving one slot.
+    for (int64_t ticks = 0;; ++ticks)
+    {
+        ExecutionContext ctx;
+        ctx.metering_enabled = true;
+        ctx.ticks = ticks;
+        const Value args[]{10};
+        Value result{};
+        std::optional<Checkpoint> checkpoint;
+        if (!execute_checkpointable(*instance, 0, args, &result, ctx, checkpoint).suspended)
+        {
+            EXPECT_EQ(result.i32, 11);
+            break;
+        }
+
+        checkpoint = deserialize_checkpoint(serialize_checkpoint(*checkpoint), *instance);
+        ctx.ticks = std::numeric_limits<int64_t>::max();
+        EXPECT_THAT(resume_checkpoint(*instance, &result, ctx, checkpoint), Result());
+        EXPECT_EQ(result.i32, 11);
+    }
+}
+
+TEST(checkpoint, deserialize_invalid_frames)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto instance = instantiate(module);
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = 1000;
+    const Value args[]{10};
+    Value result{};
+    std::optional<Checkpoint> checkpoint;
+    ASSERT_TRUE(execute_checkpointable(*instance, 3, args, &result, ctx, checkpoint).suspended);
+    ASSERT_GE(checkpoint->frames.size(), 2);
+
+    // The code format version follows the magic bytes and the checkpoint version.
+    auto other_code_format = serialize_checkpoint(*checkpoint);
+    ++other_code_format[8];
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(other_code_format, *instance), parser_error,
+        "unsupported checkpoint code format");
+
+    // The offset of the immediate of the first instruction: local.get 0.
+    auto tampered = *checkpoint;
+    tampered.frames.front().code_offset = 1;
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(serialize_checkpoint(tampered), *instance),
+        instantiate_error, "checkpoint frame with invalid code offset");
+
+    tampered = *checkpoint;
+    tampered.frames.back().stack.push_back(0);
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(serialize_checkpoint(tampered), *instance),
+        instantiate_error, "checkpoint frame with invalid stack height");
+
+    // The outer frame at the first instruction, which is not the call of the next frame.
+    tampered = *checkpoint;
+    tampered.frames.front().code_offset = 0;
+    tampered.frames.front().stack.clear();
+    EXPECT_THROW_MESSAGE(deserialize_checkpoint(serialize_checkpoint(tampered), *instance),
+        instantiate_error, "checkpoint frame is not at a call");
+}
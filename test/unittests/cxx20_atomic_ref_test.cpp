@@ -0,0 +1,40 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "cxx20/atomic_ref.hpp"
+#include <gtest/gtest.h>
+#include <cstdint>
+
+using namespace fizzy;
+
+TEST(cxx20_atomic_ref, operations)
+{
+    uint32_t value = 10;
+    const atomic_ref<uint32_t> ref{value};
+
+    EXPECT_EQ(ref.load(), 10);
+    ref.store(20);
+    EXPECT_EQ(value, 20);
+    EXPECT_EQ(ref.fetch_add(5), 20);
+    EXPECT_EQ(ref.fetch_sub(30), 25);
+    EXPECT_EQ(value, 0xfffffffb);
+    EXPECT_EQ(ref.fetch_and(0xf0), 0xfffffffb);
+    EXPECT_EQ(ref.fetch_or(0x0f), 0xf0);
+    EXPECT_EQ(ref.fetch_xor(0xff), 0xff);
+    EXPECT_EQ(ref.exchange(7), 0);
+    EXPECT_EQ(value, 7);
+}
+
+TEST(cxx20_atomic_ref, compare_exchange_strong)
+{
+    uint8_t value = 1;
+    const atomic_ref<uint8_t> ref{value};
+
+    uint8_t expected = 2;
+    EXPECT_FALSE(ref.compare_exchange_strong(expected, 3));
+    EXPECT_EQ(expected, 1);
+    EXPECT_EQ(value, 1);
+    EXPECT_TRUE(ref.compare_exchange_strong(expected, 3));
+    EXPECT_EQ(value, 3);
+}
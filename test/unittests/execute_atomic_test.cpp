@@ -0,0 +1,262 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instance_pool.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm --enable-threads
+  (import "env" "memory" (memory 1 1 shared))
+  (func (param i32) (result i32) (i32.atomic.load (local.get 0)))
+  (func (param i32 i32) (i32.atomic.store (local.get 0) (local.get 1)))
+  (func (param i32 i32) (result i32) (i32.atomic.rmw.add (local.get 0) (local.get 1)))
+  (func (param i32 i32) (result i32) (i32.atomic.rmw8.sub_u (local.get 0) (local.get 1)))
+  (func (param i32 i64) (result i64) (i64.atomic.rmw16.xor_u (local.get 0) (local.get 1)))
+  (func (param i32 i32) (result i32) (i32.atomic.rmw.xchg (local.get 0) (local.get 1)))
+  (func (param i32 i32 i32) (result i32)
+    (i32.atomic.rmw.cmpxchg (local.get 0) (local.get 1) (local.get 2)))
+  (func (param i32 i64 i64) (result i64)
+    (i64.atomic.rmw32.cmpxchg_u (local.get 0) (local.get 1) (local.get 2)))
+  (func (param i32 i32 i64) (result i32)
+    (memory.atomic.wait32 (local.get 0) (local.get 1) (local.get 2)))
+  (func (param i32 i64 i64) (result i32)
+    (memory.atomic.wait64 (local.get 0) (local.get 1) (local.get 2)))
+  (func (param i32 i32) (result i32) (memory.atomic.notify (local.get 0) (local.get 1)))
+  (func (param i32) (result i32) (atomic.fence) (i32.atomic.load16_u offset=2 (local.get 0)))
+  (func (param i32) (result i32) (memory.grow (local.get 0)))
+*/
+const auto wasm = from_hex(
+    "0061736d0100000001330860017f017f60027f7f017f60037f7f7f017f60027f7e017e60037f7f7e017f60037f"
+    "7e7e017f60027f7f0060037f7e7e017e02100103656e76066d656d6f727902030101030e0d0006010103010207"
+    "04050100000a93010d08002000fe1002000b0a0020002001fe1702000b0a0020002001fe1e02000b0a00200020"
+    "01fe2700000b0a0020002001fe3f01000b0a0020002001fe4102000b0c00200020012002fe4802000b0c002000"
+    "20012002fe4e02000b0c00200020012002fe0102000b0c00200020012002fe0203000b0a0020002001fe000200"
+    "0b0b00fe03002000fe1301020b0600200040000b");
+
+/* wat2wasm --enable-threads
+  (memory 1)
+  (func (param i32 i32 i64) (result i32)
+    (memory.atomic.wait32 (local.get 0) (local.get 1) (local.get 2)))
+  (func (param i32 i32) (result i32) (memory.atomic.notify (local.get 0) (local.get 1)))
+*/
+const auto wasm_unshared = from_hex(
+    "0061736d01000000010e0260037f7f7e017f60027f7f017f030302000105030100010a19020c00200020012002"
+    "fe0102000b0a0020002001fe0002000b");
+
+std::unique_ptr<Instance> instantiate_shared(std::shared_ptr<const Module> module, bytes& memory)
+{
+    return instantiate(std::move(module), {}, {}, {{&memory, {1, 1, true}}});
+}
+}  // namespace
+
+TEST(execute_atomic, load_store)
+{
+    bytes memory(PageSize, 0);
+    auto instance = instantiate_shared(parse(wasm), memory);
+
+    EXPECT_THAT(execute(*instance, 1, {8, 0x11223344}), Result());
+    EXPECT_THAT(execute(*instance, 0, {8}), Result(0x11223344));
+    EXPECT_THAT(execute(*instance, 11, {8}), Result(0x1122));
+    EXPECT_THAT(execute(*instance, 1, {PageSize - 4, 7}), Result());
+    EXPECT_THAT(execute(*instance, 0, {PageSize - 4}), Result(7));
+}
+
+TEST(execute_atomic, read_modify_write)
+{
+    bytes memory(PageSize, 0);
+    auto instance = instantiate_shared(parse(wasm), memory);
+
+    EXPECT_THAT(execute(*instance, 1, {0, 0x1234}), Result());
+    EXPECT_THAT(execute(*instance, 2, {0, 0xffffffff}), Result(0x1234));
+    EXPECT_THAT(execute(*instance, 0, {0}), Result(0x1233));
+
+    // The narrow operations wrap the operand and the result in the accessed bytes.
+    EXPECT_THAT(execute(*instance, 3, {0, 0x134}), Result(0x33));
+    EXPECT_THAT(execute(*instance, 0, {0}), Result(0x12ff));
+    EXPECT_THAT(execute(*instance, 4, {2, 0xffff00ff_u64}), Result(0_u64));
+    EXPECT_THAT(execute(*instance, 0, {0}), Result(0x00ff12ff));
+
+    EXPECT_THAT(execute(*instance, 5, {0, 5}), Result(0x00ff12ff));
+    EXPECT_THAT(execute(*instance, 0, {0}), Result(5));
+}
+
+TEST(execute_atomic, compare_exchange)
+{
+    bytes memory(PageSize, 0);
+    auto instance = instantiate_shared(parse(wasm), memory);
+
+    EXPECT_THAT(execute(*instance, 6, {4, 1, 2}), Result(0));
+    EXPECT_THAT(execute(*instance, 0, {4}), Result(0));
+    EXPECT_THAT(execute(*instance, 6, {4, 0, 2}), Result(0));
+    EXPECT_THAT(execute(*instance, 0, {4}), Result(2));
+
+    // The expected value is wrapped to 32 bits.
+    EXPECT_THAT(execute(*instance, 7, {4, 0x100000002_u64, 0x300000009_u64}), Result(2_u64));
+    EXPECT_THAT(execute(*instance, 0, {4}), Result(9));
+}
+
+TEST(execute_atomic, unaligned_and_out_of_bounds)
+{
+    bytes memory(PageSize, 0);
+    auto instance = instantiate_shared(parse(wasm), memory);
+
+    EXPECT_THAT(execute(*instance, 0, {2}), Traps());
+    EXPECT_THAT(execute(*instance, 1, {1, 1}), Traps());
+    EXPECT_THAT(execute(*instance, 2, {3, 1}), Traps());
+    EXPECT_THAT(execute(*instance, 10, {2, 1}), Traps());
+    EXPECT_THAT(execute(*instance, 11, {1}), Traps());
+    EXPECT_THAT(execute(*instance, 0, {0}), Result(0));
+
+    EXPECT_THAT(execute(*instance, 0, {PageSize}), Traps());
+    EXPECT_THAT(execute(*instance, 11, {PageSize - 2}), Traps());
+    EXPECT_THAT(execute(*instance, 7, {0xfffffffc, 0_u64, 0_u64}), Traps());
+    EXPECT_THAT(execute(*instance, 9, {PageSize - 4, 0_u64, 0_u64}), Traps());
+}
+
+TEST(execute_atomic, wait_not_equal_and_timeout)
+{
+    bytes memory(PageSize, 0);
+    auto instance = instantiate_shared(parse(wasm), memory);
+
+    EXPECT_THAT(execute(*instance, 1, {16, 1}), Result());
+    EXPECT_THAT(execute(*instance, 8, {16, 0, int64_t{-1}}), Result(1));
+    EXPECT_THAT(execute(*instance, 8, {16, 1, int64_t{0}}), Result(2));
+    EXPECT_THAT(execute(*instance, 8, {16, 1, int64_t{1000}}), Result(2));
+    EXPECT_THAT(execute(*instance, 9, {16, 0_u64, int64_t{-1}}), Result(1));
+    EXPECT_THAT(execute(*instance, 9, {16, 1_u64, int64_t{1000}}), Result(2));
+
+    EXPECT_THAT(execute(*instance, 10, {16, 1}), Result(0));
+}
+
+TEST(execute_atomic, wait_notify_threads)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    bytes memory(PageSize, 0);
+    auto notifying_instance = instantiate_shared(module, memory);
+
+    constexpr int num_waiters = 3;
+    std::vector<std::thread> waiters;
+    std::vector<uint32_t> wait_results(num_waiters, 0xff);
+    for (int i = 0; i < num_waiters; ++i)
+    {
+        waiters.emplace_back([&module, &memory, &wait_results, i] {
+            auto instance = instantiate_shared(module, memory);
+            const auto result = fizzy::test::execute(*instance, 8, {64, 0, int64_t{-1}});
+            wait_results[static_cast<size_t>(i)] = result.value.i32;
+        });
+    }
+
+    // Retry until all the waiters are woken, as they may not be queued yet.
+    uint32_t num_woken = 0;
+    while (num_woken < num_waiters)
+    {
+        num_woken += execute(*notifying_instance, 10, {64, 1}).value.i32;
+        std::this_thread::yield();
+    }
+    for (auto& waiter : waiters)
+        waiter.join();
+
+    EXPECT_EQ(wait_results, std::vector<uint32_t>(num_waiters, 0));
+    EXPECT_THAT(execute(*notifying_instance, 10, {64, 1}), Result(0));
+}
+
+TEST(execute_atomic, wait_interrupted)
+{
+    bytes memory(PageSize, 0);
+    auto instance = instantiate_shared(parse(wasm), memory);
+
+    // The wait without a timeout is stopped by the interrupt request, which does not notify it.
+    for (const auto func_idx : {FuncIdx{8}, FuncIdx{9}})
+    {
+        ExecutionContext ctx;
+        std::thread timer{[&ctx] {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            ctx.interrupt_requested = true;
+        }};
+        const auto result = func_idx == 8 ? execute(*instance, 8, {32, 0, int64_t{-1}}, ctx) :
+                                            execute(*instance, 9, {32, 0_u64, int64_t{-1}}, ctx);
+        timer.join();
+
+        EXPECT_THAT(result, Traps());
+        EXPECT_TRUE(result.interrupted);
+        EXPECT_EQ(ctx.depth, 0);
+    }
+
+    // The interrupted waiter has left the queue.
+    EXPECT_THAT(execute(*instance, 10, {32, 1}), Result(0));
+}
+
+TEST(execute_atomic, concurrent_increments)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    bytes memory(PageSize, 0);
+
+    constexpr int num_threads = 4;
+    constexpr int num_increments = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        // Each thread executes its own instance importing the shared memory.
+        threads.emplace_back([&module, &memory] {
+            auto instance = instantiate_shared(module, memory);
+            for (int i = 0; i < num_increments; ++i)
+                fizzy::test::execute(*instance, 2, {32, 1});
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    auto instance = instantiate_shared(module, memory);
+    EXPECT_THAT(execute(*instance, 0, {32}), Result(num_threads * num_increments));
+}
+
+TEST(execute_atomic, shared_memory_grow)
+{
+    bytes memory(PageSize, 0);
+    auto instance = instantiate_shared(parse(wasm), memory);
+
+    EXPECT_THAT(execute(*instance, 12, {0}), Result(1));
+    EXPECT_THAT(execute(*instance, 12, {1}), Result(-1));
+    EXPECT_EQ(memory.size(), PageSize);
+}
+
+TEST(execute_atomic, unshared_memory)
+{
+    auto instance = instantiate(parse(wasm_unshared));
+
+    EXPECT_THAT(execute(*instance, 0, {0, 0, int64_t{0}}), Traps());
+    EXPECT_THAT(execute(*instance, 1, {0, 1}), Result(0));
+    EXPECT_THAT(execute(*instance, 1, {1, 1}), Traps());
+}
+
+TEST(execute_atomic, instance_pool_reset)
+{
+    /* wat2wasm --enable-threads
+      (memory 1 1 shared)
+      (func (param i32 i32) (result i32) (i32.atomic.rmw.add (local.get 0) (local.get 1)))
+    */
+    const auto wasm_defined = from_hex(
+        "0061736d0100000001070160027f7f017f030201000504010301010a0c010a0020002001fe1e02000b");
+
+    InstancePool pool{parse(wasm_defined)};
+    auto instance = pool.acquire();
+    EXPECT_TRUE(instance->memory_limits.shared);
+    EXPECT_THAT(execute(*instance, 0, {2 * DirtyMemoryBlockSize, 5}), Result(0));
+    pool.release(std::move(instance));
+
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 0, {2 * DirtyMemoryBlockSize, 1}), Result(0));
+}
@@ -0,0 +1,159 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instance_pool.hpp"
+#include "parser.hpp"
+#include "snapshot.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm --enable-bulk-memory
+  (memory 1)
+  (func (param i32 i32 i32) (memory.init 0 (local.get 0) (local.get 1) (local.get 2)))
+  (func (data.drop 0))
+  (func (param i32 i32 i32) (memory.copy (local.get 0) (local.get 1) (local.get 2)))
+  (func (param i32 i32 i32) (memory.fill (local.get 0) (local.get 1) (local.get 2)))
+  (func (param i32) (result i32) (i32.load (local.get 0)))
+  (func (param i32 i32 i32) (memory.init 1 (local.get 0) (local.get 1) (local.get 2)))
+  (data "\01\02\03\04")
+  (data (i32.const 100) "\aa\bb")
+*/
+const auto wasm = from_hex(
+    "0061736d01000000010f0360037f7f7f0060000060017f017f03070600010000020005030100010c01020a4206"
+    "0c00200020012002fc0800000b0500fc09000b0c00200020012002fc0a00000b0b00200020012002fc0b000b07"
+    "0020002802000b0c00200020012002fc0801000b0b0f020104010203040041e4000b02aabb");
+}  // namespace
+
+TEST(execute_bulk_memory, memory_init)
+{
+    auto instance = instantiate(parse(wasm));
+    EXPECT_THAT(execute(*instance, 0, {8, 1, 3}), Result());
+    EXPECT_THAT(execute(*instance, 4, {8}), Result(0x040302));
+    EXPECT_THAT(execute(*instance, 0, {PageSize - 4, 0, 4}), Result());
+    EXPECT_THAT(execute(*instance, 4, {PageSize - 4}), Result(0x04030201));
+
+    // The passive segment is not applied at instantiation.
+    EXPECT_THAT(execute(*instance, 4, {0}), Result(0));
+    EXPECT_THAT(execute(*instance, 4, {100}), Result(0xbbaa));
+}
+
+TEST(execute_bulk_memory, memory_init_out_of_bounds)
+{
+    auto instance = instantiate(parse(wasm));
+    EXPECT_THAT(execute(*instance, 0, {0, 1, 4}), Traps());
+    EXPECT_THAT(execute(*instance, 0, {0, 5, 0}), Traps());
+    EXPECT_THAT(execute(*instance, 0, {PageSize - 3, 0, 4}), Traps());
+    EXPECT_THAT(execute(*instance, 0, {PageSize + 1, 0, 0}), Traps());
+    EXPECT_THAT(execute(*instance, 0, {0xffffffff, 0, 4}), Traps());
+    EXPECT_THAT(execute(*instance, 4, {PageSize - 4}), Result(0));
+
+    // Empty ranges at the ends are in bounds.
+    EXPECT_THAT(execute(*instance, 0, {PageSize, 4, 0}), Result());
+}
+
+TEST(execute_bulk_memory, data_drop)
+{
+    auto instance = instantiate(parse(wasm));
+    EXPECT_THAT(execute(*instance, 1, {}), Result());
+    EXPECT_THAT(execute(*instance, 1, {}), Result());
+    EXPECT_THAT(execute(*instance, 0, {0, 0, 1}), Traps());
+    EXPECT_THAT(execute(*instance, 0, {0, 0, 0}), Result());
+
+    // The active segment is dropped by instantiation.
+    EXPECT_THAT(execute(*instance, 5, {0, 0, 1}), Traps());
+    EXPECT_THAT(execute(*instance, 5, {0, 0, 0}), Result());
+}
+
+TEST(execute_bulk_memory, memory_copy)
+{
+    auto instance = instantiate(parse(wasm));
+    EXPECT_THAT(execute(*instance, 0, {0, 0, 4}), Result());
+
+    EXPECT_THAT(execute(*instance, 2, {1, 0, 4}), Result());
+    EXPECT_THAT(execute(*instance, 4, {0}), Result(0x03020101));
+    EXPECT_THAT(execute(*instance, 4, {4}), Result(0x04));
+
+    EXPECT_THAT(execute(*instance, 2, {0, 2, 3}), Result());
+    EXPECT_THAT(execute(*instance, 4, {0}), Result(0x03040302));
+
+    EXPECT_THAT(execute(*instance, 2, {PageSize - 2, 0, 2}), Result());
+    EXPECT_THAT(execute(*instance, 4, {PageSize - 4}), Result(0x03020000));
+}
+
+TEST(execute_bulk_memory, memory_copy_out_of_bounds)
+{
+    auto instance = instantiate(parse(wasm));
+    EXPECT_THAT(execute(*instance, 2, {0, PageSize - 1, 2}), Traps());
+    EXPECT_THAT(execute(*instance, 2, {PageSize - 1, 0, 2}), Traps());
+    EXPECT_THAT(execute(*instance, 2, {0, 0xffffffff, 2}), Traps());
+    EXPECT_THAT(execute(*instance, 2, {PageSize + 1, 0, 0}), Traps());
+    EXPECT_THAT(execute(*instance, 2, {PageSize, PageSize, 0}), Result());
+}
+
+TEST(execute_bulk_memory, memory_fill)
+{
+    auto instance = instantiate(parse(wasm));
+    EXPECT_THAT(execute(*instance, 3, {1, 0x1ab, 2}), Result());
+    EXPECT_THAT(execute(*instance, 4, {0}), Result(0xabab00));
+
+    EXPECT_THAT(execute(*instance, 3, {0, 0x11, PageSize}), Result());
+    EXPECT_THAT(execute(*instance, 4, {PageSize - 4}), Result(0x11111111));
+
+    EXPECT_THAT(execute(*instance, 3, {PageSize - 1, 0, 2}), Traps());
+    EXPECT_THAT(execute(*instance, 3, {PageSize, 0, 0}), Result());
+}
+
+TEST(execute_bulk_memory, metering)
+{
+    auto instance = instantiate(parse(wasm));
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = 1000;
+    // 3 local.get, memory.fill, end and 100 bytes.
+    EXPECT_THAT(execute(*instance, 3, {0, 1, 100}, ctx), Result());
+    EXPECT_EQ(ctx.ticks, 1000 - 5 - 100);
+
+    ctx.ticks = 104;
+    EXPECT_THAT(execute(*instance, 2, {0, 100, 100}, ctx), Traps());
+    EXPECT_THAT(execute(*instance, 4, {100}), Result(0xbbaa));
+}
+
+TEST(execute_bulk_memory, instance_pool_reset)
+{
+    InstancePool pool{parse(wasm)};
+    auto instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 3, {2 * DirtyMemoryBlockSize, 0x22, 2}), Result());
+    EXPECT_THAT(execute(*instance, 0, {3 * DirtyMemoryBlockSize, 0, 4}), Result());
+    EXPECT_THAT(execute(*instance, 2, {4 * DirtyMemoryBlockSize, 100, 2}), Result());
+    EXPECT_THAT(execute(*instance, 1, {}), Result());
+    EXPECT_FALSE(instance->memory_dirty_untracked);
+    pool.release(std::move(instance));
+
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 4, {2 * DirtyMemoryBlockSize}), Result(0));
+    EXPECT_THAT(execute(*instance, 4, {3 * DirtyMemoryBlockSize}), Result(0));
+    EXPECT_THAT(execute(*instance, 4, {4 * DirtyMemoryBlockSize}), Result(0));
+    EXPECT_THAT(execute(*instance, 0, {0, 0, 4}), Result());
+}
+
+TEST(execute_bulk_memory, snapshot_dropped_segments)
+{
+    auto instance = instantiate(parse(wasm));
+    const auto snap = snapshot(*instance);
+    EXPECT_THAT(execute(*instance, 1, {}), Result());
+    auto copy = copy_instance(*instance);
+
+    restore(*instance, snap);
+    EXPECT_THAT(execute(*instance, 0, {0, 0, 4}), Result());
+    EXPECT_THAT(execute(*copy, 0, {0, 0, 4}), Traps());
+}
@@ -374,6 +374,147 @@ TEST(execute_call_depth, execute_internal_function_infinite_recursion)
     EXPECT_EQ(counter.i64, 0);
 }
 
+TEST(execute_call_depth, trap_restores_depth)
+{
+    // The trap unwinds all the frames at once, the call depth must be restored anyway.
+
+    /* wat2wasm
+    (global $counter (import "host" "counter") (mut i64))
+    (func $f
+      (global.set $counter (i64.add (global.get $counter) (i64.const 1)))
+      (call $f)
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001040160000002110104686f737407636f756e746572037e01030201000a0d010b00230042"
+        "017c240010000b");
+
+    Value counter;
+    auto instance = instantiate(parse(wasm), {}, {}, {}, {{&counter, {ValType::i64, true}}});
+
+    ExecutionContext ctx;
+    ctx.depth = 10;
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 0, {}, ctx), Traps());
+    EXPECT_EQ(counter.i64, DepthLimit - 10);
+    EXPECT_EQ(ctx.depth, 10);
+
+    // The instance is usable after the trap.
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 0, {}, ctx), Traps());
+    EXPECT_EQ(counter.i64, DepthLimit - 10);
+    EXPECT_EQ(ctx.depth, 10);
+}
+
+TEST(execute_call_depth, bounded_call_chain)
+{
+    // The call depth of the chain is known statically and checked once at its entry if it fits.
+    // Otherwise, the calls are checked one by one, so the trap happens at the same call
+    // and the side effects before it are the same.
+
+    /* wat2wasm
+    (global $counter (import "host" "counter") (mut i64))
+    (func $f0 (global.set $counter (i64.add (global.get $counter) (i64.const 1))))
+    (func $f1 (global.set $counter (i64.add (global.get $counter) (i64.const 1))) (call $f0))
+    (func $f2 (global.set $counter (i64.add (global.get $counter) (i64.const 1))) (call $f1))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001040160000002110104686f737407636f756e746572037e010304030000000a2303090023"
+        "0042017c24000b0b00230042017c240010000b0b00230042017c240010010b");
+
+    Value counter;
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->codesec[2].max_call_depth, 3);
+    auto instance = instantiate(*module, {}, {}, {}, {{&counter, {ValType::i64, true}}});
+
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 2, {}, DepthLimit - 3), Result());
+    EXPECT_EQ(counter.i64, 3);
+
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 2, {}, DepthLimit - 2), Traps());
+    EXPECT_EQ(counter.i64, 2);
+
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 2, {}, DepthLimit - 1), Traps());
+    EXPECT_EQ(counter.i64, 1);
+
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 2, {}, DepthLimit), Traps());
+    EXPECT_EQ(counter.i64, 0);
+}
+
+TEST(execute_call_depth, tail_call_recursion)
+{
+    // The tail calls replace the frame of the caller, so the recursion depth is not limited.
+
+    /* wat2wasm --enable-tail-call
+    (func $sum (param i64 i64) (result i64)
+      (if (result i64) (i64.eqz (local.get 0))
+        (then (local.get 1))
+        (else (return_call $sum (i64.sub (local.get 0) (i64.const 1))
+          (i64.add (local.get 0) (local.get 1))))))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001070160027e7e017e030201000a19011700200050047e200105200042017d200020017c12"
+        "000b0b");
+
+    /* wat2wasm
+    (func $sum (param i64 i64) (result i64)
+      (if (result i64) (i64.eqz (local.get 0))
+        (then (local.get 1))
+        (else (call $sum (i64.sub (local.get 0) (i64.const 1))
+          (i64.add (local.get 0) (local.get 1))))))
+    */
+    const auto wasm_call = from_hex(
+        "0061736d0100000001070160027e7e017e030201000a19011700200050047e200105200042017d200020017c10"
+        "000b0b");
+
+    constexpr auto n = uint64_t{100000};
+    auto instance = instantiate(parse(wasm));
+    EXPECT_THAT(execute(*instance, 0, {n, 0_u64}), Result(n * (n + 1) / 2));
+    EXPECT_THAT(execute(*instance, 0, {n, 0_u64}, DepthLimit - 1), Result(n * (n + 1) / 2));
+    EXPECT_THAT(execute(*instance, 0, {n, 0_u64}, DepthLimit), Traps());
+
+    ExecutionContext ctx;
+    ctx.depth = 5;
+    EXPECT_THAT(execute(*instance, 0, {n, 0_u64}, ctx), Result(n * (n + 1) / 2));
+    EXPECT_EQ(ctx.depth, 5);
+
+    auto instance_call = instantiate(parse(wasm_call));
+    EXPECT_THAT(execute(*instance_call, 0, {uint64_t{DepthLimit - 1}, 0_u64}), Result(2096128_u64));
+    EXPECT_THAT(execute(*instance_call, 0, {uint64_t{DepthLimit}, 0_u64}), Traps());
+}
+
+TEST(execute_call_depth, tail_call_bounded_call_chain)
+{
+    // The tail calls are included in the statically bounded call depth as the regular calls.
+
+    /* wat2wasm --enable-tail-call
+    (global $counter (import "host" "counter") (mut i64))
+    (func $f0 (global.set $counter (i64.add (global.get $counter) (i64.const 1))))
+    (func $f1 (call $f0) (return_call $f0))
+    (func $f2 (return_call $f1))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001040160000002110104686f737407636f756e746572037e010304030000000a1703090023"
+        "0042017c24000b0600100012000b040012010b");
+
+    Value counter;
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->codesec[1].max_call_depth, 2);
+    EXPECT_EQ(module->codesec[2].max_call_depth, 3);
+    auto instance = instantiate(*module, {}, {}, {}, {{&counter, {ValType::i64, true}}});
+
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 2, {}, DepthLimit - 2), Result());
+    EXPECT_EQ(counter.i64, 2);
+
+    counter.i64 = 0;
+    EXPECT_THAT(execute(*instance, 2, {}, DepthLimit - 1), Traps());
+    EXPECT_EQ(counter.i64, 0);
+}
+
 TEST(execute_call_depth, execute_start_function_infinite_recursion)
 {
     // This execution must always trap.
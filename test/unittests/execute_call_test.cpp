@@ -35,6 +35,47 @@ TEST(execute_call, call_trap)
     EXPECT_THAT(execute(parse(wasm), 1, {}), Traps());
 }
 
+TEST(execute_call, call_counts)
+{
+    /* wat2wasm
+    (func (result i32) (i32.const 0x2a000))
+    (func (result i32) (call 0))
+    (func (result i32) (i32.const 0))
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000105016000017f0304030000000a120306004180c00a0b040010000b040041000b");
+    auto instance = instantiate(parse(wasm));
+
+    uint64_t call_counts[3]{};
+    ExecutionContext ctx;
+    ctx.call_counts = call_counts;
+    ctx.call_counts_module = instance->module.get();
+    EXPECT_THAT(execute(*instance, 1, {}, ctx), Result(0x2a000));
+    EXPECT_THAT(execute(*instance, 1, {}, ctx), Result(0x2a000));
+    EXPECT_THAT(execute(*instance, 0, {}, ctx), Result(0x2a000));
+    EXPECT_EQ(call_counts[0], 3);
+    EXPECT_EQ(call_counts[1], 2);
+    EXPECT_EQ(call_counts[2], 0);
+
+    // The calls of the functions of another module are not counted.
+    /* wat2wasm
+    (func $f (import "m" "f") (result i32))
+    (func (result i32) (call $f))
+    */
+    const auto wasm_importing = from_hex(
+        "0061736d010000000105016000017f020701016d01660000030201000a0601040010000b");
+    constexpr auto host_f = [](std::any& host_context, Instance&, const Value*,
+                                ExecutionContext& host_ctx) noexcept {
+        return fizzy::execute(*std::any_cast<Instance*>(host_context), 1, nullptr, host_ctx);
+    };
+    auto importing_instance = instantiate(
+        parse(wasm_importing), {{{host_f, instance.get()}, instance->module->typesec[0]}});
+    EXPECT_THAT(execute(*importing_instance, 1, {}, ctx), Result(0x2a000));
+    EXPECT_EQ(call_counts[0], 4);
+    EXPECT_EQ(call_counts[1], 3);
+    EXPECT_EQ(call_counts[2], 0);
+}
+
 TEST(execute_call, call_with_arguments)
 {
     /* wat2wasm
@@ -890,3 +931,92 @@ TEST(execute_call, drop_call_result)
     auto instance = instantiate(*module);
     EXPECT_THAT(execute(*instance, *func_idx, {}), Result());
 }
+
+namespace
+{
+/* wat2wasm --enable-tail-call
+  (type $sum_t (func (param i64 i64) (result i64)))
+  (table 3 funcref)
+  (elem (i32.const 0) $sum_indirect $even)
+  (func $sum (type $sum_t)
+    (if (result i64) (i64.eqz (local.get 0))
+      (then (local.get 1))
+      (else (return_call $sum (i64.sub (local.get 0) (i64.const 1))
+        (i64.add (local.get 0) (local.get 1))))))
+  (func $sum_indirect (type $sum_t)
+    (if (result i64) (i64.eqz (local.get 0))
+      (then (local.get 1))
+      (else (return_call_indirect (type $sum_t) (i64.sub (local.get 0) (i64.const 1))
+        (i64.add (local.get 0) (local.get 1)) (i32.const 0)))))
+  (func $even (param i32) (result i32)
+    (if (result i32) (i32.eqz (local.get 0))
+      (then (i32.const 1))
+      (else (return_call $odd (i32.sub (local.get 0) (i32.const 1))))))
+  (func $odd (param i32) (result i32)
+    (if (result i32) (i32.eqz (local.get 0))
+      (then (i32.const 0))
+      (else (return_call $even (i32.sub (local.get 0) (i32.const 1))))))
+  (func (param i32) (result i64)
+    (return_call_indirect (type $sum_t) (i64.const 10) (i64.const 0) (local.get 0)))
+*/
+const auto tail_call_wasm = from_hex(
+    "0061736d0100000001110360027e7e017e60017f017f60017f017e030605000001010204040170000309080100"
+    "41000b0201020a66051700200050047e200105200042017d200020017c12000b0b1a00200050047e2001052000"
+    "42017d200020017c41001300000b0b1200200045047f410105200041016b12030b0b1200200045047f41000520"
+    "0041016b12020b0b0b00420a420020001300000b");
+}  // namespace
+
+TEST(execute_call, return_call)
+{
+    auto instance = instantiate(parse(tail_call_wasm));
+
+    EXPECT_THAT(execute(*instance, 0, {0_u64, 7_u64}), Result(7_u64));
+    EXPECT_THAT(execute(*instance, 0, {10_u64, 0_u64}), Result(55_u64));
+    EXPECT_THAT(execute(*instance, 2, {10}), Result(1));
+    EXPECT_THAT(execute(*instance, 2, {7}), Result(0));
+    EXPECT_THAT(execute(*instance, 3, {7}), Result(1));
+}
+
+TEST(execute_call, return_call_indirect)
+{
+    auto instance = instantiate(parse(tail_call_wasm));
+
+    EXPECT_THAT(execute(*instance, 1, {10_u64, 0_u64}), Result(55_u64));
+    EXPECT_THAT(execute(*instance, 4, {0}), Result(55_u64));
+
+    // Type mismatch, uninitialized element and element out of table bounds.
+    EXPECT_THAT(execute(*instance, 4, {1}), Traps());
+    EXPECT_THAT(execute(*instance, 4, {2}), Traps());
+    EXPECT_THAT(execute(*instance, 4, {3}), Traps());
+}
+
+TEST(execute_call, return_call_imported_function)
+{
+    /* wat2wasm --enable-tail-call
+      (func $host_f (import "host" "f") (param i32) (result i32))
+      (func $f (param i32) (result i32) (return_call $host_f (local.get 0)))
+      (func (param i32) (result i32) (return_call $f (local.get 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f020a0104686f73740166000003030200000a0f020600200012000b0600"
+        "200012010b");
+
+    static int recorded_depth;
+    constexpr auto host_f = [](std::any&, Instance&, const Value* args,
+                                ExecutionContext& ctx) noexcept {
+        recorded_depth = ctx.depth;
+        return ExecutionResult{Value{args[0].i32 + 1}};
+    };
+
+    const auto module = parse(wasm);
+    auto instance = instantiate(*module, {{{host_f}, module->typesec[0]}});
+
+    // The host function replaces the frame of the tail calling function.
+    recorded_depth = -1000;
+    EXPECT_THAT(execute(*instance, 1, {1}), Result(2));
+    EXPECT_EQ(recorded_depth, 1);
+
+    recorded_depth = -1000;
+    EXPECT_THAT(execute(*instance, 2, {2}), Result(3));
+    EXPECT_EQ(recorded_depth, 1);
+}
@@ -13,14 +13,11 @@ TEST(execute_death, malformed_instruction_opcode)
 {
     constexpr uint8_t malformed_opcode = 6;
 
-    Code code;
-    code.instructions.emplace_back(malformed_opcode);
-    code.instructions.emplace_back(static_cast<uint8_t>(Instr::end));
-
     auto module = std::make_unique<Module>();
     module->typesec.emplace_back(FuncType{});
     module->funcsec.emplace_back(TypeIdx{0});
-    module->codesec.emplace_back(std::move(code));
+    module->code_buffer = {malformed_opcode, static_cast<uint8_t>(Instr::end)};
+    module->codesec.emplace_back(Code{0, 0, 0, 2});
 
     auto instance = instantiate(std::move(module));
     EXPECT_DEATH(execute(*instance, 0, nullptr), "unreachable");
@@ -0,0 +1,170 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (type $swap (func (param i32 i32) (result i32 i32)))
+  (type $triple (func (result i32 i64 i32)))
+  (type $binop (func (param i32 i32) (result i32)))
+  (type $unop (func (param i32) (result i32)))
+  (type $pair (func (result i32 i32)))
+  (func $swap (export "swap") (type $swap) (local.get 1) (local.get 0))
+  (func $triple (type $triple) (i32.const 1) (i64.const 2) (i32.const 3))
+  (func (type $binop) (call $swap (local.get 0) (local.get 1)) (i32.sub))
+  (func (type $binop) (local.get 0) (local.get 1) (block (type $binop) (i32.add)))
+  (func (type $swap)
+    (block (type $pair) (i32.const 7) (local.get 0) (local.get 1) (br 0)))
+  (func (type $unop)
+    (i32.const 0)
+    (loop (type $unop)
+      (i32.add (local.get 0))
+      (br_if 0 (local.tee 0 (i32.sub (local.get 0) (i32.const 1))))))
+  (func (type $triple) (return_call $triple))
+  (func (type $binop)
+    (local.get 0) (local.get 1)
+    (if (type $unop) (then (i32.add (i32.const 10))) (else (i32.add (i32.const 20)))))
+*/
+const auto wasm = from_hex(
+    "0061736d01000000011e0560027f7f027f7f6000037f7e7f60027f7f017f60017f017f6000027f7f0309080001"
+    "020200030102070801047377617000000a5e080600200120000b08004101420241030b09002000200110006b0b"
+    "0a002000200102026a0b0b0d0002044107200020010c000b0b13004100030320006a200041016b22000d000b0b"
+    "040012010b1000200020010403410a6a0541146a0b0b");
+
+/* wat2wasm
+  (func $swap (import "m" "swap") (param i32 i32) (result i32 i32))
+  (func (param i32 i32) (result i32) (call $swap (local.get 0) (local.get 1)) (i32.sub))
+*/
+const auto wasm_importer = from_hex(
+    "0061736d01000000010e0260027f7f027f7f60027f7f017f020a01016d04737761700000030201010a0b010900"
+    "2000200110006b0b");
+
+ExecutionResult host_fn(std::any&, Instance&, const Value*, ExecutionContext&) noexcept
+{
+    return Void;
+}
+}  // namespace
+
+TEST(execute_multivalue, function_results)
+{
+    auto instance = instantiate(parse(wasm));
+
+    const Value args[]{1, 2};
+    Value results[3]{};
+    EXPECT_THAT(fizzy::execute(*instance, 0, args, results), Result());
+    EXPECT_EQ(results[0].i32, 2);
+    EXPECT_EQ(results[1].i32, 1);
+
+    EXPECT_THAT(fizzy::execute(*instance, 1, nullptr, results), Result());
+    EXPECT_EQ(results[0].i32, 1);
+    EXPECT_EQ(results[1].i64, 2);
+    EXPECT_EQ(results[2].i32, 3);
+
+    // The single result is returned and written to the results array too.
+    Value result{};
+    EXPECT_THAT(fizzy::execute(*instance, 2, args, &result), Result());
+    EXPECT_EQ(result.i32, 1);
+}
+
+TEST(execute_multivalue, single_result_api)
+{
+    auto instance = instantiate(parse(wasm));
+
+    // Functions with multiple results cannot be executed without the results array.
+    const Value args[]{1, 2};
+    EXPECT_THAT(fizzy::execute(*instance, 0, args), Traps());
+    EXPECT_THAT(fizzy::execute(*instance, 1, nullptr), Traps());
+
+    ExecutionContext ctx;
+    EXPECT_THAT(fizzy::execute(*instance, 0, args, ctx), Traps());
+    EXPECT_EQ(ctx.depth, 0);
+}
+
+TEST(execute_multivalue, call)
+{
+    auto instance = instantiate(parse(wasm));
+
+    EXPECT_THAT(execute(*instance, 2, {2, 7}), Result(5));
+    EXPECT_THAT(execute(*instance, 2, {7, 2}), Result(-5));
+}
+
+TEST(execute_multivalue, block_params)
+{
+    auto instance = instantiate(parse(wasm));
+
+    EXPECT_THAT(execute(*instance, 3, {2, 7}), Result(9));
+}
+
+TEST(execute_multivalue, br_multiple_values)
+{
+    auto instance = instantiate(parse(wasm));
+
+    const Value args[]{3, 4};
+    Value results[2]{};
+    EXPECT_THAT(fizzy::execute(*instance, 4, args, results), Result());
+    EXPECT_EQ(results[0].i32, 3);
+    EXPECT_EQ(results[1].i32, 4);
+}
+
+TEST(execute_multivalue, loop_params)
+{
+    auto instance = instantiate(parse(wasm));
+
+    EXPECT_THAT(execute(*instance, 5, {1}), Result(1));
+    EXPECT_THAT(execute(*instance, 5, {10}), Result(55));
+}
+
+TEST(execute_multivalue, if_params)
+{
+    auto instance = instantiate(parse(wasm));
+
+    EXPECT_THAT(execute(*instance, 7, {1, 1}), Result(11));
+    EXPECT_THAT(execute(*instance, 7, {1, 0}), Result(21));
+}
+
+TEST(execute_multivalue, return_call)
+{
+    auto instance = instantiate(parse(wasm));
+
+    Value results[3]{};
+    ExecutionContext ctx;
+    EXPECT_THAT(fizzy::execute(*instance, 6, nullptr, results, ctx), Result());
+    EXPECT_EQ(results[0].i32, 1);
+    EXPECT_EQ(results[1].i64, 2);
+    EXPECT_EQ(results[2].i32, 3);
+    EXPECT_EQ(ctx.depth, 0);
+}
+
+TEST(execute_multivalue, imported_function_from_another_module)
+{
+    auto instance1 = instantiate(parse(wasm));
+    auto instance2 =
+        instantiate(parse(wasm_importer), {*find_exported_function(*instance1, "swap")});
+
+    EXPECT_THAT(execute(*instance2, 1, {2, 7}), Result(5));
+
+    const Value args[]{5, 6};
+    Value results[2]{};
+    EXPECT_THAT(fizzy::execute(*instance2, 0, args, results), Result());
+    EXPECT_EQ(results[0].i32, 6);
+    EXPECT_EQ(results[1].i32, 5);
+}
+
+TEST(execute_multivalue, host_function_multiple_results)
+{
+    const auto module = parse(wasm_importer);
+
+    EXPECT_THROW_MESSAGE(instantiate(*module, {{host_fn, module->typesec[0]}}), instantiate_error,
+        "function 0 is a host function with multi-slot results, not supported");
+}
@@ -26,9 +26,10 @@ auto create_unary_operation_executor(Instr instr)
     auto module{std::make_unique<Module>()};
     module->typesec.emplace_back(FuncType{{instr_type.inputs[0]}, {instr_type.outputs[0]}});
     module->funcsec.emplace_back(TypeIdx{0});
-    module->codesec.emplace_back(Code{1, 0,
-        {static_cast<uint8_t>(Instr::local_get), 0, 0, 0, 0, static_cast<uint8_t>(instr),
-            static_cast<uint8_t>(Instr::end)}});
+    module->code_buffer = {static_cast<uint8_t>(Instr::local_get), 0, 0, 0, 0,
+        static_cast<uint8_t>(instr), static_cast<uint8_t>(Instr::end)};
+    module->codesec.emplace_back(
+        Code{1, 0, 0, static_cast<uint32_t>(module->code_buffer.size()), sizeof(uint32_t)});
 
     auto instance = instantiate(std::move(module));
 
@@ -46,9 +47,11 @@ auto create_binary_operation_executor(Instr instr)
     module->typesec.emplace_back(
         FuncType{{instr_type.inputs[0], instr_type.inputs[1]}, {instr_type.outputs[0]}});
     module->funcsec.emplace_back(TypeIdx{0});
-    module->codesec.emplace_back(Code{2, 0,
-        {static_cast<uint8_t>(Instr::local_get), 0, 0, 0, 0, static_cast<uint8_t>(Instr::local_get),
-            1, 0, 0, 0, static_cast<uint8_t>(instr), static_cast<uint8_t>(Instr::end)}});
+    module->code_buffer = {static_cast<uint8_t>(Instr::local_get), 0, 0, 0, 0,
+        static_cast<uint8_t>(Instr::local_get), 1, 0, 0, 0, static_cast<uint8_t>(instr),
+        static_cast<uint8_t>(Instr::end)};
+    module->codesec.emplace_back(
+        Code{2, 0, 0, static_cast<uint32_t>(module->code_buffer.size()), sizeof(uint32_t)});
 
     auto instance = instantiate(std::move(module));
 
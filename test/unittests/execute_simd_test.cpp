@@ -0,0 +1,456 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instance_pool.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm --enable-simd
+  (memory 1)
+  ;; The operations of the v128 values at the addresses 0, 16 and 32, storing the result at 48.
+  (func (v128.store (i32.const 48)
+    (i8x16.add_sat_s (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i8x16.swizzle (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i8x16.shuffle 0 17 2 19 4 21 6 23 8 25 10 27 12 29 14 31
+      (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i16x8.q15mulr_sat_s (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i32x4.dot_i16x8_s (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (f32x4.min (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i8x16.narrow_i16x8_u (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i16x8.extmul_low_i8x16_s (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i64x2.mul (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48)
+    (i32x4.lt_u (v128.load (i32.const 0)) (v128.load (i32.const 16)))))
+  (func (v128.store (i32.const 48) (i8x16.popcnt (v128.load (i32.const 0)))))
+  (func (v128.store (i32.const 48) (i32x4.trunc_sat_f32x4_s (v128.load (i32.const 0)))))
+  (func (v128.store (i32.const 48) (f64x2.nearest (v128.load (i32.const 0)))))
+  (func (v128.store (i32.const 48) (i64x2.abs (v128.load (i32.const 0)))))
+  (func (v128.store (i32.const 48) (i16x8.extadd_pairwise_i8x16_u (v128.load (i32.const 0)))))
+  (func (v128.store (i32.const 48) (f32x4.demote_f64x2_zero (v128.load (i32.const 0)))))
+  (func (v128.store (i32.const 48) (f32x4.convert_i32x4_u (v128.load (i32.const 0)))))
+  (func (v128.store (i32.const 48) (v128.bitselect
+    (v128.load (i32.const 0)) (v128.load (i32.const 16)) (v128.load (i32.const 32)))))
+  (func (param i32)
+    (v128.store (i32.const 48) (i16x8.shr_s (v128.load (i32.const 0)) (local.get 0))))
+  (func (result i32) (i8x16.bitmask (v128.load (i32.const 0))))
+  (func (result i32) (i32x4.all_true (v128.load (i32.const 0))))
+  (func (result i32) (v128.any_true (v128.load (i32.const 0))))
+  (func (result i32) (i8x16.extract_lane_s 3 (v128.load (i32.const 0))))
+  (func (param i32) (v128.store (i32.const 48)
+    (i16x8.replace_lane 2 (i8x16.splat (local.get 0)) (i32.const 0x1234))))
+  (func (param i32) (v128.store (i32.const 48) (v128.load8x8_s (local.get 0))))
+  (func (param i32) (v128.store (i32.const 48) (v128.load16_splat (local.get 0))))
+  (func (param i32) (v128.store (i32.const 48) (v128.load32_zero (local.get 0))))
+  (func (param i32) (v128.store (i32.const 48)
+    (v128.load8_lane 5 (local.get 0) (v128.load (i32.const 0)))))
+  (func (param i32) (v128.store64_lane 1 (local.get 0) (v128.load (i32.const 0))))
+  (func (param i32) (v128.store (local.get 0) (v128.load (i32.const 0))))
+  (func (param i32) (local v128)
+    (local.set 1 (v128.load (i32.const 0)))
+    (v128.store (i32.const 48)
+      (block (result v128)
+        (i32.const 7) (local.get 1) (br_if 0 (local.get 0))
+        (drop) (drop) (v128.const i32x4 1 2 3 4))))
+  (func (param i32) (v128.store (i32.const 48)
+    (select (v128.load (i32.const 0)) (v128.load (i32.const 16)) (local.get 0))))
+  (func (result i32) (local v128)
+    (i32.add (i32x4.extract_lane 2 (local.tee 0 (v128.const i32x4 1 2 3 4)))
+      (i32x4.extract_lane 3 (local.get 0))))
+*/
+const auto wasm = from_hex(
+    "0061736d0100000001110460000060017f006000017f60017f017f032221000000000000000000000000000000"
+    "00000001020202020101010101010101010205030100010ab70521160041304100fd0004004110fd000400fd6f"
+    "fd0b04000b160041304100fd0004004110fd000400fd0efd0b04000b260041304100fd0004004110fd000400fd"
+    "0d001102130415061708190a1b0c1d0e1ffd0b04000b170041304100fd0004004110fd000400fd8201fd0b0400"
+    "0b170041304100fd0004004110fd000400fdba01fd0b04000b170041304100fd0004004110fd000400fde801fd"
+    "0b04000b160041304100fd0004004110fd000400fd66fd0b04000b170041304100fd0004004110fd000400fd9c"
+    "01fd0b04000b170041304100fd0004004110fd000400fdd501fd0b04000b160041304100fd0004004110fd0004"
+    "00fd3afd0b04000b100041304100fd000400fd62fd0b04000b110041304100fd000400fdf801fd0b04000b1100"
+    "41304100fd000400fd9401fd0b04000b110041304100fd000400fdc001fd0b04000b100041304100fd000400fd"
+    "7dfd0b04000b100041304100fd000400fd5efd0b04000b110041304100fd000400fdfb01fd0b04000b1c004130"
+    "4100fd0004004110fd0004004120fd000400fd52fd0b04000b130041304100fd0004002000fd8c01fd0b04000b"
+    "0a004100fd000400fd640b0b004100fd000400fda3010b0a004100fd000400fd530b0b004100fd000400fd1503"
+    "0b120041302000fd0f41b424fd1a02fd0b04000b0e0041302000fd010000fd0b04000b0e0041302000fd080100"
+    "fd0b04000b0e0041302000fd5c0200fd0b04000b1500413020004100fd000400fd54000005fd0b04000b0f0020"
+    "004100fd000400fd5b0300010b0e0020004100fd000400fd0b04000b3101017b4100fd00040021014130027b41"
+    "07200120000d001a1afd0c010000000200000003000000040000000bfd0b04000b170041304100fd0004004110"
+    "fd00040020001bfd0b04000b2101017bfd0c010000000200000003000000040000002200fd1b022000fd1b036a"
+    "0b");
+
+/// Writes the lanes of the v128 value into the memory.
+template <typename T>
+void store_v128(Instance& instance, uint32_t address, const std::vector<T>& lanes)
+{
+    ASSERT_EQ(lanes.size() * sizeof(T), 16);
+    std::memcpy(&(*instance.memory)[address], lanes.data(), 16);
+}
+
+/// Reads the lanes of the v128 value from the memory.
+template <typename T>
+std::vector<T> load_v128(const Instance& instance, uint32_t address)
+{
+    std::vector<T> lanes(16 / sizeof(T));
+    std::memcpy(lanes.data(), &(*instance.memory)[address], 16);
+    return lanes;
+}
+}  // namespace
+
+TEST(execute_simd, integer_arithmetic)
+{
+    auto instance = instantiate(parse(wasm));
+
+    store_v128<int8_t>(*instance, 0, {127, -128, 100, -100, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+    store_v128<int8_t>(*instance, 16, {1, -1, 100, -100, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+    EXPECT_THAT(execute(*instance, 0, {}), Result());
+    EXPECT_EQ(load_v128<int8_t>(*instance, 48),
+        (std::vector<int8_t>{127, -128, 127, -128, 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22}));
+
+    store_v128<int16_t>(*instance, 0, {0x4000, -0x8000, 0x7fff, -0x8000, 100, 0, 0, 0});
+    store_v128<int16_t>(*instance, 16, {0x4000, -0x8000, 0x7fff, 0x7fff, 0x4000, 0, 0, 0});
+    EXPECT_THAT(execute(*instance, 3, {}), Result());
+    EXPECT_EQ(load_v128<int16_t>(*instance, 48),
+        (std::vector<int16_t>{0x2000, 0x7fff, 0x7ffe, -0x7fff, 50, 0, 0, 0}));
+
+    store_v128<int16_t>(*instance, 0, {1, 2, 3, 4, -0x8000, -0x8000, 0, 0});
+    store_v128<int16_t>(*instance, 16, {5, 6, 7, 8, -0x8000, -0x8000, 0, 0});
+    EXPECT_THAT(execute(*instance, 4, {}), Result());
+    EXPECT_EQ(load_v128<int32_t>(*instance, 48),
+        (std::vector<int32_t>{17, 53, std::numeric_limits<int32_t>::min(), 0}));
+
+    store_v128<int8_t>(*instance, 0, {-128, 127, -1, 2, 3, 4, 5, 6, 0, 0, 0, 0, 0, 0, 0, 0});
+    store_v128<int8_t>(*instance, 16, {-128, 127, 5, -3, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0});
+    EXPECT_THAT(execute(*instance, 7, {}), Result());
+    EXPECT_EQ(load_v128<int16_t>(*instance, 48),
+        (std::vector<int16_t>{16384, 16129, -5, -6, 3, 4, 5, 6}));
+
+    store_v128<int64_t>(*instance, 0, {0x100000001, -1});
+    store_v128<int64_t>(*instance, 16, {0x100000001, 5});
+    EXPECT_THAT(execute(*instance, 8, {}), Result());
+    EXPECT_EQ(load_v128<int64_t>(*instance, 48), (std::vector<int64_t>{0x200000001, -5}));
+
+    store_v128<uint8_t>(*instance, 0, {0, 1, 3, 0xff, 0x80, 0x55, 7, 15, 0, 0, 0, 0, 0, 0, 0, 0});
+    EXPECT_THAT(execute(*instance, 10, {}), Result());
+    EXPECT_EQ(load_v128<uint8_t>(*instance, 48),
+        (std::vector<uint8_t>{0, 1, 2, 8, 1, 4, 3, 4, 0, 0, 0, 0, 0, 0, 0, 0}));
+
+    store_v128<int64_t>(*instance, 0, {std::numeric_limits<int64_t>::min(), -5});
+    EXPECT_THAT(execute(*instance, 13, {}), Result());
+    EXPECT_EQ(load_v128<int64_t>(*instance, 48),
+        (std::vector<int64_t>{std::numeric_limits<int64_t>::min(), 5}));
+
+    store_v128<uint8_t>(*instance, 0, {255, 255, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14});
+    EXPECT_THAT(execute(*instance, 14, {}), Result());
+    EXPECT_EQ(load_v128<uint16_t>(*instance, 48),
+        (std::vector<uint16_t>{510, 3, 7, 11, 15, 19, 23, 27}));
+
+    store_v128<int16_t>(*instance, 0, {-0x8000, 0x7fff, -1, 16, 0, 0, 0, 0});
+    EXPECT_THAT(execute(*instance, 18, {17}), Result());
+    EXPECT_EQ(load_v128<int16_t>(*instance, 48),
+        (std::vector<int16_t>{-0x4000, 0x3fff, -1, 8, 0, 0, 0, 0}));
+}
+
+TEST(execute_simd, lanes)
+{
+    auto instance = instantiate(parse(wasm));
+
+    store_v128<uint8_t>(*instance, 0, {0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19,
+                                          0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f});
+    store_v128<uint8_t>(*instance, 16, {15, 0, 16, 255, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0x80});
+    EXPECT_THAT(execute(*instance, 1, {}), Result());
+    EXPECT_EQ(load_v128<uint8_t>(*instance, 48),
+        (std::vector<uint8_t>{0x1f, 0x10, 0, 0, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+            0x19, 0x1a, 0x1b, 0}));
+
+    store_v128<uint8_t>(*instance, 16,
+        {100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115});
+    EXPECT_THAT(execute(*instance, 2, {}), Result());
+    EXPECT_EQ(load_v128<uint8_t>(*instance, 48),
+        (std::vector<uint8_t>{0x10, 101, 0x12, 103, 0x14, 105, 0x16, 107, 0x18, 109, 0x1a, 111,
+            0x1c, 113, 0x1e, 115}));
+
+    store_v128<int16_t>(*instance, 0, {-1, 0, 255, 256, 0x7fff, -0x8000, 1, 2});
+    store_v128<int16_t>(*instance, 16, {3, 4, 5, 6, 7, 8, 9, 10});
+    EXPECT_THAT(execute(*instance, 6, {}), Result());
+    EXPECT_EQ(load_v128<uint8_t>(*instance, 48),
+        (std::vector<uint8_t>{0, 0, 255, 255, 255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+
+    store_v128<uint64_t>(*instance, 0, {0x1111111111111111, 0x2222222222222222});
+    store_v128<uint64_t>(*instance, 16, {0xeeeeeeeeeeeeeeee, 0xdddddddddddddddd});
+    store_v128<uint64_t>(*instance, 32, {0xffffffff00000000, 0x00000000ffffffff});
+    EXPECT_THAT(execute(*instance, 17, {}), Result());
+    EXPECT_EQ(load_v128<uint64_t>(*instance, 48),
+        (std::vector<uint64_t>{0x11111111eeeeeeee, 0xdddddddd22222222}));
+
+    EXPECT_THAT(execute(*instance, 23, {0x1ab}), Result());
+    EXPECT_EQ(load_v128<uint16_t>(*instance, 48),
+        (std::vector<uint16_t>{0xabab, 0xabab, 0x1234, 0xabab, 0xabab, 0xabab, 0xabab, 0xabab}));
+
+    store_v128<int8_t>(*instance, 0, {0, 0, 0, -2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    EXPECT_THAT(execute(*instance, 22, {}), Result(-2));
+}
+
+TEST(execute_simd, comparison_and_reduction)
+{
+    auto instance = instantiate(parse(wasm));
+
+    store_v128<uint32_t>(*instance, 0, {1, 0xffffffff, 5, 0});
+    store_v128<uint32_t>(*instance, 16, {2, 1, 5, 0x80000000});
+    EXPECT_THAT(execute(*instance, 9, {}), Result());
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 48),
+        (std::vector<uint32_t>{0xffffffff, 0, 0, 0xffffffff}));
+
+    store_v128<int8_t>(*instance, 0, {-1, 0, -128, 127, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1});
+    EXPECT_THAT(execute(*instance, 19, {}), Result(0x8005));
+
+    store_v128<uint32_t>(*instance, 0, {1, 2, 3, 4});
+    EXPECT_THAT(execute(*instance, 20, {}), Result(1));
+    store_v128<uint32_t>(*instance, 0, {1, 0, 3, 4});
+    EXPECT_THAT(execute(*instance, 20, {}), Result(0));
+
+    EXPECT_THAT(execute(*instance, 21, {}), Result(1));
+    store_v128<uint32_t>(*instance, 0, {0, 0, 0, 0});
+    EXPECT_THAT(execute(*instance, 21, {}), Result(0));
+    store_v128<uint32_t>(*instance, 0, {0, 0, 0, 0x80000000});
+    EXPECT_THAT(execute(*instance, 21, {}), Result(1));
+}
+
+TEST(execute_simd, floating_point)
+{
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    constexpr auto nan = std::numeric_limits<float>::quiet_NaN();
+    auto instance = instantiate(parse(wasm));
+
+    store_v128<float>(*instance, 0, {1.0f, -0.0f, nan, 2.0f});
+    store_v128<float>(*instance, 16, {2.0f, 0.0f, 1.0f, -inf});
+    EXPECT_THAT(execute(*instance, 5, {}), Result());
+    const auto min = load_v128<float>(*instance, 48);
+    EXPECT_EQ(min[0], 1.0f);
+    EXPECT_TRUE(min[1] == 0.0f && std::signbit(min[1]));
+    EXPECT_TRUE(std::isnan(min[2]));
+    EXPECT_EQ(min[3], -inf);
+
+    store_v128<float>(*instance, 0, {1.9f, -2.5f, nan, 3e9f});
+    EXPECT_THAT(execute(*instance, 11, {}), Result());
+    EXPECT_EQ(load_v128<int32_t>(*instance, 48),
+        (std::vector<int32_t>{1, -2, 0, std::numeric_limits<int32_t>::max()}));
+    store_v128<float>(*instance, 0, {-inf, inf, -2147483648.0f, 2147483520.0f});
+    EXPECT_THAT(execute(*instance, 11, {}), Result());
+    EXPECT_EQ(load_v128<int32_t>(*instance, 48),
+        (std::vector<int32_t>{std::numeric_limits<int32_t>::min(),
+            std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min(),
+            2147483520}));
+
+    store_v128<double>(*instance, 0, {2.5, -3.5});
+    EXPECT_THAT(execute(*instance, 12, {}), Result());
+    EXPECT_EQ(load_v128<double>(*instance, 48), (std::vector<double>{2.0, -4.0}));
+    store_v128<double>(*instance, 0, {0.5, -0.5});
+    EXPECT_THAT(execute(*instance, 12, {}), Result());
+    EXPECT_EQ(load_v128<uint64_t>(*instance, 48), (std::vector<uint64_t>{0, 0x8000000000000000}));
+
+    store_v128<double>(*instance, 0, {1.5, 1e300});
+    EXPECT_THAT(execute(*instance, 15, {}), Result());
+    EXPECT_EQ(load_v128<float>(*instance, 48), (std::vector<float>{1.5f, inf, 0.0f, 0.0f}));
+
+    store_v128<uint32_t>(*instance, 0, {0, 1, 0xffffffff, 0x80000000});
+    EXPECT_THAT(execute(*instance, 16, {}), Result());
+    EXPECT_EQ(load_v128<float>(*instance, 48),
+        (std::vector<float>{0.0f, 1.0f, 4294967296.0f, 2147483648.0f}));
+}
+
+TEST(execute_simd, memory)
+{
+    auto instance = instantiate(parse(wasm));
+    store_v128<uint8_t>(*instance, 0, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    store_v128<uint8_t>(*instance, 100,
+        {0x80, 0x7f, 0xff, 1, 2, 3, 4, 5, 0, 0, 0, 0, 0, 0, 0, 0});
+
+    EXPECT_THAT(execute(*instance, 24, {100}), Result());
+    EXPECT_EQ(load_v128<int16_t>(*instance, 48),
+        (std::vector<int16_t>{-128, 127, -1, 1, 2, 3, 4, 5}));
+    EXPECT_THAT(execute(*instance, 24, {PageSize - 8}), Result());
+    EXPECT_THAT(execute(*instance, 24, {PageSize - 7}), Traps());
+
+    EXPECT_THAT(execute(*instance, 25, {101}), Result());
+    EXPECT_EQ(load_v128<uint16_t>(*instance, 48),
+        (std::vector<uint16_t>{0xff7f, 0xff7f, 0xff7f, 0xff7f, 0xff7f, 0xff7f, 0xff7f, 0xff7f}));
+    EXPECT_THAT(execute(*instance, 25, {PageSize - 1}), Traps());
+
+    EXPECT_THAT(execute(*instance, 26, {100}), Result());
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 48), (std::vector<uint32_t>{0x01ff7f80, 0, 0, 0}));
+    EXPECT_THAT(execute(*instance, 26, {PageSize - 3}), Traps());
+
+    EXPECT_THAT(execute(*instance, 27, {101}), Result());
+    EXPECT_EQ(load_v128<uint8_t>(*instance, 48),
+        (std::vector<uint8_t>{0, 1, 2, 3, 4, 0x7f, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}));
+    EXPECT_THAT(execute(*instance, 27, {PageSize}), Traps());
+
+    EXPECT_THAT(execute(*instance, 28, {200}), Result());
+    EXPECT_EQ(load_v128<uint64_t>(*instance, 200), (std::vector<uint64_t>{0x0f0e0d0c0b0a0908, 0}));
+    EXPECT_THAT(execute(*instance, 28, {PageSize - 7}), Traps());
+
+    EXPECT_THAT(execute(*instance, 29, {PageSize - 16}), Result());
+    EXPECT_EQ(load_v128<uint8_t>(*instance, PageSize - 16), load_v128<uint8_t>(*instance, 0));
+    EXPECT_THAT(execute(*instance, 29, {PageSize - 15}), Traps());
+    EXPECT_THAT(execute(*instance, 29, {0xffffffff}), Traps());
+}
+
+TEST(execute_simd, control_and_locals)
+{
+    auto instance = instantiate(parse(wasm));
+    store_v128<uint32_t>(*instance, 0, {10, 11, 12, 13});
+    store_v128<uint32_t>(*instance, 16, {20, 21, 22, 23});
+
+    EXPECT_THAT(execute(*instance, 30, {1}), Result());
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 48), (std::vector<uint32_t>{10, 11, 12, 13}));
+    EXPECT_THAT(execute(*instance, 30, {0}), Result());
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 48), (std::vector<uint32_t>{1, 2, 3, 4}));
+
+    EXPECT_THAT(execute(*instance, 31, {1}), Result());
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 48), (std::vector<uint32_t>{10, 11, 12, 13}));
+    EXPECT_THAT(execute(*instance, 31, {0}), Result());
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 48), (std::vector<uint32_t>{20, 21, 22, 23}));
+
+    EXPECT_THAT(execute(*instance, 32, {}), Result(7));
+}
+
+TEST(execute_simd, v128_arguments_results_and_globals)
+{
+    /* wat2wasm --enable-simd
+      (func $f (import "m" "f") (param v128) (result i32))
+      (global $g (import "m" "g") (mut v128))
+      (global $h (export "h") (mut v128) (v128.const i64x2 1 2))
+      (global $i i32 (i32.const 3))
+      (func $id (param v128) (result v128) (local.get 0))
+      (func $add (param i32 v128) (result v128)
+        (i32x4.add (local.get 1) (i32x4.splat (local.get 0))))
+      (func (result v128) (call $add (i32.const 10) (call $id (global.get $h))))
+      (func (param v128) (global.set $h (local.get 0)) (global.set $g (global.get $h)))
+      (func (result v128 i32) (global.get $g) (global.get $i))
+      (func (param v128) (result v128) (return_call $id (local.get 0)))
+      (func (param v128 i32) (result i32) (local i32)
+        (local.set 2 (i32.const 5)) (i32.add (local.get 1) (local.get 2)))
+      (func (param v128) (result i32) (call $f (local.get 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001240760017b017b60027f7b017b6000017b60017b006000027b7f60027b7f017f60017b01"
+        "7f020e02016d01660006016d0167037b010309080001020304000506061b027b01fd0c01000000000000000200"
+        "0000000000000b7f0041030b070501016803010a4b08040020000b0b0020012000fd11fdae010b0a00410a2301"
+        "100110020b0a0020002401230124000b0600230023020b0600200012010b0d01017f41052102200120026a0b06"
+        "00200010000b");
+
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->global_slots, (std::vector<uint32_t>{0, 2}));
+
+    const HostFunctionPtr host_f = [](std::any&, Instance&, const Value* args,
+                                       ExecutionContext&) noexcept {
+        return ExecutionResult{Value{args[0].i32 + args[1].i32}};
+    };
+    Value g[2]{uint64_t{7}, uint64_t{8}};
+    auto instance = instantiate(*module, {{host_f, module->typesec[6]}}, {}, {},
+        {ExternalGlobal{g, {ValType::v128, true}}});
+    ASSERT_EQ(instance->globals.size(), 3);
+
+    // The v128 arguments and results occupy 2 Value slots each.
+    const Value v[]{uint64_t{0x1111}, uint64_t{0x2222}, 4};
+    Value results[3]{};
+    EXPECT_THAT(fizzy::execute(*instance, 1, v, results), Result());
+    EXPECT_EQ(results[0].i64, 0x1111);
+    EXPECT_EQ(results[1].i64, 0x2222);
+    EXPECT_THAT(fizzy::execute(*instance, 1, v), Traps());
+
+    EXPECT_THAT(fizzy::execute(*instance, 3, nullptr, results), Result());
+    EXPECT_EQ(results[0].i64, 0x0000000a'0000000b);
+    EXPECT_EQ(results[1].i64, 0x0000000a'0000000c);
+
+    EXPECT_THAT(fizzy::execute(*instance, 5, nullptr, results), Result());
+    EXPECT_EQ(results[0].i64, 7);
+    EXPECT_EQ(results[1].i64, 8);
+    EXPECT_EQ(results[2].i32, 3);
+
+    const Value new_value[]{uint64_t{5}, uint64_t{6}};
+    EXPECT_THAT(fizzy::execute(*instance, 4, new_value), Result());
+    EXPECT_EQ(g[0].i64, 5);
+    EXPECT_EQ(g[1].i64, 6);
+    const auto h = find_exported_global(*instance, "h");
+    ASSERT_TRUE(h.has_value());
+    EXPECT_EQ(h->type.value_type, ValType::v128);
+    EXPECT_EQ(h->value[0].i64, 5);
+    EXPECT_EQ(h->value[1].i64, 6);
+    EXPECT_EQ(instance->globals[2].i32, 3);
+
+    EXPECT_THAT(fizzy::execute(*instance, 6, v, results), Result());
+    EXPECT_EQ(results[0].i64, 0x1111);
+    EXPECT_EQ(results[1].i64, 0x2222);
+
+    EXPECT_THAT(fizzy::execute(*instance, 7, v, results), Result());
+    EXPECT_EQ(results[0].i32, 4 + 5);
+
+    EXPECT_THAT(fizzy::execute(*instance, 8, v, results), Result());
+    EXPECT_EQ(results[0].i32, 0x1111 + 0x2222);
+}
+
+TEST(execute_simd, host_function_v128_result)
+{
+    /* wat2wasm --enable-simd
+      (func (import "m" "f") (result v128))
+    */
+    const auto wasm = from_hex("0061736d010000000105016000017b020701016d01660000");
+    const auto module = parse(wasm);
+
+    const HostFunctionPtr host_f = [](std::any&, Instance&, const Value*,
+                                       ExecutionContext&) noexcept { return Void; };
+    EXPECT_THROW_MESSAGE(instantiate(*module, {{host_f, module->typesec[0]}}), instantiate_error,
+        "function 0 is a host function with multi-slot results, not supported");
+}
+
+TEST(execute_simd, metering)
+{
+    auto instance = instantiate(parse(wasm));
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = 100;
+    // i32.const, v128.load, v128.any_true and end.
+    EXPECT_THAT(execute(*instance, 21, {}, ctx), Result(0));
+    EXPECT_EQ(ctx.ticks, 100 - 4);
+
+    ctx.ticks = 3;
+    EXPECT_THAT(execute(*instance, 21, {}, ctx), Traps());
+}
+
+TEST(execute_simd, instance_pool_reset)
+{
+    InstancePool pool{parse(wasm)};
+    auto instance = pool.acquire();
+    store_v128<uint32_t>(*instance, 0, {1, 2, 3, 4});
+    EXPECT_THAT(execute(*instance, 29, {2 * DirtyMemoryBlockSize}), Result());
+    EXPECT_THAT(execute(*instance, 28, {3 * DirtyMemoryBlockSize}), Result());
+    pool.release(std::move(instance));
+
+    instance = pool.acquire();
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 2 * DirtyMemoryBlockSize),
+        (std::vector<uint32_t>{0, 0, 0, 0}));
+    EXPECT_EQ(load_v128<uint32_t>(*instance, 3 * DirtyMemoryBlockSize),
+        (std::vector<uint32_t>{0, 0, 0, 0}));
+}
@@ -0,0 +1,201 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "parser.hpp"
+#include "suspend.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (func $read (import "env" "read") (param i32) (result i32))
+  (func $write (import "env" "write") (param i32))
+  (func (param i32) (result i32) (i32.add (call $read (local.get 0)) (call $read (i32.const 10))))
+  (func $rec (param i32) (result i32)
+    (if (result i32) (local.get 0)
+      (then (i32.add (call $rec (i32.sub (local.get 0) (i32.const 1))) (i32.const 1)))
+      (else (call $read (i32.const 0)))))
+  (func (call $write (i32.const 5)))
+*/
+const auto wasm = from_hex(
+    "0061736d01000000010d0360017f017f60017f0060000002180203656e760472656164000003656e7605777269"
+    "746500010304030000020a2b030b0020001000410a10006a0b16002000047f200041016b100341016a05410010"
+    "000b0b0600410510010b");
+
+/// The host function suspending the execution, recording its argument in the host context.
+ExecutionResult suspend_host_fn(
+    std::any& host_context, Instance&, const Value* args, ExecutionContext&) noexcept
+{
+    std::any_cast<std::vector<uint32_t>*>(host_context)->push_back(args[0].i32);
+    return Suspended;
+}
+
+std::unique_ptr<Instance> instantiate_suspending(std::vector<uint32_t>& host_args)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    return instantiate(module, {{{suspend_host_fn, &host_args}, module->typesec[0]},
+                                   {{suspend_host_fn, &host_args}, module->typesec[1]}});
+}
+}  // namespace
+
+TEST(execute_suspend, suspend_resume)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    ExecutionContext ctx;
+    const Value args[]{3};
+    Value result{};
+    EXPECT_TRUE(execute_suspendable(*instance, 2, args, &result, ctx).suspended);
+    EXPECT_EQ(host_args, std::vector<uint32_t>{3});
+    EXPECT_NE(ctx.suspendable_execution, nullptr);
+
+    const Value host_result1{100};
+    EXPECT_TRUE(resume(ctx, &host_result1).suspended);
+    EXPECT_EQ(host_args, (std::vector<uint32_t>{3, 10}));
+
+    const Value host_result2{7};
+    EXPECT_THAT(resume(ctx, &host_result2), Result());
+    EXPECT_EQ(result.i32, 107);
+    EXPECT_EQ(ctx.suspendable_execution, nullptr);
+    EXPECT_EQ(ctx.depth, 0);
+}
+
+TEST(execute_suspend, suspend_void_host_function)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    ExecutionContext ctx;
+    EXPECT_TRUE(execute_suspendable(*instance, 4, nullptr, nullptr, ctx).suspended);
+    EXPECT_EQ(host_args, std::vector<uint32_t>{5});
+    EXPECT_THAT(resume(ctx, nullptr), Result());
+}
+
+TEST(execute_suspend, suspend_deep_call_stack)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    ExecutionContext ctx;
+    const Value args[]{1000};
+    Value result{};
+    EXPECT_TRUE(execute_suspendable(*instance, 3, args, &result, ctx).suspended);
+    EXPECT_EQ(ctx.depth, 1001);
+
+    const Value host_result{5};
+    EXPECT_THAT(resume(ctx, &host_result), Result());
+    EXPECT_EQ(result.i32, 1005);
+    EXPECT_EQ(ctx.depth, 0);
+}
+
+TEST(execute_suspend, native_stack_limit)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    // The limit is set only while the suspendable execution runs.
+    ExecutionContext ctx;
+    const Value args[]{1000};
+    Value result{};
+    EXPECT_TRUE(execute_suspendable(*instance, 3, args, &result, ctx).suspended);
+    EXPECT_EQ(ctx.native_stack_limit, 0);
+    const Value host_result{5};
+    EXPECT_THAT(resume(ctx, &host_result), Result());
+    EXPECT_EQ(ctx.native_stack_limit, 0);
+
+    // The call traps when the native stack is below the limit.
+    ctx.native_stack_limit = std::numeric_limits<uintptr_t>::max();
+    EXPECT_THAT(execute(*instance, 3, {1000}, ctx), Traps());
+    EXPECT_EQ(host_args, std::vector<uint32_t>{0});
+    EXPECT_EQ(ctx.depth, 0);
+}
+
+TEST(execute_suspend, not_suspendable)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    EXPECT_THAT(execute(*instance, 2, {3}), Traps());
+    EXPECT_EQ(host_args, std::vector<uint32_t>{3});
+}
+
+TEST(execute_suspend, cancel)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    ExecutionContext ctx;
+    const Value args[]{10};
+    Value result{};
+    EXPECT_TRUE(execute_suspendable(*instance, 3, args, &result, ctx).suspended);
+    EXPECT_EQ(ctx.depth, 11);
+
+    // The frames are unwound.
+    ctx.suspendable_execution.reset();
+    EXPECT_EQ(ctx.depth, 0);
+
+    EXPECT_TRUE(execute_suspendable(*instance, 3, args, &result, ctx).suspended);
+    const Value host_result{1};
+    EXPECT_THAT(resume(ctx, &host_result), Result());
+    EXPECT_EQ(result.i32, 11);
+
+    // The context destroyed with the suspended execution cancels it too.
+    ExecutionContext ctx2;
+    EXPECT_TRUE(execute_suspendable(*instance, 3, args, &result, ctx2).suspended);
+}
+
+TEST(execute_suspend, resume_in_another_thread)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    ExecutionContext ctx;
+    const Value args[]{3};
+    Value result{};
+    EXPECT_TRUE(execute_suspendable(*instance, 2, args, &result, ctx).suspended);
+
+    std::thread{[&ctx] {
+        const Value host_result{1};
+        EXPECT_TRUE(resume(ctx, &host_result).suspended);
+    }}.join();
+
+    const Value host_result{2};
+    EXPECT_THAT(resume(ctx, &host_result), Result());
+    EXPECT_EQ(result.i32, 3);
+}
+
+TEST(execute_suspend, many_suspended_executions)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    constexpr size_t num_executions = 100;
+    std::vector<ExecutionContext> contexts(num_executions);
+    std::vector<Value> results(num_executions);
+    for (size_t i = 0; i < num_executions; ++i)
+    {
+        const Value args[]{static_cast<uint32_t>(i)};
+        EXPECT_TRUE(execute_suspendable(*instance, 2, args, &results[i], contexts[i]).suspended);
+    }
+
+    const Value host_result{1};
+    for (auto& ctx : contexts)
+        EXPECT_TRUE(resume(ctx, &host_result).suspended);
+    for (auto& ctx : contexts)
+        EXPECT_THAT(resume(ctx, &host_result), Result());
+
+    for (const auto& result : results)
+        EXPECT_EQ(result.i32, 2);
+    EXPECT_EQ(host_args.size(), 2 * num_executions);
+}
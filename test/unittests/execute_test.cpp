@@ -9,6 +9,9 @@
 #include <test/utils/asserts.hpp>
 #include <test/utils/execute_helpers.hpp>
 #include <test/utils/hex.hpp>
+#include <test/utils/wasm_binary.hpp>
+#include <chrono>
+#include <thread>
 
 using namespace fizzy;
 using namespace fizzy::test;
@@ -416,9 +419,11 @@ TEST(execute, i32_load_all_variants)
         from_hex("0061736d0100000001060160017f017f030201000504010101010a0901070020002802000b");
     const auto module = parse(wasm);
 
-    auto* const load_instr = const_cast<uint8_t*>(&module->codesec[0].instructions[5]);
+    ASSERT_EQ(module->codesec[0].immediate_size, 1);
+    auto* const load_instr =
+        const_cast<uint8_t*>(&module->get_instructions(module->codesec[0])[2]);
     ASSERT_EQ(*load_instr, Instr::i32_load);
-    ASSERT_EQ(bytes_view(load_instr + 1, 4), "00000000"_bytes);  // load offset.
+    ASSERT_EQ(bytes_view(load_instr + 1, 1), "00"_bytes);  // load offset.
 
     const auto memory_fill = "deb0b1b2b3ed"_bytes;
 
@@ -454,9 +459,11 @@ TEST(execute, i64_load_all_variants)
         from_hex("0061736d0100000001060160017f017e030201000504010101010a0901070020002903000b");
     const auto module = parse(wasm);
 
-    auto* const load_instr = const_cast<uint8_t*>(&module->codesec[0].instructions[5]);
+    ASSERT_EQ(module->codesec[0].immediate_size, 1);
+    auto* const load_instr =
+        const_cast<uint8_t*>(&module->get_instructions(module->codesec[0])[2]);
     ASSERT_EQ(*load_instr, Instr::i64_load);
-    ASSERT_EQ(bytes_view(load_instr + 1, 4), "00000000"_bytes);  // load offset.
+    ASSERT_EQ(bytes_view(load_instr + 1, 1), "00"_bytes);  // load offset.
 
     const auto memory_fill = "deb0b1b2b3b4b5b6b7ed"_bytes;
 
@@ -565,9 +572,11 @@ TEST(execute, i32_store_all_variants)
         from_hex("0061736d0100000001060160027f7f00030201000504010101010a0b010900200120003602000b");
     const auto module = parse(wasm);
 
-    auto* const store_instr = const_cast<uint8_t*>(&module->codesec[0].instructions[10]);
+    ASSERT_EQ(module->codesec[0].immediate_size, 1);
+    auto* const store_instr =
+        const_cast<uint8_t*>(&module->get_instructions(module->codesec[0])[4]);
     ASSERT_EQ(*store_instr, Instr::i32_store);
-    ASSERT_EQ(bytes_view(store_instr + 1, 4), "00000000"_bytes);  // store offset
+    ASSERT_EQ(bytes_view(store_instr + 1, 1), "00"_bytes);  // store offset
 
     const std::tuple<Instr, bytes> test_cases[]{
         {Instr::i32_store8, "ccb0cccccccc"_bytes},
@@ -601,9 +610,11 @@ TEST(execute, i64_store_all_variants)
         from_hex("0061736d0100000001060160027e7f00030201000504010101010a0b010900200120003703000b");
     const auto module = parse(wasm);
 
-    auto* const store_instr = const_cast<uint8_t*>(&module->codesec[0].instructions[10]);
+    ASSERT_EQ(module->codesec[0].immediate_size, 1);
+    auto* const store_instr =
+        const_cast<uint8_t*>(&module->get_instructions(module->codesec[0])[4]);
     ASSERT_EQ(*store_instr, Instr::i64_store);
-    ASSERT_EQ(bytes_view(store_instr + 1, 4), "00000000"_bytes);  // store offset
+    ASSERT_EQ(bytes_view(store_instr + 1, 1), "00"_bytes);  // store offset
 
     const std::tuple<Instr, bytes> test_cases[]{
         {Instr::i64_store8, "ccb0cccccccccccccccc"_bytes},
@@ -995,6 +1006,30 @@ TEST(execute, memory_copy_32bytes)
     EXPECT_EQ(output, input);
 }
 
+TEST(execute, compact_immediate_sizes)
+{
+    // (func (param i32) (result i32)
+    //   (local i32 x N)
+    //   local.get 0
+    //   local.set N
+    //   local.get N
+    // )
+    for (const auto& [num_locals, expected_immediate_size] :
+        {std::pair{10u, 1}, std::pair{300u, 2}, std::pair{70000u, 4}})
+    {
+        const auto local_idx = leb128u_encode(num_locals);
+        const auto func_bin = "01"_bytes + leb128u_encode(num_locals) + "7f2000"_bytes +
+                              uint8_t{0x21} + local_idx + uint8_t{0x20} + local_idx + "0b"_bytes;
+        const auto wasm = bytes{wasm_prefix} + make_section(1, make_vec({"60017f017f"_bytes})) +
+                          make_section(3, make_vec({"00"_bytes})) +
+                          make_section(10, make_vec({add_size_prefix(func_bin)}));
+
+        const auto module = parse(wasm);
+        EXPECT_EQ(module->codesec[0].immediate_size, expected_immediate_size);
+        EXPECT_THAT(execute(*instantiate(*module), 0, {0xbeef}), Result(0xbeef));
+    }
+}
+
 TEST(execute, reuse_args)
 {
     /* wat2wasm
@@ -1124,3 +1159,78 @@ TEST(execute, metering_memory)
     ctx.ticks = 65536;
     EXPECT_THAT(execute(*instance, 0, {}, ctx), Traps());
 }
+
+TEST(execute, interrupt)
+{
+    /* wat2wasm
+    (func (export "loop") (loop (br 0)))
+    (func (return_call 1))
+    (func (result i32) (i32.const 1))
+    (func unreachable)
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000108026000006000017f03050400000100070801046c6f6f7000000a1704070003400c000b"
+        "0b040012010b040041010b0300000b");
+    auto instance = instantiate(parse(wasm));
+
+    ExecutionContext ctx;
+    EXPECT_THAT(execute(*instance, 2, {}, ctx), Result(1));
+    const auto trap = execute(*instance, 3, {}, ctx);
+    EXPECT_THAT(trap, Traps());
+    EXPECT_FALSE(trap.interrupted);
+
+    // The flag is not reset by the execution.
+    ctx.interrupt_requested = true;
+    for (const FuncIdx func_idx : {0u, 1u})
+    {
+        const auto result = execute(*instance, func_idx, {}, ctx);
+        EXPECT_THAT(result, Traps());
+        EXPECT_TRUE(result.interrupted);
+        EXPECT_EQ(ctx.depth, 0);
+    }
+
+    // The function without loops and calls to unbounded functions is not polled.
+    EXPECT_THAT(execute(*instance, 2, {}, ctx), Result(1));
+
+    ctx.interrupt_requested = false;
+    EXPECT_THAT(execute(*instance, 2, {}, ctx), Result(1));
+}
+
+TEST(execute, interrupt_from_another_thread)
+{
+    /* wat2wasm
+    (func (export "loop") (loop (br 0)))
+    (func (return_call 1))
+    (func (result i32) (i32.const 1))
+    (func unreachable)
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000108026000006000017f03050400000100070801046c6f6f7000000a1704070003400c000b"
+        "0b040012010b040041010b0300000b");
+    auto instance1 = instantiate(parse(wasm));
+
+    /* wat2wasm
+    (func $loop (import "m" "loop"))
+    (func (call $loop))
+    */
+    const auto wasm_importer =
+        from_hex("0061736d01000000010401600000020a01016d046c6f6f700000030201000a0601040010000b");
+    auto instance2 =
+        instantiate(parse(wasm_importer), {*find_exported_function(*instance1, "loop")});
+
+    for (const auto& [instance, func_idx] : {std::pair{instance1.get(), FuncIdx{0}},
+             std::pair{instance1.get(), FuncIdx{1}}, std::pair{instance2.get(), FuncIdx{1}}})
+    {
+        ExecutionContext ctx;
+        std::thread timer{[&ctx] {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            ctx.interrupt_requested = true;
+        }};
+        const auto result = execute(*instance, func_idx, {}, ctx);
+        timer.join();
+
+        EXPECT_THAT(result, Traps());
+        EXPECT_TRUE(result.interrupted);
+        EXPECT_EQ(ctx.depth, 0);
+    }
+}
@@ -0,0 +1,22 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "hash.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+TEST(hash, hash_bytes)
+{
+    const auto wasm1 = from_hex("0061736d010000000105016000017f030201000a0601040041010b");
+    const auto wasm2 = from_hex("0061736d010000000105016000017f030201000a0601040041020b");
+
+    EXPECT_EQ(hash_bytes({}), hash_bytes({}));
+    EXPECT_EQ(hash_bytes(wasm1), hash_bytes(bytes{wasm1}));
+    EXPECT_NE(hash_bytes(wasm1), hash_bytes(wasm2));
+    EXPECT_NE(hash_bytes("00"_bytes), hash_bytes("0000"_bytes));
+    EXPECT_NE(hash_bytes("0000000000000000"_bytes), hash_bytes("000000000000000000"_bytes));
+}
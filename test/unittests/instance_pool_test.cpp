@@ -0,0 +1,241 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "instance_pool.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (memory 2)
+  (global (mut i32) (i32.const 7))
+  (func (param i32 i32) (i32.store (local.get 0) (local.get 1)))
+  (func (param i32) (result i32) (i32.load (local.get 0)))
+  (func (result i32) (memory.grow (i32.const 1)))
+  (func (param i32) (global.set 0 (local.get 0)))
+  (func (result i32) (global.get 0))
+  (func (result i32) (memory.size))
+  (data (i32.const 0) "\01\02")
+*/
+const auto wasm_memory_global = from_hex(
+    "0061736d0100000001130460027f7f0060017f017f6000017f60017f0003070600010203020205030100020606"
+    "017f0141070b0a2b060900200020013602000b070020002802000b0600410140000b0600200024000b040023000b"
+    "04003f000b0b08010041000b020102");
+}  // namespace
+
+TEST(instance_pool, reuse_instance)
+{
+    InstancePool pool{parse(wasm_memory_global)};
+    EXPECT_EQ(pool.idle_count(), 0);
+
+    auto instance = pool.acquire();
+    const auto* const instance_ptr = instance.get();
+    pool.release(std::move(instance));
+    EXPECT_EQ(pool.idle_count(), 1);
+
+    instance = pool.acquire();
+    EXPECT_EQ(instance.get(), instance_ptr);
+    EXPECT_EQ(pool.idle_count(), 0);
+
+    auto instance2 = pool.acquire();
+    EXPECT_NE(instance2.get(), instance_ptr);
+}
+
+TEST(instance_pool, max_idle)
+{
+    InstancePool pool{parse(wasm_memory_global), {}, {}, DefaultMemoryPagesLimit, 1};
+    auto instance1 = pool.acquire();
+    auto instance2 = pool.acquire();
+    pool.release(std::move(instance1));
+    pool.release(std::move(instance2));
+    EXPECT_EQ(pool.idle_count(), 1);
+}
+
+TEST(instance_pool, reset_memory)
+{
+    InstancePool pool{parse(wasm_memory_global)};
+
+    auto instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 1, {0}), Result(0x0201));
+    EXPECT_THAT(execute(*instance, 0, {0, 0xaabbccdd}), Result());
+    // Store crossing the boundary of tracked blocks.
+    EXPECT_THAT(execute(*instance, 0, {DirtyMemoryBlockSize - 2, 0x11223344}), Result());
+    // Store into the last block of the memory.
+    EXPECT_THAT(execute(*instance, 0, {2 * PageSize - 4, 0x55}), Result());
+    EXPECT_THAT(execute(*instance, 1, {0}), Result(0xaabbccdd));
+
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 1, {0}), Result(0x0201));
+    EXPECT_THAT(execute(*instance, 1, {DirtyMemoryBlockSize - 2}), Result(0));
+    EXPECT_THAT(execute(*instance, 1, {2 * PageSize - 4}), Result(0));
+    EXPECT_EQ(*instance->memory, bytes(2 * PageSize, 0).replace(0, 2, "0102"_bytes));
+}
+
+TEST(instance_pool, reset_grown_memory)
+{
+    InstancePool pool{parse(wasm_memory_global)};
+
+    auto instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 2, {}), Result(2));
+    EXPECT_THAT(execute(*instance, 5, {}), Result(3));
+    EXPECT_THAT(execute(*instance, 0, {2 * PageSize, 0xff}), Result());
+
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 5, {}), Result(2));
+    EXPECT_THAT(execute(*instance, 1, {2 * PageSize}), Traps());
+    EXPECT_THAT(execute(*instance, 2, {}), Result(2));
+    EXPECT_THAT(execute(*instance, 1, {2 * PageSize}), Result(0));
+}
+
+TEST(instance_pool, reset_memory_modified_by_embedder)
+{
+    InstancePool pool{parse(wasm_memory_global)};
+
+    auto instance = pool.acquire();
+    (*instance->memory)[PageSize] = 0xfe;
+    mark_memory_dirty(*instance, PageSize, 1);
+
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_EQ((*instance->memory)[PageSize], 0);
+}
+
+TEST(instance_pool, reset_globals)
+{
+    InstancePool pool{parse(wasm_memory_global)};
+
+    auto instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 4, {}), Result(7));
+    EXPECT_THAT(execute(*instance, 3, {42}), Result());
+    EXPECT_THAT(execute(*instance, 4, {}), Result(42));
+
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 4, {}), Result(7));
+}
+
+TEST(instance_pool, reset_memory_modified_by_host_function)
+{
+    /* wat2wasm
+      (func (import "env" "host"))
+      (memory 1)
+      (func (call 0))
+      (func (param i32) (result i32) (i32.load (local.get 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001090260000060017f017f020c0103656e7604686f73740000030302000105030100010a"
+        "0e02040010000b070020002802000b");
+
+    constexpr auto host = [](std::any&, Instance& instance, const Value*,
+                              ExecutionContext&) noexcept {
+        (*instance.memory)[100] = 0xff;
+        return Void;
+    };
+
+    const std::shared_ptr<const Module> module = parse(wasm);
+    InstancePool pool{module, {{{host}, module->typesec[0]}}};
+
+    auto instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 1, {}), Result());
+    EXPECT_TRUE(instance->memory_dirty_untracked);
+    EXPECT_THAT(execute(*instance, 2, {100}), Result(0xff));
+
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_FALSE(instance->memory_dirty_untracked);
+    EXPECT_THAT(execute(*instance, 2, {100}), Result(0));
+}
+
+TEST(instance_pool, reset_memory_marked_dirty_by_host_function)
+{
+    /* wat2wasm
+      (func (import "env" "host"))
+      (memory 1)
+      (func (call 0))
+      (func (param i32) (result i32) (i32.load (local.get 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001090260000060017f017f020c0103656e7604686f73740000030302000105030100010a"
+        "0e02040010000b070020002802000b");
+
+    constexpr auto host = [](std::any&, Instance& instance, const Value*,
+                              ExecutionContext&) noexcept {
+        (*instance.memory)[100] = 0xff;
+        mark_memory_dirty(instance, 100, 1);
+        return Void;
+    };
+
+    const std::shared_ptr<const Module> module = parse(wasm);
+    InstancePool pool{
+        module, {{{host}, module->typesec[0]}}, {}, DefaultMemoryPagesLimit, 64, true};
+
+    auto instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 1, {}), Result());
+    EXPECT_FALSE(instance->memory_dirty_untracked);
+    EXPECT_EQ(instance->dirty_memory_blocks[0], 1);
+    EXPECT_THAT(execute(*instance, 2, {100}), Result(0xff));
+
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 2, {100}), Result(0));
+}
+
+TEST(instance_pool, reset_table)
+{
+    /* wat2wasm
+      (table 2 funcref)
+      (elem (i32.const 1) 0)
+      (func (result i32) (i32.const 42))
+      (func (param i32) (result i32) (call_indirect (type 0) (local.get 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010a026000017f60017f017f03030200010404017000020907010041010b01000a0e0204"
+        "00412a0b070020001100000b");
+
+    InstancePool pool{parse(wasm)};
+
+    auto instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 1, {1}), Result(42));
+    (*instance->table)[0] = (*instance->table)[1];
+    (*instance->table)[1] = {};
+    EXPECT_THAT(execute(*instance, 1, {0}), Result(42));
+    EXPECT_THAT(execute(*instance, 1, {1}), Traps());
+
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 1, {0}), Traps());
+    EXPECT_THAT(execute(*instance, 1, {1}), Result(42));
+    EXPECT_EQ((*instance->table)[1].instance, instance.get());
+}
+
+TEST(instance_pool, imported_memory)
+{
+    /* wat2wasm
+      (memory (import "mod" "m") 1)
+    */
+    const auto wasm = from_hex("0061736d01000000020a01036d6f64016d020001");
+
+    EXPECT_THROW_MESSAGE(InstancePool{parse(wasm)}, instantiate_error,
+        "instance pool does not support imported memory");
+}
+
+TEST(instance_pool, imported_table)
+{
+    /* wat2wasm
+      (table (import "mod" "t") 1 funcref)
+    */
+    const auto wasm = from_hex("0061736d01000000020b01036d6f64017401700001");
+
+    EXPECT_THROW_MESSAGE(InstancePool{parse(wasm)}, instantiate_error,
+        "instance pool does not support imported table");
+}
@@ -248,6 +248,25 @@ TEST(instantiate, imported_memory_stricter_limits)
     EXPECT_EQ(instance->memory_limits.max, 2);
 }
 
+TEST(instantiate, imported_memory_shared)
+{
+    /* wat2wasm --enable-threads
+      (memory (import "mod" "m") 1 3 shared)
+    */
+    const auto bin = from_hex("0061736d01000000020b01036d6f64016d02030103");
+    const auto module = parse(bin);
+
+    bytes memory(PageSize, 0);
+    auto instance = instantiate(*module, {}, {}, {{&memory, {1, 3, true}}});
+    EXPECT_EQ(instance->memory->data(), memory.data());
+    EXPECT_TRUE(instance->memory_limits.shared);
+    // The shared memory cannot grow.
+    EXPECT_EQ(instance->memory_pages_limit, 1);
+
+    EXPECT_THROW_MESSAGE(instantiate(*module, {}, {}, {{&memory, {1, 3}}}), instantiate_error,
+        "provided imported memory sharing doesn't match module's imported memory");
+}
+
 TEST(instantiate, imported_memory_invalid)
 {
     /* wat2wasm
@@ -448,6 +467,32 @@ TEST(instantiate, imported_globals_nullptr)
         "global 0 has a null pointer to value");
 }
 
+TEST(instantiate, shared_module)
+{
+    /* wat2wasm
+      (memory 1)
+      (global (mut i32) (i32.const 1))
+    */
+    const auto bin = from_hex("0061736d0100000005030100010606017f0141010b");
+
+    const std::shared_ptr<const Module> module = parse(bin);
+    auto instance1 = instantiate(module);
+    auto instance2 = instantiate(module);
+    EXPECT_EQ(instance1->module, module);
+    EXPECT_EQ(instance2->module, module);
+    EXPECT_EQ(module.use_count(), 3);
+
+    // Instances share the module, but not the state.
+    instance1->globals[0].i32 = 2;
+    (*instance1->memory)[0] = 0xff;
+    EXPECT_EQ(instance2->globals[0].i32, 1);
+    EXPECT_EQ((*instance2->memory)[0], 0);
+
+    instance1.reset();
+    EXPECT_EQ(module.use_count(), 2);
+    EXPECT_EQ(instance2->module->globalsec.size(), 1);
+}
+
 TEST(instantiate, memory_default)
 {
     auto instance = instantiate(std::make_unique<Module>());
@@ -804,6 +849,43 @@ TEST(instantiate, data_section)
     EXPECT_EQ(instance->memory->substr(0, 6), from_hex("00aa55550000"));
 }
 
+TEST(instantiate, data_section_memory_image)
+{
+    /* wat2wasm
+      (memory 1)
+      (data (i32.const 1) "\aa\ff")
+      (data (i32.const 2) "\55\55")
+    */
+    const auto bin = from_hex("0061736d0100000005030100010b0f020041010b02aaff0041020b025555");
+    const auto module = parse(bin);
+    ASSERT_TRUE(module->memory_image.has_value());
+
+    auto instance = instantiate(*module);
+
+    ASSERT_EQ(instance->memory->size(), PageSize);
+    EXPECT_EQ(instance->memory->substr(0, 6), from_hex("00aa55550000"));
+    EXPECT_EQ(instance->memory->find_first_not_of(uint8_t{0}, 4), bytes::npos);
+
+    /* wat2wasm
+      (memory 2)
+      (data (i32.const 0) "\aa")
+      (data (i32.const 100000) "\ff")
+    */
+    const auto bin_sparse =
+        from_hex("0061736d0100000005030100020b0f020041000b01aa0041a08d060b01ff");
+    const auto module_sparse = parse(bin_sparse);
+    ASSERT_TRUE(module_sparse->memory_image.has_value());
+    ASSERT_EQ(module_sparse->memory_image->runs.size(), 2);
+
+    auto instance_sparse = instantiate(*module_sparse);
+
+    ASSERT_EQ(instance_sparse->memory->size(), 2 * PageSize);
+    EXPECT_EQ((*instance_sparse->memory)[0], 0xaa);
+    EXPECT_EQ(instance_sparse->memory->find_first_not_of(uint8_t{0}, 1), 100000);
+    EXPECT_EQ((*instance_sparse->memory)[100000], 0xff);
+    EXPECT_EQ(instance_sparse->memory->find_first_not_of(uint8_t{0}, 100001), bytes::npos);
+}
+
 TEST(instantiate, data_section_offset_from_global)
 {
     const auto module{std::make_unique<Module>()};
@@ -863,6 +945,24 @@ TEST(instantiate, data_section_fills_imported_memory)
     EXPECT_EQ(memory.substr(0, 6), from_hex("00aa55550000"));
 }
 
+TEST(instantiate, data_section_keeps_imported_memory_between_segments)
+{
+    /* wat2wasm
+      (memory (import "mod" "m") 1 1)
+      (data (i32.const 0) "\aa\ff")
+      (data (i32.const 100) "\55\55")
+    */
+    const auto bin = from_hex(
+        "0061736d01000000020b01036d6f64016d020101010b10020041000b02aaff0041e4000b025555");
+
+    bytes memory(PageSize, 0x77);
+    auto instance = instantiate(parse(bin), {}, {}, {{&memory, {1, 1}}});
+
+    EXPECT_EQ(memory.substr(0, 3), from_hex("aaff77"));
+    EXPECT_EQ(memory[50], 0x77);
+    EXPECT_EQ(memory.substr(99, 4), from_hex("77555577"));
+}
+
 TEST(instantiate, data_section_out_of_bounds_doesnt_change_imported_memory)
 {
     /* wat2wasm
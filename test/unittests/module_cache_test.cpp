@@ -0,0 +1,198 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "module_cache.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/hex.hpp>
+#include <thread>
+#include <vector>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (func (result i32) (i32.const 1))
+*/
+const auto wasm1 = from_hex("0061736d010000000105016000017f030201000a0601040041010b");
+
+/* wat2wasm
+  (func (result i32) (i32.const 2))
+*/
+const auto wasm2 = from_hex("0061736d010000000105016000017f030201000a0601040041020b");
+
+/* wat2wasm
+  (func (result i32) (i32.const 3))
+*/
+const auto wasm3 = from_hex("0061736d010000000105016000017f030201000a0601040041030b");
+}  // namespace
+
+TEST(module_cache, module_size)
+{
+    const auto module1 = parse(wasm1);
+    EXPECT_GE(get_module_size(*module1), sizeof(Module) + module1->code_buffer.size());
+
+    /* wat2wasm
+      (memory 1)
+      (data (i32.const 0) "0123456789abcdef")
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000005030100010b16010041000b1030313233343536373839616263646566");
+    const auto module = parse(wasm);
+    ASSERT_EQ(module->datasec.size(), 1);
+    ASSERT_TRUE(module->memory_image.has_value());
+    // The data segment payload is only kept in the memory image built from it.
+    EXPECT_TRUE(module->datasec[0].init.empty());
+    EXPECT_GE(get_module_size(*module), sizeof(Module) + 16);
+
+    ModuleCache cache{4096};
+    cache.get_or_parse(wasm);
+    EXPECT_EQ(cache.used_bytes(), wasm.size() + get_module_size(*module));
+}
+
+TEST(module_cache, hit)
+{
+    ModuleCache cache{4096};
+    EXPECT_EQ(cache.find(wasm1), nullptr);
+
+    const auto module1 = cache.get_or_parse(wasm1);
+    ASSERT_NE(module1, nullptr);
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_EQ(cache.hits(), 0);
+    EXPECT_EQ(cache.misses(), 1);
+    EXPECT_EQ(cache.used_bytes(), wasm1.size() + get_module_size(*module1));
+    EXPECT_EQ(module1->binary_hash, hash_bytes(wasm1));
+
+    EXPECT_EQ(cache.get_or_parse(bytes{wasm1}), module1);
+    EXPECT_EQ(cache.find(wasm1), module1);
+    EXPECT_EQ(cache.hits(), 1);
+    EXPECT_EQ(cache.misses(), 1);
+
+    const auto module2 = cache.get_or_parse(wasm2);
+    EXPECT_NE(module2, module1);
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.misses(), 2);
+}
+
+TEST(module_cache, lru_eviction)
+{
+    const auto cost = wasm1.size() + get_module_size(*parse(wasm1));
+    ModuleCache cache{2 * cost};
+
+    const auto module1 = cache.get_or_parse(wasm1);
+    const auto module2 = cache.get_or_parse(wasm2);
+    EXPECT_EQ(cache.size(), 2);
+
+    // Use module1, so module2 becomes the least recently used.
+    EXPECT_EQ(cache.get_or_parse(wasm1), module1);
+
+    const auto module3 = cache.get_or_parse(wasm3);
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.used_bytes(), 2 * cost);
+    EXPECT_EQ(cache.find(wasm1), module1);
+    EXPECT_EQ(cache.find(wasm2), nullptr);
+    EXPECT_EQ(cache.find(wasm3), module3);
+
+    // The evicted module stays alive while used.
+    EXPECT_EQ(module2->codesec.size(), 1);
+}
+
+TEST(module_cache, over_budget)
+{
+    ModuleCache cache{wasm1.size()};
+    const auto module = cache.get_or_parse(wasm1);
+    ASSERT_NE(module, nullptr);
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.used_bytes(), 0);
+}
+
+TEST(module_cache, invalid_binary)
+{
+    ModuleCache cache{4096};
+    EXPECT_THROW_MESSAGE(
+        cache.get_or_parse("0061736d"_bytes), parser_error, "invalid wasm module prefix");
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.misses(), 1);
+}
+
+TEST(module_cache, hash_collision)
+{
+    // Two 24-byte binaries with a custom section, made to collide by the last 8 bytes of its
+    // payload. The hash mixes the 8-byte words with a bijection, so the last word of the second
+    // binary is solved for from the states of the hashes before it.
+    constexpr uint64_t multiplier = 0x9e3779b97f4a7c15;
+    const auto mix_word = [](uint64_t h, uint64_t word) noexcept {
+        h ^= word * multiplier;
+        h = (h << 31) | (h >> 33);
+        return h * 0xbf58476d1ce4e5b9;
+    };
+    const auto load_word = [](const bytes& b, size_t offset) noexcept {
+        uint64_t word;
+        __builtin_memcpy(&word, &b[offset], sizeof(word));
+        return word;
+    };
+    uint64_t multiplier_inverse = multiplier;
+    for (int i = 0; i < 5; ++i)
+        multiplier_inverse *= 2 - multiplier * multiplier_inverse;
+
+    const auto wasm_a = from_hex("0061736d01000000000e00" "0000000000" "0000000000000000");
+    auto wasm_b = from_hex("0061736d01000000000e00" "0101010101" "0000000000000000");
+    const auto state = [&](const bytes& b) noexcept {
+        const auto h = mix_word(uint64_t{b.size()} * multiplier, load_word(b, 0));
+        return mix_word(h, load_word(b, 8));
+    };
+    const uint64_t last_word_b =
+        (state(wasm_a) ^ state(wasm_b) ^ (load_word(wasm_a, 16) * multiplier)) * multiplier_inverse;
+    __builtin_memcpy(&wasm_b[16], &last_word_b, sizeof(last_word_b));
+    ASSERT_NE(wasm_a, wasm_b);
+    ASSERT_EQ(hash_bytes(wasm_a), hash_bytes(wasm_b));
+
+    ModuleCache cache{4096};
+    const auto module_a = cache.get_or_parse(wasm_a);
+    const auto module_b = cache.get_or_parse(wasm_b);
+    EXPECT_NE(module_a, module_b);
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.find(wasm_a), module_a);
+    EXPECT_EQ(cache.find(wasm_b), module_b);
+    EXPECT_EQ(cache.misses(), 2);
+}
+
+TEST(module_cache, clear)
+{
+    ModuleCache cache{4096};
+    const auto module = cache.get_or_parse(wasm1);
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.used_bytes(), 0);
+    EXPECT_EQ(cache.find(wasm1), nullptr);
+    EXPECT_NE(cache.get_or_parse(wasm1), module);
+}
+
+TEST(module_cache, concurrent)
+{
+    ModuleCache cache{4096};
+    const bytes* const binaries[]{&wasm1, &wasm2, &wasm3};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&cache, &binaries] {
+            for (int i = 0; i < 300; ++i)
+            {
+                const auto& wasm = *binaries[i % 3];
+                const auto module = cache.get_or_parse(wasm);
+                EXPECT_EQ(module->codesec.size(), 1);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(cache.size(), 3);
+    EXPECT_EQ(cache.hits() + cache.misses(), 4 * 300);
+    EXPECT_GE(cache.misses(), 3);
+}
@@ -30,11 +30,11 @@ TEST(module, functions)
     EXPECT_EQ(module->get_function_type(2), (FuncType{{ValType::i64}, {}}));
     EXPECT_EQ(module->get_function_type(3), (FuncType{{}, {ValType::f32}}));
 
-    EXPECT_EQ(module->get_code(1).instructions.size(), 1);
+    EXPECT_EQ(module->get_code(1).instructions_size, 1);
     EXPECT_EQ(module->get_code(1).local_count, 0);
-    EXPECT_EQ(module->get_code(2).instructions.size(), 1);
+    EXPECT_EQ(module->get_code(2).instructions_size, 1);
     EXPECT_EQ(module->get_code(2).local_count, 1);
-    EXPECT_EQ(module->get_code(3).instructions.size(), 6);
+    EXPECT_EQ(module->get_code(3).instructions_size, 6);
     EXPECT_EQ(module->get_code(3).local_count, 0);
 }
 
@@ -8,10 +8,12 @@
 
 #include "execute.hpp"
 #include "parser.hpp"
+#include "suspend.hpp"
 #include <gtest/gtest.h>
 #include <test/utils/asserts.hpp>
 #include <test/utils/execute_helpers.hpp>
 #include <test/utils/hex.hpp>
+#include <cstdlib>
 
 #ifdef __linux__
 #include <sys/resource.h>
@@ -36,7 +38,12 @@ namespace
 ///   at the point of setting the limit (otherwise it returns success, but has no effect).
 constexpr uint32_t OSMemoryLimitBytes = 2 * 1024 * 1024;
 
-/// Tries to set the OS memory limit. Returns true if the limit has been set.
+/// Tries to set the OS memory limit. Returns true if the limit has been set and takes effect.
+///
+/// The allocator may serve the allocations from the memory it has mapped already, e.g. glibc falls
+/// back to the arenas left by the threads of the previous tests, which are reserved in advance.
+/// The limit is then lifted again and false is returned, so the tests do not depend on the tests
+/// run before them.
 bool try_set_memory_limit(size_t size) noexcept;
 
 /// Lifts the previously set memory limit. Returns false in case of unexpected error.
@@ -54,6 +61,15 @@ bool try_set_memory_limit(size_t size) noexcept
     limit.rlim_cur = size;  // Set the soft limit, leaving the hard limit unchanged.
     err = setrlimit(RLIMIT_AS, &limit);
     assert(err == 0);
+
+    // The result is stored to volatile, so the allocation is not elided.
+    void* volatile probe = std::malloc(size);
+    if (probe != nullptr)
+    {
+        std::free(probe);
+        restore_memory_limit();
+        return false;
+    }
     return true;
 }
 
@@ -117,6 +133,28 @@ TEST(oom, execute_memory_grow)
     ASSERT_TRUE(restore_memory_limit());
 }
 
+TEST(oom, execute_suspendable_allocate_stack)
+{
+    /* wat2wasm
+    (func)
+    */
+    const auto wasm = from_hex("0061736d01000000010401600000030201000a040102000b");
+
+    auto instance = instantiate(parse(wasm));
+
+    ExecutionContext ctx;
+    const auto is_limited = try_set_memory_limit(OSMemoryLimitBytes);
+    const auto result = execute_suspendable(*instance, 0, nullptr, nullptr, ctx);
+    ASSERT_TRUE(restore_memory_limit());
+    if (is_limited)
+    {
+        EXPECT_THAT(result, Traps());
+        EXPECT_EQ(ctx.suspendable_execution, nullptr);
+    }
+    else
+        EXPECT_THAT(result, Result());
+}
+
 TEST(oom, capi_instantiate)
 {
     /* wat2wasm
@@ -14,8 +14,8 @@ using namespace testing;
 
 namespace
 {
-const Module ModuleWithSingleFunction = {
-    {FuncType{{}, {}}}, {}, {0}, {}, {}, {}, {}, std::nullopt, {}, {}, {}, {}, {}, {}, {}};
+const Module ModuleWithSingleFunction = {{FuncType{{}, {}}}, {}, {0}, {}, {}, {}, {}, std::nullopt,
+    {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}};
 
 inline auto parse_expr(bytes_view input, FuncIdx func_idx = 0,
     const std::vector<Locals>& locals = {}, const Module& module = ModuleWithSingleFunction)
@@ -59,8 +59,16 @@ TEST(parser_expr, instr_loop_input_buffer_overflow)
 
 TEST(parser_expr, instr_block)
 {
-    const auto wrong_type = "0200"_bytes;
-    EXPECT_THROW_MESSAGE(parse_expr(wrong_type), parser_error, "invalid valtype 0");
+    const auto wrong_type = "0260"_bytes;
+    EXPECT_THROW_MESSAGE(parse_expr(wrong_type), parser_error, "invalid valtype 96");
+
+    const auto wrong_type_idx = "02010b0b"_bytes;
+    EXPECT_THROW_MESSAGE(
+        parse_expr(wrong_type_idx), validation_error, "invalid type index with block");
+
+    const auto type_idx = "02000b0b"_bytes;
+    const auto [code0, pos0] = parse_expr(type_idx);
+    EXPECT_THAT(code0.instructions, ElementsAre(Instr::block, Instr::end, Instr::end));
 
     const auto empty = "010102400b0b"_bytes;
     const auto [code1, pos1] = parse_expr(empty);
@@ -93,9 +101,9 @@ TEST(parser_expr, loop_br)
     const auto wasm = from_hex("0061736d01000000010401600000030201000a0901070003400c000b0b");
     const auto module = parse(wasm);
 
-    EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::loop, Instr::br, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 0, 0, 0, 0,
-            /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[0]),
+        ElementsAre(Instr::loop, Instr::br, /*arity:*/ 0, /*code_offset:*/ 0, /*stack_drop:*/ 0,
+            Instr::end, Instr::end));
 
     /* wat2wasm
     (func
@@ -108,10 +116,9 @@ TEST(parser_expr, loop_br)
         from_hex("0061736d01000000010401600000030201000a0c010a00410003400c000b1a0b");
     const auto module_parent_stack = parse(wasm_parent_stack);
 
-    EXPECT_THAT(module_parent_stack->codesec[0].instructions,
-        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::loop, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 5, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+    EXPECT_THAT(module_parent_stack->get_instructions(module_parent_stack->codesec[0]),
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::loop, Instr::br, /*arity:*/ 0,
+            /*code_offset:*/ 5, /*stack_drop:*/ 0, Instr::end, Instr::drop, Instr::end));
 
     /* wat2wasm
     (func
@@ -126,10 +133,9 @@ TEST(parser_expr, loop_br)
         from_hex("0061736d01000000010401600000030201000a0c010a00037f41000c000b1a0b");
     const auto module_arity = parse(wasm_arity);
 
-    EXPECT_THAT(module_arity->codesec[0].instructions,
-        ElementsAre(Instr::loop, Instr::i32_const, 0, 0, 0, 0, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 0, 0, 0, 0, /*stack_drop:*/ 1, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+    EXPECT_THAT(module_arity->get_instructions(module_arity->codesec[0]),
+        ElementsAre(Instr::loop, Instr::i32_const, 0, 0, 0, 0, Instr::br, /*arity:*/ 0,
+            /*code_offset:*/ 0, /*stack_drop:*/ 1, Instr::end, Instr::drop, Instr::end));
 }
 
 TEST(parser_expr, loop_return)
@@ -140,10 +146,9 @@ TEST(parser_expr, loop_return)
     const auto wasm = from_hex("0061736d01000000010401600000030201000a0801060003400f0b0b");
     const auto module = parse(wasm);
 
-    EXPECT_THAT(
-        module->codesec[0].instructions, ElementsAre(Instr::loop, Instr::return_,
-                                             /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 15, 0, 0, 0,
-                                             /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[0]),
+        ElementsAre(Instr::loop, Instr::return_, /*arity:*/ 0, /*code_offset:*/ 6,
+            /*stack_drop:*/ 0, Instr::end, Instr::end));
 }
 
 TEST(parser_expr, block_br)
@@ -181,10 +186,9 @@ TEST(parser_expr, block_br)
         from_hex("0061736d01000000010401600000030201000a0c010a00410002400c000b1a0b");
     const auto module_parent_stack = parse(wasm_parent_stack);
 
-    EXPECT_THAT(module_parent_stack->codesec[0].instructions,
-        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::block, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 20, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+    EXPECT_THAT(module_parent_stack->get_instructions(module_parent_stack->codesec[0]),
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::block, Instr::br, /*arity:*/ 0,
+            /*code_offset:*/ 11, /*stack_drop:*/ 0, Instr::end, Instr::drop, Instr::end));
 
     /* wat2wasm
     (func
@@ -199,10 +203,9 @@ TEST(parser_expr, block_br)
         from_hex("0061736d01000000010401600000030201000a0c010a00027f41000c000b1a0b");
     const auto module_arity = parse(wasm_arity);
 
-    EXPECT_THAT(module_arity->codesec[0].instructions,
-        ElementsAre(Instr::block, Instr::i32_const, 0, 0, 0, 0, Instr::br, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 20, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+    EXPECT_THAT(module_arity->get_instructions(module_arity->codesec[0]),
+        ElementsAre(Instr::block, Instr::i32_const, 0, 0, 0, 0, Instr::br, /*arity:*/ 1,
+            /*code_offset:*/ 11, /*stack_drop:*/ 0, Instr::end, Instr::drop, Instr::end));
 }
 
 TEST(parser_expr, block_return)
@@ -213,9 +216,9 @@ TEST(parser_expr, block_return)
     const auto wasm = from_hex("0061736d01000000010401600000030201000a0801060002400f0b0b");
     const auto module = parse(wasm);
 
-    EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::block, Instr::return_, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 15, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[0]),
+        ElementsAre(Instr::block, Instr::return_, /*arity:*/ 0, /*code_offset:*/ 6,
+            /*stack_drop:*/ 0, Instr::end, Instr::end));
 }
 
 TEST(parser_expr, if_br)
@@ -229,11 +232,10 @@ TEST(parser_expr, if_br)
     const auto wasm = from_hex("0061736d01000000010401600000030201000a0b010900410004400c000b0b");
     const auto module = parse(wasm);
 
-    EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::if_, /*else_offset:*/ 24, 0, 0, 0,
-            Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 24, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*24:*/ Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[0]),
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::if_, /*else_offset:*/ 12, Instr::br,
+            /*arity:*/ 0, /*code_offset:*/ 12, /*stack_drop:*/ 0, Instr::end,
+            /*12:*/ Instr::end));
 
     /* wat2wasm
     (func
@@ -247,11 +249,10 @@ TEST(parser_expr, if_br)
         from_hex("0061736d01000000010401600000030201000a0e010c004100410004400c000b1a0b");
     const auto module_parent_stack = parse(wasm_parent_stack);
 
-    EXPECT_THAT(module_parent_stack->codesec[0].instructions,
+    EXPECT_THAT(module_parent_stack->get_instructions(module_parent_stack->codesec[0]),
         ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::i32_const, 0, 0, 0, 0, Instr::if_,
-            /*else_offset:*/ 29, 0, 0, 0, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 29, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*29:*/ Instr::end, Instr::drop, Instr::end));
+            /*else_offset:*/ 17, Instr::br, /*arity:*/ 0, /*code_offset:*/ 17, /*stack_drop:*/ 0,
+            Instr::end, /*17:*/ Instr::drop, Instr::end));
 }
 
 TEST(parser_expr, instr_br_table)
@@ -285,28 +286,29 @@ TEST(parser_expr, instr_br_table)
     ASSERT_EQ(module->codesec.size(), 1);
     const auto& code = module->codesec[0];
 
-    EXPECT_THAT(code.instructions,
+    EXPECT_THAT(module->get_instructions(code),
         ElementsAre(Instr::block, Instr::block, Instr::block, Instr::block, Instr::block,
-            Instr::local_get, 0, 0, 0, 0, Instr::br_table,
-            /*label_count:*/ 4, 0, 0, 0, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 135, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 116, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 97, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 78, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 154, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-
-            /*59:*/ Instr::i32_const, 0x41, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*78:*/ Instr::i32_const, 0x42, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*97:*/ Instr::i32_const, 0x43, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*116:*/ Instr::i32_const, 0x44, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*135:*/ Instr::i32_const, 0x45, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*154:*/ Instr::i32_const, 0x46, 0, 0, 0,
-            /*159:*/ Instr::end));
+            Instr::local_get, 0, Instr::br_table,
+            /*label_count:*/ 4, /*arity:*/ 0,
+            /*code_offset:*/ 60, /*stack_drop:*/ 0,
+            /*code_offset:*/ 50, /*stack_drop:*/ 0,
+            /*code_offset:*/ 40, /*stack_drop:*/ 0,
+            /*code_offset:*/ 30, /*stack_drop:*/ 0,
+            /*code_offset:*/ 70, /*stack_drop:*/ 0,
+
+            /*20:*/ Instr::i32_const, 0x41, 0, 0, 0, Instr::return_, /*arity:*/ 1,
+            /*code_offset:*/ 75, /*stack_drop:*/ 0, Instr::end,
+            /*30:*/ Instr::i32_const, 0x42, 0, 0, 0, Instr::return_, /*arity:*/ 1,
+            /*code_offset:*/ 75, /*stack_drop:*/ 0, Instr::end,
+            /*40:*/ Instr::i32_const, 0x43, 0, 0, 0, Instr::return_, /*arity:*/ 1,
+            /*code_offset:*/ 75, /*stack_drop:*/ 0, Instr::end,
+            /*50:*/ Instr::i32_const, 0x44, 0, 0, 0, Instr::return_, /*arity:*/ 1,
+            /*code_offset:*/ 75, /*stack_drop:*/ 0, Instr::end,
+            /*60:*/ Instr::i32_const, 0x45, 0, 0, 0, Instr::return_, /*arity:*/ 1,
+            /*code_offset:*/ 75, /*stack_drop:*/ 0, Instr::end,
+            /*70:*/ Instr::i32_const, 0x46, 0, 0, 0,
+            /*75:*/ Instr::end));
+    EXPECT_EQ(code.immediate_size, 1);
 
     EXPECT_EQ(code.max_stack_height, 1);
 }
@@ -329,12 +331,11 @@ TEST(parser_expr, instr_br_table_empty_vector)
     ASSERT_EQ(module->codesec.size(), 1);
     const auto& code = module->codesec[0];
 
-    EXPECT_THAT(code.instructions,
-        ElementsAre(Instr::block, Instr::local_get, 0, 0, 0, 0, Instr::br_table,
-            /*label_count:*/ 0, 0, 0, 0, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 42, 0, 0, 0,
-            /*stack_drop:*/ 0, 0, 0, 0, Instr::i32_const, 0x63, 0, 0, 0, Instr::return_,
-            /*arity:*/ 1, 0, 0, 0, /*code_offset:*/ 47, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            Instr::end, Instr::i32_const, 0x64, 0, 0, 0, Instr::end));
+    EXPECT_THAT(module->get_instructions(code),
+        ElementsAre(Instr::block, Instr::local_get, 0, Instr::br_table, /*label_count:*/ 0,
+            /*arity:*/ 0, /*code_offset:*/ 18, /*stack_drop:*/ 0, Instr::i32_const, 0x63, 0, 0,
+            0, Instr::return_, /*arity:*/ 1, /*code_offset:*/ 23, /*stack_drop:*/ 0, Instr::end,
+            Instr::i32_const, 0x64, 0, 0, 0, Instr::end));
 
     EXPECT_EQ(code.max_stack_height, 1);
 }
@@ -528,3 +529,45 @@ TEST(parser_expr, call_nonexisting_typeidx)
 
     EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "invalid function type index");
 }
+
+TEST(parser_expr, compact_code_immediate_size)
+{
+    // local.get 300
+    // drop
+    // end
+    const auto [code16, pos16] = parse_expr("20ac021a0b"_bytes, 0, {{301, ValType::i32}});
+    const auto compact16 = compact_code(code16, std::pmr::get_default_resource());
+    EXPECT_EQ(compact16.immediate_size, 2);
+    EXPECT_THAT(compact16.instructions,
+        ElementsAre(Instr::local_get, 0x2c, 0x01, Instr::drop, Instr::end));
+
+    // local.get 70000
+    // drop
+    // end
+    const auto [code32, pos32] = parse_expr("20f0a2041a0b"_bytes, 0, {{70001, ValType::i32}});
+    const auto compact32 = compact_code(code32, std::pmr::get_default_resource());
+    EXPECT_EQ(compact32.immediate_size, 4);
+    EXPECT_EQ(compact32.instructions, code32.instructions);
+}
+
+TEST(parser_expr, compact_code_branch_offsets)
+{
+    // block
+    //   (i64.const 0; drop) x 50
+    //   br 0
+    // end
+    // end
+    bytes code_bin = "0240"_bytes;
+    for (int i = 0; i < 50; ++i)
+        code_bin += i64_const(0) + "1a"_bytes;
+    code_bin += "0c000b0b"_bytes;
+    const auto [code, pos] = parse_expr(code_bin);
+
+    // The compact code size exceeds 255, so the code offsets need 2 bytes.
+    const auto compact = compact_code(code, std::pmr::get_default_resource());
+    EXPECT_EQ(compact.immediate_size, 2);
+    ASSERT_EQ(compact.instructions.size(), 510);
+    EXPECT_EQ(compact.instructions[501], Instr::br);
+    EXPECT_THAT(bytes_view(&compact.instructions[502], 6),
+        ElementsAre(/*arity:*/ 0, 0, /*code_offset:*/ 0xfd, 0x01, /*stack_drop:*/ 0, 0));
+}
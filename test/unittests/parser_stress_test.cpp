@@ -0,0 +1,83 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/parser_stress.hpp>
+#include <algorithm>
+#include <chrono>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/// The size of the smaller modules, and how many times the bigger ones are bigger.
+constexpr size_t SmallSize = 1024;
+constexpr size_t SizeFactor = 32;
+
+/// The bound of the ratio of the times for the bigger and the smaller module. It allows
+/// the timing noise and the cache effects of several times the size factor, but not the square
+/// of it, which quadratic time would give.
+constexpr double MaxTimeRatio = 8 * SizeFactor;
+
+/// Returns the shortest time of several runs of the function, which is the least noisy one.
+template <typename Func>
+double measure(Func func)
+{
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < 5; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+/// Checks that parsing and validation of the modules made by the generator take linear time.
+void expect_linear_time(bytes (*generator)(size_t))
+{
+    const auto small = generator(SmallSize);
+    const auto big = generator(SmallSize * SizeFactor);
+
+    const auto parse_ratio = measure([&big] { parse(big); }) / measure([&small] { parse(small); });
+    EXPECT_LT(parse_ratio, MaxTimeRatio);
+
+    const auto validate_ratio =
+        measure([&big] { validate(big); }) / measure([&small] { validate(small); });
+    EXPECT_LT(validate_ratio, MaxTimeRatio);
+}
+}  // namespace
+
+TEST(parser_stress, deep_nesting)
+{
+    expect_linear_time(deep_nesting);
+}
+
+TEST(parser_stress, deep_br_table)
+{
+    expect_linear_time(deep_br_table);
+}
+
+TEST(parser_stress, huge_br_table)
+{
+    expect_linear_time(huge_br_table);
+}
+
+TEST(parser_stress, many_locals)
+{
+    expect_linear_time(many_locals);
+}
+
+TEST(parser_stress, long_locals_run)
+{
+    expect_linear_time(long_locals_run);
+}
+
+TEST(parser_stress, deep_operand_stack)
+{
+    expect_linear_time(deep_operand_stack);
+}
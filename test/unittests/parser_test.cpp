@@ -2,6 +2,7 @@
 // Copyright 2019-2020 The Fizzy Authors.
 // SPDX-License-Identifier: Apache-2.0
 
+#include "hash.hpp"
 #include "instructions.hpp"
 #include "parser.hpp"
 #include <gmock/gmock.h>
@@ -90,8 +91,8 @@ TEST(parser, limits_minmax_invalid_too_short)
 
 TEST(parser, limits_invalid)
 {
-    const auto wasm = bytes{wasm_prefix} + make_section(5, make_vec({"02"_bytes}));
-    EXPECT_THROW_MESSAGE(parse(wasm), parser_error, "invalid limits 2");
+    const auto wasm = bytes{wasm_prefix} + make_section(5, make_vec({"04"_bytes}));
+    EXPECT_THROW_MESSAGE(parse(wasm), parser_error, "invalid limits 4");
 }
 
 TEST(parser, module_empty)
@@ -102,6 +103,14 @@ TEST(parser, module_empty)
     EXPECT_EQ(module->codesec.size(), 0);
 }
 
+TEST(parser, module_binary_hash)
+{
+    const auto wasm = "0061736d01000000000401616263"_bytes;
+    EXPECT_EQ(parse(wasm)->binary_hash, hash_bytes(wasm));
+    EXPECT_EQ(parse(wasm, hash_bytes(wasm))->binary_hash, hash_bytes(wasm));
+    EXPECT_NE(parse(wasm_prefix)->binary_hash, hash_bytes(wasm));
+}
+
 TEST(parser, module_with_wrong_prefix)
 {
     EXPECT_THROW_MESSAGE(parse({}), parser_error, "invalid wasm module prefix");
@@ -262,6 +271,17 @@ TEST(parser, type_section_with_single_functype_params)
     EXPECT_EQ(module->codesec.size(), 0);
 }
 
+TEST(parser, type_section_with_v128)
+{
+    /* wat2wasm --enable-simd
+    (type (func (param v128 i32) (result v128)))
+    */
+    const auto module = parse(from_hex("0061736d0100000001070160027b7f017b"));
+    ASSERT_EQ(module->typesec.size(), 1);
+    EXPECT_EQ(module->typesec[0].inputs, (std::vector{ValType::v128, ValType::i32}));
+    EXPECT_EQ(module->typesec[0].outputs, std::vector{ValType::v128});
+}
+
 TEST(parser, type_section_with_multiple_functypes)
 {
     // type 0 [void] -> [void]
@@ -569,6 +589,23 @@ TEST(parser, memory_single_invalid_max_limit)
     EXPECT_THROW_MESSAGE(parse(bin), validation_error, "maximum memory page limit exceeded");
 }
 
+TEST(parser, memory_shared_limits)
+{
+    const auto bin = bytes{wasm_prefix} + make_section(5, make_vec({"030102"_bytes}));
+
+    const auto module = parse(bin);
+    ASSERT_EQ(module->memorysec.size(), 1);
+    EXPECT_EQ(module->memorysec[0].limits.min, 1);
+    EXPECT_EQ(module->memorysec[0].limits.max, 2);
+    EXPECT_TRUE(module->memorysec[0].limits.shared);
+
+    const auto bin_no_max = bytes{wasm_prefix} + make_section(5, make_vec({"0201"_bytes}));
+    EXPECT_THROW_MESSAGE(parse(bin_no_max), validation_error, "shared memory must have maximum");
+
+    const auto bin_table = bytes{wasm_prefix} + make_section(4, make_vec({"70030102"_bytes}));
+    EXPECT_THROW_MESSAGE(parse(bin_table), parser_error, "invalid limits 3");
+}
+
 TEST(parser, memory_limits_kind_out_of_bounds)
 {
     const auto wasm = bytes{wasm_prefix} + make_section(5, make_vec({""_bytes}));
@@ -673,6 +710,38 @@ TEST(parser, global_float)
     EXPECT_EQ(module->globalsec[2].expression.value.global_index, 1);
 }
 
+TEST(parser, global_v128)
+{
+    /* wat2wasm --enable-simd
+      (global (import "m" "g") v128)
+      (global (mut v128) (v128.const i64x2 1 2))
+      (global i32 (i32.const 3))
+      (global v128 (global.get 0))
+    */
+    const auto bin = from_hex(
+        "0061736d01000000020801016d0167037b000620037b01fd0c010000000000000002000000000000000b7f0041"
+        "030b7b0023000b");
+
+    const auto module = parse(bin);
+    ASSERT_EQ(module->imported_global_types.size(), 1);
+    EXPECT_EQ(module->imported_global_types[0].value_type, ValType::v128);
+
+    ASSERT_EQ(module->globalsec.size(), 3);
+    EXPECT_TRUE(module->globalsec[0].type.is_mutable);
+    EXPECT_EQ(module->globalsec[0].type.value_type, ValType::v128);
+    EXPECT_EQ(module->globalsec[0].expression.kind, ConstantExpression::Kind::Constant);
+    EXPECT_EQ(module->globalsec[0].expression.value.constant.i64, 1);
+    EXPECT_EQ(module->globalsec[0].expression.constant_high.i64, 2);
+    EXPECT_EQ(module->globalsec[1].type.value_type, ValType::i32);
+    EXPECT_EQ(module->globalsec[2].type.value_type, ValType::v128);
+    EXPECT_EQ(module->globalsec[2].expression.kind, ConstantExpression::Kind::GlobalGet);
+    EXPECT_EQ(module->globalsec[2].expression.value.global_index, 0);
+
+    // The v128 globals occupy 2 slots.
+    EXPECT_EQ(module->global_slots, (std::vector<uint32_t>{0, 2, 3}));
+    EXPECT_EQ(module->get_global_slot(1), 2);
+}
+
 TEST(parser, global_invalid_mutability)
 {
     const auto wasm = bytes{wasm_prefix} + make_section(6, make_vec({"7f02"_bytes}));
@@ -988,15 +1057,31 @@ TEST(parser, code_locals_2)
     EXPECT_EQ(module->codesec[0].local_count, 1 + 2 + 3 + 4);
 }
 
+TEST(parser, code_locals_v128)
+{
+    const auto wasm_locals1 = "017f"_bytes;  // 1 x i32.
+    const auto wasm_locals2 = "037b"_bytes;  // 3 x v128.
+    const auto wasm =
+        bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+        make_section(3, "0100"_bytes) +
+        make_section(10,
+            make_vec({add_size_prefix(make_vec({wasm_locals1, wasm_locals2}) + "0b"_bytes)}));
+
+    const auto module = parse(wasm);
+    ASSERT_EQ(module->codesec.size(), 1);
+    // The v128 local occupies 2 stack items.
+    EXPECT_EQ(module->codesec[0].local_count, 1 + 3 * 2);
+}
+
 TEST(parser, code_locals_invalid_type)
 {
-    const auto wasm_locals = "017b"_bytes;  // 1 x <invalid_type>.
+    const auto wasm_locals = "017a"_bytes;  // 1 x <invalid_type>.
     const auto wasm =
         bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
         make_section(3, "0100"_bytes) +
         make_section(10, make_vec({add_size_prefix(make_vec({wasm_locals}) + "0b"_bytes)}));
 
-    EXPECT_THROW_MESSAGE(parse(wasm), parser_error, "invalid valtype 123");
+    EXPECT_THROW_MESSAGE(parse(wasm), parser_error, "invalid valtype 122");
 }
 
 TEST(parser, code_locals_too_many)
@@ -1028,7 +1113,7 @@ TEST(parser, code_with_empty_expr_2_locals)
     ASSERT_EQ(module->codesec.size(), 1);
     const auto& code_obj = module->codesec[0];
     EXPECT_EQ(code_obj.local_count, 2);
-    EXPECT_THAT(code_obj.instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(module->get_instructions(code_obj), ElementsAre(Instr::end));
 }
 
 TEST(parser, code_with_empty_expr_5_locals)
@@ -1043,7 +1128,7 @@ TEST(parser, code_with_empty_expr_5_locals)
     ASSERT_EQ(module->codesec.size(), 1);
     const auto& code_obj = module->codesec[0];
     EXPECT_EQ(code_obj.local_count, 5);
-    EXPECT_THAT(code_obj.instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(module->get_instructions(code_obj), ElementsAre(Instr::end));
 }
 
 TEST(parser, code_section_with_2_trivial_codes)
@@ -1060,9 +1145,98 @@ TEST(parser, code_section_with_2_trivial_codes)
     EXPECT_EQ(module->typesec[0].outputs.size(), 0);
     ASSERT_EQ(module->codesec.size(), 2);
     EXPECT_EQ(module->codesec[0].local_count, 0);
-    EXPECT_THAT(module->codesec[0].instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[0]), ElementsAre(Instr::end));
     EXPECT_EQ(module->codesec[1].local_count, 0);
-    EXPECT_THAT(module->codesec[1].instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[1]), ElementsAre(Instr::end));
+}
+
+TEST(parser, code_section_layout)
+{
+    const auto code0_bin = add_size_prefix("000b"_bytes);
+    const auto code1_bin = add_size_prefix("00010b"_bytes);
+    const auto code2_bin = add_size_prefix("0001010b"_bytes);
+    const auto bin = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+                     make_section(3, "03000000"_bytes) +
+                     make_section(10, make_vec({code0_bin, code1_bin, code2_bin}));
+
+    const auto module = parse(bin);
+    ASSERT_EQ(module->codesec.size(), 3);
+    EXPECT_EQ(module->code_buffer.size(), 6);
+    EXPECT_EQ(module->codesec[0].instructions_offset, 0);
+    EXPECT_EQ(module->codesec[1].instructions_offset, 1);
+    EXPECT_EQ(module->codesec[2].instructions_offset, 3);
+    EXPECT_THAT(module->get_instructions(module->codesec[0]), ElementsAre(Instr::end));
+    EXPECT_THAT(
+        module->get_instructions(module->codesec[1]), ElementsAre(Instr::nop, Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[2]),
+        ElementsAre(Instr::nop, Instr::nop, Instr::end));
+
+    const uint64_t call_counts[] = {0, 5, 9};
+    const auto module_reordered = parse(bin, call_counts);
+    ASSERT_EQ(module_reordered->codesec.size(), 3);
+    EXPECT_EQ(module_reordered->code_buffer.size(), 6);
+    EXPECT_EQ(module_reordered->codesec[2].instructions_offset, 0);
+    EXPECT_EQ(module_reordered->codesec[1].instructions_offset, 3);
+    EXPECT_EQ(module_reordered->codesec[0].instructions_offset, 5);
+    EXPECT_THAT(module_reordered->get_instructions(module_reordered->codesec[0]),
+        ElementsAre(Instr::end));
+    EXPECT_THAT(module_reordered->get_instructions(module_reordered->codesec[1]),
+        ElementsAre(Instr::nop, Instr::end));
+    EXPECT_THAT(module_reordered->get_instructions(module_reordered->codesec[2]),
+        ElementsAre(Instr::nop, Instr::nop, Instr::end));
+
+    // Functions without call count are placed after the ones with non-zero count,
+    // in the order of the code section.
+    const uint64_t partial_call_counts[] = {0, 1};
+    const auto module_partial = parse(bin, partial_call_counts);
+    EXPECT_EQ(module_partial->codesec[1].instructions_offset, 0);
+    EXPECT_EQ(module_partial->codesec[0].instructions_offset, 2);
+    EXPECT_EQ(module_partial->codesec[2].instructions_offset, 3);
+}
+
+TEST(parser, code_section_layout_with_imported_functions)
+{
+    // Call counts are indexed by function index, i.e. include the imported functions.
+    const auto import_section = make_section(2, make_vec({"036d6f64046e616d650000"_bytes}));
+    const auto code0_bin = add_size_prefix("000b"_bytes);
+    const auto code1_bin = add_size_prefix("00010b"_bytes);
+    const auto bin = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+                     import_section + make_section(3, "020000"_bytes) +
+                     make_section(10, make_vec({code0_bin, code1_bin}));
+
+    const uint64_t call_counts[] = {100, 0, 1};
+    const auto module = parse(bin, call_counts);
+    ASSERT_EQ(module->codesec.size(), 2);
+    EXPECT_EQ(module->codesec[1].instructions_offset, 0);
+    EXPECT_EQ(module->codesec[0].instructions_offset, 2);
+}
+
+TEST(parser, code_max_call_depth)
+{
+    /* wat2wasm
+    (func $host (import "host" "f"))
+    (table 1 funcref)
+    (func $leaf)
+    (func $f2 (call $leaf) (call $leaf))
+    (func $f3 (call $f2) (call $leaf))
+    (func $self (call $self))
+    (func (call $self))
+    (func (call_indirect (i32.const 0)))
+    (func (call $host))
+    (func $a (call $b))
+    (func $b (call $a))
+    (func (call $f3))
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010401600000020a0104686f737401660000030b0a000000000000000000000404017000"
+        "010a380a02000b0600100110010b0600100210010b040010040b040010040b070041001100000b040010000b"
+        "040010090b040010080b040010030b");
+
+    const auto module = parse(wasm);
+    ASSERT_EQ(module->codesec.size(), 10);
+    const uint32_t expected_depths[]{1, 2, 3, 0, 0, 0, 0, 0, 0, 4};
+    for (size_t i = 0; i < module->codesec.size(); ++i)
+        EXPECT_EQ(module->codesec[i].max_call_depth, expected_depths[i]) << i;
 }
 
 TEST(parser, code_section_with_basic_instructions)
@@ -1087,9 +1261,10 @@ TEST(parser, code_section_with_basic_instructions)
     EXPECT_EQ(module->typesec[0].outputs.size(), 0);
     ASSERT_EQ(module->codesec.size(), 1);
     EXPECT_EQ(module->codesec[0].local_count, 4);
-    EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::local_get, 1, 0, 0, 0, Instr::i32_const, 2, 0, 0, 0, Instr::i32_add,
-            Instr::local_set, 3, 0, 0, 0, Instr::nop, Instr::unreachable, Instr::end));
+    EXPECT_THAT(module->get_instructions(module->codesec[0]),
+        ElementsAre(Instr::local_get, 1, Instr::i32_const, 2, 0, 0, 0, Instr::i32_add,
+            Instr::local_set, 3, Instr::nop, Instr::unreachable, Instr::end));
+    EXPECT_EQ(module->codesec[0].immediate_size, 1);
 }
 
 TEST(parser, code_section_with_memory_size)
@@ -1105,7 +1280,8 @@ TEST(parser, code_section_with_memory_size)
     const auto module = parse(bin);
     ASSERT_EQ(module->codesec.size(), 1);
     EXPECT_EQ(module->codesec[0].local_count, 0);
-    EXPECT_THAT(module->codesec[0].instructions, ElementsAre(Instr::memory_size, Instr::end));
+    EXPECT_THAT(
+        module->get_instructions(module->codesec[0]), ElementsAre(Instr::memory_size, Instr::end));
 
     const auto func_bin_invalid =
         "00"  // vec(locals)
@@ -1132,7 +1308,7 @@ TEST(parser, code_section_with_memory_grow)
     const auto module = parse(bin);
     ASSERT_EQ(module->codesec.size(), 1);
     EXPECT_EQ(module->codesec[0].local_count, 0);
-    EXPECT_THAT(module->codesec[0].instructions,
+    EXPECT_THAT(module->get_instructions(module->codesec[0]),
         ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::memory_grow, Instr::drop, Instr::end));
 
     const auto func_bin_invalid = "00"_bytes +  // vec(locals)
@@ -1177,6 +1353,8 @@ TEST(parser, code_section_fp_instructions)
             case (ValType::f64):
                 func_bin += uint8_t(Instr::f64_const) + bytes(8, 0);
                 break;
+            case (ValType::v128):
+                FAIL() << "v128 input of a non-SIMD instruction";
             }
         }
         func_bin += bytes{instr};
@@ -1215,12 +1393,12 @@ TEST(parser, code_section_fp_instructions)
 
 TEST(parser, code_section_invalid_instructions)
 {
-    const uint8_t invalid_instructions[] = {0x06, 0x07, 0x08, 0x09, 0x0a, 0x12, 0x13, 0x14, 0x15,
-        0x16, 0x17, 0x18, 0x19, 0x25, 0x26, 0x27, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
-        0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf, 0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6,
-        0xd7, 0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf, 0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5,
-        0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef, 0xf0, 0xf1, 0xf2, 0xf3, 0xf4,
-        0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+    const uint8_t invalid_instructions[] = {0x06, 0x07, 0x08, 0x09, 0x0a, 0x14, 0x15, 0x16, 0x17,
+        0x18, 0x19, 0x25, 0x26, 0x27, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+        0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf, 0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8,
+        0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf, 0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7,
+        0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef, 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6,
+        0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xff};
 
     for (const auto instr : invalid_instructions)
     {
@@ -1237,6 +1415,57 @@ TEST(parser, code_section_invalid_instructions)
     }
 }
 
+TEST(parser, code_section_invalid_misc_instruction)
+{
+    const std::pair<bytes, uint32_t> invalid_instructions[] = {
+        {"fc00"_bytes, 0}, {"fc07"_bytes, 7}, {"fc0c"_bytes, 12}, {"fc8001"_bytes, 128}};
+
+    for (const auto& [instr, sub_opcode] : invalid_instructions)
+    {
+        const auto code_bin = add_size_prefix("00"_bytes + instr);
+        const auto bin = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+                         make_section(3, make_vec({"00"_bytes})) +
+                         make_section(10, make_vec({code_bin}));
+
+        const auto expected_msg = "invalid instruction 252 " + std::to_string(sub_opcode);
+        EXPECT_THROW_MESSAGE(parse(bin), parser_error, expected_msg.c_str());
+    }
+}
+
+TEST(parser, code_section_invalid_simd_instruction)
+{
+    const std::pair<bytes, uint32_t> invalid_instructions[] = {{"fd9a01"_bytes, 154},
+        {"fdee01"_bytes, 238}, {"fd8002"_bytes, 256}, {"fd8080808001"_bytes, 0x10000000}};
+
+    for (const auto& [instr, sub_opcode] : invalid_instructions)
+    {
+        const auto code_bin = add_size_prefix("00"_bytes + instr);
+        const auto bin = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+                         make_section(3, make_vec({"00"_bytes})) +
+                         make_section(10, make_vec({code_bin}));
+
+        const auto expected_msg = "invalid instruction 253 " + std::to_string(sub_opcode);
+        EXPECT_THROW_MESSAGE(parse(bin), parser_error, expected_msg.c_str());
+    }
+}
+
+TEST(parser, code_section_invalid_atomic_instruction)
+{
+    const std::pair<bytes, uint32_t> invalid_instructions[] = {
+        {"fe04"_bytes, 4}, {"fe0f"_bytes, 15}, {"fe4f"_bytes, 79}, {"fe8002"_bytes, 256}};
+
+    for (const auto& [instr, sub_opcode] : invalid_instructions)
+    {
+        const auto code_bin = add_size_prefix("00"_bytes + instr);
+        const auto bin = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+                         make_section(3, make_vec({"00"_bytes})) +
+                         make_section(10, make_vec({code_bin}));
+
+        const auto expected_msg = "invalid instruction 254 " + std::to_string(sub_opcode);
+        EXPECT_THROW_MESSAGE(parse(bin), parser_error, expected_msg.c_str());
+    }
+}
+
 TEST(parser, code_section_size_too_small)
 {
     // Real size is 5 bytes
@@ -1321,9 +1550,178 @@ TEST(parser, data_section)
     EXPECT_EQ(module->datasec[2].init, "2424"_bytes);
 }
 
+TEST(parser, data_section_memory_image)
+{
+    /* wat2wasm
+      (memory 1)
+      (data (i32.const 1) "\aa\ff")
+      (data (i32.const 2) "\55\55")
+    */
+    const auto bin = from_hex("0061736d0100000005030100010b0f020041010b02aaff0041020b025555");
+    const auto module = parse(bin);
+    ASSERT_TRUE(module->memory_image.has_value());
+    ASSERT_EQ(module->memory_image->runs.size(), 1);
+    EXPECT_EQ(module->memory_image->runs[0].offset, 1);
+    EXPECT_EQ(module->memory_image->runs[0].data, "aa5555"_bytes);
+    // The payloads of the segments are only kept in the image.
+    ASSERT_EQ(module->datasec.size(), 2);
+    EXPECT_TRUE(module->datasec[0].init.empty());
+    EXPECT_TRUE(module->datasec[1].init.empty());
+
+    /* wat2wasm
+      (memory 1)
+      (data (i32.const 65535) "\aa\ff")
+    */
+    const auto bin_out_of_bounds = from_hex("0061736d0100000005030100010b0a010041ffff030b02aaff");
+    EXPECT_FALSE(parse(bin_out_of_bounds)->memory_image.has_value());
+
+    /* wat2wasm
+      (memory 2)
+      (data (i32.const 0) "\aa")
+      (data (i32.const 100000) "\ff")
+    */
+    const auto bin_sparse =
+        from_hex("0061736d0100000005030100020b0f020041000b01aa0041a08d060b01ff");
+    const auto module_sparse = parse(bin_sparse);
+    ASSERT_TRUE(module_sparse->memory_image.has_value());
+    const auto& runs = module_sparse->memory_image->runs;
+    ASSERT_EQ(runs.size(), 2);
+    EXPECT_EQ(runs[0].offset, 0);
+    EXPECT_EQ(runs[0].data, "aa"_bytes);
+    EXPECT_EQ(runs[1].offset, 100000);
+    EXPECT_EQ(runs[1].data, "ff"_bytes);
+
+    /* wat2wasm
+      (memory 1)
+      (data (i32.const 4) "\aa")
+      (data (i32.const 1) "\ff\ff")
+      (data (i32.const 3) "\55")
+    */
+    const auto bin_adjacent = from_hex(
+        "0061736d0100000005030100010b14030041040b01aa0041010b02ffff0041030b0155");
+    const auto module_adjacent = parse(bin_adjacent);
+    ASSERT_TRUE(module_adjacent->memory_image.has_value());
+    ASSERT_EQ(module_adjacent->memory_image->runs.size(), 1);
+    EXPECT_EQ(module_adjacent->memory_image->runs[0].offset, 1);
+    EXPECT_EQ(module_adjacent->memory_image->runs[0].data, "ffff55aa"_bytes);
+
+    /* wat2wasm
+      (memory 1)
+    */
+    const auto bin_no_data = from_hex("0061736d010000000503010001");
+    EXPECT_FALSE(parse(bin_no_data)->memory_image.has_value());
+
+    /* wat2wasm
+      (memory (import "mod" "m") 1 1)
+      (data (i32.const 1) "\aa\ff")
+    */
+    const auto bin_imported_memory =
+        from_hex("0061736d01000000020b01036d6f64016d020101010b08010041010b02aaff");
+    EXPECT_FALSE(parse(bin_imported_memory)->memory_image.has_value());
+}
+
+TEST(parser, data_section_memory_image_offset_from_global)
+{
+    /* wat2wasm
+      (global (import "m" "g") i32)
+      (memory 0)
+      (data (i32.const 1) "\aa\ff")
+      (data (i32.const 2) "\55\55")
+      (data (global.get 0) "\24\24")
+    */
+    const auto bin = from_hex(
+        "0061736d01000000020801016d0167037f0005030100000b16030041010b02aaff0041020b0255550023000b02"
+        "2424");
+    EXPECT_FALSE(parse(bin)->memory_image.has_value());
+}
+
+TEST(parser, data_section_passive)
+{
+    const auto section_contents =
+        make_vec({"0041010b02aaff"_bytes, "0103010203"_bytes, "020041020b0155"_bytes});
+    const auto bin = bytes{wasm_prefix} + make_section(5, make_vec({"0001"_bytes})) +
+                     make_section(11, section_contents);
+    const auto module = parse(bin);
+    ASSERT_EQ(module->datasec.size(), 3);
+    EXPECT_FALSE(module->datasec[0].passive);
+    EXPECT_EQ(module->datasec[0].offset.value.constant.i32, 1);
+    EXPECT_TRUE(module->datasec[0].init.empty());
+    EXPECT_TRUE(module->datasec[1].passive);
+    EXPECT_EQ(module->datasec[1].init, "010203"_bytes);
+    EXPECT_FALSE(module->datasec[2].passive);
+    EXPECT_EQ(module->datasec[2].offset.value.constant.i32, 2);
+    EXPECT_TRUE(module->datasec[2].init.empty());
+    EXPECT_FALSE(module->datacount.has_value());
+
+    // The passive segment is not included in the memory image, and its payload is kept.
+    ASSERT_TRUE(module->memory_image.has_value());
+    ASSERT_EQ(module->memory_image->runs.size(), 1);
+    EXPECT_EQ(module->memory_image->runs[0].offset, 1);
+    EXPECT_EQ(module->memory_image->runs[0].data, "aa55"_bytes);
+}
+
+TEST(parser, data_section_passive_only)
+{
+    // Passive segments do not require memory.
+    const auto bin =
+        bytes{wasm_prefix} + make_section(11, make_vec({"0102aaff"_bytes, "0100"_bytes}));
+    const auto module = parse(bin);
+    ASSERT_EQ(module->datasec.size(), 2);
+    EXPECT_TRUE(module->datasec[0].passive);
+    EXPECT_TRUE(module->datasec[1].passive);
+    EXPECT_FALSE(module->memory_image.has_value());
+}
+
+TEST(parser, data_section_invalid_kind)
+{
+    const auto bin = bytes{wasm_prefix} + make_section(5, make_vec({"0001"_bytes})) +
+                     make_section(11, make_vec({"0341010b00"_bytes}));
+    EXPECT_THROW_MESSAGE(parse(bin), parser_error, "invalid data segment kind 3");
+}
+
+TEST(parser, data_count_section)
+{
+    const auto bin = bytes{wasm_prefix} + make_section(12, "02"_bytes) +
+                     make_section(11, make_vec({"0100"_bytes, "0100"_bytes}));
+    const auto module = parse(bin);
+    EXPECT_EQ(module->datacount, 2);
+    EXPECT_EQ(module->datasec.size(), 2);
+
+    const auto bin_no_data = bytes{wasm_prefix} + make_section(12, "00"_bytes);
+    EXPECT_EQ(parse(bin_no_data)->datacount, 0);
+}
+
+TEST(parser, data_count_section_inconsistent)
+{
+    const auto bin1 = bytes{wasm_prefix} + make_section(12, "01"_bytes) +
+                      make_section(11, make_vec({"0100"_bytes, "0100"_bytes}));
+    EXPECT_THROW_MESSAGE(
+        parse(bin1), validation_error, "data count and data section have inconsistent lengths");
+
+    const auto bin2 = bytes{wasm_prefix} + make_section(12, "01"_bytes);
+    EXPECT_THROW_MESSAGE(
+        parse(bin2), validation_error, "data count and data section have inconsistent lengths");
+}
+
+TEST(parser, data_count_section_order)
+{
+    const auto element_section = make_section(9, make_vec({}));
+    const auto data_count_section = make_section(12, "00"_bytes);
+    const auto code_section = make_section(10, make_vec({}));
+
+    EXPECT_NO_THROW(
+        parse(bytes{wasm_prefix} + element_section + data_count_section + code_section));
+    EXPECT_THROW_MESSAGE(parse(bytes{wasm_prefix} + data_count_section + element_section),
+        parser_error, "unexpected out-of-order section type");
+    EXPECT_THROW_MESSAGE(parse(bytes{wasm_prefix} + code_section + data_count_section),
+        parser_error, "unexpected out-of-order section type");
+    EXPECT_THROW_MESSAGE(parse(bytes{wasm_prefix} + data_count_section + data_count_section),
+        parser_error, "unexpected out-of-order section type");
+}
+
 TEST(parser, data_section_memidx_nonzero)
 {
-    const auto section_contents = make_vec({"0141010b0100"_bytes});
+    const auto section_contents = make_vec({"020141010b0100"_bytes});
     const auto bin = bytes{wasm_prefix} + make_section(11, section_contents);
     EXPECT_THROW_MESSAGE(
         parse(bin), validation_error, "invalid memory index 1 (only memory 0 is allowed)");
@@ -1370,8 +1768,8 @@ TEST(parser, data_section_out_of_bounds)
 
 TEST(parser, unknown_section_empty)
 {
-    const auto bin = bytes{wasm_prefix} + make_section(12, bytes{});
-    EXPECT_THROW_MESSAGE(parse(bin), parser_error, "unknown section encountered 12");
+    const auto bin = bytes{wasm_prefix} + make_section(13, bytes{});
+    EXPECT_THROW_MESSAGE(parse(bin), parser_error, "unknown section encountered 13");
 }
 
 TEST(parser, unknown_section_nonempty)
@@ -1454,8 +1852,7 @@ TEST(parser, milestone1)
     ASSERT_EQ(m->codesec.size(), 1);
     const auto& c = m->codesec[0];
     EXPECT_EQ(c.local_count, 1);
-    EXPECT_THAT(c.instructions,
-        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::local_get, 1, 0, 0, 0, Instr::i32_add,
-            Instr::local_get, 2, 0, 0, 0, Instr::i32_add, Instr::local_tee, 2, 0, 0, 0,
-            Instr::local_get, 0, 0, 0, 0, Instr::i32_add, Instr::end));
+    EXPECT_THAT(m->get_instructions(c),
+        ElementsAre(Instr::local_get, 0, Instr::local_get, 1, Instr::i32_add, Instr::local_get, 2,
+            Instr::i32_add, Instr::local_tee, 2, Instr::local_get, 0, Instr::i32_add, Instr::end));
 }
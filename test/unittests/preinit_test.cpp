@@ -0,0 +1,212 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "parser.hpp"
+#include "preinit.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (memory (export "mem") 1)
+  (global $g (mut i32) (i32.const 0))
+  (global $h (mut i64) (i64.const 0))
+  (global $count (mut i32) (i32.const 0))
+  (global $f (mut f64) (f64.const 0))
+  (global i32 (i32.const 9))
+  (func $start
+    (global.set $count (i32.add (global.get $count) (i32.const 1)))
+    (i32.store (i32.const 100) (i32.const 0xdead))
+  )
+  (func (export "_initialize")
+    (global.set $g (i32.const -5))
+    (global.set $h (i64.const 0x10000000000))
+    (drop (memory.grow (i32.const 1)))
+    (i32.store offset=70000 (i32.const 0) (i32.const 7))
+    (global.set $f (f64.const 1.5))
+  )
+  (func (export "get") (result i32) (global.get $g))
+  (func (export "load") (param i32) (result i32) (i32.load (local.get 0)))
+  (func (export "size") (result i32) (memory.size))
+  (func (export "count") (result i32) (global.get $count))
+  (start $start)
+  (data (i32.const 0) "\01")
+*/
+const auto wasm = from_hex(
+    "0061736d01000000010d036000006000017f60017f017f03070600000102010105030100010621057f0141000b7e"
+    "0142000b7f0141000b7c014400000000000000000b7f0041090b0731060b5f696e697469616c697a650001036765"
+    "740002046c6f616400030473697a65000405636f756e740005036d656d02000801000a55061300230241016a2402"
+    "41e40041adbd033602000b2800417b2400428080808080202401410140001a410041073602f0a204440000000000"
+    "00f83f24030b040023000b070020002802000b04003f000b040023020b0b07010041000b0101");
+}  // namespace
+
+TEST(preinit, preinitialize)
+{
+    const auto output = preinitialize(wasm, DefaultInitFunctionName);
+    const std::shared_ptr<const Module> module = parse(output);
+
+    EXPECT_FALSE(module->startfunc.has_value());
+    ASSERT_EQ(module->exportsec.size(), 5);
+    EXPECT_EQ(module->exportsec[0].name, "get");
+    EXPECT_EQ(module->exportsec[4].name, "mem");
+    ASSERT_EQ(module->memorysec.size(), 1);
+    EXPECT_EQ(module->memorysec[0].limits.min, 2);
+
+    ASSERT_EQ(module->globalsec.size(), 5);
+    EXPECT_TRUE(module->globalsec[0].type.is_mutable);
+    EXPECT_EQ(module->globalsec[0].expression.value.constant.as<int32_t>(), -5);
+    EXPECT_EQ(module->globalsec[1].expression.value.constant.i64, 0x10000000000);
+    EXPECT_EQ(module->globalsec[2].expression.value.constant.i32, 1);
+    EXPECT_EQ(module->globalsec[3].expression.value.constant.f64, 1.5);
+    EXPECT_FALSE(module->globalsec[4].type.is_mutable);
+    EXPECT_EQ(module->globalsec[4].expression.value.constant.i32, 9);
+
+    auto instance = instantiate(module);
+    EXPECT_THAT(execute(*instance, 2, {}), Result(-5));
+    EXPECT_THAT(execute(*instance, 3, {0}), Result(1));
+    EXPECT_THAT(execute(*instance, 3, {100}), Result(0xdead));
+    EXPECT_THAT(execute(*instance, 3, {70000}), Result(7));
+    EXPECT_THAT(execute(*instance, 4, {}), Result(2));
+    // The start function is not executed again.
+    EXPECT_THAT(execute(*instance, 5, {}), Result(1));
+}
+
+TEST(preinit, data_segments)
+{
+    const auto module = parse(preinitialize(wasm, DefaultInitFunctionName));
+
+    // The bytes at 0 and 100 are too far apart to share a segment.
+    ASSERT_EQ(module->datasec.size(), 3);
+    EXPECT_EQ(module->datasec[0].offset.value.constant.i32, 0);
+    EXPECT_EQ(module->datasec[1].offset.value.constant.i32, 100);
+    EXPECT_EQ(module->datasec[2].offset.value.constant.i32, 70000);
+    // The payloads of the segments are kept in the memory image by the parser.
+    ASSERT_TRUE(module->memory_image.has_value());
+    const auto& runs = module->memory_image->runs;
+    ASSERT_EQ(runs.size(), 3);
+    EXPECT_EQ(runs[0].data, "01"_bytes);
+    EXPECT_EQ(runs[1].data, "adde"_bytes);
+    EXPECT_EQ(runs[2].data, "07"_bytes);
+}
+
+TEST(preinit, data_segments_small_gap)
+{
+    /* wat2wasm
+      (memory 1)
+      (data (i32.const 8) "\01")
+      (data (i32.const 12) "\02")
+    */
+    const auto wasm_data =
+        from_hex("0061736d0100000005030100010b0d020041080b010100410c0b0102");
+
+    const auto module = parse(preinitialize(wasm_data, DefaultInitFunctionName));
+    ASSERT_EQ(module->datasec.size(), 1);
+    EXPECT_EQ(module->datasec[0].offset.value.constant.i32, 8);
+    ASSERT_TRUE(module->memory_image.has_value());
+    ASSERT_EQ(module->memory_image->runs.size(), 1);
+    EXPECT_EQ(module->memory_image->runs[0].data, "0100000002"_bytes);
+}
+
+TEST(preinit, shared_memory)
+{
+    /* wat2wasm --enable-threads
+      (memory 1 2 shared)
+      (data (i32.const 8) "\01")
+    */
+    const auto wasm_shared_memory =
+        from_hex("0061736d010000000504010301020b07010041080b0101");
+
+    const auto module = parse(preinitialize(wasm_shared_memory, DefaultInitFunctionName));
+    ASSERT_EQ(module->memorysec.size(), 1);
+    EXPECT_TRUE(module->memorysec[0].limits.shared);
+    EXPECT_EQ(module->memorysec[0].limits.min, 1);
+    EXPECT_EQ(module->memorysec[0].limits.max, 2);
+    ASSERT_EQ(module->datasec.size(), 1);
+    EXPECT_EQ(module->datasec[0].offset.value.constant.i32, 8);
+    ASSERT_TRUE(module->memory_image.has_value());
+    ASSERT_EQ(module->memory_image->runs.size(), 1);
+    EXPECT_EQ(module->memory_image->runs[0].data, "01"_bytes);
+}
+
+TEST(preinit, v128_global)
+{
+    /* wat2wasm --enable-simd
+      (global $v (mut v128) (v128.const i64x2 1 2))
+      (global i32 (i32.const 9))
+      (func (export "_initialize") (global.set $v (v128.const i64x2 3 4)))
+    */
+    const auto wasm_v128 = from_hex(
+        "0061736d0100000001040160000003020100061b027b01fd0c010000000000000002000000000000000b7f0041"
+        "090b070f010b5f696e697469616c697a6500000a18011600fd0c0300000000000000040000000000000024"
+        "000b");
+
+    const auto module = parse(preinitialize(wasm_v128, DefaultInitFunctionName));
+    ASSERT_EQ(module->globalsec.size(), 2);
+    EXPECT_EQ(module->globalsec[0].type.value_type, ValType::v128);
+    EXPECT_EQ(module->globalsec[0].expression.value.constant.i64, 3);
+    EXPECT_EQ(module->globalsec[0].expression.constant_high.i64, 4);
+    EXPECT_EQ(module->globalsec[1].expression.value.constant.i32, 9);
+}
+
+TEST(preinit, no_init_function)
+{
+    const auto output = preinitialize(wasm, "none");
+    const std::shared_ptr<const Module> module = parse(output);
+    EXPECT_FALSE(module->startfunc.has_value());
+    EXPECT_EQ(module->exportsec.size(), 6);
+    EXPECT_EQ(module->memorysec[0].limits.min, 1);
+
+    auto instance = instantiate(module);
+    EXPECT_THAT(execute(*instance, 2, {}), Result(0));
+    EXPECT_THAT(execute(*instance, 3, {100}), Result(0xdead));
+    EXPECT_THAT(execute(*instance, 5, {}), Result(1));
+}
+
+TEST(preinit, init_function_invalid_type)
+{
+    EXPECT_THROW_MESSAGE(preinitialize(wasm, "get"), instantiate_error,
+        "initialization function must have no parameters and results");
+}
+
+TEST(preinit, init_function_trap)
+{
+    /* wat2wasm
+      (func (export "_initialize") (unreachable))
+    */
+    const auto wasm_trap = from_hex(
+        "0061736d0100000001040160000003020100070f010b5f696e697469616c697a6500000a05010300000b");
+
+    EXPECT_THROW_MESSAGE(preinitialize(wasm_trap, DefaultInitFunctionName), instantiate_error,
+        "initialization function failed to execute");
+}
+
+TEST(preinit, imported_memory)
+{
+    /* wat2wasm
+      (memory (import "mod" "m") 1)
+    */
+    const auto wasm_imported_memory = from_hex("0061736d01000000020a01036d6f64016d020001");
+
+    EXPECT_THROW_MESSAGE(preinitialize(wasm_imported_memory, DefaultInitFunctionName),
+        instantiate_error, "pre-initialization of modules importing memory is not supported");
+}
+
+TEST(preinit, passive_data_segments)
+{
+    /* wat2wasm --enable-bulk-memory
+      (memory 1)
+      (data "\01")
+    */
+    const auto wasm_passive_data = from_hex("0061736d0100000005030100010c01010b0401010101");
+
+    EXPECT_THROW_MESSAGE(preinitialize(wasm_passive_data, DefaultInitFunctionName),
+        instantiate_error,
+        "pre-initialization of modules with passive data segments is not supported");
+}
@@ -0,0 +1,194 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "parser.hpp"
+#include "scheduler.hpp"
+#include "suspend.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/hex.hpp>
+#include <chrono>
+#include <limits>
+#include <vector>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (func (param i32) (result i32) (local i32)
+    (loop
+      (local.set 1 (i32.add (local.get 1) (local.get 0)))
+      (br_if 0 (local.tee 0 (i32.sub (local.get 0) (i32.const 1)))))
+    (local.get 1))
+  (func (loop (br 0)))
+*/
+const auto wasm = from_hex(
+    "0061736d0100000001090260017f017f60000003030200010a23021901017f0340200120006a2101200041016b"
+    "22000d000b20010b070003400c000b0b");
+
+/// Returns the ticks consumed by the execution of the sum of 1..n.
+int64_t sum_cost(Instance& instance, uint32_t n)
+{
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = std::numeric_limits<int64_t>::max();
+    const Value args[]{n};
+    Value result{};
+    EXPECT_THAT(execute(instance, 0, args, &result, ctx), Result());
+    return std::numeric_limits<int64_t>::max() - ctx.ticks;
+}
+}  // namespace
+
+TEST(scheduler, pause_execution_out_of_ticks)
+{
+    const auto instance = instantiate(parse(wasm));
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = 100;
+    const Value args[]{1000};
+    Value result{};
+    EXPECT_TRUE(execute_suspendable(*instance, 0, args, &result, ctx).suspended);
+    EXPECT_LT(ctx.ticks, 0);
+
+    // Resuming without ticks pauses again right away.
+    EXPECT_TRUE(resume(ctx, nullptr).suspended);
+
+    int num_slices = 1;
+    do
+    {
+        ctx.ticks += 100;
+        ++num_slices;
+    } while (resume(ctx, nullptr).suspended);
+    EXPECT_EQ(result.i32, 500500);
+    EXPECT_EQ(ctx.suspendable_execution, nullptr);
+    EXPECT_GT(num_slices, 10);
+
+    // Cancelling the paused execution unwinds it.
+    ctx.ticks = 100;
+    EXPECT_TRUE(execute_suspendable(*instance, 1, nullptr, nullptr, ctx).suspended);
+    ctx.suspendable_execution.reset();
+    EXPECT_EQ(ctx.depth, 0);
+}
+
+TEST(scheduler, execute)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    constexpr size_t num_executions = 20;
+    std::vector<std::unique_ptr<Instance>> instances;
+    for (size_t i = 0; i < num_executions; ++i)
+        instances.emplace_back(instantiate(module));
+    const auto cost = sum_cost(*instances[0], 1000);
+
+    Scheduler scheduler{{4, 1000}};
+    const auto tenant = scheduler.add_tenant(1000000);
+    std::vector<Value> results(num_executions);
+    std::vector<std::future<ExecutionResult>> futures;
+    for (size_t i = 0; i < num_executions; ++i)
+    {
+        const Value args[]{1000};
+        futures.emplace_back(
+            scheduler.submit(tenant, Priority::normal, *instances[i], 0, args, &results[i]));
+    }
+
+    for (auto& future : futures)
+        EXPECT_THAT(future.get(), Result());
+    for (const auto& result : results)
+        EXPECT_EQ(result.i32, 500500);
+
+    // The executions are charged exactly the ticks they have consumed.
+    EXPECT_EQ(scheduler.remaining_quota(tenant), 1000000 - int64_t{num_executions} * cost);
+}
+
+TEST(scheduler, long_running_execution_does_not_block)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto instance1 = instantiate(module);
+    const auto instance2 = instantiate(module);
+
+    Scheduler scheduler{{1, 1000}};
+    const auto tenant1 = scheduler.add_tenant();
+    const auto tenant2 = scheduler.add_tenant();
+
+    // The infinite loop keeps being paused and re-queued.
+    auto loop_future =
+        scheduler.submit(tenant1, Priority::normal, *instance1, 1, nullptr, nullptr);
+
+    const Value args[]{10000};
+    Value result{};
+    auto sum_future = scheduler.submit(tenant2, Priority::normal, *instance2, 0, args, &result);
+    EXPECT_THAT(sum_future.get(), Result());
+    EXPECT_EQ(result.i32, 50005000);
+    EXPECT_EQ(loop_future.wait_for(std::chrono::seconds{0}), std::future_status::timeout);
+}
+
+TEST(scheduler, quota)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto instance1 = instantiate(module);
+    const auto instance2 = instantiate(module);
+
+    Scheduler scheduler{{2, 1000}};
+    const auto tenant1 = scheduler.add_tenant(100000);
+    const auto tenant2 = scheduler.add_tenant(100000);
+
+    // The infinite loop traps when the quota of its tenant is exhausted.
+    EXPECT_THAT(
+        scheduler.submit(tenant1, Priority::normal, *instance1, 1, nullptr, nullptr).get(),
+        Traps());
+    EXPECT_EQ(scheduler.remaining_quota(tenant1), 0);
+    EXPECT_THAT(
+        scheduler.submit(tenant1, Priority::normal, *instance1, 1, nullptr, nullptr).get(),
+        Traps());
+
+    // The other tenant has its own quota.
+    const Value args[]{10};
+    Value result{};
+    EXPECT_THAT(
+        scheduler.submit(tenant2, Priority::normal, *instance2, 0, args, &result).get(), Result());
+    EXPECT_EQ(result.i32, 55);
+    EXPECT_EQ(scheduler.remaining_quota(tenant2), 100000 - sum_cost(*instance2, 10));
+}
+
+TEST(scheduler, priority)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto instance1 = instantiate(module);
+    const auto instance2 = instantiate(module);
+
+    Scheduler scheduler{{1, 1000}};
+    const auto tenant1 = scheduler.add_tenant(100000);
+    const auto tenant2 = scheduler.add_tenant();
+
+    auto high_future = scheduler.submit(tenant1, Priority::high, *instance1, 1, nullptr, nullptr);
+    const Value args[]{10};
+    Value result{};
+    auto low_future = scheduler.submit(tenant2, Priority::low, *instance2, 0, args, &result);
+
+    // The low priority execution runs only after the high priority one has used up its quota.
+    EXPECT_THAT(low_future.get(), Result());
+    EXPECT_EQ(high_future.wait_for(std::chrono::seconds{0}), std::future_status::ready);
+    EXPECT_THAT(high_future.get(), Traps());
+    EXPECT_EQ(result.i32, 55);
+}
+
+TEST(scheduler, destroy_with_pending_executions)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto instance1 = instantiate(module);
+    const auto instance2 = instantiate(module);
+
+    std::future<ExecutionResult> future1;
+    std::future<ExecutionResult> future2;
+    {
+        Scheduler scheduler{{1, 1000}};
+        const auto tenant = scheduler.add_tenant();
+        future1 = scheduler.submit(tenant, Priority::normal, *instance1, 1, nullptr, nullptr);
+        future2 = scheduler.submit(tenant, Priority::normal, *instance2, 1, nullptr, nullptr);
+    }
+    EXPECT_THAT(future1.get(), Traps());
+    EXPECT_THAT(future2.get(), Traps());
+}
@@ -0,0 +1,172 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "instance_pool.hpp"
+#include "parser.hpp"
+#include "snapshot.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (memory 2)
+  (global (mut i32) (i32.const 7))
+  (func (param i32 i32) (i32.store (local.get 0) (local.get 1)))
+  (func (param i32) (result i32) (i32.load (local.get 0)))
+  (func (result i32) (memory.grow (i32.const 1)))
+  (func (param i32) (global.set 0 (local.get 0)))
+  (func (result i32) (global.get 0))
+  (func (result i32) (memory.size))
+  (data (i32.const 0) "\01\02")
+*/
+const auto wasm_memory_global = from_hex(
+    "0061736d0100000001130460027f7f0060017f017f6000017f60017f0003070600010203020205030100020606"
+    "017f0141070b0a2b060900200020013602000b070020002802000b0600410140000b0600200024000b040023000b"
+    "04003f000b0b08010041000b020102");
+
+/* wat2wasm
+  (table 2 funcref)
+  (elem (i32.const 1) 0)
+  (func (result i32) (i32.const 42))
+  (func (param i32) (result i32) (call_indirect (type 0) (local.get 0)))
+*/
+const auto wasm_table = from_hex(
+    "0061736d01000000010a026000017f60017f017f03030200010404017000020907010041010b01000a0e020400"
+    "412a0b070020001100000b");
+}  // namespace
+
+TEST(snapshot, restore_memory_and_globals)
+{
+    auto instance = instantiate(parse(wasm_memory_global));
+    EXPECT_THAT(execute(*instance, 0, {4, 0x11}), Result());
+    EXPECT_THAT(execute(*instance, 3, {8}), Result());
+
+    const auto snap = snapshot(*instance);
+    EXPECT_EQ(snap.module, instance->module);
+    ASSERT_TRUE(snap.memory.has_value());
+    EXPECT_EQ(snap.memory->size(), 2 * PageSize);
+    EXPECT_FALSE(snap.table.has_value());
+
+    EXPECT_THAT(execute(*instance, 0, {4, 0x22}), Result());
+    EXPECT_THAT(execute(*instance, 3, {9}), Result());
+    EXPECT_THAT(execute(*instance, 2, {}), Result(2));
+
+    restore(*instance, snap);
+    EXPECT_THAT(execute(*instance, 1, {0}), Result(0x0201));
+    EXPECT_THAT(execute(*instance, 1, {4}), Result(0x11));
+    EXPECT_THAT(execute(*instance, 4, {}), Result(8));
+    EXPECT_THAT(execute(*instance, 5, {}), Result(2));
+}
+
+TEST(snapshot, restore_into_other_instance)
+{
+    const std::shared_ptr<const Module> module = parse(wasm_memory_global);
+    auto instance1 = instantiate(module);
+    EXPECT_THAT(execute(*instance1, 2, {}), Result(2));
+    EXPECT_THAT(execute(*instance1, 0, {2 * PageSize, 0x33}), Result());
+    const auto snap = snapshot(*instance1);
+    instance1.reset();
+
+    auto instance2 = instantiate(module);
+    restore(*instance2, snap);
+    EXPECT_THAT(execute(*instance2, 5, {}), Result(3));
+    EXPECT_THAT(execute(*instance2, 1, {2 * PageSize}), Result(0x33));
+}
+
+TEST(snapshot, restore_table)
+{
+    const std::shared_ptr<const Module> module = parse(wasm_table);
+    auto instance1 = instantiate(module);
+    const auto snap = snapshot(*instance1);
+    ASSERT_TRUE(snap.table.has_value());
+    EXPECT_EQ(snap.table->size(), 2);
+
+    auto instance2 = instantiate(module);
+    (*instance2->table)[1] = {};
+    EXPECT_THAT(execute(*instance2, 1, {1}), Traps());
+
+    restore(*instance2, snap);
+    EXPECT_EQ((*instance2->table)[0].instance, nullptr);
+    EXPECT_EQ((*instance2->table)[1].instance, instance2.get());
+    EXPECT_THAT(execute(*instance2, 1, {1}), Result(42));
+}
+
+TEST(snapshot, restore_pooled_instance)
+{
+    InstancePool pool{parse(wasm_memory_global)};
+    auto instance = pool.acquire();
+    const auto snap = snapshot(*instance);
+    EXPECT_THAT(execute(*instance, 0, {PageSize, 0x44}), Result());
+    const auto modified_snap = snapshot(*instance);
+
+    restore(*instance, snap);
+    EXPECT_THAT(execute(*instance, 1, {PageSize}), Result(0));
+    restore(*instance, modified_snap);
+    EXPECT_TRUE(instance->memory_dirty_untracked);
+
+    // The whole memory is reset, because it is not known which blocks the restore has modified.
+    pool.release(std::move(instance));
+    instance = pool.acquire();
+    EXPECT_THAT(execute(*instance, 1, {PageSize}), Result(0));
+}
+
+TEST(snapshot, copy_instance)
+{
+    auto instance = instantiate(parse(wasm_memory_global));
+    EXPECT_THAT(execute(*instance, 0, {4, 0x11}), Result());
+    EXPECT_THAT(execute(*instance, 3, {8}), Result());
+    EXPECT_THAT(execute(*instance, 2, {}), Result(2));
+
+    auto copy = copy_instance(*instance);
+    EXPECT_EQ(copy->module, instance->module);
+    EXPECT_NE(copy->memory.get(), instance->memory.get());
+    EXPECT_THAT(execute(*copy, 1, {4}), Result(0x11));
+    EXPECT_THAT(execute(*copy, 4, {}), Result(8));
+    EXPECT_THAT(execute(*copy, 5, {}), Result(3));
+
+    // The copy is independent of the original instance.
+    EXPECT_THAT(execute(*copy, 0, {4, 0x22}), Result());
+    EXPECT_THAT(execute(*copy, 3, {9}), Result());
+    EXPECT_THAT(execute(*instance, 1, {4}), Result(0x11));
+    EXPECT_THAT(execute(*instance, 4, {}), Result(8));
+
+    instance.reset();
+    EXPECT_THAT(execute(*copy, 1, {4}), Result(0x22));
+}
+
+TEST(snapshot, copy_instance_table)
+{
+    auto instance = instantiate(parse(wasm_table));
+    auto copy = copy_instance(*instance);
+    EXPECT_NE(copy->table.get(), instance->table.get());
+    EXPECT_EQ((*copy->table)[1].instance, copy.get());
+
+    instance.reset();
+    EXPECT_THAT(execute(*copy, 1, {1}), Result(42));
+}
+
+TEST(snapshot, copy_instance_imported_memory)
+{
+    /* wat2wasm
+      (memory (import "mod" "m") 1)
+      (func (param i32) (result i32) (i32.load (local.get 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f020a01036d6f64016d02000103020100"
+        "0a0901070020002802000b");
+
+    bytes memory(PageSize, 0);
+    auto instance = instantiate(parse(wasm), {}, {}, {{&memory, {1, 1}}});
+    auto copy = copy_instance(*instance);
+    EXPECT_EQ(copy->memory.get(), &memory);
+
+    memory[0] = 0x55;
+    EXPECT_THAT(execute(*copy, 0, {0}), Result(0x55));
+}
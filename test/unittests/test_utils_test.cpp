@@ -59,17 +59,17 @@ TEST(test_utils, print_execution_result)
 TEST(test_utils, print_c_execution_result)
 {
     std::stringstream str_trap;
-    str_trap << FizzyExecutionResult{true, false, {0}};
+    str_trap << FizzyExecutionResult{true, false, {0}, false};
     EXPECT_EQ(str_trap.str(), "trapped");
 
     std::stringstream str_void;
-    str_void << FizzyExecutionResult{false, false, {0}};
+    str_void << FizzyExecutionResult{false, false, {0}, false};
     EXPECT_EQ(str_void.str(), "result()");
 
     std::stringstream str_value;
     FizzyValue v;
     v.i64 = 42;
-    str_value << FizzyExecutionResult{false, true, v};
+    str_value << FizzyExecutionResult{false, true, v, false};
     EXPECT_EQ(str_value.str(), "result(42 [0x2a])");
 }
 
@@ -163,11 +163,11 @@ TEST(test_utils, cresult_value_matcher)
 {
     using testing::Not;
 
-    FizzyExecutionResult trap{true, false, FizzyValue{}};
+    FizzyExecutionResult trap{true, false, FizzyValue{}, false};
     EXPECT_THAT(trap, CTraps());
     EXPECT_THAT(trap, Not(CResult()));
 
-    FizzyExecutionResult result_void{false, false, FizzyValue{}};
+    FizzyExecutionResult result_void{false, false, FizzyValue{}, false};
     EXPECT_THAT(result_void, CResult());
     EXPECT_THAT(result_void, Not(CTraps()));
 
@@ -177,7 +177,7 @@ TEST(test_utils, cresult_value_matcher)
     EXPECT_THAT(trap, Not(CResult(0_u32)));
     EXPECT_THAT(result_void, Not(CResult(0_u32)));
     FizzyValue value_i32{-1_u32};
-    FizzyExecutionResult result_i32{false, true, value_i32};
+    FizzyExecutionResult result_i32{false, true, value_i32, false};
     EXPECT_THAT(result_i32, CResult(-1_u32));
     EXPECT_THAT(result_i32, Not(CResult(-2_u32)));
 
@@ -185,7 +185,7 @@ TEST(test_utils, cresult_value_matcher)
     EXPECT_THAT(result_void, Not(CResult(0_u64)));
     FizzyValue value_i64;
     value_i64.i64 = -1_u64;
-    FizzyExecutionResult result_i64{false, true, value_i64};
+    FizzyExecutionResult result_i64{false, true, value_i64, false};
     EXPECT_THAT(result_i64, CResult(-1_u64));
     EXPECT_THAT(result_i64, Not(CResult(-2_u64)));
 
@@ -193,7 +193,7 @@ TEST(test_utils, cresult_value_matcher)
     EXPECT_THAT(result_void, Not(CResult(0.0f)));
     FizzyValue value_f32;
     value_f32.f32 = 1.1f;
-    FizzyExecutionResult result_f32{false, true, value_f32};
+    FizzyExecutionResult result_f32{false, true, value_f32, false};
     EXPECT_THAT(result_f32, CResult(1.1f));
     EXPECT_THAT(result_f32, Not(CResult(1.0f)));
 
@@ -201,7 +201,7 @@ TEST(test_utils, cresult_value_matcher)
     EXPECT_THAT(result_void, Not(CResult(0.0)));
     FizzyValue value_f64;
     value_f64.f64 = 2.2;
-    FizzyExecutionResult result_f64{false, true, value_f64};
+    FizzyExecutionResult result_f64{false, true, value_f64, false};
     EXPECT_THAT(result_f64, CResult(2.2));
     EXPECT_THAT(result_f64, Not(CResult(2.0)));
 }
@@ -0,0 +1,147 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "parser.hpp"
+#include "snapshot.hpp"
+#include "tiering.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (func (param i32) (result i32)
+    (local.get 0)
+    (loop (result i32)
+      (local.get 0)
+      (local.set 0 (i32.sub (local.get 0) (i32.const 1)))
+      (br_if 0 (local.get 0))
+    )
+    (i32.add)
+  )
+  (func (param i32) (result i32) (local i32)
+    (block (loop
+      (br_if 1 (i32.eqz (local.get 0)))
+      (local.set 1 (i32.add (local.get 1) (local.get 0)))
+      (local.set 0 (i32.sub (local.get 0) (i32.const 1)))
+      (br 0)
+    ))
+    (local.get 1)
+  )
+  (func (param i32) (result i32) (i32.add (local.get 0) (i32.const 7)))
+*/
+const auto wasm = from_hex(
+    "0061736d0100000001060160017f017f0304030000000a410315002000037f2000200041016b210020000d00"
+    "0b6a0b2101017f024003402000450d01200120006a2101200041016b21000c000b0b20010b0700200041076a"
+    "0b");
+}  // namespace
+
+TEST(tiering, optimize_instructions)
+{
+    const auto module = parse(wasm);
+    ASSERT_EQ(module->codesec[0].immediate_size, 1);
+    ASSERT_EQ(module->codesec[1].immediate_size, 1);
+    ASSERT_EQ(module->codesec[2].immediate_size, 1);
+
+    const auto optimize = [&module](FuncIdx idx) {
+        const auto& code = module->codesec[idx];
+        return optimize_instructions(module->get_instructions(code), code.immediate_size);
+    };
+
+    // The pairs of local.get, i32.const + i32.sub with the negated constant.
+    EXPECT_EQ(module->get_instructions(module->codesec[0]),
+        "2000032000200041010000006b210020000d0002010b6a0b"_bytes);
+    EXPECT_EQ(optimize(0), "200003e2002000e0ffffffff6b210020000d0002010b6a0b"_bytes);
+
+    // i32.eqz + br_if.
+    EXPECT_EQ(module->get_instructions(module->codesec[1]),
+        "02032000450d002000200120006a2101200041010000006b21000c0001000b0b20010b"_bytes);
+    EXPECT_EQ(optimize(1),
+        "02032000e10d002000e20120006a21012000e0ffffffff6b21000c0001000b0b20010b"_bytes);
+
+    // i32.const + i32.add.
+    EXPECT_EQ(optimize(2), "2000e0070000006a0b"_bytes);
+}
+
+TEST(tiering, promotion_by_calls)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    auto instance = instantiate(module);
+    instance->tiering = std::make_shared<TieringManager>(module, TieringConfig{3, 1000, false});
+    const auto& tiering = *instance->tiering;
+
+    EXPECT_THAT(execute(*instance, 2, {1}), Result(8));
+    EXPECT_THAT(execute(*instance, 2, {2}), Result(9));
+    EXPECT_FALSE(tiering.is_optimized(2));
+    EXPECT_THAT(execute(*instance, 2, {3}), Result(10));
+    EXPECT_TRUE(tiering.is_optimized(2));
+    EXPECT_THAT(execute(*instance, 2, {0xfffffff9}), Result(0));
+    EXPECT_FALSE(tiering.is_optimized(0));
+    EXPECT_FALSE(tiering.is_optimized(1));
+}
+
+TEST(tiering, promotion_by_back_edges)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    auto instance = instantiate(module);
+    instance->tiering = std::make_shared<TieringManager>(module, TieringConfig{1000, 10, false});
+    const auto& tiering = *instance->tiering;
+
+    EXPECT_THAT(execute(*instance, 0, {5}), Result(6));
+    EXPECT_THAT(execute(*instance, 1, {5}), Result(15));
+    EXPECT_FALSE(tiering.is_optimized(0));
+    EXPECT_FALSE(tiering.is_optimized(1));
+
+    // The running frame finishes in the plain code, the next call uses the optimized code.
+    EXPECT_THAT(execute(*instance, 0, {20}), Result(21));
+    EXPECT_THAT(execute(*instance, 1, {20}), Result(210));
+    EXPECT_TRUE(tiering.is_optimized(0));
+    EXPECT_TRUE(tiering.is_optimized(1));
+    EXPECT_THAT(execute(*instance, 0, {100}), Result(101));
+    EXPECT_THAT(execute(*instance, 1, {100}), Result(5050));
+}
+
+TEST(tiering, background)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    auto instance = instantiate(module);
+    instance->tiering = std::make_shared<TieringManager>(module, TieringConfig{1, 1000, true});
+
+    EXPECT_THAT(execute(*instance, 1, {10}), Result(55));
+    instance->tiering->wait_idle();
+    EXPECT_TRUE(instance->tiering->is_optimized(1));
+    EXPECT_THAT(execute(*instance, 1, {10}), Result(55));
+}
+
+TEST(tiering, shared_by_instances)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    const auto tiering = std::make_shared<TieringManager>(module, TieringConfig{2, 1000, false});
+    auto instance1 = instantiate(module);
+    instance1->tiering = tiering;
+    auto instance2 = copy_instance(*instance1);
+    EXPECT_EQ(instance2->tiering, tiering);
+
+    EXPECT_THAT(execute(*instance1, 2, {1}), Result(8));
+    EXPECT_THAT(execute(*instance2, 2, {2}), Result(9));
+    EXPECT_TRUE(tiering->is_optimized(2));
+}
+
+TEST(tiering, metering_uses_plain_code)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    auto instance = instantiate(module);
+    instance->tiering = std::make_shared<TieringManager>(module, TieringConfig{1, 1, false});
+
+    ExecutionContext ctx;
+    ctx.metering_enabled = true;
+    ctx.ticks = 1000;
+    EXPECT_THAT(execute(*instance, 1, {5}, ctx), Result(15));
+    EXPECT_FALSE(instance->tiering->is_optimized(1));
+}
@@ -173,3 +173,28 @@ TEST(utf8, validate_utf8_demo)
         reinterpret_cast<const uint8_t*>(utf8_demo.data()), utf8_demo.size()};
     EXPECT_TRUE(utf8_validate(utf8_demo_bytes));
 }
+
+TEST(utf8, ascii_blocks)
+{
+    // Check non-ASCII characters at all positions of ASCII strings spanning multiple blocks.
+    constexpr size_t size = 80;
+    const bytes ascii(size, 'a');
+    EXPECT_TRUE(utf8_validate(ascii));
+
+    for (size_t i = 0; i < size - 1; ++i)
+    {
+        auto valid = ascii;
+        valid.replace(i, 2, "c2a9"_bytes);  // U+00A9
+        EXPECT_TRUE(utf8_validate({valid.data(), i + 2})) << i;
+        EXPECT_TRUE(utf8_validate(valid)) << i;
+
+        auto invalid = ascii;
+        invalid[i] = 0x80;
+        EXPECT_FALSE(utf8_validate(invalid)) << i;
+        EXPECT_TRUE(utf8_validate({invalid.data(), i})) << i;
+
+        auto truncated = ascii.substr(0, i + 1);
+        truncated[i] = 0xe0;
+        EXPECT_FALSE(utf8_validate(truncated)) << i;
+    }
+}
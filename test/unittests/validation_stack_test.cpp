@@ -132,6 +132,23 @@ TEST(validation_stack, block_stack_underflow)
     EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "stack underflow");
 }
 
+TEST(validation_stack, block_with_params)
+{
+    /* wat2wasm
+    (type $t (func (param i32) (result i32 i32)))
+    (func (type $t)
+      local.get 0
+      (block (type $t)
+        i32.const 1
+      )
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001070160017f027f7f030201000a0b0109002000020041010b0b");
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->codesec[0].max_stack_height, 2);
+}
+
 TEST(validation_stack, block_with_result)
 {
     /* wat2wasm
@@ -870,6 +887,39 @@ TEST(validation_stack, else_missing_result)
         parse(wasm_unreachable), validation_error, "missing result in else branch");
 }
 
+TEST(validation_stack, if_with_params_without_else)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      i32.const 1
+      local.get 0
+      (if (param i32) (result i32)
+        (then)
+      )
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001060160017f017f030201000a0b0109004101200004000b0b");
+    EXPECT_NO_THROW(parse(wasm));
+
+    /* wat2wasm --no-check
+    (type $t (func (param i32) (result i64)))
+    (func (param i32) (result i32)
+      i32.const 1
+      local.get 0
+      (if (type $t)
+        (then drop i64.const 0)
+      )
+      drop
+      local.get 0
+    )
+    */
+    const auto wasm_missing_else = from_hex(
+        "0061736d01000000010b0260017f017e60017f017f030201010a11010f004101200004001a42000b1a20000b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm_missing_else), validation_error, "missing result in else branch");
+}
+
 TEST(validation_stack, else_missing_result_v2)
 {
     /* wat2wasm --no-check
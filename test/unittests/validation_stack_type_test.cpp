@@ -434,6 +434,22 @@ TEST(validation_stack_type, block_type_mismatch)
     EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "type mismatch");
 }
 
+TEST(validation_stack_type, block_param_type_mismatch)
+{
+    /* wat2wasm --no-check
+    (type $t (func (param i64)))
+    (func
+      i32.const 0
+      (block (type $t)
+        drop
+      )
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001080260000060017e00030201000a0a010800410002011a0b0b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "type mismatch");
+}
+
 TEST(validation_stack_type, unreachable_end)
 {
     /* wat2wasm
@@ -13,13 +13,15 @@
 using namespace fizzy;
 using namespace fizzy::test;
 
-TEST(validation, function_type_invalid_arity)
+TEST(validation, function_type_multiple_results)
 {
-    /* wat2wasm --no-check
+    /* wat2wasm
     (type (func (result i32 i32)))
     */
     const auto wasm = from_hex("0061736d010000000106016000027f7f");
-    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "function has more than one result");
+    const auto module = parse(wasm);
+    ASSERT_EQ(module->typesec.size(), 1);
+    EXPECT_EQ(module->typesec[0].outputs, (std::vector{ValType::i32, ValType::i32}));
 }
 
 TEST(validation, imported_function_unknown_type)
@@ -335,6 +337,165 @@ TEST(validation, memory_size_no_memory)
         parse(wasm), validation_error, "memory instructions require imported or defined memory");
 }
 
+TEST(validation, memory_fill_no_memory)
+{
+    /* wat2wasm --enable-bulk-memory --no-check
+    (func (memory.fill (i32.const 0) (i32.const 0) (i32.const 0)))
+    */
+    const auto wasm =
+        from_hex("0061736d01000000010401600000030201000a0d010b00410041004100fc0b000b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm), validation_error, "memory instructions require imported or defined memory");
+}
+
+TEST(validation, memory_init_without_data_count)
+{
+    /* wat2wasm --enable-bulk-memory
+    (memory 1)
+    (func (memory.init 0 (i32.const 0) (i32.const 0) (i32.const 0)))
+    (data "")
+    */
+    // The data count section removed.
+    const auto wasm = from_hex(
+        "0061736d010000000104016000000302010005030100010a0d010b00410041004100fc08000b0b03010100");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "data count section required");
+}
+
+TEST(validation, memory_init_invalid_data_index)
+{
+    /* wat2wasm --enable-bulk-memory --no-check
+    (memory 1)
+    (func (memory.init 1 (i32.const 0) (i32.const 0) (i32.const 0)))
+    (data "")
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000104016000000302010005030100010c01010a0d010b00410041004100fc08010b0b0301"
+        "0100");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "invalid data segment index");
+}
+
+TEST(validation, data_drop_no_memory)
+{
+    /* wat2wasm --enable-bulk-memory
+    (func (data.drop 0))
+    (data "\01")
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010401600000030201000c01010a07010500fc09000b0b0401010101");
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->datacount, 1);
+}
+
+TEST(validation, v128_constant_expression_type_mismatch)
+{
+    /* wat2wasm --enable-simd --no-check
+    (global i32 (v128.const i64x2 0 0))
+    */
+    const auto wasm = from_hex("0061736d010000000616017f00fd0c000000000000000000000000000000000b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "constant expression type mismatch");
+}
+
+TEST(validation, v128_constant_expression_invalid_instruction)
+{
+    /* wat2wasm --enable-simd --no-check
+    (global v128 (i8x16.splat))
+    */
+    const auto wasm = from_hex("0061736d010000000606017b00fd0f0b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error,
+        "unexpected instruction in the constant expression: 253 15");
+}
+
+TEST(validation, simd_invalid_lane_index)
+{
+    /* wat2wasm --enable-simd --no-check
+    (func (result i32) (i8x16.extract_lane_s 16 (v128.const i64x2 0 0)))
+    */
+    const auto wasm1 = from_hex(
+        "0061736d010000000105016000017f030201000a19011700fd0c00000000000000000000000000000000fd15"
+        "100b");
+    EXPECT_THROW_MESSAGE(parse(wasm1), validation_error, "invalid lane index");
+
+    /* wat2wasm --enable-simd --no-check
+    (func (drop (i8x16.shuffle 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 32
+      (v128.const i64x2 0 0) (v128.const i64x2 0 0))))
+    */
+    const auto wasm2 = from_hex(
+        "0061736d01000000010401600000030201000a3b013900fd0c00000000000000000000000000000000fd0c00"
+        "000000000000000000000000000000fd0d000000000000000000000000000000201a0b");
+    EXPECT_THROW_MESSAGE(parse(wasm2), validation_error, "invalid lane index");
+}
+
+TEST(validation, simd_load_no_memory)
+{
+    /* wat2wasm --enable-simd --no-check
+    (func (drop (v128.load (i32.const 0))))
+    */
+    const auto wasm = from_hex("0061736d01000000010401600000030201000a0b0109004100fd0004001a0b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm), validation_error, "memory instructions require imported or defined memory");
+}
+
+TEST(validation, simd_load_alignment)
+{
+    /* wat2wasm --enable-simd --no-check
+    (memory 1)
+    (func (drop (v128.load align=32 (i32.const 0))))
+    */
+    const auto wasm =
+        from_hex("0061736d010000000104016000000302010005030100010a0b0109004100fd0005001a0b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "alignment cannot exceed operand size");
+}
+
+TEST(validation, simd_type_mismatch)
+{
+    /* wat2wasm --enable-simd --no-check
+    (func (drop (i32x4.add (i32.const 0) (i32.const 0))))
+    */
+    const auto wasm = from_hex("0061736d01000000010401600000030201000a0c010a0041004100fdae011a0b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "type mismatch");
+}
+
+TEST(validation, atomic_alignment)
+{
+    /* wat2wasm --enable-threads --no-check
+    (memory 1)
+    (func (drop (i32.atomic.load align=1 (i32.const 0))))
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000104016000000302010005030100010a0b0109004100fe1000001a0b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm), validation_error, "atomic alignment must be equal to operand size");
+}
+
+TEST(validation, atomic_no_memory)
+{
+    /* wat2wasm --enable-threads --no-check
+    (func (drop (i32.atomic.load (i32.const 0))))
+    */
+    const auto wasm =
+        from_hex("0061736d01000000010401600000030201000a0b0109004100fe1002001a0b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm), validation_error, "memory instructions require imported or defined memory");
+}
+
+TEST(validation, atomic_fence_flags)
+{
+    const auto wasm =
+        from_hex("0061736d010000000104016000000302010005030100010a07010500fe03010b");
+    EXPECT_THROW_MESSAGE(parse(wasm), parser_error, "invalid atomic.fence flags");
+}
+
+TEST(validation, atomic_type_mismatch)
+{
+    /* wat2wasm --enable-threads --no-check
+    (memory 1)
+    (func (drop (i32.atomic.rmw.add (i64.const 0) (i32.const 0))))
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000104016000000302010005030100010a0d010b0042004100fe1e02001a0b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "type mismatch");
+}
+
 TEST(validation, store_alignment)
 {
     // NOTE: could use instruction_metrics here, but better to have two sources of truth for testing
@@ -626,6 +787,67 @@ TEST(validation, call_indirect_no_table)
     EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "call_indirect without defined table");
 }
 
+TEST(validation, return_call_unknown_function)
+{
+    /* wat2wasm --no-check --enable-tail-call
+    (func (import "m" "f"))
+    (func (result i32) return_call 2)
+    */
+    const auto wasm =
+        from_hex("0061736d010000000108026000006000017f020701016d01660000030201010a0601040012020b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm), validation_error, "invalid funcidx encountered with return_call");
+}
+
+TEST(validation, return_call_result_type_mismatch)
+{
+    /* wat2wasm --no-check --enable-tail-call
+    (func $g (result i32) (i32.const 0))
+    (func (result i64) (return_call $g))
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000109026000017f6000017e03030200010a0b02040041000b040012000b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "return_call result type mismatch");
+}
+
+TEST(validation, return_call_indirect_result_type_mismatch)
+{
+    /* wat2wasm --no-check --enable-tail-call
+    (table 1 funcref)
+    (func (param i32)
+      (return_call_indirect (result i32) (local.get 0))
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001090260017f006000017f030201000404017000010a0901070020001301000b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm), validation_error, "return_call_indirect result type mismatch");
+}
+
+TEST(validation, return_call_indirect_no_table)
+{
+    /* wat2wasm --no-check --enable-tail-call
+    (func (param i32)
+      (return_call_indirect (type 0) (local.get 0))
+    )
+    */
+    const auto wasm = from_hex("0061736d0100000001050160017f00030201000a0901070020001300000b");
+    EXPECT_THROW_MESSAGE(
+        parse(wasm), validation_error, "return_call_indirect without defined table");
+}
+
+TEST(validation, return_call_stack_polymorphic)
+{
+    /* wat2wasm --enable-tail-call
+    (func $g (result i32) (i32.const 1))
+    (func (result i32) (return_call $g) (i32.add))
+    */
+    const auto wasm =
+        from_hex("0061736d010000000105016000017f03030200000a0c02040041010b050012006a0b");
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->codesec[1].max_stack_height, 0);
+}
+
 TEST(validation, export_invalid_index)
 {
     /* wat2wasm --no-check
@@ -965,3 +1187,72 @@ TEST(validation, tee_local_out_of_bounds)
         from_hex("0061736d0100000001070160027f7e017f030201000a0c010a02017e017f410022040b");
     EXPECT_THROW_MESSAGE(parse(wasm4), validation_error, "invalid local index");
 }
+
+TEST(validation, local_types_in_runs)
+{
+    /* wat2wasm --no-check
+    (func (param i32) (result i64)
+      (local i64 i64)
+      (local f64 f64 f64)
+      local.get N
+    )
+    */
+    // The locals vector contains also the empty run of f32 locals between i64 and f64 runs.
+    const auto wasm = [](uint8_t local_idx) {
+        return from_hex("0061736d0100000001060160017f017e030201000a0c010a03027e007d037c20") +
+               bytes{local_idx, 0x0b};
+    };
+
+    EXPECT_NO_THROW(parse(wasm(1)));
+    EXPECT_NO_THROW(parse(wasm(2)));
+    EXPECT_THROW_MESSAGE(parse(wasm(0)), validation_error, "type mismatch");
+    EXPECT_THROW_MESSAGE(parse(wasm(3)), validation_error, "type mismatch");
+    EXPECT_THROW_MESSAGE(parse(wasm(5)), validation_error, "type mismatch");
+    EXPECT_THROW_MESSAGE(parse(wasm(6)), validation_error, "invalid local index");
+}
+
+TEST(validation, validate_without_code)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      (block (result i32)
+        (i32.const 1)
+        (local.get 0)
+        (br_if 0)
+        (drop)
+        (i32.const 2)
+      )
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001060160017f017f030201000a10010e00027f410120000d001a41020b0b");
+    EXPECT_NO_THROW(validate(wasm));
+    EXPECT_NO_THROW(parse(wasm));
+
+    /* wat2wasm --no-check
+    (func (result i32)
+      local.get 0
+    )
+    */
+    const auto wasm_invalid_local =
+        from_hex("0061736d010000000105016000017f030201000a0601040020000b");
+    EXPECT_THROW_MESSAGE(validate(wasm_invalid_local), validation_error, "invalid local index");
+
+    /* wat2wasm --no-check
+    (global i32 (i32.const 0))
+    (func (param i32)
+      (i32.const 0)
+      (global.set 0)
+    )
+    */
+    const auto wasm_immutable_global =
+        from_hex("0061736d0100000001050160017f00030201000606017f0041000b0a08010600410024000b");
+    EXPECT_THROW_MESSAGE(
+        validate(wasm_immutable_global), validation_error, "trying to mutate immutable global");
+
+    // The code entry size covers an extra byte after the end of the function body.
+    const auto wasm_malformed_size =
+        from_hex("0061736d010000000105016000017f030201000a07010500410b0b00");
+    EXPECT_THROW_MESSAGE(
+        validate(wasm_malformed_size), parser_error, "malformed size field for function");
+}
@@ -0,0 +1,115 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "async.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/hex.hpp>
+#include <exception>
+#include <optional>
+#include <vector>
+
+#ifndef __cpp_impl_coroutine
+#error "C++20 coroutines are required"
+#endif
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+  (func $read (import "env" "read") (param i32) (result i32))
+  (func (param i32) (result i32) (i32.add (call $read (local.get 0)) (call $read (i32.const 10))))
+  (func (param i32) (result i32) (if (local.get 0) (then unreachable)) (local.get 0))
+*/
+const auto wasm = from_hex(
+    "0061736d0100000001060160017f017f020c0103656e76047265616400000303020000"
+    "0a18020b0020001000410a10006a0b0a0020000440000b20000b");
+
+/// The host function suspending the execution, recording its argument in the host context.
+ExecutionResult suspend_host_fn(
+    std::any& host_context, Instance&, const Value* args, ExecutionContext&) noexcept
+{
+    std::any_cast<std::vector<uint32_t>*>(host_context)->push_back(args[0].i32);
+    return Suspended;
+}
+
+std::unique_ptr<Instance> instantiate_suspending(std::vector<uint32_t>& host_args)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    return instantiate(module, {{{suspend_host_fn, &host_args}, module->typesec[0]}});
+}
+
+/// The coroutine which starts eagerly and is never awaited.
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+Task execute_task(Instance& instance, FuncIdx func_idx, uint32_t arg, AsyncExecutionContext& ctx,
+    std::optional<ExecutionResult>& ret, std::optional<uint32_t>& result)
+{
+    const Value args[]{arg};
+    Value results[1]{};
+    ret.emplace(co_await execute_async(instance, func_idx, args, results, ctx));
+    if (!ret->trapped)
+        result = results[0].i32;
+}
+}  // namespace
+
+TEST(execute_async, coroutine)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    AsyncExecutionContext ctx;
+    std::optional<ExecutionResult> ret;
+    std::optional<uint32_t> result;
+    execute_task(*instance, 1, 3, ctx, ret, result);
+    EXPECT_FALSE(ret.has_value());
+    EXPECT_EQ(host_args, std::vector<uint32_t>{3});
+
+    const Value host_result1{100};
+    resume_async(ctx, &host_result1);
+    EXPECT_FALSE(ret.has_value());
+    EXPECT_EQ(host_args, (std::vector<uint32_t>{3, 10}));
+
+    const Value host_result2{7};
+    resume_async(ctx, &host_result2);
+    ASSERT_TRUE(ret.has_value());
+    EXPECT_FALSE(ret->trapped);
+    EXPECT_EQ(result, 107);
+    EXPECT_EQ(ctx.suspendable_execution, nullptr);
+}
+
+TEST(execute_async, coroutine_not_suspended)
+{
+    std::vector<uint32_t> host_args;
+    auto instance = instantiate_suspending(host_args);
+
+    // The execution finishing without suspension does not suspend the coroutine.
+    AsyncExecutionContext ctx;
+    std::optional<ExecutionResult> ret;
+    std::optional<uint32_t> result;
+    execute_task(*instance, 2, 0, ctx, ret, result);
+    ASSERT_TRUE(ret.has_value());
+    EXPECT_FALSE(ret->trapped);
+    EXPECT_EQ(result, 0);
+
+    ret.reset();
+    result.reset();
+    execute_task(*instance, 2, 1, ctx, ret, result);
+    ASSERT_TRUE(ret.has_value());
+    EXPECT_TRUE(ret->trapped);
+    EXPECT_FALSE(result.has_value());
+    EXPECT_TRUE(host_args.empty());
+}
@@ -64,6 +64,8 @@ std::ostream& operator<<(std::ostream& os, const TypedExecutionResult& result)
         case ValType::f64:
             os << FP{result.value.f64} << " (f64)";
             break;
+        case ValType::v128:  // Not used in function types.
+            break;
         }
         os << ")";
     }
@@ -39,11 +39,11 @@ FizzyExecutionResult env_adler32(
         const auto ret = fizzy::test::adler32(
             bytes_view(memory, size)
                 .substr(static_cast<uint32_t>(args[0].i64), static_cast<uint32_t>(args[1].i64)));
-        return {false, true, {ret}};
+        return {false, true, {ret}, false};
     }
     catch (...)
     {
-        return {true, false, {}};
+        return {true, false, {}, false};
     }
 }
 }  // namespace
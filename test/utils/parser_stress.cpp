@@ -0,0 +1,83 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <test/utils/hex.hpp>
+#include <test/utils/parser_stress.hpp>
+#include <test/utils/wasm_binary.hpp>
+
+namespace fizzy::test
+{
+namespace
+{
+/// Creates a module with a single function of the type (func (param i32)) with the given
+/// locals vector and instructions.
+bytes make_module(const bytes& locals, const bytes& instructions)
+{
+    const auto type_section = make_section(1, make_vec({"60017f00"_bytes}));
+    const auto function_section = make_section(3, make_vec({"00"_bytes}));
+    const auto code = add_size_prefix(locals + instructions + "0b"_bytes);
+    const auto code_section = make_section(10, make_vec({code}));
+    return "0061736d01000000"_bytes + type_section + function_section + code_section;
+}
+}  // namespace
+
+bytes deep_nesting(size_t n)
+{
+    bytes instructions;
+    for (size_t i = 0; i < n; ++i)
+        instructions += "0240"_bytes;  // block
+    instructions.append(n, 0x0b);      // end
+    return make_module("00"_bytes, instructions);
+}
+
+bytes deep_br_table(size_t n)
+{
+    bytes instructions;
+    for (size_t i = 0; i < n; ++i)
+        instructions += "0240"_bytes;                    // block
+    instructions += "20000e"_bytes + leb128u_encode(n);  // local.get 0, br_table
+    for (size_t i = 0; i < n; ++i)
+        instructions += leb128u_encode(i);
+    instructions += leb128u_encode(0);
+    instructions.append(n, 0x0b);  // end
+    return make_module("00"_bytes, instructions);
+}
+
+bytes huge_br_table(size_t n)
+{
+    bytes instructions = "20000e"_bytes + leb128u_encode(n);
+    instructions.append(n + 1, 0x00);
+    return make_module("00"_bytes, instructions);
+}
+
+bytes many_locals(size_t n)
+{
+    bytes locals = leb128u_encode(n);
+    for (size_t i = 0; i < n; ++i)
+        locals += "017f"_bytes;
+    bytes instructions;
+    const auto last_local_idx = leb128u_encode(n);
+    for (size_t i = 0; i < n; ++i)
+        instructions += uint8_t{0x20} + last_local_idx + uint8_t{0x1a};  // local.get, drop
+    return make_module(locals, instructions);
+}
+
+bytes long_locals_run(size_t n)
+{
+    const auto locals = "01"_bytes + leb128u_encode(n) + "7e"_bytes;
+    bytes instructions;
+    for (uint32_t i = 1; i <= n; ++i)
+        instructions += uint8_t{0x20} + leb128u_encode(i) + uint8_t{0x1a};  // local.get, drop
+    return make_module(locals, instructions);
+}
+
+bytes deep_operand_stack(size_t n)
+{
+    bytes instructions;
+    for (size_t i = 0; i < n; ++i)
+        instructions += i32_const(0);
+    instructions.append(n, 0x1a);  // drop
+    return make_module("00"_bytes, instructions);
+}
+}  // namespace fizzy::test
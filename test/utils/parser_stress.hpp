@@ -0,0 +1,31 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include <cstddef>
+
+/// Generators of pathological modules of growing sizes for stress testing the parser.
+/// Parsing and validation of these must take time linear in N.
+namespace fizzy::test
+{
+/// N nested empty blocks.
+bytes deep_nesting(size_t n);
+
+/// N nested blocks with the br_table jumping out of each of them at the innermost level.
+bytes deep_br_table(size_t n);
+
+/// A single br_table with N labels, all targeting the function block.
+bytes huge_br_table(size_t n);
+
+/// N runs of locals of single i32 local each, and N accesses to the last local.
+bytes many_locals(size_t n);
+
+/// A single run of N locals, and N accesses to locals spread across the run.
+bytes long_locals_run(size_t n);
+
+/// Deep operand stack: N constants pushed and then dropped.
+bytes deep_operand_stack(size_t n);
+}  // namespace fizzy::test
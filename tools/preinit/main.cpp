@@ -0,0 +1,51 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2022 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+/// Pre-initializes a WebAssembly module, see fizzy::preinitialize().
+/// Usage: fizzy-preinit <input.wasm> <output.wasm> [init_function_name]
+/// Only modules without imported functions and globals can be instantiated by the tool.
+
+#include "preinit.hpp"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 3 || argc > 4)
+        {
+            std::cerr << "Usage: " << argv[0] << " <input.wasm> <output.wasm> [init_function]\n";
+            return -1;
+        }
+
+        std::ifstream input_file{argv[1], std::ios::binary};
+        if (!input_file)
+        {
+            std::cerr << "Failed to open file: " << argv[1] << "\n";
+            return -1;
+        }
+        const fizzy::bytes input(
+            std::istreambuf_iterator<char>{input_file}, std::istreambuf_iterator<char>{});
+
+        const auto init_function_name = argc == 4 ? argv[3] : fizzy::DefaultInitFunctionName;
+        const auto output = fizzy::preinitialize(input, init_function_name);
+
+        std::ofstream output_file{argv[2], std::ios::binary};
+        output_file.write(reinterpret_cast<const char*>(output.data()),
+            static_cast<std::streamsize>(output.size()));
+        if (!output_file)
+        {
+            std::cerr << "Failed to write file: " << argv[2] << "\n";
+            return -1;
+        }
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << "\n";
+        return -2;
+    }
+}